@@ -209,3 +209,122 @@ heap_fill_tuple_s(TupleDesc tupleDesc,
 	/* selog(DEBUG1, "datum was not copied correctly") */
 	/* } */
 }
+
+/*
+ * heap_deform_tuple
+ *		Given a tuple, extract data into values/lens/isnull arrays; this is
+ *		the inverse of heap_form_tuple.
+ *
+ *		Storage for the values/lens/isnull arrays is provided by the caller;
+ *		they should be sized according to tupledesc->natts, not the number
+ *		of attributes in the tuple. values[i] points to the data of the
+ *		attribute on the tuple (with the header of a varlena) and lens[i] is
+ *		its length.
+ *
+ *		The offsets of the attributes that are not preceded by a null or a
+ *		variable length attribute are cached in the descriptor (attcacheoff),
+ *		which must have been set to -1 when the descriptor was created.
+ *
+ *		Returns false if the attributes do not fit in the tuple.
+ */
+bool
+heap_deform_tuple_s(HeapTuple tuple, TupleDesc tupleDesc, char **values,
+					int32 *lens, bool *isnull)
+{
+	HeapTupleHeader tup = tuple->t_data;
+	bool		hasnulls = HeapTupleHeaderHasNulls_s(tup);
+	int			tdesc_natts = tupleDesc->natts;
+	int			natts;			/* number of atts to extract */
+	int			attnum;
+	char	   *tp;				/* ptr to tuple data */
+	uint32		off;			/* offset in tuple data */
+	uint32		datalen;		/* length of the tuple data */
+	uint32		next;
+	bits8	   *bp = tup->t_bits;	/* ptr to null bitmap in tuple */
+	bool		slow = false;	/* can we use/set attcacheoff? */
+
+	if (tuple->t_len < SizeofHeapTupleHeader || tup->t_hoff > tuple->t_len)
+		return false;
+
+	natts = Min_s(HeapTupleHeaderGetNatts_s(tup), tdesc_natts);
+	tp = (char *) tup + tup->t_hoff;
+	datalen = tuple->t_len - tup->t_hoff;
+	off = 0;
+
+	for (attnum = 0; attnum < natts; attnum++)
+	{
+		Form_pg_attribute thisatt = TupleDescAttr_s(tupleDesc, attnum);
+
+		if (hasnulls && att_isnull_s(attnum, bp))
+		{
+			values[attnum] = NULL;
+			lens[attnum] = 0;
+			isnull[attnum] = true;
+			slow = true;		/* can't use attcacheoff anymore */
+			continue;
+		}
+
+		isnull[attnum] = false;
+
+		if (!slow && thisatt->attcacheoff >= 0)
+			off = thisatt->attcacheoff;
+		else if (thisatt->attlen == -1)
+		{
+			/*
+			 * We can only cache the offset for a varlena attribute if the
+			 * offset is already suitably aligned, so that there would be no
+			 * pad bytes in any case: then the offset will be valid for either
+			 * an aligned or unaligned value.
+			 */
+			if (!slow &&
+				off == att_align_nominal_s(off, thisatt->attalign))
+				thisatt->attcacheoff = off;
+			else
+			{
+				if (off >= datalen)
+					return false;
+				off = att_align_pointer_s(off, thisatt->attalign, -1,
+										  tp + off);
+				slow = true;
+			}
+		}
+		else
+		{
+			/* not varlena, so safe to use att_align_nominal */
+			off = att_align_nominal_s(off, thisatt->attalign);
+
+			if (!slow)
+				thisatt->attcacheoff = off;
+		}
+
+		if (off >= datalen)
+			return false;
+		/* a pointer to a toasted value has the size of its tag */
+		if (thisatt->attlen == -1 && VARATT_IS_EXTERNAL_S(tp + off))
+			next = off + VARSIZE_EXTERNAL_S(tp + off);
+		else
+			next = att_addlength_pointer_s(off, thisatt->attlen, tp + off);
+		if (next > datalen)
+			return false;
+
+		values[attnum] = tp + off;
+		lens[attnum] = next - off;
+		off = next;
+
+		if (thisatt->attlen <= 0)
+			slow = true;		/* can't use attcacheoff anymore */
+	}
+
+	/*
+	 * If tuple doesn't have all the atts indicated by tupleDesc, read the
+	 * rest as nulls.
+	 */
+	for (; attnum < tdesc_natts; attnum++)
+	{
+		values[attnum] = NULL;
+		lens[attnum] = 0;
+		isnull[attnum] = true;
+	}
+
+	return true;
+}
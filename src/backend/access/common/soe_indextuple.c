@@ -19,6 +19,7 @@
 #include "access/soe_htup_details.h"
 #include "logger/logger.h"
 #include <stdlib.h>
+#include <string.h>
 
 
 /* ----------------------------------------------------------------
@@ -127,3 +128,54 @@ index_form_tuple_s(TupleDesc tupleDescriptor,
 	tuple->t_info = infomask;
 	return tuple;
 }
+
+
+/*
+ * index_getposting_s
+ *
+ * Decodes the heap TIDs of a posting list tuple into tids, which has room
+ * for maxtids of them. Returns the number of TIDs, or -1 if the posting list
+ * is malformed or does not fit.
+ */
+int
+index_getposting_s(IndexTuple itup, ItemPointer tids, int maxtids)
+{
+	int			ntids = IndexTupleGetNPosting_s(itup);
+	Size		offset = IndexTupleGetPostingOffset_s(itup);
+	Size		size = IndexTupleSize_s(itup);
+	unsigned char *data;
+	uint64		value;
+	uint64		delta;
+	int			shift;
+	int			i;
+
+	if (ntids < 1 || ntids > maxtids ||
+		offset < IndexInfoFindDataOffset_s(itup->t_info) ||
+		offset + sizeof(ItemPointerData) > size)
+		return -1;
+
+	data = (unsigned char *) itup + offset;
+	memcpy(&tids[0], data, sizeof(ItemPointerData));
+	data += sizeof(ItemPointerData);
+	value = ((uint64) ItemPointerGetBlockNumberNoCheck_s(&tids[0]) << 16) |
+		ItemPointerGetOffsetNumberNoCheck_s(&tids[0]);
+
+	for (i = 1; i < ntids; i++)
+	{
+		delta = 0;
+		shift = 0;
+		do
+		{
+			if (data >= (unsigned char *) itup + size || shift > 42)
+				return -1;
+			delta |= (uint64) (*data & 0x7F) << shift;
+			shift += 7;
+		} while (*data++ & 0x80);
+
+		value += delta;
+		ItemPointerSet_s(&tids[i], (BlockNumber) (value >> 16),
+						 (OffsetNumber) (value & 0xFFFF));
+	}
+
+	return ntids;
+}
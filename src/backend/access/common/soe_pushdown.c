@@ -0,0 +1,286 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_pushdown.c
+ *	  Projections and predicates evaluated in the enclave.
+ *
+ * getTupleProject evaluates the predicates of a request on the columns of
+ * the heap tuple of a match, deformed with the column descriptors of the
+ * table (setTableDesc), and only copies the projected columns of a tuple
+ * that satisfies them out of the enclave. Every predicate is evaluated, so
+ * the time taken does not depend on which predicate fails.
+ *
+ * src/backend/access/common/soe_pushdown.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "access/soe_pushdown.h"
+#include "access/soe_htup_details.h"
+#include "access/soe_nbtcompare.h"
+#include "logger/logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Reads the next 4 bytes of a query. */
+static bool
+pushdown_getint_s(const char *query, unsigned int queryLen,
+				  unsigned int *off, int32 *value)
+{
+	if (*off > queryLen || queryLen - *off < sizeof(int32))
+		return false;
+	memcpy(value, query + *off, sizeof(int32));
+	*off += sizeof(int32);
+	return true;
+}
+
+/* Is the column number of a query (from 1) a column of the table? */
+static bool
+pushdown_attnumok_s(TupleDesc desc, int32 attnum)
+{
+	Form_pg_attribute att;
+
+	if (attnum < 1 || attnum > desc->natts)
+		return false;
+	att = TupleDescAttr_s(desc, attnum - 1);
+	return att->attlen > 0 || att->attlen == -1;
+}
+
+/*
+ * Can a predicate be taken on a column of type atttypid? Only the types with
+ * a comparator are accepted, as the others would be read as strings.
+ */
+static bool
+pushdown_typeok_s(Oid atttypid)
+{
+	switch (atttypid)
+	{
+		case INT4OID:
+		case DATEOID:
+		case INT8OID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+		case FLOAT8OID:
+		case BYTEAOID:
+		case BPCHAROID:
+		case VARCHAROID:
+		case TEXTOID:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*
+ * Parses the projection and the predicates of a query on a table with the
+ * columns of desc. Returns NULL if the query is malformed.
+ */
+Pushdown
+pushdown_parse_s(TupleDesc desc, const char *query, unsigned int queryLen)
+{
+	Pushdown	pd;
+	PushdownPredData *pred;
+	unsigned int off = 0;
+	int32		n;
+	int32		attnum;
+	int32		opoid;
+	int32		len;
+	Oid			atttypid;
+	int			i;
+
+	if (desc->attrs == NULL)
+	{
+		selog(ERROR, "Table has no column descriptors");
+		return NULL;
+	}
+
+	pd = (Pushdown) calloc(1, sizeof(PushdownData));
+
+	if (!pushdown_getint_s(query, queryLen, &off, &n) || n < 0 ||
+		(unsigned int) n > queryLen / sizeof(int32))
+		goto fail;
+	pd->proj = (AttrNumber *) malloc(sizeof(AttrNumber) * (n + 1));
+	for (i = 0; i < n; i++)
+	{
+		if (!pushdown_getint_s(query, queryLen, &off, &attnum) ||
+			!pushdown_attnumok_s(desc, attnum))
+			goto fail;
+		pd->proj[i] = attnum - 1;
+	}
+	pd->nproj = n;
+
+	if (!pushdown_getint_s(query, queryLen, &off, &n) || n < 0 ||
+		(unsigned int) n > queryLen / sizeof(int32))
+		goto fail;
+	pd->preds = (PushdownPredData *) calloc(n + 1, sizeof(PushdownPredData));
+	for (i = 0; i < n; i++)
+	{
+		pred = &pd->preds[i];
+		if (!pushdown_getint_s(query, queryLen, &off, &attnum) ||
+			!pushdown_attnumok_s(desc, attnum) ||
+			!pushdown_getint_s(query, queryLen, &off, &opoid) ||
+			!pushdown_getint_s(query, queryLen, &off, &len) ||
+			len < 0 || (unsigned int) len > queryLen - off)
+			goto fail;
+
+		atttypid = TupleDescAttr_s(desc, attnum - 1)->atttypid;
+		if (!pushdown_typeok_s(atttypid))
+		{
+			selog(ERROR, "Predicates on columns of type %d are not supported",
+				  atttypid);
+			goto fail;
+		}
+		pred->attnum = attnum - 1;
+		pred->strategy = _bt_strategy_s((unsigned int) opoid);
+		if (pred->strategy == InvalidStrategy ||
+			!_bt_keysizeok_s(atttypid, len + 1))
+			goto fail;
+
+		/* the constant is terminated as the scan keys of getTuple */
+		pred->key.sk_argument = (char *) malloc(len + 1);
+		memcpy(pred->key.sk_argument, query + off, len);
+		pred->key.sk_argument[len] = '\0';
+		pred->key.datumSize = len + 1;
+		/* the whole column is compared, not a prefix as the index keys */
+		pred->key.sk_cmp = _bt_valuecmp_s(atttypid);
+		off += len;
+		pd->npreds = i + 1;
+	}
+	pd->npreds = n;
+
+	if (off != queryLen)
+		goto fail;
+	return pd;
+
+fail:
+	selog(ERROR, "Malformed projection or predicates at byte %u", off);
+	pushdown_free_s(pd);
+	return NULL;
+}
+
+void
+pushdown_free_s(Pushdown pd)
+{
+	int			i;
+
+	for (i = 0; i < pd->npreds; i++)
+		free(pd->preds[i].key.sk_argument);
+	free(pd->preds);
+	free(pd->proj);
+	free(pd);
+}
+
+/*
+ * The value of a column without its varlena header. Toasted values are not
+ * in the tuple and compressed values can not be compared.
+ */
+static bool
+pushdown_value_s(Form_pg_attribute att, char *value, int32 len,
+				 char **data, int32 *dataLen)
+{
+	if (att->attlen != -1)
+	{
+		*data = value;
+		*dataLen = len;
+		return true;
+	}
+	if (VARATT_IS_EXTERNAL_S(value) || VARATT_IS_COMPRESSED_S(value))
+		return false;
+	*data = VARDATA_ANY_S(value);
+	*dataLen = VARSIZE_ANY_EXHDR_S(value);
+	return true;
+}
+
+/*
+ * Evaluates the predicates of a query on a heap tuple and copies the
+ * projected columns of the tuple to result, each as a 4 byte length (-1 for
+ * a null) followed by the value in the format of the scan keys. Returns the
+ * size of the result, 0 if the tuple does not satisfy the predicates or -1
+ * on an error.
+ */
+int
+pushdown_apply_s(Pushdown pd, TupleDesc desc, HeapTuple tuple, char *result,
+				 unsigned int resultLen)
+{
+	char	  **values;
+	int32	   *lens;
+	bool	   *isnull;
+	char	   *data;
+	int32		dataLen;
+	int32		test;
+	bool		qual = true;
+	int			ncols;
+	int			col;
+	int			i;
+	int			size = 0;
+
+	values = (char **) malloc(sizeof(char *) * desc->natts);
+	lens = (int32 *) malloc(sizeof(int32) * desc->natts);
+	isnull = (bool *) malloc(sizeof(bool) * desc->natts);
+
+	if (!heap_deform_tuple_s(tuple, desc, values, lens, isnull))
+	{
+		selog(ERROR, "Tuple does not match the columns of the table");
+		size = -1;
+		goto done;
+	}
+
+	for (i = 0; i < pd->npreds; i++)
+	{
+		col = pd->preds[i].attnum;
+		if (isnull[col])
+		{
+			qual = false;
+			continue;
+		}
+		if (TupleDescAttr_s(desc, col)->attlen == -1 &&
+			(VARATT_IS_EXTERNAL_S(values[col]) ||
+			 VARATT_IS_COMPRESSED_S(values[col])))
+		{
+			selog(ERROR, "Predicate on a compressed or toasted column %d", col + 1);
+			size = -1;
+			goto done;
+		}
+		/* test compares the column with the constant */
+		test = -pd->preds[i].key.sk_cmp(&pd->preds[i].key, values[col]);
+		qual = _bt_strategymatches_s(pd->preds[i].strategy, test) && qual;
+	}
+	if (!qual)
+		goto done;
+
+	ncols = pd->nproj > 0 ? pd->nproj : desc->natts;
+	for (i = 0; i < ncols; i++)
+	{
+		col = pd->nproj > 0 ? pd->proj[i] : i;
+		if (isnull[col])
+			dataLen = -1;
+		else if (!pushdown_value_s(TupleDescAttr_s(desc, col), values[col],
+								   lens[col], &data, &dataLen))
+		{
+			selog(ERROR, "Projection of a compressed or toasted column %d",
+				  col + 1);
+			size = -1;
+			goto done;
+		}
+
+		if (resultLen - size < sizeof(int32) + Max_s(dataLen, 0))
+		{
+			selog(ERROR, "Projected columns do not fit in %u bytes", resultLen);
+			size = -1;
+			goto done;
+		}
+		memcpy(result + size, &dataLen, sizeof(int32));
+		size += sizeof(int32);
+		if (dataLen > 0)
+		{
+			memcpy(result + size, data, dataLen);
+			size += dataLen;
+		}
+	}
+
+done:
+	free(values);
+	free(lens);
+	free(isnull);
+	return size;
+}
@@ -23,6 +23,67 @@
 #include "access/soe_itup.h"
 #include "logger/logger.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+ *	hash_load_s() -- write a block of an index built outside of the enclave.
+ *
+ *	The blocks are loaded in order, starting with the metapage, which is
+ *	cached to map the scan keys to their buckets without reading it from the
+ *	ORAM. The index is a static table: a bucket chain can not hold more than
+ *	HASH_DEPTH pages, as every scan reads that many. A block that can not be
+ *	loaded fails the load of the index, which then rejects every scan, as
+ *	the scans would miss the tuples of the block.  Returns false if the
+ *	block was rejected.
+ */
+bool
+hash_load_s(VRelation rel, char *block, unsigned int offset)
+{
+	Buffer		buffer;
+	HashPageOpaque opaque;
+	HashMetaPage metap;
+
+	opaque = (HashPageOpaque) PageGetSpecialPointer_s((Page) block);
+
+	if (opaque->hasho_flag & LH_META_PAGE)
+	{
+		if (rel->rd_amcache == NULL)
+			rel->rd_amcache = (char *) malloc(sizeof(HashMetaPageData));
+		memcpy(rel->rd_amcache, HashPageGetMeta_s((Page) block),
+			   sizeof(HashMetaPageData));
+
+		metap = (HashMetaPage) rel->rd_amcache;
+		rel->nbuckets = metap->hashm_maxbucket + 1;
+		free(rel->chainPages);
+		rel->chainPages = (uint16 *) calloc(rel->nbuckets, sizeof(uint16));
+	}
+	else if (opaque->hasho_flag & (LH_BUCKET_PAGE | LH_OVERFLOW_PAGE))
+	{
+		if (rel->chainPages == NULL || opaque->hasho_bucket >= rel->nbuckets)
+		{
+			selog(ERROR, "hash block %d of bucket %d loaded before the metapage",
+				  offset, opaque->hasho_bucket);
+			rel->loadFailed = true;
+			return false;
+		}
+		if (++rel->chainPages[opaque->hasho_bucket] > HASH_DEPTH)
+		{
+			selog(ERROR, "hash bucket %d has more than %d pages",
+				  opaque->hasho_bucket, HASH_DEPTH);
+			rel->loadFailed = true;
+			return false;
+		}
+	}
+
+	buffer = ReadBuffer_s(rel, offset);
+	memcpy(BufferGetPage_s(rel, buffer), block, BLCKSZ);
+	MarkBufferDirty_s(rel, buffer);
+	ReleaseBuffer_s(rel, buffer);
+	return true;
+}
+
 /*
  *	hashinsert() -- insert an index tuple into a hash table.
  *
@@ -121,6 +182,7 @@ hashbeginscan_s(VRelation irel, const char *key, int keysize)
 	scanKey->sk_argument = (char *) malloc(keysize);
 	memcpy(scanKey->sk_argument, key, keysize);
 	scanKey->datumSize = keysize;
+	scanKey->sk_norm = NULL;
 
 	so = (HashScanOpaque) malloc(sizeof(HashScanOpaqueData));
 	HashScanPosInvalidate_s(so->currPos);
@@ -129,6 +191,7 @@ hashbeginscan_s(VRelation irel, const char *key, int keysize)
 
 	so->hashso_buc_populated = false;
 	so->hashso_buc_split = false;
+	so->hashso_npages = 0;
 
 	/* so->killedItems = NULL; */
 	/* so->numKilled = 0; */
@@ -142,6 +205,13 @@ hashbeginscan_s(VRelation irel, const char *key, int keysize)
 	scan->xs_ctup.t_data = NULL;
 	scan->xs_cbuf = InvalidBuffer;
 	scan->xs_continue_hot = false;
+	scan->xs_want_itup = false;
+	scan->xs_itup = NULL;
+	scan->xs_heapfetch = true;
+	scan->xs_kill = false;
+	scan->xs_killed = false;
+	scan->xs_exact = false;
+	scan->xs_hikey = NULL;
 
 	return scan;
 }
@@ -157,6 +227,10 @@ hashendscan_s(IndexScanDesc scan)
 
 	_hash_dropscanbuf_s(rel, so);
 
+	/* Every scan reads HASH_DEPTH pages, whatever the length of the chain. */
+	for (; so->hashso_npages < HASH_DEPTH; so->hashso_npages++)
+		ReadDummyBuffer(rel, rel->totalBlocks + 1);
+
 	free(scan->keyData->sk_argument);
 	free(scan->keyData);
 	free(so);
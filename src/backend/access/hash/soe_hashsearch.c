@@ -62,6 +62,7 @@ _hash_next_s(IndexScanDesc scan)
 		if (BlockNumberIsValid_s(blkno))
 		{
 			buf = _hash_getbuf_s(rel, blkno, HASH_READ, LH_OVERFLOW_PAGE);
+			so->hashso_npages++;
 			if (!_hash_readpage_s(scan, buf))
 				end_of_scan = true;
 		}
@@ -120,6 +121,7 @@ _hash_readnext_s(IndexScanDesc scan,
 		 * ",BlockNumberIsValid_s(blkno));
 		 */
 		*bufp = _hash_getbuf_s(rel, blkno, HASH_READ, LH_OVERFLOW_PAGE);
+		so->hashso_npages++;
 		block_found = true;
 	}
 
@@ -159,6 +161,7 @@ _hash_first_s(IndexScanDesc scan)
 
 	/* Bucket		bucket; */
 	Buffer		buf;
+	Buffer		metabuf;
 
 /* 	Page		page; */
 /* 	HashPageOpaque opaque; */
@@ -183,7 +186,19 @@ _hash_first_s(IndexScanDesc scan)
 
 	so->hashso_sk_hash = hashkey;
 
-	buf = _hash_getbucketbuf_from_hashkey_s(rel, hashkey, HASH_READ, NULL);
+	/*
+	 * The metapage is cached when the index is loaded, so a scan only reads
+	 * the pages of the bucket chain.
+	 */
+	if (rel->rd_amcache == NULL)
+	{
+		_hash_getcachedmetap_s(rel, &metabuf, true);
+		ReleaseBuffer_s(rel, metabuf);
+	}
+
+	buf = _hash_getbucketbuf_from_hashkey_s(rel, hashkey, HASH_READ,
+											(HashMetaPage) rel->rd_amcache);
+	so->hashso_npages++;
 
 	so->hashso_bucket_buf = buf;
 
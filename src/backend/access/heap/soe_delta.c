@@ -0,0 +1,185 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_delta.c
+ *	  Delta ORAM of a table for cheap appends.
+ *
+ * Tuples are appended with their keys to a small heap ORAM instead of being
+ * inserted on the table and its index, which needs padded splits. A lookup
+ * reads every block of the delta after searching the index, so its accesses
+ * do not depend on the key or on the contents of the delta, and mergeDelta
+ * (soe.c) periodically moves the appended tuples to the table and its index.
+ *
+ * src/backend/access/heap/soe_delta.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "access/soe_delta.h"
+#include "access/soe_nbtcompare.h"
+#include "logger/logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Reads the block where the next entry goes, initializing the page of a
+ * block without entries as heap_insert_s does.
+ */
+static Buffer
+delta_getbuffer_s(VRelation rel)
+{
+	Buffer		buffer;
+	bool		empty;
+
+	empty = FreeSpaceBlock_s(rel) == P_NEW;
+	buffer = ReadBuffer_s(rel, rel->currentBlock);
+	if (empty)
+		rel->pageinit(BufferGetPage_s(rel, buffer),
+					  rel->blockOffset + rel->currentBlock, 0, BLCKSZ);
+	return buffer;
+}
+
+/*
+ * Appends a tuple and its key to the delta. Like an insert on the heap,
+ * the delta is read twice and written once, whether the entry fits on the
+ * current block or not. Returns false if the delta is full.
+ */
+bool
+delta_insert_s(VRelation rel, const char *key, uint32 keySize,
+			   const char *tuple, uint32 tupleSize)
+{
+	DeltaTuple	dtup;
+	Size		len = DeltaTupleSize(keySize, tupleSize);
+	Buffer		buffer;
+	Page		page;
+	bool		moved = false;
+	bool		inserted = false;
+
+	dtup = (DeltaTuple) malloc(len);
+	dtup->keySize = keySize;
+	dtup->tupleSize = tupleSize;
+	memcpy(DeltaTupleGetKey(dtup), key, keySize);
+	memcpy(DeltaTupleGetTuple(dtup), tuple, tupleSize);
+
+	buffer = delta_getbuffer_s(rel);
+	page = BufferGetPage_s(rel, buffer);
+	if (MAXALIGN_s(len) > PageGetHeapFreeSpace_s(page) &&
+		rel->currentBlock < rel->totalBlocks - 1)
+	{
+		ReleaseBuffer_s(rel, buffer);
+		BufferFull_s(rel, buffer);
+		buffer = delta_getbuffer_s(rel);
+		page = BufferGetPage_s(rel, buffer);
+		moved = true;
+	}
+
+	if (PageAddItem_s(page, (Item) dtup, len, InvalidOffsetNumber, false,
+					  true) != InvalidOffsetNumber)
+	{
+		UpdateFSM(rel);
+		inserted = true;
+	}
+	else
+		selog(ERROR, "Delta of relation %d is full", rel->rd_id);
+
+	if (!moved)
+		ReadDummyBuffer(rel, rel->totalBlocks + 1);
+	MarkBufferDirty_s(rel, buffer);
+	ReleaseBuffer_s(rel, buffer);
+	free(dtup);
+
+	return inserted;
+}
+
+/*
+ * Searches the entries of a delta page in append order for the first key
+ * that satisfies the scan key.
+ */
+static bool
+delta_searchpage_s(Page page, ScanKey skey, StrategyNumber strategy,
+				   TupleDesc desc, keycmp_function keycmp, HeapTuple tuple,
+				   IndexTuple *itup)
+{
+	OffsetNumber offnum;
+	OffsetNumber maxoff = PageGetMaxOffsetNumber_s(page);
+	ItemId		lp;
+	DeltaTuple	dtup;
+	IndexTuple	key;
+	int			test;
+
+	for (offnum = FirstOffsetNumber; offnum <= maxoff;
+		 offnum = OffsetNumberNext_s(offnum))
+	{
+		lp = PageGetItemId_s(page, offnum);
+		/* the entries already merged on the table are dead */
+		if (!ItemIdIsNormal_s(lp))
+			continue;
+
+		dtup = (DeltaTuple) PageGetItem_s(page, lp);
+		key = _bt_formkeytuple_s(desc, DeltaTupleGetKey(dtup), dtup->keySize);
+		if (key == NULL)
+			continue;
+
+		/* test compares the key with the scan key, the comparator the other way */
+		test = -keycmp(skey, index_getattr_s(key));
+		if (!_bt_strategymatches_s(strategy, test))
+		{
+			free(key);
+			continue;
+		}
+
+		tuple->t_len = dtup->tupleSize;
+		tuple->t_data = (HeapTupleHeader) malloc(dtup->tupleSize);
+		memcpy(tuple->t_data, DeltaTupleGetTuple(dtup), dtup->tupleSize);
+		ItemPointerSetInvalid_s(&(tuple->t_self));
+		if (itup != NULL)
+		{
+			ItemPointerSetInvalid_s(&(key->t_tid));
+			*itup = key;
+		}
+		else
+			free(key);
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Searches the delta for the first appended tuple whose key satisfies the
+ * scan key of a getTuple request, with the comparator of the index. Every
+ * block of the delta is read, whether a match is found or not. On a match,
+ * tuple holds a copy of the heap tuple (without a TID) and, if itup is not
+ * NULL, *itup the index tuple of the key.
+ */
+bool
+delta_search_s(VRelation rel, ScanKey skey, StrategyNumber strategy,
+			   TupleDesc desc, keycmp_function keycmp, HeapTuple tuple,
+			   IndexTuple *itup)
+{
+	BlockNumber blkno;
+	Buffer		buffer;
+	bool		found = false;
+
+	tuple->t_tableOid = RelationGetRelid_s(rel);
+	for (blkno = 0; blkno < (BlockNumber) rel->totalBlocks; blkno++)
+	{
+		buffer = ReadBuffer_s(rel, blkno);
+		/* blocks without entries may hold the entries of a merged delta */
+		if (!found && rel->fsm[blkno] > 0)
+			found = delta_searchpage_s(BufferGetPage_s(rel, buffer), skey,
+									   strategy, desc, keycmp, tuple, itup);
+		ReleaseBuffer_s(rel, buffer);
+	}
+	return found;
+}
+
+/* Empties the delta after its tuples were merged on the table. */
+void
+delta_reset_s(VRelation rel)
+{
+	int			blkno;
+
+	for (blkno = 0; blkno < rel->totalBlocks; blkno++)
+		rel->fsm[blkno] = 0;
+	rel->currentBlock = 0;
+}
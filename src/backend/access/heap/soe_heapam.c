@@ -1,9 +1,35 @@
 
 /* #include "access/soe_genam.h" */
 #include "access/soe_heapam.h"
+#include "access/soe_htup_details.h"
 #include "logger/logger.h"
 #include "common/soe_prf.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Reads the block where the next tuple goes. A block without tuples has not
+ * been initialized by the loaded blocks, so its page is initialized here.
+ */
+static Buffer
+heap_getfreebuffer_s(VRelation rel)
+{
+	Buffer		buffer;
+	bool		empty;
+
+	empty = FreeSpaceBlock_s(rel) == P_NEW;
+	buffer = ReadBuffer_s(rel, rel->currentBlock);
+	if (empty)
+		rel->pageinit(BufferGetPage_s(rel, buffer),
+					  rel->blockOffset + rel->currentBlock, 0, BLCKSZ);
+	return buffer;
+}
+
+/*
+ * Inserts the tuple on the current free space block of the relation. If the
+ * relation is full, tuple->t_self is set invalid.
+ */
 void
 heap_insert_s(VRelation rel, Item tup, Size len, HeapTuple tuple)
 {
@@ -14,13 +40,8 @@ heap_insert_s(VRelation rel, Item tup, Size len, HeapTuple tuple)
 	Size		pageFreeSpace,
 				saveFreeSpace;
 	Size		alignedSize;
-	BlockNumber freeSpaceBlock;
-
-	freeSpaceBlock = FreeSpaceBlock_s(rel);
-
-	/* selog(DEBUG1, "Free space block returned is %d", freeSpaceBlock); */
 
-	buffer = ReadBuffer_s(rel, freeSpaceBlock);
+	buffer = heap_getfreebuffer_s(rel);
 
 	/* selog(DEBUG1, "buffer id is %d", buffer); */
 	if (buffer == DUMMY_BLOCK)
@@ -59,12 +80,27 @@ heap_insert_s(VRelation rel, Item tup, Size len, HeapTuple tuple)
 		BufferFull_s(rel, buffer);
 
 		ReleaseBuffer_s(rel, buffer);
-		buffer = ReadBuffer_s(rel, FreeSpaceBlock_s(rel));
+
+		/* the last block holds a copy of the first one */
+		if (rel->currentBlock >= rel->totalBlocks - 1)
+		{
+			selog(ERROR, "Relation %d has no free blocks", rel->rd_id);
+			rel->currentBlock = rel->totalBlocks - 2;
+			ItemPointerSetInvalid_s(&(tuple->t_self));
+			return;
+		}
+		buffer = heap_getfreebuffer_s(rel);
 		page = BufferGetPage_s(rel, buffer);
 	}
 
 	offnum = PageAddItem_s(page, tup, len, InvalidOffsetNumber, false, true);
-
+	if (offnum == InvalidOffsetNumber)
+	{
+		selog(ERROR, "Failed to add tuple to block %d", rel->currentBlock);
+		ReleaseBuffer_s(rel, buffer);
+		ItemPointerSetInvalid_s(&(tuple->t_self));
+		return;
+	}
 
 	tuple->t_data = (HeapTupleHeader) tup;
 	tuple->t_len = len;
@@ -123,15 +159,15 @@ heap_insert_block_s(VRelation rel, char *rpage, int blkno)
     //selog(DEBUG1, "Inserting heap block %d, level %d", blkno, level);
 
     r_blkno = (int*) PageGetSpecialPointer_s(rpage);
-    #if defined TFORESTORAM || defined TPATHORAM 
-    //selog(DEBUG1, "FIRST heap_block_insert prf");
-    prf(level, blkno, 0, (unsigned int*) &token);
-
-    //selog(DEBUG1, "Counters are %d %d %d %d\n", token[0], token[1], token[2], token[3]); 
-    //selog(DEBUG1, "size of oopaque lsize %d\n", r_blkno[1]);
-    //selog(DEBUG1, "Page has %d tuples",PageGetMaxOffsetNumber_s(rpage));  
-    rel->token = token;
-    #endif
+    if(rel->backend->tokens){
+        //selog(DEBUG1, "FIRST heap_block_insert prf");
+        prf(level, blkno, 0, (unsigned int*) &token);
+
+        //selog(DEBUG1, "Counters are %d %d %d %d\n", token[0], token[1], token[2], token[3]); 
+        //selog(DEBUG1, "size of oopaque lsize %d\n", r_blkno[1]);
+        //selog(DEBUG1, "Page has %d tuples",PageGetMaxOffsetNumber_s(rpage));  
+        rel->token = token;
+    }
     if(*r_blkno != blkno){
         selog(ERROR, "Page block %d number does not match offset %d", *r_blkno, blkno);
     }
@@ -159,11 +195,11 @@ heap_insert_block_s(VRelation rel, char *rpage, int blkno)
         selog(ERROR, "Block numbers in heap page do not match %d %d", r_blkno[0], p_blkno[0]);
     }
 
-    #if defined TFORESTORAM || defined TPATHORAM
-    //selog(DEBUG1, "second heap_block_insert prf");
+    if(rel->backend->tokens){
+        //selog(DEBUG1, "second heap_block_insert prf");
 
-    prf(level, blkno, 1, (unsigned int*) &token);
-    #endif
+        prf(level, blkno, 1, (unsigned int*) &token);
+    }
     //selog(DEBUG1, "Counters are %d %d %d %d", token[0], token[1], token[2], token[3]);
     //selog(DEBUG1, "Flush block %d", *r_blkno);
 	MarkBufferDirty_s(rel, buffer);
@@ -174,7 +210,8 @@ heap_insert_block_s(VRelation rel, char *rpage, int blkno)
 * The logic for this function was taken from the functions index_fetch_heap in
 * indexam.c and from heap_hot_search_buffer in heapam.c.
 * The major difference is the lack of support for locks and Hot-chains.
-* So its just a simple tuple access.
+* So its just a simple tuple access. The tuple of a deleted item has no
+* data (t_data is NULL).
 **/
 void
 heap_gettuple_s(VRelation rel, ItemPointer tid, HeapTuple tuple)
@@ -191,13 +228,13 @@ heap_gettuple_s(VRelation rel, ItemPointer tid, HeapTuple tuple)
     
 	//selog(DEBUG1, "Going to get heap block %d", blkno);
 
-    #if defined TFORESTORAM || defined TPATHORAM    
-    prf(tlevel, blkno, rel->heapBlockCounter, (unsigned int*) &token);
+    if(rel->backend->tokens){
+        prf(tlevel, blkno, rel->heapBlockCounter, (unsigned int*) &token);
 
-    //selog(DEBUG1, "counter of block %d are %d %d %d %d", blkno, token[0], token[1], token[2], token[3]);
+        //selog(DEBUG1, "counter of block %d are %d %d %d %d", blkno, token[0], token[1], token[2], token[3]);
 
-    rel->token = token;
-    #endif
+        rel->token = token;
+    }
 	buffer = ReadBuffer_s(rel, blkno);
 	if (ItemPointerGetBlockNumber_s(tid) != BufferGetBlockNumber_s(buffer))
 	{
@@ -213,11 +250,14 @@ heap_gettuple_s(VRelation rel, ItemPointer tid, HeapTuple tuple)
 
 	lp = PageGetItemId_s(page, offnum);
 	//selog(DEBUG1, "Item id has offset %zu ", ItemIdGetOffset_s(lp));
+	/* the tuple was deleted (heap_delete_s) */
 	if (!ItemIdIsNormal_s(lp))
 	{
-		selog(ERROR, "Item ID is not normal");
-        abort();
-        //exit(1);
+		tuple->t_len = 0;
+		tuple->t_tableOid = RelationGetRelid_s(rel);
+		tuple->t_data = NULL;
+		ReleaseBuffer_s(rel, buffer);
+		return;
 	}
 
 	tuple->t_len = ItemIdGetLength_s(lp);
@@ -229,3 +269,132 @@ heap_gettuple_s(VRelation rel, ItemPointer tid, HeapTuple tuple)
     //MarkBufferDirty_s(rel, buffer);
 	ReleaseBuffer_s(rel, buffer);
 }
+
+/*
+ * Whether the columns keycols (zero based) of the tuple of item lp and of
+ * tup, with the attributes of desc, have the same values.
+ */
+static bool
+heap_samekeys_s(Page page, ItemId lp, Item tup, Size len, TupleDesc desc,
+				int *keycols, int nkeycols)
+{
+	HeapTupleData oldTuple,
+				newTuple;
+	char	  **oldValues = (char **) malloc(desc->natts * sizeof(char *));
+	char	  **newValues = (char **) malloc(desc->natts * sizeof(char *));
+	int32	   *oldLens = (int32 *) malloc(desc->natts * sizeof(int32));
+	int32	   *newLens = (int32 *) malloc(desc->natts * sizeof(int32));
+	bool	   *oldNull = (bool *) malloc(desc->natts * sizeof(bool));
+	bool	   *newNull = (bool *) malloc(desc->natts * sizeof(bool));
+	bool		same;
+	int			i,
+				c;
+
+	oldTuple.t_data = (HeapTupleHeader) PageGetItem_s(page, lp);
+	oldTuple.t_len = ItemIdGetLength_s(lp);
+	newTuple.t_data = (HeapTupleHeader) tup;
+	newTuple.t_len = len;
+
+	same = heap_deform_tuple_s(&oldTuple, desc, oldValues, oldLens, oldNull) &&
+		heap_deform_tuple_s(&newTuple, desc, newValues, newLens, newNull);
+
+	for (i = 0; same && i < nkeycols; i++)
+	{
+		c = keycols[i];
+		if (oldNull[c] != newNull[c])
+			same = false;
+		else if (!oldNull[c])
+			same = oldLens[c] == newLens[c] &&
+				memcmp(oldValues[c], newValues[c], oldLens[c]) == 0;
+	}
+
+	free(oldValues);
+	free(newValues);
+	free(oldLens);
+	free(newLens);
+	free(oldNull);
+	free(newNull);
+	return same;
+}
+
+/*
+ * Replaces the tuple tid with tup in place. The index items of the tuple are
+ * not changed, so if desc is not NULL the update is refused when a column of
+ * keycols (zero based, with the attributes of desc) differs between the old
+ * and the new tuple. The block is read and written back whether the tuple is
+ * replaced or not. Returns false if the item was deleted, a key column
+ * changed or the new tuple does not fit on the block.
+ */
+bool
+heap_update_s(VRelation rel, ItemPointer tid, Item tup, Size len,
+			  TupleDesc desc, int *keycols, int nkeycols)
+{
+	Buffer		buffer;
+	Page		page;
+	OffsetNumber offnum;
+	ItemId		lp;
+	bool		updated = false;
+
+	buffer = ReadBuffer_s(rel, ItemPointerGetBlockNumber_s(tid));
+	page = BufferGetPage_s(rel, buffer);
+	offnum = ItemPointerGetOffsetNumber_s(tid);
+
+	if (offnum > PageGetMaxOffsetNumber_s(page) ||
+		!ItemIdIsNormal_s(PageGetItemId_s(page, offnum)))
+		selog(ERROR, "Tuple %d of block %d does not exist", offnum,
+			  ItemPointerGetBlockNumber_s(tid));
+	else if (desc != NULL &&
+			 !heap_samekeys_s(page, PageGetItemId_s(page, offnum), tup, len,
+							  desc, keycols, nkeycols))
+		selog(ERROR, "Tuple %d of block %d can not change its index key",
+			  offnum, ItemPointerGetBlockNumber_s(tid));
+	else if (!PageIndexTupleOverwrite_s(page, offnum, tup, len))
+		selog(ERROR, "Tuple of size %zu does not fit on block %d", len,
+			  ItemPointerGetBlockNumber_s(tid));
+	else
+	{
+		lp = PageGetItemId_s(page, offnum);
+		((HeapTupleHeader) PageGetItem_s(page, lp))->t_ctid = *tid;
+		updated = true;
+	}
+
+	MarkBufferDirty_s(rel, buffer);
+	ReleaseBuffer_s(rel, buffer);
+	return updated;
+}
+
+/*
+ * Deletes the tuple tid by marking its item dead, as the kill of index items
+ * does. The space of the tuple is not reused. The block is read and written
+ * back whether the tuple is deleted or not.
+ */
+bool
+heap_delete_s(VRelation rel, ItemPointer tid)
+{
+	Buffer		buffer;
+	Page		page;
+	OffsetNumber offnum;
+	ItemId		lp;
+	bool		deleted = false;
+
+	buffer = ReadBuffer_s(rel, ItemPointerGetBlockNumber_s(tid));
+	page = BufferGetPage_s(rel, buffer);
+	offnum = ItemPointerGetOffsetNumber_s(tid);
+
+	if (offnum <= PageGetMaxOffsetNumber_s(page))
+	{
+		lp = PageGetItemId_s(page, offnum);
+		if (ItemIdIsNormal_s(lp))
+		{
+			ItemIdMarkDead_s(lp);
+			deleted = true;
+		}
+	}
+	if (!deleted)
+		selog(ERROR, "Tuple %d of block %d does not exist", offnum,
+			  ItemPointerGetBlockNumber_s(tid));
+
+	MarkBufferDirty_s(rel, buffer);
+	ReleaseBuffer_s(rel, buffer);
+	return deleted;
+}
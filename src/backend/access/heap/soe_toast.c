@@ -0,0 +1,163 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_toast.c
+ *	  Out of line storage of large tuples on a toast ORAM.
+ *
+ * A tuple larger than MAX_TUPLE_SIZE (soe.c) does not fit on a page of the
+ * table. As TOAST does for large values, insertHeap splits it in chunks of
+ * a block each on a separate heap ORAM and inserts on the table a pointer
+ * to the chunks in its place. A read of the toast is padded to the number
+ * of chunks of the bytes requested, the size class of the request, so it
+ * does not tell whether the tuple was stored out of line or how large it
+ * is.
+ *
+ * src/backend/access/heap/soe_toast.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "access/soe_toast.h"
+#include "logger/logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Stores a tuple of size bytes in chunks on the next free blocks of the
+ * toast and sets the pointer to them. Returns false if the toast is full.
+ */
+bool
+toast_insert_s(VRelation rel, const char *tuple, uint32 size,
+			   ToastPointer ptr)
+{
+	ToastChunk	chunk;
+	Buffer		buffer;
+	Page		page;
+	uint32		nchunks = ToastChunksSpanned(0, size);
+	uint32		seq;
+	bool		inserted = true;
+
+	if (rel->currentBlock + nchunks > (uint32) rel->totalBlocks)
+	{
+		selog(ERROR, "Toast of relation %d can't hold %d more chunks",
+			  rel->rd_id, nchunks);
+		return false;
+	}
+
+	ptr->magic = TOAST_POINTER_MAGIC;
+	ptr->rawSize = size;
+	ptr->firstBlock = rel->currentBlock;
+	ptr->nchunks = nchunks;
+
+	chunk = (ToastChunk) malloc(TOAST_MAX_ITEM_SIZE);
+	for (seq = 0; seq < nchunks; seq++)
+	{
+		chunk->firstBlock = ptr->firstBlock;
+		chunk->seq = seq;
+		chunk->len = Min_s(TOAST_CHUNK_SIZE, size - seq * TOAST_CHUNK_SIZE);
+		memcpy(chunk->data, tuple + seq * TOAST_CHUNK_SIZE, chunk->len);
+
+		buffer = ReadBuffer_s(rel, rel->currentBlock);
+		page = BufferGetPage_s(rel, buffer);
+		rel->pageinit(page, rel->blockOffset + rel->currentBlock, 0, BLCKSZ);
+		if (PageAddItem_s(page, (Item) chunk,
+						  offsetof_s(ToastChunkData, data) + chunk->len,
+						  InvalidOffsetNumber, false, true) == InvalidOffsetNumber)
+		{
+			selog(ERROR, "Chunk %d does not fit on a toast block", seq);
+			inserted = false;
+		}
+		rel->fsm[rel->currentBlock] = 1;
+		rel->currentBlock++;
+		MarkBufferDirty_s(rel, buffer);
+		ReleaseBuffer_s(rel, buffer);
+	}
+	free(chunk);
+
+	return inserted;
+}
+
+/*
+ * Forms the item stored on the table in place of a tuple stored out of
+ * line, of ToastTupleSize bytes, with the pointer to its chunks.
+ */
+HeapTupleHeader
+toast_formtuple_s(ToastPointer ptr)
+{
+	HeapTupleHeader tuple = (HeapTupleHeader) malloc(ToastTupleSize);
+
+	memset(tuple, 0, ToastTupleSize);
+	tuple->t_infomask2 = HEAP_TOAST_POINTER_S;
+	tuple->t_hoff = MAXALIGN_s(SizeofHeapTupleHeader);
+	memcpy((char *) tuple + tuple->t_hoff, ptr, sizeof(ToastPointerData));
+	return tuple;
+}
+
+/*
+ * Copies the bytes [offset, offset + len) of the tuple of ptr to data,
+ * reading the blocks of the chunks that hold them. Exactly
+ * ToastChunksSpanned(offset, len) blocks are accessed, with dummy accesses
+ * past the end of the tuple or when ptr is NULL. Returns the number of
+ * bytes copied, or -1 if a chunk does not belong to the tuple.
+ */
+int
+toast_fetch_s(VRelation rel, ToastPointer ptr, uint32 offset, char *data,
+			  uint32 len)
+{
+	uint32		nblocks = ToastChunksSpanned(offset, len);
+	uint32		first = offset / TOAST_CHUNK_SIZE;
+	uint32		seq;
+	uint32		start;
+	uint32		end;
+	uint32		copied = 0;
+	Buffer		buffer;
+	Page		page;
+	ToastChunk	chunk;
+	bool		valid = true;
+
+	if (offset + len < offset)
+	{
+		selog(ERROR, "Toast read of %d bytes at %d is out of range", len, offset);
+		return -1;
+	}
+
+	for (seq = first; seq < first + nblocks; seq++)
+	{
+		if (ptr == NULL || seq >= ptr->nchunks)
+		{
+			ReadDummyBuffer(rel, rel->totalBlocks + 1);
+			continue;
+		}
+
+		buffer = ReadBuffer_s(rel, ptr->firstBlock + seq);
+		page = BufferGetPage_s(rel, buffer);
+		chunk = NULL;
+		if (PageGetMaxOffsetNumber_s(page) >= FirstOffsetNumber)
+			chunk = (ToastChunk) PageGetItem_s(page,
+											   PageGetItemId_s(page, FirstOffsetNumber));
+		if (chunk == NULL || chunk->firstBlock != ptr->firstBlock ||
+			chunk->seq != seq || chunk->len > TOAST_CHUNK_SIZE)
+			valid = false;
+		else
+		{
+			/* the part of the chunk in the requested bytes */
+			start = Max_s(offset, seq * TOAST_CHUNK_SIZE);
+			end = Min_s(offset + len, seq * TOAST_CHUNK_SIZE + chunk->len);
+			if (start < end)
+			{
+				memcpy(data + (start - offset),
+					   chunk->data + (start - seq * TOAST_CHUNK_SIZE),
+					   end - start);
+				copied += end - start;
+			}
+		}
+		ReleaseBuffer_s(rel, buffer);
+	}
+
+	if (!valid)
+	{
+		selog(ERROR, "Toast chunks of block %d are corrupted", ptr->firstBlock);
+		return -1;
+	}
+	return copied;
+}
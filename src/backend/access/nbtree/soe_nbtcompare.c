@@ -0,0 +1,966 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_nbtcompare.c
+ *	  Comparison functions for btree access method.
+ *
+ * The SOE does not have the fmgr, so instead of the btree support functions
+ * of each operator class, the index keeps a single comparator chosen from
+ * the type of the indexed attribute. Strings keep the prefix comparison the
+ * prototype has always used, the other types are compared by value.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/nbtree/nbtcompare.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "access/soe_nbtcompare.h"
+#include "access/soe_nbtree.h"
+#include "access/soe_tupmacs.h"
+#include "logger/logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Length of a varlena attribute. Index tuples do not hold toasted values. */
+static int
+varlena_len(const char *attr)
+{
+	if (VARATT_IS_1B_S(attr))
+		return VARSIZE_1B_S(attr) - VARHDRSZ_SHORT;
+	return VARSIZE_4B_S(attr) - sizeof(int32);
+}
+
+/*
+ * The scan key matches the strings it is a prefix of. A key longer than the
+ * attribute, as the truncated separator keys of the internal pages, is
+ * greater than it.
+ */
+static int32
+btcmp_text(ScanKey scankey, const char *attr)
+{
+	char	   *datum = VARDATA_ANY_S(DatumGetBpCharPP_S(attr));
+	int			dlen = varlena_len(attr);
+	int			klen = strlen(scankey->sk_argument);
+	int32		result;
+
+	result = (int32) strncmp(scankey->sk_argument, datum, Min_s(klen, dlen));
+	if (result == 0 && klen > dlen)
+		return 1;
+	return result;
+}
+
+/* Same as byteacmp: memcmp of the common prefix, then the length. */
+static int32
+btcmp_bytea(ScanKey scankey, const char *attr)
+{
+	char	   *datum = VARDATA_ANY_S(DatumGetByteaPP_S(attr));
+	int			dlen = varlena_len(attr);
+	int			klen = scankey->datumSize - 1;
+	int32		result;
+
+	result = memcmp(scankey->sk_argument, datum, Min_s(klen, dlen));
+	if (result == 0 && klen != dlen)
+		result = klen < dlen ? -1 : 1;
+	return result;
+}
+
+static int32
+btcmp_int4(ScanKey scankey, const char *attr)
+{
+	int32		a;
+	int32		b;
+
+	memcpy(&a, scankey->sk_argument, sizeof(int32));
+	memcpy(&b, attr, sizeof(int32));
+	return (a > b) - (a < b);
+}
+
+/* int8, timestamp and timestamptz */
+static int32
+btcmp_int8(ScanKey scankey, const char *attr)
+{
+	int64		a;
+	int64		b;
+
+	memcpy(&a, scankey->sk_argument, sizeof(int64));
+	memcpy(&b, attr, sizeof(int64));
+	return (a > b) - (a < b);
+}
+
+/* Same as float8_cmp_internal: NaNs are equal and greater than non-NaNs. */
+static int32
+btcmp_float8(ScanKey scankey, const char *attr)
+{
+	float8		a;
+	float8		b;
+
+	memcpy(&a, scankey->sk_argument, sizeof(float8));
+	memcpy(&b, attr, sizeof(float8));
+
+	if (a != a)
+		return b != b ? 0 : 1;
+	if (b != b)
+		return -1;
+	return (a > b) - (a < b);
+}
+
+
+keycmp_function
+_bt_keycmp_s(Oid atttypid)
+{
+	switch (atttypid)
+	{
+		case INT4OID:
+		case DATEOID:
+			return &btcmp_int4;
+		case INT8OID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			return &btcmp_int8;
+		case FLOAT8OID:
+			return &btcmp_float8;
+		case BYTEAOID:
+			return &btcmp_bytea;
+		case BPCHAROID:
+		case VARCHAROID:
+		case TEXTOID:
+			return &btcmp_text;
+		default:
+			selog(WARNING, "Index keys of type %d are compared as strings", atttypid);
+			return &btcmp_text;
+	}
+}
+
+bool
+_bt_keyisstring_s(Oid atttypid)
+{
+	return _bt_keycmp_s(atttypid) == &btcmp_text;
+}
+
+/*
+ * Checks that a scan key of keysize bytes (including the terminator added by
+ * getTuple) holds a value of the type atttypid.
+ */
+bool
+_bt_keysizeok_s(Oid atttypid, int keysize)
+{
+	keycmp_function cmp = _bt_keycmp_s(atttypid);
+
+	if (cmp == &btcmp_int4)
+		return keysize - 1 == sizeof(int32);
+	if (cmp == &btcmp_int8)
+		return keysize - 1 == sizeof(int64);
+	if (cmp == &btcmp_float8)
+		return keysize - 1 == sizeof(float8);
+	return keysize > 0;
+}
+
+
+/*
+ * Composite keys
+ *
+ * The keys of an index on several columns are compared column by column,
+ * with the comparator of the type of each column. The scan key of such an
+ * index holds the values of one or more leading columns, each as a 4 byte
+ * length (in the byte order of the enclave) followed by the value in the
+ * format of a single column scan key. A key with fewer columns than the
+ * index is equal to every key that starts with its values, so a prefix of
+ * the columns can be scanned with any strategy. Composite keys are not
+ * normalized or truncated.
+ */
+
+static int32
+btcmp_composite(ScanKey scankey, const char *attr)
+{
+	ScanKey		col;
+	uintptr_t	off = 0;
+	int32		result;
+	int			i;
+
+	for (i = 0; i < scankey->sk_ncols; i++)
+	{
+		col = &scankey->sk_cols[i];
+		off = att_align_pointer_s(off, col->sk_attalign, col->sk_attlen,
+								  attr + off);
+		result = col->sk_cmp(col, attr + off);
+		if (result != 0)
+			return result;
+		off = att_addlength_pointer_s(off, col->sk_attlen, attr + off);
+	}
+	return 0;
+}
+
+/*
+ * Sets the key attributes of an index from the attribute descriptors given
+ * at initialization (attrDesc, one FormData_pg_attribute per column) and
+ * returns the comparator of its keys.
+ */
+keycmp_function
+_bt_initkeydesc_s(TupleDesc desc, const char *attrDesc,
+				  unsigned int attrDescLength)
+{
+	int			natts = attrDescLength / sizeof(FormData_pg_attribute);
+
+	desc->natts = Max_s(natts, 1);
+	desc->attrs = (FormData_pg_attribute *)
+		calloc(desc->natts, sizeof(FormData_pg_attribute));
+	memcpy(desc->attrs, attrDesc,
+		   Min_s(attrDescLength, desc->natts * sizeof(FormData_pg_attribute)));
+
+	if (desc->natts > 1)
+		return &btcmp_composite;
+	return _bt_keycmp_s(desc->attrs->atttypid);
+}
+
+/*
+ * Number of columns of a composite scan key of keysize bytes (without the
+ * terminator added by getTuple) for an index with the attributes of desc.
+ * Returns -1 if the key is malformed.
+ */
+int
+_bt_keycolumns_s(TupleDesc desc, const char *key, int keysize)
+{
+	int32		len;
+	int			ncols = 0;
+	int			off = 0;
+
+	while (off < keysize)
+	{
+		if (ncols == desc->natts || keysize - off < (int) sizeof(int32))
+			return -1;
+		memcpy(&len, key + off, sizeof(int32));
+		off += sizeof(int32);
+		if (len < 0 || len > keysize - off ||
+			!_bt_keysizeok_s(desc->attrs[ncols].atttypid, len + 1))
+			return -1;
+		off += len;
+		ncols++;
+	}
+	return ncols > 0 ? ncols : -1;
+}
+
+/*
+ * Prepares a scan key, once per scan, for the comparator of an index with
+ * the attributes of desc: a single column key is normalized and a composite
+ * key is split in the scan keys of its columns (sk_cols), freed with the key.
+ */
+void
+_bt_preparekey_s(TupleDesc desc, ScanKey scankey)
+{
+	ScanKey		col;
+	char	   *data;
+	int32		len;
+	int			keysize = scankey->datumSize - 1;
+	int			ncols;
+	int			off = 0;
+	int			i;
+
+	scankey->sk_ncols = 0;
+	scankey->sk_cols = NULL;
+	if (desc->natts == 1)
+	{
+		_bt_normalizekey_s(desc->attrs->atttypid, scankey);
+		return;
+	}
+
+	scankey->sk_norm = NULL;
+	scankey->normSize = 0;
+	scankey->normVarlena = false;
+
+	ncols = _bt_keycolumns_s(desc, scankey->sk_argument, keysize);
+	if (ncols < 0)
+	{
+		selog(ERROR, "Malformed composite scan key of %d bytes", keysize);
+		return;
+	}
+
+	/* the column keys are followed by their terminated values */
+	scankey->sk_cols = (ScanKey) malloc(sizeof(ScanKeyData) * ncols +
+										keysize + ncols);
+	data = (char *) (scankey->sk_cols + ncols);
+	for (i = 0; i < ncols; i++)
+	{
+		memcpy(&len, scankey->sk_argument + off, sizeof(int32));
+		off += sizeof(int32);
+		memcpy(data, scankey->sk_argument + off, len);
+		data[len] = '\0';
+		off += len;
+
+		col = &scankey->sk_cols[i];
+		col->sk_subtype = scankey->sk_subtype;
+		col->sk_argument = data;
+		col->datumSize = len + 1;
+		col->sk_norm = NULL;
+		col->normSize = 0;
+		col->normVarlena = false;
+		col->sk_ncols = 0;
+		col->sk_cols = NULL;
+		col->sk_cmp = _bt_keycmp_s(desc->attrs[i].atttypid);
+		col->sk_attlen = desc->attrs[i].attlen;
+		col->sk_attalign = desc->attrs[i].attalign;
+		data += len + 1;
+	}
+	scankey->sk_ncols = ncols;
+}
+
+/* Frees the normalized and column keys of a scan key prepared for a scan. */
+void
+_bt_freekeydata_s(ScanKey scankey)
+{
+	if (scankey->sk_norm != NULL)
+		free(scankey->sk_norm);
+	if (scankey->sk_cols != NULL)
+		free(scankey->sk_cols);
+}
+
+/*
+ * Maps the oid of the operator of a where clause to its btree strategy.
+ * Returns InvalidStrategy for the operators that can not use the index.
+ */
+StrategyNumber
+_bt_strategy_s(unsigned int opoid)
+{
+	switch (opoid)
+	{
+			/* bpchar, text, int4, int8, float8, date, timestamp(tz), bytea */
+		case 1058:
+		case 664:
+		case 97:
+		case 412:
+		case 672:
+		case 1095:
+		case 2062:
+		case 1322:
+		case 1957:
+			return BTLessStrategyNumber;
+		case 1059:
+		case 665:
+		case 523:
+		case 414:
+		case 673:
+		case 1096:
+		case 2063:
+		case 1323:
+		case 1958:
+			return BTLessEqualStrategyNumber;
+		case 1054:
+		case 98:
+		case 96:
+		case 410:
+		case 670:
+		case 1093:
+		case 2060:
+		case 1320:
+		case 1955:
+			return BTEqualStrategyNumber;
+		case 1061:
+		case 667:
+		case 525:
+		case 415:
+		case 675:
+		case 1098:
+		case 2065:
+		case 1325:
+		case 1960:
+			return BTGreaterEqualStrategyNumber;
+		case 1060:
+		case 666:
+		case 521:
+		case 413:
+		case 674:
+		case 1097:
+		case 2064:
+		case 1324:
+		case 1959:
+			return BTGreaterStrategyNumber;
+		default:
+			return InvalidStrategy;
+	}
+}
+
+/*
+ * Does an attribute satisfy a strategy, given the result of the comparison
+ * of the attribute with the scan key (test)?
+ */
+bool
+_bt_strategymatches_s(StrategyNumber strategy, int32 test)
+{
+	return (strategy == BTLessStrategyNumber && test < 0) ||
+		(strategy == BTLessEqualStrategyNumber && test <= 0) ||
+		(strategy == BTEqualStrategyNumber && test == 0) ||
+		(strategy == BTGreaterEqualStrategyNumber && test >= 0) ||
+		(strategy == BTGreaterStrategyNumber && test > 0);
+}
+
+
+/* Length of a string without the blank padding or the zeros of normalization. */
+static int
+string_truelen(const char *value, int len)
+{
+	while (len > 0 && (value[len - 1] == ' ' || value[len - 1] == '\0'))
+		len--;
+	return len;
+}
+
+/*
+ * Exact comparisons
+ *
+ * The prefix comparison of the string keys finds the index entries a scan
+ * key is a prefix of, which does not suit predicates on the columns of the
+ * table. These comparators compare the whole strings, as texteq and
+ * bpchareq do in the C collation, the blank padding of bpchar aside.
+ */
+
+static int32
+string_cmp(const char *a, int alen, const char *b, int blen)
+{
+	int32		result = memcmp(a, b, Min_s(alen, blen));
+
+	if (result == 0 && alen != blen)
+		result = alen < blen ? -1 : 1;
+	return result;
+}
+
+static int32
+btcmp_text_exact(ScanKey scankey, const char *attr)
+{
+	return string_cmp(scankey->sk_argument, scankey->datumSize - 1,
+					  VARDATA_ANY_S(attr), varlena_len(attr));
+}
+
+static int32
+btcmp_bpchar_exact(ScanKey scankey, const char *attr)
+{
+	char	   *datum = VARDATA_ANY_S(attr);
+
+	return string_cmp(scankey->sk_argument,
+					  string_truelen(scankey->sk_argument, scankey->datumSize - 1),
+					  datum, string_truelen(datum, varlena_len(attr)));
+}
+
+/* Comparator of a value of the type atttypid with a constant of its type. */
+keycmp_function
+_bt_valuecmp_s(Oid atttypid)
+{
+	switch (atttypid)
+	{
+		case BPCHAROID:
+			return &btcmp_bpchar_exact;
+		case VARCHAROID:
+		case TEXTOID:
+			return &btcmp_text_exact;
+		default:
+			if (_bt_keyisstring_s(atttypid))
+				return &btcmp_text_exact;
+			return _bt_keycmp_s(atttypid);
+	}
+}
+
+/*
+ * Whether the key of an index tuple is equal to the whole scan key, and not
+ * only starts with it as in the prefix comparison of the strings. A
+ * composite scan key must hold a value for every column. The key of a tuple
+ * of a page with BTP_NORMKEYS is compared on a denormalized copy.
+ */
+bool
+_bt_keyexact_s(TupleDesc desc, ScanKey scankey, IndexTuple itup,
+			   bool normkeys)
+{
+	IndexTuple	copy = NULL;
+	const char *attr;
+	ScanKey		col;
+	uintptr_t	off = 0;
+	bool		result = true;
+	int			i;
+
+	if (desc->natts == 1)
+	{
+		if (normkeys)
+		{
+			copy = (IndexTuple) malloc(IndexTupleSize_s(itup));
+			memcpy(copy, itup, IndexTupleSize_s(itup));
+			_bt_denormalizetuple_s(desc->attrs->atttypid, copy);
+			itup = copy;
+		}
+		result = _bt_valuecmp_s(desc->attrs->atttypid) (scankey,
+														index_getattr_s(itup)) == 0;
+		free(copy);
+		return result;
+	}
+
+	if (scankey->sk_ncols != desc->natts)
+		return false;
+	attr = index_getattr_s(itup);
+	for (i = 0; i < scankey->sk_ncols && result; i++)
+	{
+		col = &scankey->sk_cols[i];
+		off = att_align_pointer_s(off, col->sk_attalign, col->sk_attlen,
+								  attr + off);
+		result = _bt_valuecmp_s(desc->attrs[i].atttypid) (col, attr + off) == 0;
+		off = att_addlength_pointer_s(off, col->sk_attlen, attr + off);
+	}
+	return result;
+}
+
+/*
+ * Number of bytes of the string key of firstright that a separator key
+ * between lastleft and firstright needs to keep: the shortest prefix of
+ * firstright greater than lastleft. Returns -1 if the key can not be
+ * truncated, as for the fixed size types.
+ */
+int
+_bt_keysuffixlen_s(Oid atttypid, const char *lastleft, const char *firstright)
+{
+	char	   *left = VARDATA_ANY_S(lastleft);
+	char	   *right = VARDATA_ANY_S(firstright);
+	int			llen;
+	int			rlen;
+	int			keep;
+
+	if (!_bt_keyisstring_s(atttypid))
+		return -1;
+
+	llen = string_truelen(left, varlena_len(lastleft));
+	rlen = string_truelen(right, varlena_len(firstright));
+
+	for (keep = 0; keep < llen && keep < rlen; keep++)
+	{
+		if (left[keep] != right[keep])
+			break;
+	}
+	/* keep the first distinguishing byte */
+	keep++;
+
+	return keep < varlena_len(firstright) ? keep : -1;
+}
+
+/*
+ * Normalized keys
+ *
+ * The pages loaded with BTP_NORMKEYS hold keys that compare with memcmp.
+ * Integers are stored big endian with the sign bit flipped, floats with the
+ * sign bit flipped for positive values and all bits flipped for negative
+ * ones, and the trailing blanks of strings are replaced by zeros, so the
+ * prefix comparison of the strings does not need the length of the value.
+ * bytea keys are already compared with memcmp and are not normalized.
+ */
+
+static void
+store_bigendian(char *dest, uint64 value, int size)
+{
+	int			i;
+
+	for (i = size - 1; i >= 0; i--)
+	{
+		dest[i] = (char) (value & 0xFF);
+		value >>= 8;
+	}
+}
+
+static uint64
+load_bigendian(const char *src, int size)
+{
+	uint64		value = 0;
+	int			i;
+
+	for (i = 0; i < size; i++)
+		value = (value << 8) | (unsigned char) src[i];
+	return value;
+}
+
+/* Normalizes in place the fixed size value of type atttypid at datum. */
+static void
+normalize_fixed(Oid atttypid, char *datum)
+{
+	int32		i4;
+	int64		i8;
+	float8		f8;
+	uint64		bits;
+
+	switch (atttypid)
+	{
+		case INT4OID:
+		case DATEOID:
+			memcpy(&i4, datum, sizeof(int32));
+			store_bigendian(datum, (uint32) i4 ^ 0x80000000U, sizeof(int32));
+			break;
+		case INT8OID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			memcpy(&i8, datum, sizeof(int64));
+			store_bigendian(datum, (uint64) i8 ^ ((uint64) 1 << 63), sizeof(int64));
+			break;
+		case FLOAT8OID:
+			memcpy(&f8, datum, sizeof(float8));
+			/* NaNs are equal to each other and -0 is equal to 0 */
+			if (f8 != f8)
+				bits = 0x7FF8000000000000ULL;
+			else if (f8 == 0)
+				bits = 0;
+			else
+				memcpy(&bits, &f8, sizeof(float8));
+			if (bits >> 63)
+				bits = ~bits;
+			else
+				bits ^= (uint64) 1 << 63;
+			store_bigendian(datum, bits, sizeof(float8));
+			break;
+	}
+}
+
+static int
+fixed_size(Oid atttypid)
+{
+	switch (atttypid)
+	{
+		case INT4OID:
+		case DATEOID:
+			return sizeof(int32);
+		case INT8OID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+		case FLOAT8OID:
+			return sizeof(int64);
+		default:
+			return 0;
+	}
+}
+
+bool
+_bt_keynormalizable_s(Oid atttypid)
+{
+	return fixed_size(atttypid) > 0 || _bt_keyisstring_s(atttypid);
+}
+
+/*
+ * Normalizes the keys of every tuple of an index page in place. Returns
+ * false, leaving the page unchanged, if the keys of the type can not be
+ * normalized.
+ */
+bool
+_bt_normalizepage_s(Oid atttypid, Page page)
+{
+	OffsetNumber offnum;
+	OffsetNumber maxoff = PageGetMaxOffsetNumber_s(page);
+	IndexTuple	itup;
+
+	if (!_bt_keynormalizable_s(atttypid))
+		return false;
+
+	for (offnum = FirstOffsetNumber; offnum <= maxoff;
+		 offnum = OffsetNumberNext_s(offnum))
+	{
+		itup = (IndexTuple) PageGetItem_s(page, PageGetItemId_s(page, offnum));
+		_bt_normalizetuple_s(atttypid, itup);
+	}
+	return true;
+}
+
+/*
+ * Normalizes in place the key of an index tuple inserted in a page with
+ * BTP_NORMKEYS. The type must be normalizable.
+ */
+void
+_bt_normalizetuple_s(Oid atttypid, IndexTuple itup)
+{
+	Size		offset = IndexInfoFindDataOffset_s(itup->t_info);
+	char	   *attr;
+	int			len;
+	int			truelen;
+	int			fsize = fixed_size(atttypid);
+
+	/* the first key of internal pages may have no value */
+	if (IndexTupleSize_s(itup) <= offset)
+		return;
+
+	attr = index_getattr_s(itup);
+	if (fsize > 0)
+	{
+		if (IndexTupleSize_s(itup) >= offset + fsize)
+			normalize_fixed(atttypid, attr);
+		return;
+	}
+
+	len = varlena_len(attr);
+	truelen = bpchartruelen_s(VARDATA_ANY_S(attr), len);
+	memset(VARDATA_ANY_S(attr) + truelen, 0, len - truelen);
+}
+
+/* Builds the normalized form of a scan key, once per scan. */
+void
+_bt_normalizekey_s(Oid atttypid, ScanKey scankey)
+{
+	int			fsize = fixed_size(atttypid);
+
+	scankey->sk_norm = NULL;
+	scankey->normSize = 0;
+	scankey->normVarlena = false;
+
+	if (fsize > 0)
+	{
+		if (scankey->datumSize - 1 < fsize)
+			return;
+		scankey->sk_norm = (char *) malloc(fsize);
+		memcpy(scankey->sk_norm, scankey->sk_argument, fsize);
+		normalize_fixed(atttypid, scankey->sk_norm);
+		scankey->normSize = fsize;
+	}
+	else if (_bt_keyisstring_s(atttypid))
+	{
+		scankey->normSize = bpchartruelen_s(scankey->sk_argument,
+											strlen(scankey->sk_argument));
+		scankey->sk_norm = (char *) malloc(scankey->normSize + 1);
+		memcpy(scankey->sk_norm, scankey->sk_argument, scankey->normSize);
+		scankey->normVarlena = true;
+	}
+}
+
+/*
+ * Restores in place the key of a tuple copied from a page with BTP_NORMKEYS
+ * to the format of the keys given to addIndexBlock. NaNs and -0 keep the
+ * canonical value given by the normalization.
+ */
+void
+_bt_denormalizetuple_s(Oid atttypid, IndexTuple itup)
+{
+	Size		offset = IndexInfoFindDataOffset_s(itup->t_info);
+	char	   *attr;
+	int32		i4;
+	int64		i8;
+	uint64		bits;
+	int			len;
+
+	if (IndexTupleSize_s(itup) <= offset)
+		return;
+
+	attr = index_getattr_s(itup);
+	switch (atttypid)
+	{
+		case INT4OID:
+		case DATEOID:
+			i4 = (int32) ((uint32) load_bigendian(attr, sizeof(int32)) ^ 0x80000000U);
+			memcpy(attr, &i4, sizeof(int32));
+			break;
+		case INT8OID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			i8 = (int64) (load_bigendian(attr, sizeof(int64)) ^ ((uint64) 1 << 63));
+			memcpy(attr, &i8, sizeof(int64));
+			break;
+		case FLOAT8OID:
+			bits = load_bigendian(attr, sizeof(float8));
+			if (bits >> 63)
+				bits ^= (uint64) 1 << 63;
+			else
+				bits = ~bits;
+			memcpy(attr, &bits, sizeof(float8));
+			break;
+		default:
+			if (!_bt_keyisstring_s(atttypid))
+				break;
+			/* the blank padding was zeroed */
+			len = varlena_len(attr);
+			while (len > 0 && VARDATA_ANY_S(attr)[len - 1] == '\0')
+				VARDATA_ANY_S(attr)[--len] = ' ';
+			break;
+	}
+}
+
+/*
+ * Forms the index tuple of a key of keysize bytes in the format of a scan
+ * key (without the terminator added by getTuple) that holds a value for
+ * every column of the index. The values of the fixed size types are copied
+ * and the other values are stored as varlenas, as in the loaded blocks. The
+ * caller sets the heap pointer of the tuple. Returns NULL if the key does
+ * not match the attributes of desc.
+ */
+IndexTuple
+_bt_formkeytuple_s(TupleDesc desc, const char *key, int keysize)
+{
+	const char *values[INDEX_MAX_KEYS];
+	int32		lens[INDEX_MAX_KEYS];
+	FormData_pg_attribute *att;
+	IndexTuple	itup;
+	Size		hoff = IndexInfoFindDataOffset_s(0);
+	Size		size;
+	char	   *data;
+	uintptr_t	off = 0;
+	bool		hasvarlena = false;
+	int			fsize;
+	int			i;
+
+	if (desc->natts > INDEX_MAX_KEYS)
+		return NULL;
+	if (desc->natts == 1)
+	{
+		values[0] = key;
+		lens[0] = keysize;
+	}
+	else
+	{
+		if (_bt_keycolumns_s(desc, key, keysize) != desc->natts)
+			return NULL;
+		for (i = 0; i < desc->natts; i++)
+		{
+			memcpy(&lens[i], key + off, sizeof(int32));
+			values[i] = key + off + sizeof(int32);
+			off += sizeof(int32) + lens[i];
+		}
+	}
+
+	/* large enough for the alignment and the headers of every value */
+	size = hoff;
+	for (i = 0; i < desc->natts; i++)
+		size += lens[i] + sizeof(int32) + MAXIMUM_ALIGNOF;
+	itup = (IndexTuple) calloc(1, MAXALIGN_s(size));
+	data = (char *) itup + hoff;
+
+	off = 0;
+	for (i = 0; i < desc->natts; i++)
+	{
+		att = &desc->attrs[i];
+		fsize = fixed_size(att->atttypid);
+		if (fsize > 0)
+		{
+			if (lens[i] != fsize)
+			{
+				free(itup);
+				return NULL;
+			}
+			off = att_align_nominal_s(off, att->attalign);
+			memcpy(data + off, values[i], fsize);
+			off += fsize;
+		}
+		else if (lens[i] + VARHDRSZ_SHORT <= VARATT_SHORT_MAX)
+		{
+			SET_VARSIZE_1B_S(data + off, VARHDRSZ_SHORT + lens[i]);
+			memcpy(data + off + VARHDRSZ_SHORT, values[i], lens[i]);
+			off += VARHDRSZ_SHORT + lens[i];
+			hasvarlena = true;
+		}
+		else
+		{
+			off = att_align_nominal_s(off, att->attalign);
+			SET_VARSIZE_4B_S(data + off, sizeof(int32) + lens[i]);
+			memcpy(data + off + sizeof(int32), values[i], lens[i]);
+			off += sizeof(int32) + lens[i];
+			hasvarlena = true;
+		}
+	}
+
+	size = MAXALIGN_s(hoff + off);
+	if ((size & INDEX_SIZE_MASK) != size)
+	{
+		free(itup);
+		return NULL;
+	}
+	itup->t_info = size | (hasvarlena ? INDEX_VAR_MASK : 0);
+	ItemPointerSetInvalid_s(&itup->t_tid);
+
+	return itup;
+}
+
+/*
+ * Compares a normalized scan key with the first attribute of an index tuple
+ * of a page with BTP_NORMKEYS. Strings keep the prefix comparison of
+ * btcmp_text.
+ */
+int32
+_bt_normcmp_s(ScanKey scankey, const char *attr)
+{
+	int			dlen;
+	int32		result;
+
+	if (!scankey->normVarlena)
+		return memcmp(scankey->sk_norm, attr, scankey->normSize);
+
+	dlen = varlena_len(attr);
+	result = memcmp(scankey->sk_norm, VARDATA_ANY_S(attr),
+					Min_s(scankey->normSize, dlen));
+	if (result == 0 && scankey->normSize > dlen)
+		return 1;
+	return result;
+}
+
+
+/*
+ * Constant time search of a page with normalized keys
+ *
+ * The first CT_PREFIX_SIZE bytes of the normalized keys of the slots
+ * [low, high) are copied into a compact array of integers that compare as
+ * the keys do, and every slot is compared with the scan key with the same
+ * branch free sequence of instructions, whatever the position of the key.
+ * The keys of up to CT_PREFIX_SIZE bytes are fully decided by the prefixes.
+ * For longer keys, the slots whose prefix is equal to the prefix of the
+ * scan key are returned as the range [*tieLow, *tieHigh) for the caller to
+ * binary search, otherwise the range is empty and *tieLow is the result of
+ * the search (see _bt_binsrch for the meaning of cmpval).
+ *
+ * The caller skips the "minus infinity" key of the internal pages.
+ */
+#define CT_PREFIX_SIZE sizeof(uint64)
+
+static uint64
+ct_prefix(const char *value, int len)
+{
+	uint64		prefix = 0;
+	int			i;
+
+	for (i = 0; i < (int) CT_PREFIX_SIZE; i++)
+		prefix = (prefix << 8) | (i < len ? (unsigned char) value[i] : 0);
+	return prefix;
+}
+
+void
+_bt_ctsearch_s(Page page, ScanKey scankey, OffsetNumber low,
+			   OffsetNumber high, int cmpval, OffsetNumber *tieLow,
+			   OffsetNumber *tieHigh)
+{
+	int			nitems = high > low ? high - low : 0;
+	int			plen = Min_s(scankey->normSize, (int) CT_PREFIX_SIZE);
+	bool		exact = scankey->normSize <= (int) CT_PREFIX_SIZE;
+	uint64	   *prefixes;
+	uint64		kprefix;
+	IndexTuple	itup;
+	char	   *attr;
+	int			before = 0;
+	int			ties = 0;
+	int			i;
+
+	prefixes = (uint64 *) malloc(sizeof(uint64) * (nitems + 1));
+
+	/* extract the prefixes, reading the page in slot order */
+	for (i = 0; i < nitems; i++)
+	{
+		itup = (IndexTuple) PageGetItem_s(page, PageGetItemId_s(page, low + i));
+		attr = index_getattr_s(itup);
+		if (scankey->normVarlena)
+			prefixes[i] = ct_prefix(VARDATA_ANY_S(attr),
+									Min_s(plen, varlena_len(attr)));
+		else
+			prefixes[i] = ct_prefix(attr, plen);
+	}
+
+	kprefix = ct_prefix(scankey->sk_norm, plen);
+	for (i = 0; i < nitems; i++)
+	{
+		before += kprefix > prefixes[i];
+		ties += kprefix == prefixes[i];
+	}
+	free(prefixes);
+
+	*tieLow = low + before;
+	*tieHigh = low + before + ties;
+
+	/* the equal keys are before the result when cmpval is 0 */
+	if (exact && cmpval == 0)
+		*tieLow = *tieHigh;
+	else if (exact)
+		*tieHigh = *tieLow;
+}
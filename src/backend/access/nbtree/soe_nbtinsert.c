@@ -15,8 +15,12 @@
  */
 
 #include "access/soe_nbtree.h"
+#include "access/soe_nbtcompare.h"
 #include "logger/logger.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 
 
 typedef struct
@@ -40,576 +44,370 @@ typedef struct
 }			FindSplitData;
 
 
-static Buffer _bt_newroot_s(VRelation rel, Buffer lbuf, Buffer rbuf);
-
-static void _bt_findinsertloc_s(VRelation rel,
-								Buffer * bufptr,
-								OffsetNumber * offsetptr,
-								int keysz,
-								ScanKey scankey,
-								IndexTuple newtup,
-								BTStack stack,
-								VRelation heapRel);
-static void _bt_insertonpg_s(VRelation rel, Buffer buf, Buffer cbuf,
-							 BTStack stack,
-							 IndexTuple itup,
-							 OffsetNumber newitemoff,
-							 bool split_only_page);
-static Buffer _bt_split_s(VRelation rel, Buffer buf, Buffer cbuf,
-						  OffsetNumber firstright, OffsetNumber newitemoff, Size newitemsz,
-						  IndexTuple newitem, bool newitemonleft);
-static void _bt_insert_parent_s(VRelation rel, Buffer buf, Buffer rbuf,
-								BTStack stack, bool is_root, bool is_only);
-static OffsetNumber _bt_findsplitloc_s(VRelation rel, Page page,
+/*
+ * Insertions
+ *
+ * The index is stored level by level, with the root in block 0 (see
+ * _bt_levelstart_s), and the root is never split, so the tree keeps the
+ * height it was loaded with.  The blocks of a level after the ones in use
+ * (levelBlocks) are the free pages for the splits of that level, and an
+ * insertion that would need a page that does not exist is rejected.
+ *
+ * An insertion reads the pages of its path from the root to the leaf and
+ * writes them all back.  Below the root, each level also reads and writes
+ * the new right page and the old right sibling of a split, or does dummy
+ * accesses in their place, so every insertion makes the same number of
+ * ORAM accesses whether it splits pages or not.  Pages are only written
+ * once the insertion is known to succeed, so a rejected insertion leaves
+ * the index as it was, and its accesses are padded with dummy accesses to
+ * the ones of an insertion that succeeds.
+ */
+
+/* Accesses of an insertion to a level: the path page and, below the root,
+ * the pages of a split, each read and written back. */
+#define BT_INSERT_ACCESSES(level)	((level) == 0 ? 2 : 6)
+
+/* A page on the path of an insertion and the pages of its split. */
+typedef struct BTInsertLevel
+{
+	Buffer		buf;			/* page on the path */
+	BlockNumber blkno;			/* its block number on the level */
+	OffsetNumber downlink;		/* offset of the downlink followed */
+	bool		split;			/* was the page split? */
+	Buffer		rbuf;			/* new right page, if split */
+	bool		sibling;		/* did the split page have a right sibling? */
+	Buffer		sbuf;			/* old right sibling, if any */
+	int			naccess;		/* accesses made to the level */
+}			BTInsertLevel;
+
+
+static bool _bt_insertonlevel_s(VRelation rel, unsigned int level,
+								BTInsertLevel * lev, IndexTuple item,
+								OffsetNumber itemoff, IndexTuple *downlink);
+static void _bt_padlevel_s(VRelation rel, unsigned int level, int naccess);
+static OffsetNumber _bt_findsplitloc_s(Page page,
 									   OffsetNumber newitemoff,
 									   Size newitemsz,
 									   bool *newitemonleft);
 static void _bt_checksplitloc_s(FindSplitData * state,
 								OffsetNumber firstoldonright, bool newitemonleft,
 								int dataitemstoleft, Size firstoldonrightsz);
-static bool _bt_pgaddtup_s(Page page, Size itemsize, IndexTuple itup,
-						   OffsetNumber itup_off);
 
 /*
  *	_bt_doinsert() -- Handle insertion of a single index tuple in the tree.
  *
  *		This routine is called by the public interface routine, btinsert.
- *		By here, itup is filled in, including the TID.
- *
- *		If checkUnique is UNIQUE_CHECK_NO or UNIQUE_CHECK_PARTIAL, this
- *		will allow duplicates.  Otherwise (UNIQUE_CHECK_YES or
- *		UNIQUE_CHECK_EXISTING) it will throw error for a duplicate.
- *		For UNIQUE_CHECK_EXISTING we merely run the duplicate check, and
- *		don't actually insert.
+ *		By here, itup is filled in, including the TID.  Duplicate keys are
+ *		allowed.
  *
- *		The result value is only significant for UNIQUE_CHECK_PARTIAL:
- *		it must be true if the entry is known unique, else false.
- *		(In the current implementation we'll also return true after a
- *		successful UNIQUE_CHECK_YES or UNIQUE_CHECK_EXISTING call, but
- *		that's just a coding artifact.)
+ *		Returns false if the tuple could not be inserted, in which case the
+ *		index is unchanged.
  */
 bool
 _bt_doinsert_s(VRelation rel, IndexTuple itup, char *datum, int size, VRelation heapRel)
 {
-	bool		is_unique = false;
-	int			indnkeyatts;
+	BTInsertLevel *path;
 	ScanKey		itup_scankey;
-	BTStack		stack = NULL;
-	Buffer		buf;
-	OffsetNumber offset;
+	IndexTuple	item;
+	IndexTuple	downlink;
+	Page		page;
+	BTPageOpaque opaque;
+	OffsetNumber offnum;
+	BlockNumber blkno;
+	int			height;
+	int			nread;
+	int			level;
+	bool		ok;
 
-	/* bool		fastpath; */
+	/* Inserted items would not have the access counters of the tokens. */
+	if (rel->backend->tokens || rel->levelBlocks == NULL)
+	{
+		selog(ERROR, "Index does not support insertions");
+		return false;
+	}
 
-	/* We currently only support indexing a single column. */
-	indnkeyatts = 1;
+	height = rel->nlevels + 1;
+	path = (BTInsertLevel *) calloc(height, sizeof(BTInsertLevel));
+	rel->token = NULL;
 
 	/* we need an insertion scan key to do our search, so build one */
 	itup_scankey = _bt_mkscankey_s(rel, itup, datum, size);
 
-	/*
-	 * It's very common to have an index on an auto-incremented or
-	 * monotonically increasing value. In such cases, every insertion happens
-	 * towards the end of the index. We try to optimize that case by caching
-	 * the right-most leaf of the index. If our cached block is still the
-	 * rightmost leaf, has enough free space to accommodate a new entry and
-	 * the insertion key is strictly greater than the first key in this page,
-	 * then we can safely conclude that the new key will be inserted in the
-	 * cached block. So we simply search within the cached block and insert
-	 * the key at the appropriate location. We call it a fastpath.
-	 *
-	 * Testing has revealed, though, that the fastpath can result in increased
-	 * contention on the exclusive-lock on the rightmost leaf page. So we
-	 * conditionally check if the lock is available. If it's not available
-	 * then we simply abandon the fastpath and take the regular path. This
-	 * makes sense because unavailability of the lock also signals that some
-	 * other backend might be concurrently inserting into the page, thus
-	 * reducing our chances to finding an insertion place in this page.
-	 */
-	/* fastpath = false; */
-	offset = InvalidOffsetNumber;
+	/* descend to the leaf, keeping every page of the path */
+	ok = true;
+	blkno = 0;
+	for (nread = 0; nread < height; nread++)
+	{
+		rel->level = nread;
+		path[nread].buf = _bt_getbuf_level_s(rel, blkno);
+		path[nread].blkno = blkno;
+		path[nread].naccess = 1;
+		page = BufferGetPage_s(rel, path[nread].buf);
+		opaque = (BTPageOpaque) PageGetSpecialPointer_s(page);
+
+		if (P_ISLEAF_s(opaque) != (nread == height - 1))
+		{
+			selog(ERROR, "Block %u of level %d does not match the index height %d",
+				  blkno, nread, height);
+			ok = false;
+			nread++;
+			break;
+		}
 
-	/* find the first page containing this key */
-	//stack = _bt_search_s(rel, indnkeyatts, itup_scankey, false, &buf, BT_WRITE, false);
+		offnum = _bt_binsrch_s(rel, path[nread].buf, 1, itup_scankey, false);
+		path[nread].downlink = offnum;
+		if (nread < height - 1)
+			blkno = BTreeInnerTupleGetDownLink_s((IndexTuple)
+												 PageGetItem_s(page, PageGetItemId_s(page, offnum)));
+		else if (P_NORMKEYS_s(opaque) && rel->tDesc->natts == 1)
+			_bt_normalizetuple_s(rel->tDesc->attrs->atttypid, itup);
+	}
 
 	/*
-	 * If the page was split between the time that we surrendered our read
-	 * lock and acquired our write lock, then this page may no longer be the
-	 * right place for the key we want to insert.  In this case, we need to
-	 * move right in the tree.  See Lehman and Yao for an excruciatingly
-	 * precise description.
+	 * Insert the tuple on the leaf and the downlinks of the split pages on
+	 * their parents, bottom-up.  The levels above the last split do the
+	 * dummy accesses of a split too.
 	 */
-	/* Concurrent splits are not supported on the prototype. */
-
-	/* Enable duplicate keys. */
-
-	/* do the insertion */
-	_bt_findinsertloc_s(rel, &buf, &offset, indnkeyatts, itup_scankey, itup,
-						stack, heapRel);
-
-	_bt_insertonpg_s(rel, buf, InvalidBuffer, stack, itup, offset, false);
+	item = itup;
+	offnum = ok ? path[height - 1].downlink : InvalidOffsetNumber;
+	for (level = height - 1; ok && level >= 0; level--)
+	{
+		rel->level = level;
+		if (item != NULL)
+		{
+			ok = _bt_insertonlevel_s(rel, level, &path[level], item, offnum,
+									 &downlink);
+			if (item != itup)
+				free(item);
+			item = downlink;
+			if (level > 0)
+				offnum = OffsetNumberNext_s(path[level - 1].downlink);
+		}
+		if (ok && level > 0)
+		{
+			if (!path[level].split)
+				ReadDummyBuffer(rel, rel->totalBlocks + 1);
+			if (!path[level].sibling)
+				ReadDummyBuffer(rel, rel->totalBlocks + 1);
+			path[level].naccess += !path[level].split + !path[level].sibling;
+		}
+	}
+	if (item != NULL && item != itup)
+		free(item);
 
+	/* write back the path and the split pages */
+	for (level = height - 1; ok && level >= 0; level--)
+	{
+		rel->level = level;
+		MarkBufferDirty_s(rel, path[level].buf);
+		path[level].naccess++;
+		if (level == 0)
+			continue;
+		if (path[level].split)
+		{
+			MarkBufferDirty_s(rel, path[level].rbuf);
+			rel->levelBlocks[level]++;
+		}
+		else
+			ReadDummyBuffer(rel, rel->totalBlocks + 1);
+		if (path[level].sibling)
+			MarkBufferDirty_s(rel, path[level].sbuf);
+		else
+			ReadDummyBuffer(rel, rel->totalBlocks + 1);
+		path[level].naccess += 2;
+	}
 
+	/* a rejected insertion makes the accesses it did not make */
+	for (level = 0; level < height; level++)
+		_bt_padlevel_s(rel, level, path[level].naccess);
 
 	/* be tidy */
-	if (stack)
-		_bt_freestack_s(stack);
+	for (level = 0; level < nread; level++)
+	{
+		ReleaseBuffer_s(rel, path[level].buf);
+		if (path[level].split)
+			ReleaseBuffer_s(rel, path[level].rbuf);
+		if (path[level].sibling)
+			ReleaseBuffer_s(rel, path[level].sbuf);
+	}
+	free(path);
 	_bt_freeskey_s(itup_scankey);
 
-	return is_unique;
+	return ok;
 }
 
+/*
+ * Dummy accesses to a level after naccess accesses of an insertion, up to
+ * the accesses of an insertion that succeeds.
+ */
+static void
+_bt_padlevel_s(VRelation rel, unsigned int level, int naccess)
+{
+	rel->level = level;
+	for (; naccess < BT_INSERT_ACCESSES(level); naccess++)
+		ReadDummyBuffer(rel, rel->totalBlocks + 1);
+}
 
 /*
- *	_bt_findinsertloc() -- Finds an insert location for a tuple
- *
- *		If the new key is equal to one or more existing keys, we can
- *		legitimately place it anywhere in the series of equal keys --- in fact,
- *		if the new key is equal to the page's "high key" we can place it on
- *		the next page.  If it is equal to the high key, and there's not room
- *		to insert the new tuple on the current page without splitting, then
- *		we can move right hoping to find more free space and avoid a split.
- *		(We should not move right indefinitely, however, since that leads to
- *		O(N^2) insertion behavior in the presence of many equal keys.)
- *		Once we have chosen the page to put the key on, we'll insert it before
- *		any existing equal keys because of the way _bt_binsrch() works.
- *
- *		If there's not enough room in the space, we try to make room by
- *		removing any LP_DEAD tuples.
+ *	_bt_dummyinsert() -- Make the accesses of an insertion without inserting.
  *
- *		On entry, *bufptr and *offsetptr point to the first legal position
- *		where the new tuple could be inserted.  The caller should hold an
- *		exclusive lock on *bufptr.  *offsetptr can also be set to
- *		InvalidOffsetNumber, in which case the function will search for the
- *		right location within the page if needed.  On exit, they point to the
- *		chosen insert location.  If _bt_findinsertloc decides to move right,
- *		the lock and pin on the original page will be released and the new
- *		page returned to the caller is exclusively locked instead.
+ *		Used by the callers that reject an insertion before it reaches the
+ *		index, so that the rejection is not told apart from an insertion.
+ */
+void
+_bt_dummyinsert_s(VRelation rel)
+{
+	unsigned int level;
+
+	for (level = 0; level <= rel->nlevels; level++)
+		_bt_padlevel_s(rel, level, 0);
+}
+
+/*
+ *	_bt_insertonlevel() -- Insert an item on the page of the path on a level.
  *
- *		newtup is the new tuple we're inserting, and scankey is an insertion
- *		type scan key for it.
+ *		If the page is full it is split into the next free block of the
+ *		level, whose buffer is kept in lev together with the buffer of the
+ *		old right sibling, and *downlink is set to the item to insert on
+ *		the parent.  Nothing is written.  Returns false on error.
  */
-static void
-_bt_findinsertloc_s(VRelation rel,
-					Buffer * bufptr,
-					OffsetNumber * offsetptr,
-					int keysz,
-					ScanKey scankey,
-					IndexTuple newtup,
-					BTStack stack,
-					VRelation heapRel)
+static bool
+_bt_insertonlevel_s(VRelation rel, unsigned int level, BTInsertLevel * lev,
+					IndexTuple item, OffsetNumber itemoff, IndexTuple *downlink)
 {
-	Buffer		buf = *bufptr;
-	Page		page = BufferGetPage_s(rel, buf);
+	Page		page = BufferGetPage_s(rel, lev->buf);
+	BTPageOpaque opaque = (BTPageOpaque) PageGetSpecialPointer_s(page);
+	BTPageOpaque sopaque;
+	BlockNumber rblkno;
 	Size		itemsz;
-	BTPageOpaque lpageop;
-	bool		movedright,
-				vacuumed;
-	OffsetNumber newitemoff;
-	OffsetNumber firstlegaloff = *offsetptr;
-
-	lpageop = (BTPageOpaque) PageGetSpecialPointer_s(page);
 
-	itemsz = IndexTupleSize_s(newtup);
-	itemsz = MAXALIGN_s(itemsz);	/* be safe, PageAddItem will do this but
-									 * we need to be consistent */
+	*downlink = NULL;
+	itemsz = MAXALIGN_s(IndexTupleSize_s(item));
 
 	/*
-	 * Check whether the item can fit on a btree page at all. (Eventually, we
-	 * ought to try to apply TOAST methods if not.) We actually need to be
-	 * able to fit three items on every page, so restrict any one item to 1/3
-	 * the per-page available space. Note that at this point, itemsz doesn't
-	 * include the ItemId.
-	 *
-	 * NOTE: if you change this, see also the similar code in _bt_buildadd().
+	 * Check whether the item can fit on a btree page at all.  We actually
+	 * need to be able to fit three items on every page, so restrict any one
+	 * item to 1/3 the per-page available space.
 	 */
 	if (itemsz > BTMaxItemSize_s(page))
-		selog(DEBUG1, "index row size %zu exceeds maximum %zu for index",
+	{
+		selog(ERROR, "index row size %zu exceeds maximum %zu for index",
 			  itemsz, BTMaxItemSize_s(page));
+		return false;
+	}
 
-	/*----------
-	 * If we will need to split the page to put the item on this page,
-	 * check whether we can put the tuple somewhere to the right,
-	 * instead.  Keep scanning right until we
-	 *		(a) find a page with enough free space,
-	 *		(b) reach the last page where the tuple can legally go, or
-	 *		(c) get tired of searching.
-	 * (c) is not flippant; it is important because if there are many
-	 * pages' worth of equal keys, it's better to split one of the early
-	 * pages than to scan all the way to the end of the run of equal keys
-	 * on every insert.  We implement "get tired" as a random choice,
-	 * since stopping after scanning a fixed number of pages wouldn't work
-	 * well (we'd never reach the right-hand side of previously split
-	 * pages).  Currently the probability of moving right is set at 0.99,
-	 * which may seem too high to change the behavior much, but it does an
-	 * excellent job of preventing O(N^2) behavior with many equal keys.
-	 *----------
+	/*
+	 * Note: PageGetFreeSpace() subtracts sizeof(ItemIdData) from its result,
+	 * so this comparison is correct even though we appear to be accounting
+	 * only for the item and not for its line pointer.
 	 */
-	movedright = false;
-	vacuumed = false;
-	while (PageGetFreeSpace_s(page) < itemsz)
+	if (PageGetFreeSpace_s(page) >= itemsz)
 	{
-		Buffer		rbuf;
-		BlockNumber rblkno;
-
-		/* selog(DEBUG1, "Page has no free space, going to find next"); */
-
-		/*
-		 * before considering moving right, see if we can obtain enough space
-		 * by erasing LP_DEAD items
-		 */
-		/* if (P_ISLEAF_s(lpageop) && P_HAS_GARBAGE(lpageop)) */
-
-		/*
-		 * nope, so check conditions (b) and (c) enumerated above
-		 */
-		if (P_RIGHTMOST_s(lpageop) ||
-			_bt_compare_s(rel, keysz, scankey, page, P_HIKEY) != 0 ||
-			getRandomInt_nb() <= (MAX_RANDOM_VALUE / 100))
-			break;
-
-		/*
-		 * step right to next non-dead page
-		 *
-		 * must write-lock that page before releasing write lock on current
-		 * page; else someone else's _bt_check_unique scan could fail to see
-		 * our insertion.  write locks on intermediate dead pages won't do
-		 * because we don't know when they will get de-linked from the tree.
-		 */
-		rbuf = InvalidBuffer;
-
-		rblkno = lpageop->btpo_next;
-		for (;;)
+		if (!_bt_pgaddtup_s(page, itemsz, item, itemoff))
 		{
-
-			ReleaseBuffer_s(rel, buf);
-			rbuf = ReadBuffer_s(rel, rblkno);
-			page = BufferGetPage_s(rel, rbuf);
-			lpageop = (BTPageOpaque) PageGetSpecialPointer_s(page);
-
-			/*
-			 * If this page was incompletely split, finish the split now. We
-			 * do this while holding a lock on the left sibling, which is not
-			 * good because finishing the split could be a fairly lengthy
-			 * operation.  But this should happen very seldom.
-			 */
-			/* Prototype assumes splits are always competed until the end. */
-			/* if (P_INCOMPLETE_SPLIT(lpageop)) */
-			/* { */
-			/* _bt_finish_split(rel, rbuf, stack); */
-			/* rbuf = InvalidBuffer; */
-			/* continue; */
-			/* } */
-
-			if (!P_IGNORE_s(lpageop))
-				break;
-			if (P_RIGHTMOST_s(lpageop))
-				selog(ERROR, "fell off the end of index");
-
-			rblkno = lpageop->btpo_next;
+			selog(ERROR, "failed to add new item to block %u in index",
+				  lev->blkno);
+			return false;
 		}
-		ReleaseBuffer_s(rel, buf);
-		buf = rbuf;
-		movedright = true;
-		vacuumed = false;
+		return true;
 	}
 
-	/*
-	 * Now we are on the right page, so find the insert position. If we moved
-	 * right at all, we know we should insert at the start of the page. If we
-	 * didn't move right, we can use the firstlegaloff hint if the caller
-	 * supplied one, unless we vacuumed the page which might have moved tuples
-	 * around making the hint invalid. If we didn't move right or can't use
-	 * the hint, find the position by searching.
-	 */
-	if (movedright)
-	{
-		newitemoff = P_FIRSTDATAKEY_s(lpageop);
-	}
-	else if (firstlegaloff != InvalidOffsetNumber && !vacuumed)
+	if (level == 0)
 	{
-		newitemoff = firstlegaloff;
+		selog(ERROR, "Index root is full");
+		return false;
 	}
-	else
+
+	rblkno = rel->levelBlocks[level];
+	if (rblkno >= _bt_levelsize_s(rel, level))
 	{
-		/* selog(DEBUG1, "Going to find offset to insert tuple"); */
-		newitemoff = _bt_binsrch_s(rel, buf, keysz, scankey, false);
+		selog(ERROR, "No free blocks left on level %u of index", level);
+		return false;
 	}
 
-	*bufptr = buf;
-	*offsetptr = newitemoff;
-}
-
-/*----------
- *	_bt_insertonpg() -- Insert a tuple on a particular page in the index.
- *
- *		This recursive procedure does the following things:
- *
- *			+  if necessary, splits the target page (making sure that the
- *			   split is equitable as far as post-insert free space goes).
- *			+  inserts the tuple.
- *			+  if the page was split, pops the parent stack, and finds the
- *			   right place to insert the new child pointer (by walking
- *			   right using information stored in the parent stack).
- *			+  invokes itself with the appropriate tuple for the right
- *			   child page on the parent.
- *			+  updates the metapage if a true root or fast root is split.
- *
- *		On entry, we must have the correct buffer in which to do the
- *		insertion, and the buffer must be pinned and write-locked.  On return,
- *		we will have dropped both the pin and the lock on the buffer.
- *
- *		This routine only performs retail tuple insertions.  'itup' should
- *		always be either a non-highkey leaf item, or a downlink (new high
- *		key items are created indirectly, when a page is split).  When
- *		inserting to a non-leaf page, 'cbuf' is the left-sibling of the page
- *		we're inserting the downlink for.  This function will clear the
- *		INCOMPLETE_SPLIT flag on it, and release the buffer.
- *
- *		The locking interactions in this code are critical.  You should
- *		grok Lehman and Yao's paper before making any changes.  In addition,
- *		you need to understand how we disambiguate duplicate keys in this
- *		implementation, in order to be able to find our location using
- *		L&Y "move right" operations.
- *----------
- */
-static void
-_bt_insertonpg_s(VRelation rel,
-				 Buffer buf,
-				 Buffer cbuf,
-				 BTStack stack,
-				 IndexTuple itup,
-				 OffsetNumber newitemoff,
-				 bool split_only_page)
-{
-	Page		page;
-	BTPageOpaque lpageop;
-	OffsetNumber firstright = InvalidOffsetNumber;
-	Size		itemsz;
-
-	page = BufferGetPage_s(rel, buf);
-	lpageop = (BTPageOpaque) PageGetSpecialPointer_s(page);
-
-
-	/* The caller should've finished any incomplete splits already. */
-	if (P_INCOMPLETE_SPLIT_s(lpageop))
-		selog(ERROR, "cannot insert to incompletely split page %u", buf);
-
-	itemsz = IndexTupleSize_s(itup);
-	itemsz = MAXALIGN_s(itemsz);	/* be safe, PageAddItem will do this but
-									 * we need to be consistent */
-
-	/*
-	 * Do we need to split the page to fit the item on it?
-	 *
-	 * Note: PageGetFreeSpace() subtracts sizeof(ItemIdData) from its result,
-	 * so this comparison is correct even though we appear to be accounting
-	 * only for the item and not for its line pointer.
-	 */
-	if (PageGetFreeSpace_s(page) < itemsz)
+	lev->rbuf = _bt_getbuf_level_s(rel, rblkno);
+	lev->split = true;
+	lev->naccess++;
+	if (!P_RIGHTMOST_s(opaque))
 	{
-		bool		is_root = P_ISROOT_s(lpageop);
-		bool		is_only = P_LEFTMOST_s(lpageop) && P_RIGHTMOST_s(lpageop);
-		bool		newitemonleft;
-		Buffer		rbuf;
-
-		/*
-		 * If we're here then a pagesplit is needed. We should never reach
-		 * here if we're using the fastpath since we should have checked for
-		 * all the required conditions, including the fact that this page has
-		 * enough freespace. Note that this routine can in theory deal with
-		 * the situation where a NULL stack pointer is passed (that's what
-		 * would happen if the fastpath is taken), like it does during crash
-		 * recovery. But that path is much slower, defeating the very purpose
-		 * of the optimization.  The following assertion should protect us
-		 * from any future code changes that invalidate those assumptions.
-		 *
-		 * Note that whenever we fail to take the fastpath, we clear the
-		 * cached block. Checking for a valid cached block at this point is
-		 * enough to decide whether we're in a fastpath or not.
-		 */
-
-		/* Choose the split point */
-		firstright = _bt_findsplitloc_s(rel, page,
-										newitemoff, itemsz,
-										&newitemonleft);
-
-
-		/* split the buffer into left and right halves */
-		rbuf = _bt_split_s(rel, buf, cbuf, firstright,
-						   newitemoff, itemsz, itup, newitemonleft);
-		/* selog(DEBUG1, "Page %d was split. Right buf is %d", buf, rbuf); */
-
-		/*----------
-		 * By here,
-		 *
-		 *		+  our target page has been split;
-		 *		+  the original tuple has been inserted;
-		 *		+  we have write locks on both the old (left half)
-		 *		   and new (right half) buffers, after the split; and
-		 *		+  we know the key we want to insert into the parent
-		 *		   (it's the "high key" on the left child page).
-		 *
-		 * We're ready to do the parent insertion.  We need to hold onto the
-		 * locks for the child pages until we locate the parent, but we can
-		 * release them before doing the actual insertion (see Lehman and Yao
-		 * for the reasoning).
-		 *----------
-		 */
-		_bt_insert_parent_s(rel, buf, rbuf, stack, is_root, is_only);
+		lev->sbuf = _bt_getbuf_level_s(rel, opaque->btpo_next);
+		lev->sibling = true;
+		lev->naccess++;
 	}
-	else
-	{
-		Buffer		metabuf = InvalidBuffer;
-		Page		metapg = NULL;
-		BTMetaPageData *metad = NULL;
 
-		/* OffsetNumber itup_off; */
-		BlockNumber itup_blkno;
-
-		/* itup_off = newitemoff; */
-		itup_blkno = BufferGetBlockNumber_s(buf);
-
-		/*
-		 * If we are doing this insert because we split a page that was the
-		 * only one on its tree level, but was not the root, it may have been
-		 * the "fast root".  We need to ensure that the fast root link points
-		 * at or above the current page.  We can safely acquire a lock on the
-		 * metapage here --- see comments for _bt_newroot().
-		 */
-		/* if (split_only_page) */
-
-		/*
-		 * The code for the above condition has been removed because the
-		 * prototype does not support fast paths.
-		 */
-
-		/*
-		 * Every internal page should have exactly one negative infinity item
-		 * at all times.  Only _bt_split() and _bt_newroot() should add items
-		 * that become negative infinity items through truncation, since
-		 * they're the only routines that allocate new internal pages.  Do not
-		 * allow a retail insertion of a new item at the negative infinity
-		 * offset.
-		 */
-		if (!P_ISLEAF_s(lpageop) && newitemoff == P_FIRSTDATAKEY_s(lpageop))
-			selog(ERROR, "cannot insert second negative infinity item in block %u of index", itup_blkno);
-
-		if (!_bt_pgaddtup_s(page, itemsz, itup, newitemoff))
-			selog(ERROR, "failed to add new item to block %u in index",
-				  itup_blkno);
-
-		MarkBufferDirty_s(rel, buf);
-
-		if (BufferIsValid_s(rel, metabuf))
-		{
-			/* upgrade meta-page if needed */
-			if (metad->btm_version < BTREE_VERSION)
-				_bt_upgrademetapage_s(metapg);
-			metad->btm_fastroot = itup_blkno;
-			metad->btm_fastlevel = lpageop->btpo.level;
-			MarkBufferDirty_s(rel, metabuf);
-		}
+	*downlink = _bt_splitpage_s(page, lev->blkno,
+								BufferGetPage_s(rel, lev->rbuf), rblkno,
+								rel->tDesc, item, itemoff);
+	if (*downlink == NULL)
+		return false;
 
-		/* clear INCOMPLETE_SPLIT flag on child if inserting a downlink */
-		if (BufferIsValid_s(rel, cbuf))
+	if (lev->sibling)
+	{
+		sopaque = (BTPageOpaque) PageGetSpecialPointer_s(BufferGetPage_s(rel, lev->sbuf));
+		if (sopaque->btpo_prev != lev->blkno)
 		{
-			Page		cpage = BufferGetPage_s(rel, cbuf);
-			BTPageOpaque cpageop = (BTPageOpaque) PageGetSpecialPointer_s(cpage);
-
-			cpageop->btpo_flags &= ~BTP_INCOMPLETE_SPLIT;
-			MarkBufferDirty_s(rel, cbuf);
+			selog(ERROR, "right sibling's left-link doesn't match: "
+				  "block %u links to %u instead of expected %u",
+				  opaque->btpo_next, sopaque->btpo_prev, lev->blkno);
+			return false;
 		}
-
-
-		/* release buffers */
-		if (BufferIsValid_s(rel, metabuf))
-			ReleaseBuffer_s(rel, metabuf);
-		if (BufferIsValid_s(rel, cbuf))
-			ReleaseBuffer_s(rel, cbuf);
-		ReleaseBuffer_s(rel, buf);
+		sopaque->btpo_prev = rblkno;
 	}
+
+	return true;
 }
 
 /*
- *	_bt_split() -- split a page in the btree.
+ *	_bt_splitpage() -- split a page in the btree.
  *
- *		On entry, buf is the page to split, and is pinned and write-locked.
- *		firstright is the item index of the first item to be moved to the
- *		new right page.  newitemoff etc. tell us about the new item that
- *		must be inserted along with the data from the old page.
+ *		origpage, block origblkno of its level, is the full page where
+ *		newitem goes at offset newitemoff.  The upper half of its items move
+ *		to rightpage, the free block rightblkno of the same level, which is
+ *		linked after origpage.  Sibling links are block numbers on the
+ *		level; the caller fixes the left-link of the old right sibling.
  *
- *		When splitting a non-leaf page, 'cbuf' is the left-sibling of the
- *		page we're inserting the downlink for.  This function will clear the
- *		INCOMPLETE_SPLIT flag on it, and release the buffer.
- *
- *		Returns the new right sibling of buf, pinned and write-locked.
- *		The pin and lock on buf are maintained.
+ *		Returns the downlink to rightpage to insert on the parent, after
+ *		the downlink to origpage, or NULL if the split failed.  origpage is
+ *		only modified on success.
  */
-static Buffer
-_bt_split_s(VRelation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
-			OffsetNumber newitemoff, Size newitemsz, IndexTuple newitem,
-			bool newitemonleft)
+IndexTuple
+_bt_splitpage_s(Page origpage, BlockNumber origblkno, Page rightpage,
+				BlockNumber rightblkno, TupleDesc desc, IndexTuple newitem,
+				OffsetNumber newitemoff)
 {
-	Buffer		rbuf;
-	Page		origpage;
-	Page		leftpage,
-				rightpage;
-	BlockNumber origpagenumber,
-				rightpagenumber;
+	Page		leftpage;
 	BTPageOpaque ropaque,
 				lopaque,
 				oopaque;
-	Buffer		sbuf = InvalidBuffer;
-	Page		spage = NULL;
-	BTPageOpaque sopaque = NULL;
+	Size		newitemsz;
 	Size		itemsz;
 	ItemId		itemid;
 	IndexTuple	item;
+	IndexTuple	lefthikey;
+	IndexTuple	downlink;
+	OffsetNumber firstright;
 	OffsetNumber leftoff,
 				rightoff;
 	OffsetNumber maxoff;
 	OffsetNumber i;
+	bool		newitemonleft;
 	bool		isleaf;
-	IndexTuple	lefthikey;
 
-	/* int			indnatts = 1;//IndexRelationGetNumberOfAttributes(rel); */
+	newitemsz = MAXALIGN_s(IndexTupleSize_s(newitem));
 
-	/*
-	 * int			indnkeyatts =
-	 * 1;//IndexRelationGetNumberOfKeyAttributes(rel);
-	 */
-
-	/* Acquire a new page to split into */
-	rbuf = _bt_getbuf_s(rel, P_NEW, BT_WRITE);
+	/* Choose the split point */
+	firstright = _bt_findsplitloc_s(origpage, newitemoff, newitemsz,
+									&newitemonleft);
+	if (firstright == InvalidOffsetNumber)
+		return NULL;
 
 	/*
-	 * origpage is the original page to be split.  leftpage is a temporary
-	 * buffer that receives the left-sibling data, which will be copied back
-	 * into origpage on success.  rightpage is the new page that receives the
-	 * right-sibling data.  If we fail before reaching the critical section,
-	 * origpage hasn't been modified and leftpage is only workspace. In
-	 * principle we shouldn't need to worry about rightpage either, because it
-	 * hasn't been linked into the btree page structure; but to avoid leaving
-	 * possibly-confusing junk behind, we are careful to rewrite rightpage as
-	 * zeroes before throwing any error.
+	 * leftpage is a temporary buffer that receives the left-sibling data,
+	 * which will be copied back into origpage on success.
 	 */
-	origpage = BufferGetPage_s(rel, buf);
 	leftpage = PageGetTempPage_s(origpage);
-	rightpage = BufferGetPage_s(rel, rbuf);
-
-
-	origpagenumber = BufferGetBlockNumber_s(buf);
-	rightpagenumber = BufferGetBlockNumber_s(rbuf);
-
-	_bt_pageinit_s(leftpage, BufferGetPageSize_s(rel, buf));
-	/* rightpage was already initialized by _bt_getbuf */
-
-	/*
-	 * Copy the original page's LSN into leftpage, which will become the
-	 * updated version of the page.  We need this because XLogInsert will
-	 * examine the LSN and possibly dump it in a page image.
-	 */
-	/* PageSetLSN(leftpage, PageGetLSN(origpage)); */
+	_bt_pageinit_s(leftpage, BLCKSZ);
+	_bt_pageinit_s(rightpage, BLCKSZ);
 
 	/* init btree private data */
 	oopaque = (BTPageOpaque) PageGetSpecialPointer_s(origpage);
@@ -618,22 +416,19 @@ _bt_split_s(VRelation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
 
 	isleaf = P_ISLEAF_s(oopaque);
 
-	/* if we're splitting this page, it won't be the root when we're done */
-	/* also, clear the SPLIT_END and HAS_GARBAGE flags in both pages */
+	/* clear the SPLIT_END and HAS_GARBAGE flags in both pages */
 	lopaque->btpo_flags = oopaque->btpo_flags;
-	lopaque->btpo_flags &= ~(BTP_ROOT | BTP_SPLIT_END | BTP_HAS_GARBAGE);
+	lopaque->btpo_flags &= ~(BTP_ROOT | BTP_SPLIT_END | BTP_HAS_GARBAGE |
+							 BTP_INCOMPLETE_SPLIT);
 	ropaque->btpo_flags = lopaque->btpo_flags;
-	/* set flag in left page indicating that the right page has no downlink */
-	lopaque->btpo_flags |= BTP_INCOMPLETE_SPLIT;
 	lopaque->btpo_prev = oopaque->btpo_prev;
-	lopaque->btpo_next = rightpagenumber;
-	ropaque->btpo_prev = origpagenumber;
+	lopaque->btpo_next = rightblkno;
+	ropaque->btpo_prev = origblkno;
 	ropaque->btpo_next = oopaque->btpo_next;
 	lopaque->btpo.level = ropaque->btpo.level = oopaque->btpo.level;
 	lopaque->o_blkno = oopaque->o_blkno;
-	/* Since we already have write-lock on both pages, ok to read cycleid */
-	/* lopaque->btpo_cycleid = _bt_vacuum_cycleid(rel); */
-	/* ropaque->btpo_cycleid = lopaque->btpo_cycleid; */
+	if (!P_RIGHTMOST_s(oopaque))
+		ropaque->btpo_flags |= BTP_SPLIT_END;
 
 	/*
 	 * If the page we're splitting is not the rightmost page at its level in
@@ -652,10 +447,9 @@ _bt_split_s(VRelation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
 		if (PageAddItem_s(rightpage, (Item) item, itemsz, rightoff,
 						  false, false) == InvalidOffsetNumber)
 		{
-			memset(rightpage, 0, BufferGetPageSize_s(rel, rbuf));
 			selog(ERROR, "failed to add hikey to the right sibling"
-				  " while splitting block %u of index",
-				  origpagenumber);
+				  " while splitting block %u of index", origblkno);
+			goto fail;
 		}
 		rightoff = OffsetNumberNext_s(rightoff);
 	}
@@ -680,26 +474,46 @@ _bt_split_s(VRelation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
 		item = (IndexTuple) PageGetItem_s(origpage, itemid);
 	}
 
+	/*
+	 * Truncate the high key of a leaf page to the prefix that separates
+	 * lastleft, the item that is going to be last on the left page, from
+	 * the first item of the right page.
+	 */
+	if (isleaf)
+	{
+		IndexTuple	lastleft;
 
-	lefthikey = item;
+		if (newitemonleft && newitemoff == firstright)
+			lastleft = newitem;
+		else
+		{
+			itemid = PageGetItemId_s(origpage, OffsetNumberPrev_s(firstright));
+			lastleft = (IndexTuple) PageGetItem_s(origpage, itemid);
+		}
+		lefthikey = _bt_truncate_s(desc, lastleft, item);
+		itemsz = MAXALIGN_s(IndexTupleSize_s(lefthikey));
+	}
+	else
+		lefthikey = item;
 
 	if (PageAddItem_s(leftpage, (Item) lefthikey, itemsz, leftoff,
 					  false, false) == InvalidOffsetNumber)
 	{
-		memset(rightpage, 0, BufferGetPageSize_s(rel, rbuf));
 		selog(ERROR, "failed to add hikey to the left sibling"
-			  " while splitting block %u of index", origpagenumber);
+			  " while splitting block %u of index", origblkno);
+		if (lefthikey != item)
+			free(lefthikey);
+		goto fail;
 	}
 	leftoff = OffsetNumberNext_s(leftoff);
-	/* be tidy */
-	if (lefthikey != item)
-		free(lefthikey);
+
+	/* the downlink to the right page is a copy of the left high key */
+	downlink = (lefthikey != item) ? lefthikey : CopyIndexTuple_s(lefthikey);
+	BTreeInnerTupleSetDownLink_s(downlink, rightblkno);
 
 	/*
-	 * Now transfer all the data items to the appropriate page.
-	 *
-	 * Note: we *must* insert at least the right page's items in item-number
-	 * order, for the benefit of _bt_restore_page().
+	 * Now transfer all the data items to the appropriate page. The items of
+	 * deleted tuples stay dead on the new pages.
 	 */
 	maxoff = PageGetMaxOffsetNumber_s(origpage);
 
@@ -714,12 +528,11 @@ _bt_split_s(VRelation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
 		{
 			if (newitemonleft)
 			{
-
 				if (!_bt_pgaddtup_s(leftpage, newitemsz, newitem, leftoff))
 				{
-					memset(rightpage, 0, BufferGetPageSize_s(rel, rbuf));
 					selog(ERROR, "failed to add new item to the left sibling"
-						  " while splitting block %u", origpagenumber);
+						  " while splitting block %u", origblkno);
+					goto faildownlink;
 				}
 				leftoff = OffsetNumberNext_s(leftoff);
 			}
@@ -727,10 +540,9 @@ _bt_split_s(VRelation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
 			{
 				if (!_bt_pgaddtup_s(rightpage, newitemsz, newitem, rightoff))
 				{
-					memset(rightpage, 0, BufferGetPageSize_s(rel, rbuf));
 					selog(ERROR, "failed to add new item to the right sibling"
-						  " while splitting block %u",
-						  origpagenumber);
+						  " while splitting block %u", origblkno);
+					goto faildownlink;
 				}
 				rightoff = OffsetNumberNext_s(rightoff);
 			}
@@ -741,22 +553,24 @@ _bt_split_s(VRelation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
 		{
 			if (!_bt_pgaddtup_s(leftpage, itemsz, item, leftoff))
 			{
-				memset(rightpage, 0, BufferGetPageSize_s(rel, rbuf));
 				selog(ERROR, "failed to add old item to the left sibling"
-					  " while splitting block %u",
-					  origpagenumber);
+					  " while splitting block %u", origblkno);
+				goto faildownlink;
 			}
+			if (ItemIdIsDead_s(itemid))
+				ItemIdMarkDead_s(PageGetItemId_s(leftpage, leftoff));
 			leftoff = OffsetNumberNext_s(leftoff);
 		}
 		else
 		{
 			if (!_bt_pgaddtup_s(rightpage, itemsz, item, rightoff))
 			{
-				memset(rightpage, 0, BufferGetPageSize_s(rel, rbuf));
 				selog(ERROR, "failed to add old item to the right sibling"
-					  " while splitting block %u",
-					  origpagenumber);
+					  " while splitting block %u", origblkno);
+				goto faildownlink;
 			}
+			if (ItemIdIsDead_s(itemid))
+				ItemIdMarkDead_s(PageGetItemId_s(rightpage, rightoff));
 			rightoff = OffsetNumberNext_s(rightoff);
 		}
 	}
@@ -764,117 +578,29 @@ _bt_split_s(VRelation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
 	/* cope with possibility that newitem goes at the end */
 	if (i <= newitemoff)
 	{
-		/*
-		 * Can't have newitemonleft here; that would imply we were told to put
-		 * *everything* on the left page, which cannot fit (if it could, we'd
-		 * not be splitting the page).
-		 */
-		/* Assert(!newitemonleft); */
 		if (!_bt_pgaddtup_s(rightpage, newitemsz, newitem, rightoff))
 		{
-			memset(rightpage, 0, BufferGetPageSize_s(rel, rbuf));
 			selog(ERROR, "failed to add new item to the right sibling"
-				  " while splitting block %u",
-				  origpagenumber);
+				  " while splitting block %u", origblkno);
+			goto faildownlink;
 		}
 		rightoff = OffsetNumberNext_s(rightoff);
 	}
 
 	/*
-	 * We have to grab the right sibling (if any) and fix the prev pointer
-	 * there. We are guaranteed that this is deadlock-free since no other
-	 * writer will be holding a lock on that page and trying to move left, and
-	 * all readers release locks on a page before trying to fetch its
-	 * neighbors.
-	 */
-
-	if (!P_RIGHTMOST_s(oopaque))
-	{
-		sbuf = _bt_getbuf_s(rel, oopaque->btpo_next, BT_WRITE);
-		spage = BufferGetPage_s(rel, sbuf);
-		sopaque = (BTPageOpaque) PageGetSpecialPointer_s(spage);
-		if (sopaque->btpo_prev != origpagenumber)
-		{
-			memset(rightpage, 0, BufferGetPageSize_s(rel, rbuf));
-			selog(ERROR, "right sibling's left-link doesn't match: "
-				  "block %u links to %u instead of expected %u",
-				  oopaque->btpo_next, sopaque->btpo_prev, origpagenumber);
-		}
-
-		/*
-		 * Check to see if we can set the SPLIT_END flag in the right-hand
-		 * split page; this can save some I/O for vacuum since it need not
-		 * proceed to the right sibling.  We can set the flag if the right
-		 * sibling has a different cycleid: that means it could not be part of
-		 * a group of pages that were all split off from the same ancestor
-		 * page.  If you're confused, imagine that page A splits to A B and
-		 * then again, yielding A C B, while vacuum is in progress.  Tuples
-		 * originally in A could now be in either B or C, hence vacuum must
-		 * examine both pages.  But if D, our right sibling, has a different
-		 * cycleid then it could not contain any tuples that were in A when
-		 * the vacuum started.
-		 */
-		ropaque->btpo_flags |= BTP_SPLIT_END;
-	}
-
-	/*
-	 * Right sibling is locked, new siblings are prepared, but original page
-	 * is not updated yet.
-	 *
-	 * NO EREPORT(ERROR) till right sibling is updated.  We can get away with
-	 * not starting the critical section till here because we haven't been
-	 * scribbling on the original page yet; see comments above.
-	 */
-	/* START_CRIT_SECTION(); */
-
-	/*
-	 * By here, the original data page has been split into two new halves, and
-	 * these are correct.  The algorithm requires that the left page never
-	 * move during a split, so we copy the new left page back on top of the
-	 * original.  Note that this is not a waste of time, since we also require
-	 * (in the page management code) that the center of a page always be
-	 * clean, and the most efficient way to guarantee this is just to compact
-	 * the data by reinserting it into a new left page.  (XXX the latter
-	 * comment is probably obsolete; but in any case it's good to not scribble
-	 * on the original page until we enter the critical section.)
-	 *
-	 * We need to do this before writing the WAL record, so that XLogInsert
-	 * can WAL log an image of the page if necessary.
+	 * The algorithm requires that the left page never move during a split,
+	 * so we copy the new left page back on top of the original.
 	 */
 	PageRestoreTempPage_s(leftpage, origpage);
-	/* leftpage, lopaque must not be used below here */
-
-	MarkBufferDirty_s(rel, buf);
-	MarkBufferDirty_s(rel, rbuf);
-	if (!P_RIGHTMOST_s(ropaque))
-	{
-		sopaque->btpo_prev = rightpagenumber;
-		MarkBufferDirty_s(rel, sbuf);
-	}
-
-	/*
-	 * Clear INCOMPLETE_SPLIT flag on child if inserting the new item finishes
-	 * a split.
-	 */
-	if (!isleaf)
-	{
-		Page		cpage = BufferGetPage_s(rel, cbuf);
-		BTPageOpaque cpageop = (BTPageOpaque) PageGetSpecialPointer_s(cpage);
-
-		cpageop->btpo_flags &= ~BTP_INCOMPLETE_SPLIT;
-		MarkBufferDirty_s(rel, cbuf);
-	}
 
-	/* release the old right sibling */
-	if (!P_RIGHTMOST_s(ropaque))
-		ReleaseBuffer_s(rel, sbuf);
+	return downlink;
 
-	/* release the child */
-	if (!isleaf)
-		ReleaseBuffer_s(rel, cbuf);
-
-	/* split's done */
-	return rbuf;
+faildownlink:
+	free(downlink);
+fail:
+	free(leftpage);
+	memset(rightpage, 0, BLCKSZ);
+	return NULL;
 }
 
 /*
@@ -903,8 +629,7 @@ _bt_split_s(VRelation rel, Buffer buf, Buffer cbuf, OffsetNumber firstright,
  * where firstright == newitemoff.
  */
 static OffsetNumber
-_bt_findsplitloc_s(VRelation rel,
-				   Page page,
+_bt_findsplitloc_s(Page page,
 				   OffsetNumber newitemoff,
 				   Size newitemsz,
 				   bool *newitemonleft)
@@ -1133,394 +858,6 @@ _bt_checksplitloc_s(FindSplitData * state,
 	}
 }
 
-/*
- * _bt_insert_parent() -- Insert downlink into parent after a page split.
- *
- * On entry, buf and rbuf are the left and right split pages, which we
- * still hold write locks on per the L&Y algorithm.  We release the
- * write locks once we have write lock on the parent page.  (Any sooner,
- * and it'd be possible for some other process to try to split or delete
- * one of these pages, and get confused because it cannot find the downlink.)
- *
- * stack - stack showing how we got here.  May be NULL in cases that don't
- *			have to be efficient (concurrent ROOT split, WAL recovery)
- * is_root - we split the true root
- * is_only - we split a page alone on its level (might have been fast root)
- */
-static void
-_bt_insert_parent_s(VRelation rel,
-					Buffer buf,
-					Buffer rbuf,
-					BTStack stack,
-					bool is_root,
-					bool is_only)
-{
-	/*
-	 * Here we have to do something Lehman and Yao don't talk about: deal with
-	 * a root split and construction of a new root.  If our stack is empty
-	 * then we have just split a node on what had been the root level when we
-	 * descended the tree.  If it was still the root then we perform a
-	 * new-root construction.  If it *wasn't* the root anymore, search to find
-	 * the next higher level that someone constructed meanwhile, and find the
-	 * right place to insert as for the normal case.
-	 *
-	 * If we have to search for the parent level, we do so by re-descending
-	 * from the root.  This is not super-efficient, but it's rare enough not
-	 * to matter.
-	 */
-	if (is_root)
-	{
-		Buffer		rootbuf;
-
-		/* create a new root node and update the metapage */
-		rootbuf = _bt_newroot_s(rel, buf, rbuf);
-
-		//selog(DEBUG1, "Root split. New root is %d", rootbuf);
-		/* release the split buffers */
-		ReleaseBuffer_s(rel, rootbuf);
-		ReleaseBuffer_s(rel, rbuf);
-		ReleaseBuffer_s(rel, buf);
-
-        //Everty time the tree root is plit, the gree gets heigher
-        //
-        rel->tHeight++;
-
-        selog(DEBUG1, "Current Tree height is %d", rel->tHeight);
-
-	}
-	else
-	{
-		BlockNumber bknum = BufferGetBlockNumber_s(buf);
-		BlockNumber rbknum = BufferGetBlockNumber_s(rbuf);
-		Page		page = BufferGetPage_s(rel, buf);
-		IndexTuple	new_item;
-
-/* 		BTStackData fakestack; */
-		IndexTuple	ritem;
-		Buffer		pbuf;
-
-		/* get high key from left page == lower bound for new right page */
-		ritem = (IndexTuple) PageGetItem_s(page,
-										   PageGetItemId_s(page, P_HIKEY));
-
-		/* form an index tuple that points at the new right page */
-		new_item = CopyIndexTuple_s(ritem);
-		BTreeInnerTupleSetDownLink_s(new_item, rbknum);
-
-		/*
-		 * Find the parent buffer and get the parent page.
-		 *
-		 * Oops - if we were moved right then we need to change stack item! We
-		 * want to find parent pointing to where we are, right ?	- vadim
-		 * 05/27/97
-		 */
-		stack->bts_btentry = bknum;
-		pbuf = _bt_getstackbuf_s(rel, stack, BT_WRITE);
-
-		/*
-		 * Now we can unlock the right child. The left child will be unlocked
-		 * by _bt_insertonpg().
-		 */
-		ReleaseBuffer_s(rel, rbuf);
-
-		/* Check for error only after writing children */
-		if (pbuf == InvalidBuffer)
-			selog(ERROR, "failed to re-find parent key in index for split pages %u/%u", bknum, rbknum);
-
-		/* Recursively update the parent */
-		_bt_insertonpg_s(rel, pbuf, buf, stack->bts_parent,
-						 new_item, stack->bts_offset + 1,
-						 is_only);
-
-		/* be tidy */
-		free(new_item);
-	}
-}
-
-
-/*
- *	_bt_getstackbuf() -- Walk back up the tree one step, and find the item
- *						 we last looked at in the parent.
- *
- *		This is possible because we save the downlink from the parent item,
- *		which is enough to uniquely identify it.  Insertions into the parent
- *		level could cause the item to move right; deletions could cause it
- *		to move left, but not left of the page we previously found it in.
- *
- *		Adjusts bts_blkno & bts_offset if changed.
- *
- *		Returns InvalidBuffer if item not found (should not happen).
- */
-Buffer
-_bt_getstackbuf_s(VRelation rel, BTStack stack, int access)
-{
-	BlockNumber blkno;
-	OffsetNumber start;
-
-	blkno = stack->bts_blkno;
-	start = stack->bts_offset;
-
-	for (;;)
-	{
-		Buffer		buf;
-		Page		page;
-		BTPageOpaque opaque;
-
-		buf = _bt_getbuf_s(rel, blkno, access);
-		page = BufferGetPage_s(rel, buf);
-		opaque = (BTPageOpaque) PageGetSpecialPointer_s(page);
-
-		if (access == BT_WRITE && P_INCOMPLETE_SPLIT_s(opaque))
-		{
-			selog(ERROR, "Concurrent splits are not supported");
-			/* _bt_finish_split(rel, buf, stack->bts_parent); */
-			/* continue; */
-		}
-
-		if (!P_IGNORE_s(opaque))
-		{
-			OffsetNumber offnum,
-						minoff,
-						maxoff;
-			ItemId		itemid;
-			IndexTuple	item;
-
-			minoff = P_FIRSTDATAKEY_s(opaque);
-			maxoff = PageGetMaxOffsetNumber_s(page);
-
-			/*
-			 * start = InvalidOffsetNumber means "search the whole page". We
-			 * need this test anyway due to possibility that page has a high
-			 * key now when it didn't before.
-			 */
-			if (start < minoff)
-				start = minoff;
-
-			/*
-			 * Need this check too, to guard against possibility that page
-			 * split since we visited it originally.
-			 */
-			if (start > maxoff)
-				start = OffsetNumberNext_s(maxoff);
-
-			/*
-			 * These loops will check every item on the page --- but in an
-			 * order that's attuned to the probability of where it actually
-			 * is.  Scan to the right first, then to the left.
-			 */
-			for (offnum = start;
-				 offnum <= maxoff;
-				 offnum = OffsetNumberNext_s(offnum))
-			{
-				itemid = PageGetItemId_s(page, offnum);
-				item = (IndexTuple) PageGetItem_s(page, itemid);
-
-				if (BTreeInnerTupleGetDownLink_s(item) == stack->bts_btentry)
-				{
-					/* Return accurate pointer to where link is now */
-					stack->bts_blkno = blkno;
-					stack->bts_offset = offnum;
-					return buf;
-				}
-			}
-
-			for (offnum = OffsetNumberPrev_s(start);
-				 offnum >= minoff;
-				 offnum = OffsetNumberPrev_s(offnum))
-			{
-				itemid = PageGetItemId_s(page, offnum);
-				item = (IndexTuple) PageGetItem_s(page, itemid);
-
-				if (BTreeInnerTupleGetDownLink_s(item) == stack->bts_btentry)
-				{
-					/* Return accurate pointer to where link is now */
-					stack->bts_blkno = blkno;
-					stack->bts_offset = offnum;
-					return buf;
-				}
-			}
-		}
-
-		/*
-		 * The item we're looking for moved right at least one page.
-		 */
-		if (P_RIGHTMOST_s(opaque))
-		{
-			ReleaseBuffer_s(rel, buf);
-			return InvalidBuffer;
-		}
-		blkno = opaque->btpo_next;
-		start = InvalidOffsetNumber;
-		ReleaseBuffer_s(rel, buf);
-	}
-}
-
-/*
- *	_bt_newroot() -- Create a new root page for the index.
- *
- *		We've just split the old root page and need to create a new one.
- *		In order to do this, we add a new root page to the file, then lock
- *		the metadata page and update it.  This is guaranteed to be deadlock-
- *		free, because all readers release their locks on the metadata page
- *		before trying to lock the root, and all writers lock the root before
- *		trying to lock the metadata page.  We have a write lock on the old
- *		root page, so we have not introduced any cycles into the waits-for
- *		graph.
- *
- *		On entry, lbuf (the old root) and rbuf (its new peer) are write-
- *		locked. On exit, a new root page exists with entries for the
- *		two new children, metapage is updated and unlocked/unpinned.
- *		The new root buffer is returned to caller which has to unlock/unpin
- *		lbuf, rbuf & rootbuf.
- */
-static Buffer
-_bt_newroot_s(VRelation rel, Buffer lbuf, Buffer rbuf)
-{
-	Buffer		rootbuf;
-	Page		lpage,
-				rootpage;
-	BlockNumber lbkno,
-				rbkno;
-	BlockNumber rootblknum;
-	BTPageOpaque rootopaque;
-	BTPageOpaque lopaque;
-	ItemId		itemid;
-	IndexTuple	item;
-	IndexTuple	left_item;
-	Size		left_item_sz;
-	IndexTuple	right_item;
-	Size		right_item_sz;
-	Buffer		metabuf;
-	Page		metapg;
-	BTMetaPageData *metad;
-
-	/* BTPageOpaque ropaquea, */
-	/* lopaquea, */
-	/* mopaquea; */
-	/* selog(DEBUG1, "creating new root"); */
-	lbkno = BufferGetBlockNumber_s(lbuf);
-	rbkno = BufferGetBlockNumber_s(rbuf);
-	lpage = BufferGetPage_s(rel, lbuf);
-	lopaque = (BTPageOpaque) PageGetSpecialPointer_s(lpage);
-
-	/* get a new root page */
-	rootbuf = _bt_getbuf_s(rel, P_NEW, BT_WRITE);
-	rootpage = BufferGetPage_s(rel, rootbuf);
-	rootblknum = BufferGetBlockNumber_s(rootbuf);
-	selog(DEBUG1, "New root buf is %d and has rootblknum %d", rootbuf, rootblknum);
-
-	/* acquire lock on the metapage */
-	metabuf = _bt_getbuf_s(rel, BTREE_METAPAGE, BT_WRITE);
-	metapg = BufferGetPage_s(rel, metabuf);
-	metad = BTPageGetMeta_s(metapg);
-/* 	selog(DEBUG1, "Acquired metabuf %d", metabuf); */
-
-	/*
-	 * Create downlink item for left page (old root).  Since this will be the
-	 * first item in a non-leaf page, it implicitly has minus-infinity key
-	 * value, so we need not store any actual key in it.
-	 */
-	left_item_sz = sizeof(IndexTupleData);
-	left_item = (IndexTuple) malloc(left_item_sz);
-	left_item->t_info = left_item_sz;
-	BTreeInnerTupleSetDownLink_s(left_item, lbkno);
-	BTreeTupleSetNAtts_s(left_item, 0);
-
-	/*
-	 * Create downlink item for right page.  The key for it is obtained from
-	 * the "high key" position in the left page.
-	 */
-	itemid = PageGetItemId_s(lpage, P_HIKEY);
-	right_item_sz = ItemIdGetLength_s(itemid);
-	item = (IndexTuple) PageGetItem_s(lpage, itemid);
-	right_item = CopyIndexTuple_s(item);
-	BTreeInnerTupleSetDownLink_s(right_item, rbkno);
-	/* selog(DEBUG1, "Right item is going to point to %d", rbkno); */
-
-	/* NO EREPORT(ERROR) from here till newroot op is logged */
-	/* START_CRIT_SECTION(); */
-
-	/* upgrade metapage if needed */
-	/* if (metad->btm_version < BTREE_VERSION){ */
-/* 		selog(DEBUG1, "Update meta page"); */
-/* 		_bt_upgrademetapage_s(metapg); */
-/* 	} */
-
-	/* set btree special data */
-	rootopaque = (BTPageOpaque) PageGetSpecialPointer_s(rootpage);
-	/* selog(DEBUG1, "rootpage has special pointer %d", rootopaque->o_blkno); */
-	rootopaque->btpo_prev = rootopaque->btpo_next = P_NONE;
-	rootopaque->btpo_flags = BTP_ROOT;
-	rootopaque->btpo.level =
-		((BTPageOpaque) PageGetSpecialPointer_s(lpage))->btpo.level + 1;
-	/* rootopaque->o_blkno = rootbuf; */
-	/* selog(DEBUG1, "rootpage level is %d", rootopaque->btpo.level); */
-	/* update metapage data */
-	metad->btm_root = rootblknum;
-	metad->btm_level = rootopaque->btpo.level;
-	metad->btm_fastroot = rootblknum;
-	metad->btm_fastlevel = rootopaque->btpo.level;
-
-	/*
-	 * selog(DEBUG1, "Metapage current root is %d and level is
-	 * %d",metad->btm_root,metad->btm_level);
-	 */
-
-	/*
-	 * Insert the left page pointer into the new root page.  The root page is
-	 * the rightmost page on its level so there is no "high key" in it; the
-	 * two items will go into positions P_HIKEY and P_FIRSTKEY.
-	 *
-	 * Note: we *must* insert the two items in item-number order, for the
-	 * benefit of _bt_restore_page().
-	 */
-	/* Assert(BTreeTupleGetNAtts(left_item, rel) == 0); */
-	if (PageAddItem_s(rootpage, (Item) left_item, left_item_sz, P_HIKEY,
-					  false, false) == InvalidOffsetNumber)
-		selog(ERROR, "failed to add leftkey to new root page"
-			  " while splitting block %u",
-			  BufferGetBlockNumber_s(lbuf));
-
-	/*
-	 * insert the right page pointer into the new root page.
-	 */
-	/* Assert(BTreeTupleGetNAtts(right_item, rel) == */
-	/* IndexRelationGetNumberOfKeyAttributes(rel)); */
-	if (PageAddItem_s(rootpage, (Item) right_item, right_item_sz, P_FIRSTKEY,
-					  false, false) == InvalidOffsetNumber)
-		selog(ERROR, "failed to add rightkey to new root page"
-			  " while splitting block %u",
-			  BufferGetBlockNumber_s(lbuf));
-
-	/*
-	 * selog(DEBUG1, "Going to write buffers to disk %d, %d, %d", lbuf,
-	 * rootbuf, metabuf);
-	 */
-	/* lopaquea =  (BTPageOpaque) PageGetSpecialPointer_s(lpage); */
-	/* ropaquea =  (BTPageOpaque) PageGetSpecialPointer_s(rootpage); */
-	/* mopaquea =  (BTPageOpaque) PageGetSpecialPointer_s(metapg); */
-
-	/*
-	 * selog(DEBUG1, "buffer special pointers are %d, %d, %d",
-	 * lopaquea->o_blkno, ropaquea->o_blkno, mopaquea->o_blkno);
-	 */
-
-	/* Clear the incomplete-split flag in the left child */
-	/* Assert(P_INCOMPLETE_SPLIT(lopaque)); */
-	lopaque->btpo_flags &= ~BTP_INCOMPLETE_SPLIT;
-	MarkBufferDirty_s(rel, lbuf);
-	MarkBufferDirty_s(rel, rootbuf);
-	MarkBufferDirty_s(rel, metabuf);
-
-	/* done with metapage */
-	ReleaseBuffer_s(rel, metabuf);
-
-	free(left_item);
-	free(right_item);
-
-	return rootbuf;
-}
-
 /*
  *	_bt_pgaddtup() -- add a tuple to a particular page in the index.
  *
@@ -1536,7 +873,7 @@ _bt_newroot_s(VRelation rel, Buffer lbuf, Buffer rbuf)
  *		we insert the tuples in order, so that the given itup_off does
  *		represent the final position of the tuple!
  */
-static bool
+bool
 _bt_pgaddtup_s(Page page,
 			   Size itemsize,
 			   IndexTuple itup,
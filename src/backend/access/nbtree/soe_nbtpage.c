@@ -24,19 +24,22 @@
 #include "access/soe_nbtree.h"
 #include "logger/logger.h"
 
-int* sfanouts;
-unsigned int snlevels;
+#include <stdlib.h>
 
-extern void btree_fanout_setup(int* fanouts,unsigned int fanout_size, 
-                               unsigned int nlevels){
+extern void btree_fanout_setup(VRelation rel, int* fanouts,
+                               unsigned int fanout_size, unsigned int nlevels){
     
-    sfanouts = (int*)malloc(fanout_size);
-    memcpy(sfanouts, fanouts, fanout_size);
-    snlevels = nlevels;
+    rel->fanouts = (int*)malloc(fanout_size);
+    memcpy(rel->fanouts, fanouts, fanout_size);
+    rel->nlevels = nlevels;
+    rel->levelBlocks = (int*)calloc(nlevels + 1, sizeof(int));
 }
 
-extern void free_btree_fanout(){
-    free(sfanouts);    
+extern void free_btree_fanout(VRelation rel){
+    free(rel->fanouts);
+    free(rel->levelBlocks);
+    rel->fanouts = NULL;
+    rel->levelBlocks = NULL;
 }
 
 
@@ -176,7 +179,7 @@ _bt_checkpage_s(VRelation rel, Buffer buf)
 	/*
 	 * Additionally check that the special area looks sane.
 	 */
-	if (PageGetSpecialSize_s(page) != MAXALIGN_s(sizeof(BTPageOpaqueData)))
+	if (PageGetSpecialSize_s(page) < MAXALIGN_s(sizeof(BTPageOpaqueData)))
 		selog(DEBUG1, "index contains corrupted page at block %d", buf);
 
 }
@@ -213,32 +216,37 @@ _bt_getbuf_s(VRelation rel, BlockNumber blkno, int access)
 	return buf;
 }
 
-Buffer
-_bt_getbuf_level_s(VRelation rel, BlockNumber blkno)
+/*
+ * First block of a level of the index. The root is the block 0 and the
+ * fanouts[i - 1] blocks of level i follow the blocks of level i - 1.
+ */
+BlockNumber
+_bt_levelstart_s(VRelation rel, unsigned int level)
 {
+    BlockNumber l_offset = 0;
 
-    unsigned int clevel = rel->level;
-    unsigned int l_offset;
-    unsigned int l_ob_blkno;
-    Buffer  buf;
-
-    if(clevel == 0){
-        l_ob_blkno = blkno;
-
-    }else{
-
+    if(level > 0){
         l_offset = 1;
 
-        for(int i=0; i < clevel-1; i++){
-            l_offset += sfanouts[i];
+        for(int i=0; i < level-1; i++){
+            l_offset += rel->fanouts[i];
         }
-    
-        l_ob_blkno = l_offset + blkno;
     }
-    
-    buf = ReadBuffer_s(rel, l_ob_blkno);
 
-    return buf;
+    return l_offset;
+}
+
+/* Number of blocks of a level of the index, see _bt_levelstart_s. */
+BlockNumber
+_bt_levelsize_s(VRelation rel, unsigned int level)
+{
+    return level == 0 ? 1 : rel->fanouts[level - 1];
+}
+
+Buffer
+_bt_getbuf_level_s(VRelation rel, BlockNumber blkno)
+{
+    return ReadBuffer_s(rel, _bt_levelstart_s(rel, rel->level) + blkno);
 }
 
 
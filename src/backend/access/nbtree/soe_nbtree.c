@@ -26,6 +26,7 @@
 #endif
 
 #include "access/soe_nbtree.h"
+#include "access/soe_nbtcompare.h"
 #include "logger/logger.h"
 #include "storage/soe_nbtree_ofile.h"
 #include "storage/soe_bufpage.h"
@@ -51,19 +52,49 @@
  */
 
 
-void btree_load_s(VRelation indexRel, char* block, unsigned int level, unsigned int offset)
+/*
+ * Loads a block of the index. The heap blocks of the items of a posting
+ * list would share the access counter of the item, so a leaf with posting
+ * lists fails the load of the index when the table ORAM is token based
+ * (heapTokens).
+ */
+void btree_load_s(VRelation indexRel, char* block, unsigned int level, unsigned int offset, bool heapTokens)
 {
 
     Buffer          buffer;
     Page            page;
     BTPageOpaque    oopaque;
+    OffsetNumber    offnum;
     unsigned int    token[8];
    
 
 
     memset(&token, 0, sizeof(unsigned int)*4);
     oopaque = (BTPageOpaque) PageGetSpecialPointer_s((Page) block);
-    memset(oopaque->counters, 0, sizeof(uint32)*300);
+
+    if (heapTokens && !P_ISMETA_s(oopaque) && P_ISLEAF_s(oopaque))
+    {
+        for (offnum = P_FIRSTDATAKEY_s(oopaque);
+             offnum <= PageGetMaxOffsetNumber_s((Page) block);
+             offnum = OffsetNumberNext_s(offnum))
+        {
+            if (IndexTupleIsPosting_s((IndexTuple) PageGetItem_s((Page) block,
+                                      PageGetItemId_s((Page) block, offnum))))
+            {
+                selog(ERROR, "btree block %d has posting lists, which the token based table ORAMs do not support",
+                      offset);
+                indexRel->loadFailed = true;
+                return;
+            }
+        }
+    }
+    memset(BTPageGetCounters_s((Page) block), 0,
+           sizeof(uint32) * BTPageGetNCounters_s((Page) block));
+
+    /* keys are normalized once, when the block is loaded */
+    if (!P_ISMETA_s(oopaque) && indexRel->tDesc->natts == 1 &&
+        _bt_normalizepage_s(indexRel->tDesc->attrs->atttypid, (Page) block))
+        oopaque->btpo_flags |= BTP_NORMKEYS;
 
     prf(level, offset, 0, (unsigned int*) &token);
     
@@ -74,6 +105,11 @@ void btree_load_s(VRelation indexRel, char* block, unsigned int level, unsigned
     indexRel->level = level;
     indexRel->token = token;
 
+    /* the blocks after the last loaded one of a level are free pages */
+    if (indexRel->levelBlocks != NULL && level <= indexRel->nlevels &&
+        offset >= (unsigned int) indexRel->levelBlocks[level])
+        indexRel->levelBlocks[level] = offset + 1;
+
     buffer = _bt_getbuf_level_s(indexRel, offset); 
 
     page = BufferGetPage_s(indexRel, buffer);
@@ -99,8 +135,9 @@ void btree_load_s(VRelation indexRel, char* block, unsigned int level, unsigned
 /*
  *	btinsert() -- insert an index tuple into a btree.
  *
- *		Descend the tree recursively, find the appropriate location for our
- *		new tuple, and put it there.
+ *		Descend the tree, find the appropriate location for our new tuple,
+ *		and put it there.  datum is the key in the format of a scan key,
+ *		with every column of the index, and datumSize counts its terminator.
  */
 bool
 btinsert_s(VRelation indexRel, VRelation heapRel, ItemPointer ht_ctid, char *datum, unsigned int datumSize)
@@ -108,16 +145,13 @@ btinsert_s(VRelation indexRel, VRelation heapRel, ItemPointer ht_ctid, char *dat
 	bool		result;
 	IndexTuple	itup;
 
-	Datum		index_values[1];
-	bool		index_isnull[1];
-
-	index_values[0] = PointerGetDatum_s(datum);
-	index_isnull[0] = false;
-
-	/* enable  */
-	/* bool checkUnique = UNIQUE_CHECK_NO; //enable duplicate? */
 	/* generate an index tuple */
-	itup = index_form_tuple_s(indexRel->tDesc, index_values, index_isnull);
+	itup = _bt_formkeytuple_s(indexRel->tDesc, datum, datumSize - 1);
+	if (itup == NULL)
+	{
+		selog(ERROR, "Key of size %d does not match the index", datumSize - 1);
+		return false;
+	}
 	itup->t_tid = *ht_ctid;
 
 	result = _bt_doinsert_s(indexRel, itup, datum, datumSize, heapRel);
@@ -136,7 +170,15 @@ btgettuple_s(IndexScanDesc scan)
 	BTScanOpaque so = (BTScanOpaque) scan->opaque;
 	bool		res;
 
+	/* workspace for the copies of the index tuples of an index-only scan */
+	if (scan->xs_want_itup && so->currTuples == NULL)
+		so->currTuples = (char *) malloc(BLCKSZ);
+
     res = _bt_first_s(scan); 
+	if (res && scan->xs_exact)
+		res = _bt_matchexact_s(scan);
+	if (scan->xs_kill)
+		_bt_killitem_s(scan, res);
     ReleaseBuffer_s(scan->indexRelation, so->currPos.buf);
     so->currPos.buf = InvalidBuffer;
     return res;
@@ -158,11 +200,14 @@ btbeginscan_s(VRelation rel, const char *key, int keysize)
 	scanKey->sk_argument = (char *) malloc(keysize);
 	memcpy(scanKey->sk_argument, key, keysize);
 	scanKey->datumSize = keysize;
+	_bt_preparekey_s(rel->tDesc, scanKey);
 
 	/* allocate private workspace */
 	so = (BTScanOpaque) malloc(sizeof(BTScanOpaqueData));
 	BTScanPosInvalidate_s(so->currPos);
 	BTScanPosInvalidate_s(so->markPos);
+	BTScanPosInitItems_s(so->currPos);
+	BTScanPosInitItems_s(so->markPos);
 
 	/*
 	 * so->keyData = malloc(sizeof(ScanKeyData)); so->arrayKeyData = NULL;
@@ -189,6 +234,13 @@ btbeginscan_s(VRelation rel, const char *key, int keysize)
 	scan->xs_ctup.t_data = NULL;
 	scan->xs_cbuf = InvalidBuffer;
 	scan->xs_continue_hot = false;
+	scan->xs_want_itup = false;
+	scan->xs_itup = NULL;
+	scan->xs_heapfetch = true;
+	scan->xs_kill = false;
+	scan->xs_killed = false;
+	scan->xs_exact = false;
+	scan->xs_hikey = NULL;
 
 	return scan;
 }
@@ -209,8 +261,19 @@ btendscan_s(IndexScanDesc scan)
 	/* Release storage */
 	/* if (so->keyData != NULL) */
 	free(scan->keyData->sk_argument);
+	_bt_freekeydata_s(scan->keyData);
 	free(scan->keyData);
+	if (scan->xs_hikey != NULL)
+	{
+		free(scan->xs_hikey->sk_argument);
+		_bt_freekeydata_s(scan->xs_hikey);
+		free(scan->xs_hikey);
+	}
+	if (so->currTuples != NULL)
+		free(so->currTuples);
 	/* so->markTuples should not be pfree'd, see btrescan */
+	if (so->currPos.items != NULL)
+		free(so->currPos.items);
 	free(so);
 	free(scan);
 }
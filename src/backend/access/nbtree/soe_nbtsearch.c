@@ -14,12 +14,16 @@
  */
 
 #include "access/soe_nbtree.h"
+#include "access/soe_nbtcompare.h"
 #include "logger/logger.h"
 #include "common/soe_prf.h"
 
+#include <stdlib.h>
+
 static bool _bt_readpage_s(IndexScanDesc scan,
 						   OffsetNumber offnum);
-static void _bt_saveitem_s(BTScanOpaque so, int itemIndex,
+static bool _bt_reserveitems_s(BTScanOpaque so, int nitems);
+static int	_bt_saveitem_s(BTScanOpaque so, int itemIndex,
 						   OffsetNumber offnum, IndexTuple itup);
 static bool _bt_steppage_s(IndexScanDesc scan);
 static bool _bt_readnextpage_s(IndexScanDesc scan, BlockNumber blkno);
@@ -129,17 +133,7 @@ BlockNumber _bt_search_s(VRelation rel, int keysz, ScanKey scankey, bool nextkey
 		itup = (IndexTuple) PageGetItem_s(page, itemid);
         
         //selog(DEBUG1, "Offset number is %d", offnum);
-        if(offnum > 300){
-            selog(DEBUG1, "Too many keys for countes in opaque data %d", offnum);
-            abort();
-        }
-        if(opaque->counters[offnum] == 0){
-            //selog(DEBUG1, "First Access");
-            opaque->counters[offnum] = 2;
-        }
-        nextNodeCounter = opaque->counters[offnum],
-
-        opaque->counters[offnum] += 2;
+        nextNodeCounter = _bt_nextcounter_s(rel, page, offnum, 2);
 
 
         //selog(DEBUG1, "oopaque %d keys are %d %d", opaque->o_blkno, opaque->btpo_prev, opaque->btpo_next);
@@ -147,13 +141,13 @@ BlockNumber _bt_search_s(VRelation rel, int keysz, ScanKey scankey, bool nextkey
 		blkno = BTreeInnerTupleGetDownLink_s(itup);
    		par_blkno = BufferGetBlockNumber_s(*bufP);
 
-        #ifdef TPATHORAM
-        prf(rel->level, oldBlkno, currentNodeCounter, (unsigned int*) &token);
-        //selog(DEBUG1, "Going to evict block %d at level %d with counters %d %d %d %d", oldBlkno, rel->level, token[0], token[1], token[2], token[3]);
-        //rel->token = token;
+        if(rel->backend->tokens){
+            prf(rel->level, oldBlkno, currentNodeCounter, (unsigned int*) &token);
+            //selog(DEBUG1, "Going to evict block %d at level %d with counters %d %d %d %d", oldBlkno, rel->level, token[0], token[1], token[2], token[3]);
+            //rel->token = token;
 
-        MarkBufferDirty_s(rel, *bufP);
-        #endif
+            MarkBufferDirty_s(rel, *bufP);
+        }
 		ReleaseBuffer_s(rel, *bufP);
 
         currentNodeCounter = nextNodeCounter;
@@ -255,6 +249,19 @@ _bt_binsrch_s(VRelation rel,
 	high++;						/* establish the loop invariant for high */
 
 	cmpval = nextkey ? 0 : 1;	/* select comparison value */
+
+#ifdef CT_SEARCH
+	/*
+	 * Compare the key with every slot of the page, leaving to the binary
+	 * search only the slots whose key prefix is equal to the scan key.
+	 */
+	if (P_NORMKEYS_s(opaque) && scankey->sk_norm != NULL)
+	{
+		if (!P_ISLEAF_s(opaque))
+			low++;				/* minus infinity is < scan key */
+		_bt_ctsearch_s(page, scankey, low, high, cmpval, &low, &high);
+	}
+#endif
     //selog(DEBUG1, "Going to compare %d %d %s", high, low, scankey->sk_argument);
 	while (high > low)
 	{
@@ -322,7 +329,6 @@ _bt_compare_s(VRelation rel,
 			  Page page,
 			  OffsetNumber offnum)
 {
-	char	   *datum;
 	IndexTuple	itup;
 	int32		result;
 	result = 0;
@@ -339,15 +345,10 @@ _bt_compare_s(VRelation rel,
 
 	itup = (IndexTuple) PageGetItem_s(page, PageGetItemId_s(page, offnum));
 
-
-
-	//datum = index_getattr_s(itup);
-    datum = VARDATA_ANY_S(DatumGetBpCharPP_S(index_getattr_s(itup)));
-
-
-    //selog(DEBUG1, "cmp strings %s %s and size %d", scankey->sk_argument, datum, strlen(scankey->sk_argument));
-    result = (int32) strncmp(scankey->sk_argument, datum, strlen(scankey->sk_argument));
-    //selog(DEBUG1, "Result comparision is %s, %s %d", scankey->sk_argument, datum, result);
+	if (P_NORMKEYS_s(opaque) && scankey->sk_norm != NULL)
+		result = _bt_normcmp_s(scankey, index_getattr_s(itup));
+	else
+		result = rel->keycmp(scankey, index_getattr_s(itup));
 	/* if the keys are unequal, return the difference */
 	if (result != 0)
 		return result;
@@ -399,7 +400,6 @@ _bt_first_s(IndexScanDesc scan)
 	ScanKey		cur = scan->keyData;
     Page         page;
     BlockNumber  leafBlkno;
-    BTPageOpaque  opaque;
     unsigned int  token[8];
 	/**
 	 * By debugging postgres, a search on a btree with a single leaf and no
@@ -425,10 +425,9 @@ _bt_first_s(IndexScanDesc scan)
 	 */
 	/* selog(DEBUG1, "bt_first scan opoid is %d", scan->opoid); */
 	/* The protoype currently does not support backward scans. */
-	switch (scan->opoid)
+	switch (scan->strategy)
 	{
-		case 1058:
-			/* BTLessStrategyNumber: */
+		case BTLessStrategyNumber:
 
 			/*
 			 * Find first item >= scankey, then back up one to arrive at last
@@ -441,8 +440,7 @@ _bt_first_s(IndexScanDesc scan)
 			selog(ERROR, "Less or equal strategy requires backward scan no supported");
 			break;
 
-		case 1059:
-			/* BTLessEqualStrategyNumber: */
+		case BTLessEqualStrategyNumber:
 
 			/*
 			 * Find first item > scankey, then back up one to arrive at last
@@ -455,8 +453,7 @@ _bt_first_s(IndexScanDesc scan)
 			selog(ERROR, "Less than strategy requires backward scan no supported");
 			break;
 
-		case 1054:
-			/* BTEqualStrategyNumber: */
+		case BTEqualStrategyNumber:
 
 
 
@@ -468,8 +465,7 @@ _bt_first_s(IndexScanDesc scan)
 			goback = false;
 			break;
 
-		case 1061:
-			/* BTGreaterEqualStrategyNumber: */
+		case BTGreaterEqualStrategyNumber:
 
 			/*
 			 * Find first item >= scankey.  (This is only used for forward
@@ -479,8 +475,7 @@ _bt_first_s(IndexScanDesc scan)
 			goback = false;
 			break;
 
-		case 1060:
-			/* BTGreaterStrategyNumber: */
+		case BTGreaterStrategyNumber:
 
 			/*
 			 * Find first item > scankey.  (This is only used for forward
@@ -533,29 +528,18 @@ _bt_first_s(IndexScanDesc scan)
 		offnum = OffsetNumberPrev_s(offnum);
 		/* selog(DEBUG1, "Found match on offset prev %d", offnum); */
 	}
-    #ifdef TPATHORAM
-    //selog(DEBUG1, "Found leaf match at offset %d", offnum);
-    if(offnum > 300){
-        selog(DEBUG1, "Too many keys for countes in opaque data %d", offnum);
-    }
-	    
-    page = BufferGetPage_s(rel, buf);
-	opaque = (BTPageOpaque) PageGetSpecialPointer_s(page);
-    
-    if(opaque->counters[offnum] == 0){
-        //selog(DEBUG1, "First Access");
-        opaque->counters[offnum] = 2;
+    if(rel->backend->tokens){
+        //selog(DEBUG1, "Found leaf match at offset %d", offnum);
+        page = BufferGetPage_s(rel, buf);
+        /* the counter only advances when the heap block is accessed */
+        rel->heapBlockCounter = _bt_nextcounter_s(rel, page, offnum,
+                                                  scan->xs_heapfetch ? 1 : 0);
+        prf(rel->level, leafBlkno, rel->leafCurrentCounter, (unsigned int*) &token);
+        //selog(DEBUG1, "Going to evict block %d at level %d with counters %d %d %d %d", leafBlkno, rel->level, token[0], token[1], token[2], token[3]);
+        rel->token = token;
+        MarkBufferDirty_s(rel, buf);
     }
 
-    //selog(DEBUG1, "heap block counter of block %d is at %d", offnum, opaque->counters[offnum]);
-    rel->heapBlockCounter = opaque->counters[offnum];
-    opaque->counters[offnum] +=1;
-    prf(rel->level, leafBlkno, rel->leafCurrentCounter, (unsigned int*) &token);
-    //selog(DEBUG1, "Going to evict block %d at level %d with counters %d %d %d %d", leafBlkno, rel->level, token[0], token[1], token[2], token[3]);
-    rel->token = token;
-    MarkBufferDirty_s(rel, buf);
-    #endif
-
 	/* remember which buffer we have pinned, if any */
 	/* Assert(!BTScanPosIsValid(so->currPos)); */
 	so->currPos.buf = buf;
@@ -595,6 +579,8 @@ _bt_first_s(IndexScanDesc scan)
 	/* OK, itemIndex says what to return */
 	currItem = &so->currPos.items[so->currPos.itemIndex];
 	scan->xs_ctup.t_self = currItem->heapTid;
+	if (scan->xs_want_itup)
+		scan->xs_itup = (IndexTuple) (so->currTuples + currItem->tupleOffset);
 
 	return true;
 }
@@ -648,8 +634,8 @@ _bt_next_s(IndexScanDesc scan)
 	/* OK, itemIndex says what to return */
 	currItem = &so->currPos.items[so->currPos.itemIndex];
 	scan->xs_ctup.t_self = currItem->heapTid;
-/* 	if (scan->xs_want_itup) */
-/* 		scan->xs_itup = (IndexTuple) (so->currTuples + currItem->tupleOffset); */
+	if (scan->xs_want_itup)
+		scan->xs_itup = (IndexTuple) (so->currTuples + currItem->tupleOffset);
 
 	return true;
 }
@@ -742,8 +728,7 @@ _bt_readpage_s(IndexScanDesc scan, OffsetNumber offnum)
 		if (itup != NULL)
 		{
 			/* tuple passes all scan key conditions, so remember it */
-			_bt_saveitem_s(so, itemIndex, offnum, itup);
-			itemIndex++;
+			itemIndex = _bt_saveitem_s(so, itemIndex, offnum, itup);
 		}
 		if (!continuescan)
 		{
@@ -764,23 +749,91 @@ _bt_readpage_s(IndexScanDesc scan, OffsetNumber offnum)
 	return (so->currPos.firstItem <= so->currPos.lastItem);
 }
 
-/* Save an index item into so->currPos.items[itemIndex] */
-static void
+/*
+ * Makes room for nitems items in so->currPos.items. The array starts with an
+ * item per index tuple of a page and only grows for the pages whose posting
+ * lists have more TIDs. Returns false if there is no room.
+ */
+static bool
+_bt_reserveitems_s(BTScanOpaque so, int nitems)
+{
+	BTScanPosItem *items;
+	int			maxItems;
+
+	if (nitems <= so->currPos.maxItems)
+		return true;
+	if (nitems > MaxTIDsPerIndexPage_s)
+		return false;
+
+	maxItems = Max_s(so->currPos.maxItems * 2, MaxIndexTuplesPerPage);
+	maxItems = Min_s(Max_s(maxItems, nitems), MaxTIDsPerIndexPage_s);
+	items = (BTScanPosItem *) realloc(so->currPos.items,
+								  sizeof(BTScanPosItem) * maxItems);
+	if (items == NULL)
+		return false;
+
+	so->currPos.items = items;
+	so->currPos.maxItems = maxItems;
+	return true;
+}
+
+/*
+ * Save an index item into so->currPos.items[itemIndex], one item per heap
+ * TID of a posting list tuple. Returns the index of the next free item.
+ */
+static int
 _bt_saveitem_s(BTScanOpaque so, int itemIndex,
 			   OffsetNumber offnum, IndexTuple itup)
 {
-	BTScanPosItem *currItem = &so->currPos.items[itemIndex];
+	BTScanPosItem *currItem;
+	LocationIndex tupleOffset = 0;
+	ItemPointer tids = &itup->t_tid;
+	int			ntids = 1;
+	int			i;
 
-	currItem->heapTid = itup->t_tid;
-	currItem->indexOffset = offnum;
 	if (so->currTuples)
 	{
 		Size		itupsz = IndexTupleSize_s(itup);
 
-		currItem->tupleOffset = so->currPos.nextTupleOffset;
+		/* the items of a posting list share the copy of the tuple */
+		tupleOffset = so->currPos.nextTupleOffset;
 		memcpy(so->currTuples + so->currPos.nextTupleOffset, itup, itupsz);
 		so->currPos.nextTupleOffset += MAXALIGN_s(itupsz);
 	}
+
+	if (IndexTupleIsPosting_s(itup))
+	{
+		tids = (ItemPointer) malloc(sizeof(ItemPointerData) *
+									IndexTupleGetNPosting_s(itup));
+		ntids = index_getposting_s(itup, tids,
+								   MaxTIDsPerIndexPage_s - itemIndex);
+		if (ntids < 0)
+		{
+			selog(ERROR, "Malformed posting list at index offset %d", offnum);
+			free(tids);
+			return itemIndex;
+		}
+	}
+
+	if (!_bt_reserveitems_s(so, itemIndex + ntids))
+	{
+		selog(ERROR, "Could not allocate %d scan items", itemIndex + ntids);
+		if (tids != &itup->t_tid)
+			free(tids);
+		return itemIndex;
+	}
+
+	for (i = 0; i < ntids; i++)
+	{
+		currItem = &so->currPos.items[itemIndex + i];
+		currItem->heapTid = tids[i];
+		currItem->indexOffset = offnum;
+		currItem->tupleOffset = tupleOffset;
+	}
+
+	if (tids != &itup->t_tid)
+		free(tids);
+	return itemIndex + ntids;
 }
 
 /*
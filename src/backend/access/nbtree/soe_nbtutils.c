@@ -15,6 +15,7 @@
 
 #include "access/soe_nbtree.h"
 #include "access/soe_itup.h"
+#include "access/soe_nbtcompare.h"
 #include "logger/logger.h"
 
 
@@ -51,19 +52,146 @@ _bt_mkscankey_s(VRelation rel, IndexTuple itup, char *datum, int dsize)
 	skey->sk_subtype = rel->foid;
 	skey->sk_argument = datum;
 	skey->datumSize = dsize;
+	_bt_preparekey_s(rel->tDesc, skey);
 
 	return skey;
 }
 
+/*
+ * Sets the upper bound of a range scan on an index with the attributes of
+ * desc: the scan stops at the first key that does not satisfy the strategy
+ * (< or <=) with key, of keysize bytes with its terminator. Used by nbtree
+ * and OST scans alike and freed by their endscan.
+ */
+void
+_bt_sethikey_s(IndexScanDesc scan, TupleDesc desc, const char *key,
+			   int keysize, StrategyNumber strategy)
+{
+	ScanKey		skey;
+
+	skey = (ScanKey) malloc(sizeof(ScanKeyData));
+	skey->sk_subtype = scan->keyData->sk_subtype;
+	skey->sk_argument = (char *) malloc(keysize);
+	memcpy(skey->sk_argument, key, keysize);
+	skey->datumSize = keysize;
+	_bt_preparekey_s(desc, skey);
+
+	scan->xs_hikey = skey;
+	scan->xs_histrategy = strategy;
+}
+
 /*
  * free a scan key made by either _bt_mkscankey or _bt_mkscankey_nodata.
  */
 void
 _bt_freeskey_s(ScanKey skey)
 {
+	_bt_freekeydata_s(skey);
 	free(skey);
 }
 
+/*
+ * Copy of the key of an index tuple, without the posting list of a posting
+ * list tuple, for a separator key.
+ */
+static IndexTuple
+_bt_pivotcopy_s(IndexTuple itup)
+{
+	IndexTuple	pivot;
+	Size		size;
+
+	if (!IndexTupleIsPosting_s(itup))
+		return CopyIndexTuple_s(itup);
+
+	size = MAXALIGN_s(IndexTupleGetPostingOffset_s(itup));
+	pivot = (IndexTuple) malloc(size);
+	memset(pivot, 0, size);
+	memcpy(pivot, itup, IndexTupleGetPostingOffset_s(itup));
+	pivot->t_info = (itup->t_info & ~(INDEX_SIZE_MASK | INDEX_AM_RESERVED_BIT))
+		| size;
+	ItemPointerSetInvalid_s(&pivot->t_tid);
+
+	return pivot;
+}
+
+/*
+ * _bt_truncate_s() -- create a separator key for a leaf page split.
+ *
+ * The high key of the left page (and the downlink to the right page) only
+ * has to be greater than lastleft and not greater than firstright, so the
+ * string keys are cut to the shortest prefix of firstright that tells them
+ * apart. Shorter separators give the internal pages a larger fanout. The
+ * result is a malloc'd copy of the key of firstright, truncated when its
+ * type allows it.
+ */
+IndexTuple
+_bt_truncate_s(TupleDesc desc, IndexTuple lastleft, IndexTuple firstright)
+{
+	IndexTuple	pivot;
+	char	   *rattr = index_getattr_s(firstright);
+	char	   *pattr;
+	Size		hoff = IndexInfoFindDataOffset_s(firstright->t_info);
+	Size		size;
+	int			keep;
+
+	if (desc->natts > 1)
+		return _bt_pivotcopy_s(firstright);
+
+	keep = _bt_keysuffixlen_s(desc->attrs->atttypid,
+							  index_getattr_s(lastleft), rattr);
+	if (keep < 0)
+		return _bt_pivotcopy_s(firstright);
+
+	if (keep + VARHDRSZ_SHORT <= VARATT_SHORT_MAX)
+		size = MAXALIGN_s(hoff + VARHDRSZ_SHORT + keep);
+	else
+		size = MAXALIGN_s(hoff + sizeof(int32) + keep);
+
+	pivot = (IndexTuple) malloc(size);
+	memset(pivot, 0, size);
+	memcpy(pivot, firstright, hoff);
+	pivot->t_info = (pivot->t_info & ~(INDEX_SIZE_MASK | INDEX_AM_RESERVED_BIT))
+		| size;
+	if (IndexTupleIsPosting_s(firstright))
+		ItemPointerSetInvalid_s(&pivot->t_tid);
+
+	pattr = (char *) pivot + hoff;
+	if (keep + VARHDRSZ_SHORT <= VARATT_SHORT_MAX)
+		SET_VARSIZE_1B_S(pattr, VARHDRSZ_SHORT + keep);
+	else
+		SET_VARSIZE_4B_S(pattr, sizeof(int32) + keep);
+	memcpy(VARDATA_ANY_S(pattr), VARDATA_ANY_S(rattr), keep);
+
+	return pivot;
+}
+
+/*
+ * Returns the access counter of the item at offnum of an index page and
+ * advances it by step. A counter starts at 2, as the blocks do two oblivious
+ * operations when loaded. Only the token based ORAMs need the counters, so
+ * a missing counter is an error only for them.
+ */
+uint32
+_bt_nextcounter_s(VRelation rel, Page page, OffsetNumber offnum, uint32 step)
+{
+	uint32	   *counters = BTPageGetCounters_s(page);
+	uint32		counter;
+
+	if (offnum < FirstOffsetNumber || offnum > BTPageGetNCounters_s(page))
+	{
+		if (rel->backend->tokens && offnum <= PageGetMaxOffsetNumber_s(page))
+			selog(ERROR, "Index page has no access counter for item %d", offnum);
+		return 0;
+	}
+
+	if (counters[offnum - 1] == 0)
+		counters[offnum - 1] = 2;
+	counter = counters[offnum - 1];
+	counters[offnum - 1] += step;
+
+	return counter;
+}
+
 /*
  * free a retracement stack made by _bt_search.
  */
@@ -101,16 +229,29 @@ _bt_freestack_s(BTStack stack)
  *
  * Caller must hold pin and lock on the index page.
  */
+/*
+ * Compares the key of an index tuple with a scan key of the scan, the
+ * comparator the other way.
+ */
+static int
+_bt_keytest_s(IndexScanDesc scan, BTPageOpaque opaque, ScanKey skey,
+			  IndexTuple tuple)
+{
+	if (P_NORMKEYS_s(opaque) && skey->sk_norm != NULL)
+		return -_bt_normcmp_s(skey, index_getattr_s(tuple));
+	return -scan->indexRelation->keycmp(skey, index_getattr_s(tuple));
+}
+
 IndexTuple
 _bt_checkkeys_s(IndexScanDesc scan,
 				Page page, OffsetNumber offnum,
 				bool *continuescan)
 {
 	ItemId		iid = PageGetItemId_s(page, offnum);
+	BTPageOpaque opaque = (BTPageOpaque) PageGetSpecialPointer_s(page);
 	IndexTuple	tuple;
-	char	   *keyValue;
-	char	   *datum;
 	int			test;
+	bool		tuple_alive;
 
 
 	*continuescan = false;		/* default assumption */
@@ -123,26 +264,36 @@ _bt_checkkeys_s(IndexScanDesc scan,
 	 * However, if this is the last tuple on the page, we should check the
 	 * index keys to prevent uselessly advancing to the next page.
 	 */
-
+	if (ItemIdIsDead_s(iid))
+	{
+		/* return immediately if there are more tuples on the page */
+		if (offnum < PageGetMaxOffsetNumber_s(page))
+		{
+			*continuescan = true;
+			return NULL;
+		}
+		tuple_alive = false;
+	}
+	else
+		tuple_alive = true;
 
 	tuple = (IndexTuple) PageGetItem_s(page, iid);
-	//datum = index_getattr_s(tuple);
-    datum = VARDATA_ANY_S(DatumGetBpCharPP_S(index_getattr_s(tuple)));
-	/* datumSize = strlen(datum)+1; */
-	keyValue = scan->keyData->sk_argument;
-	/* the prototype assumes string comparisons */
-	//test = (int32) strcmp(datum, keyValue);
-    test = (int32) strncmp(datum, keyValue, strlen(keyValue));
-
-    //selog(DEBUG1, "test %s %s %d %d at offnum %d", datum, keyValue, test, scan->opoid, offnum);
-	/**
-	* Look at soe_nbtsearch.c function _bt_first_s to which operations the
-	* opoids correspond to.
-	*/
-	if ((scan->opoid == 1058 && test < 0) || (scan->opoid == 1059 && test <= 0) || (scan->opoid == 1054 && test == 0) || (scan->opoid == 1061 && test >= 0) || (scan->opoid == 1060 && test > 0))
+	test = _bt_keytest_s(scan, opaque, scan->keyData, tuple);
+
+	if ((scan->strategy == BTLessStrategyNumber && test < 0) ||
+		(scan->strategy == BTLessEqualStrategyNumber && test <= 0) ||
+		(scan->strategy == BTEqualStrategyNumber && test == 0) ||
+		(scan->strategy == BTGreaterEqualStrategyNumber && test >= 0) ||
+		(scan->strategy == BTGreaterStrategyNumber && test > 0))
 	{
+		/* the keys past the upper bound of a range scan end it */
+		if (scan->xs_hikey != NULL &&
+			!_bt_strategymatches_s(scan->xs_histrategy,
+								   _bt_keytest_s(scan, opaque,
+												 scan->xs_hikey, tuple)))
+			return NULL;
 		*continuescan = true;
-		return tuple;
+		return tuple_alive ? tuple : NULL;
 	}
 	else
 	{
@@ -153,6 +304,72 @@ _bt_checkkeys_s(IndexScanDesc scan,
 }
 
 
+/*
+ * _bt_matchexact() -- Whether the match of a scan is equal to its key.
+ *
+ * The search finds the first item the scan key is a prefix of, so a scan
+ * that changes its match (scan->xs_exact) checks that the key of the item is
+ * the whole scan key. The leaf page of the match is still pinned.
+ */
+bool
+_bt_matchexact_s(IndexScanDesc scan)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	VRelation	rel = scan->indexRelation;
+	Page		page;
+	BTPageOpaque opaque;
+	IndexTuple	itup;
+
+	page = BufferGetPage_s(rel, so->currPos.buf);
+	opaque = (BTPageOpaque) PageGetSpecialPointer_s(page);
+	itup = (IndexTuple) PageGetItem_s(page,
+									  PageGetItemId_s(page, so->currPos.items[so->currPos.itemIndex].indexOffset));
+
+	return _bt_keyexact_s(rel->tDesc, scan->keyData, itup,
+						  P_NORMKEYS_s(opaque));
+}
+
+/*
+ * _bt_killitem() -- Mark the index item of the match of a scan dead.
+ *
+ * Called by btgettuple_s before the leaf page of the match is released, when
+ * the scan deletes its match (scan->xs_kill). The leaf is written back, or a
+ * dummy block is accessed in its place if there is no match, so a delete
+ * makes the same accesses to the index whether it finds a tuple or not.
+ *
+ * The item of a posting list is not killed, as it also holds the heap TIDs
+ * of the other duplicates. scan->xs_killed is set if the item is dead.
+ */
+void
+_bt_killitem_s(IndexScanDesc scan, bool res)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	VRelation	rel = scan->indexRelation;
+	Page		page;
+	ItemId		iid;
+
+	scan->xs_killed = false;
+	if (!res)
+	{
+		ReadDummyBuffer(rel, rel->totalBlocks + 1);
+		return;
+	}
+
+	page = BufferGetPage_s(rel, so->currPos.buf);
+	iid = PageGetItemId_s(page, so->currPos.items[so->currPos.itemIndex].indexOffset);
+	if (IndexTupleIsPosting_s((IndexTuple) PageGetItem_s(page, iid)))
+		selog(ERROR, "Can't delete a tuple with duplicate keys");
+	else
+	{
+		ItemIdMarkDead_s(iid);
+		scan->xs_killed = true;
+	}
+
+	rel->token = NULL;
+	MarkBufferDirty_s(rel, so->currPos.buf);
+}
+
+
 
 
 
@@ -26,6 +26,7 @@
 #endif
 
 #include "access/soe_ost.h"
+#include "access/soe_nbtcompare.h"
 #include "logger/logger.h"
 #include "storage/soe_ost_ofile.h"
 #include "storage/soe_bufpage.h"
@@ -68,13 +69,24 @@ insert_ost(OSTRelation rel, char *block, unsigned int level, unsigned int offset
     oopaque = (BTPageOpaqueOST) PageGetSpecialPointer_s((Page) block);
 
     memset(&token, 0, sizeof(unsigned int)*4);
-    memset(oopaque->counters, 0, sizeof(uint32)*300);
+    memset(BTPageGetCounters_OST((Page) block), 0,
+           sizeof(uint32) * BTPageGetNCounters_OST((Page) block));
+
+    /* keys are normalized once, when the block is loaded */
+    if (!P_ISMETA_OST(oopaque) && rel->tDesc->natts == 1 &&
+        _bt_normalizepage_s(rel->tDesc->attrs->atttypid, (Page) block))
+        oopaque->btpo_flags |= BTP_NORMKEYS_OST;
 
     prf(level, offset, 0, (unsigned int*) &token);
     
     rel->level = level;
     rel->token = token;
-    
+
+	/* the blocks after the last loaded one of a level are free pages */
+	if (level <= (unsigned int) rel->osts->nlevels &&
+		offset >= (unsigned int) rel->levelBlocks[level])
+		rel->levelBlocks[level] = offset + 1;
+
 	buffer = ReadBuffer_ost(rel, offset);
 	page = BufferGetPage_ost(rel, buffer);
 
@@ -86,6 +98,33 @@ insert_ost(OSTRelation rel, char *block, unsigned int level, unsigned int offset
 	return true;
 }
 
+/*
+ *	btinsert() -- insert an index tuple into a btree.
+ *
+ *		Same as btinsert_s: datum is the key in the format of a scan key and
+ *		datumSize counts its terminator.
+ */
+bool
+btinsert_ost(OSTRelation rel, ItemPointer ht_ctid, char *datum, unsigned int datumSize)
+{
+	bool		result;
+	IndexTuple	itup;
+
+	itup = _bt_formkeytuple_s(rel->tDesc, datum, datumSize - 1);
+	if (itup == NULL)
+	{
+		selog(ERROR, "Key of size %d does not match the index", datumSize - 1);
+		return false;
+	}
+	itup->t_tid = *ht_ctid;
+
+	result = _bt_doinsert_ost(rel, itup, datum, datumSize);
+
+	free(itup);
+
+	return result;
+}
+
 /*
  *	btgettuple() -- Get the next tuple in the scan.
  */
@@ -95,8 +134,16 @@ btgettuple_ost(IndexScanDesc scan)
 	BTScanOpaqueOST so = (BTScanOpaqueOST) scan->opaque;
 	bool		res;
 
+	/* workspace for the copies of the index tuples of an index-only scan */
+	if (scan->xs_want_itup && so->currTuples == NULL)
+		so->currTuples = (char *) malloc(BLCKSZ);
+
     res = _bt_first_ost(scan);
     //selog(DEBUG1, "ost - Result of first iteration %d", res);
+	if (res && scan->xs_exact)
+		res = _bt_matchexact_ost(scan);
+	if (scan->xs_kill)
+		_bt_killitem_ost(scan, res);
     ReleaseBuffer_ost(scan->ost, so->currPos.buf);
     so->currPos.buf = InvalidBuffer;
 
@@ -118,11 +165,14 @@ btbeginscan_ost(OSTRelation rel, const char *key, int keysize)
 	scanKey->sk_argument = (char *) malloc(keysize);
 	memcpy(scanKey->sk_argument, key, keysize);
 	scanKey->datumSize = keysize;
+	_bt_preparekey_s(rel->tDesc, scanKey);
 
 	/* allocate private workspace */
 	so = (BTScanOpaqueOST) malloc(sizeof(BTScanOpaqueDataOST));
 	BTScanPosInvalidate_OST(so->currPos);
 	BTScanPosInvalidate_OST(so->markPos);
+	BTScanPosInitItems_OST(so->currPos);
+	BTScanPosInitItems_OST(so->markPos);
 
 	/*
 	 * so->keyData = malloc(sizeof(ScanKeyData)); so->arrayKeyData = NULL;
@@ -147,6 +197,13 @@ btbeginscan_ost(OSTRelation rel, const char *key, int keysize)
 	scan->xs_ctup.t_data = NULL;
 	scan->xs_cbuf = InvalidBuffer;
 	scan->xs_continue_hot = false;
+	scan->xs_want_itup = false;
+	scan->xs_itup = NULL;
+	scan->xs_heapfetch = true;
+	scan->xs_kill = false;
+	scan->xs_killed = false;
+	scan->xs_exact = false;
+	scan->xs_hikey = NULL;
 
 	return scan;
 }
@@ -167,8 +224,19 @@ btendscan_ost(IndexScanDesc scan)
 	/* Release storage */
 	/* if (so->keyData != NULL) */
 	free(scan->keyData->sk_argument);
+	_bt_freekeydata_s(scan->keyData);
 	free(scan->keyData);
+	if (scan->xs_hikey != NULL)
+	{
+		free(scan->xs_hikey->sk_argument);
+		_bt_freekeydata_s(scan->xs_hikey);
+		free(scan->xs_hikey);
+	}
+	if (so->currTuples != NULL)
+		free(so->currTuples);
 	/* so->markTuples should not be pfree'd, see btrescan */
+	if (so->currPos.items != NULL)
+		free(so->currPos.items);
 	free(so);
 	free(scan);
 }
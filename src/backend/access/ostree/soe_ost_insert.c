@@ -0,0 +1,304 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_ost_insert.c
+ *	  Insertion of single tuples in the OST btrees, following the insertion
+ *	  of the nbtree indexes (soe_nbtinsert.c).
+ *
+ * Each level of the tree is a separate ORAM and the root is in level 0,
+ * which is never split. Below the root, a level splits a page into its next
+ * free block (levelBlocks) and every insertion reads and writes the new
+ * right page and the old right sibling of each level, or does dummy
+ * accesses in their place, so that an insertion always makes the same
+ * number of accesses to each level ORAM.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/nbtree/nbtinsert.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "access/soe_ost.h"
+#include "access/soe_nbtcompare.h"
+#include "storage/soe_ost_bufmgr.h"
+#include "logger/logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* A page on the path of an insertion and the pages of its split. */
+typedef struct BTInsertLevelOST
+{
+	Buffer		buf;			/* page on the path */
+	BlockNumber blkno;			/* its block number on the level */
+	OffsetNumber downlink;		/* offset of the downlink followed */
+	bool		split;			/* was the page split? */
+	Buffer		rbuf;			/* new right page, if split */
+	bool		sibling;		/* did the split page have a right sibling? */
+	Buffer		sbuf;			/* old right sibling, if any */
+	int			naccess;		/* accesses made to the level */
+}			BTInsertLevelOST;
+
+/* Accesses of an insertion to a level, as in soe_nbtinsert.c. */
+#define BT_INSERT_ACCESSES_OST(level)	((level) == 0 ? 2 : 6)
+
+static bool _bt_insertonlevel_ost(OSTRelation rel, unsigned int level,
+								  BTInsertLevelOST * lev, IndexTuple item,
+								  OffsetNumber itemoff, IndexTuple *downlink);
+static void _bt_dummysplit_ost(OSTRelation rel, unsigned int level,
+							   BTInsertLevelOST * lev);
+static void _bt_padlevel_ost(OSTRelation rel, unsigned int level, int naccess);
+
+/*
+ *	_bt_doinsert() -- Handle insertion of a single index tuple in the tree.
+ *
+ *		Same as _bt_doinsert_s. Returns false if the tuple could not be
+ *		inserted, in which case the index is unchanged and the accesses are
+ *		padded to the ones of an insertion that succeeds.
+ */
+bool
+_bt_doinsert_ost(OSTRelation rel, IndexTuple itup, char *datum, int size)
+{
+	BTInsertLevelOST *path;
+	ScanKey		itup_scankey;
+	IndexTuple	item;
+	IndexTuple	downlink;
+	Page		page;
+	BTPageOpaqueOST opaque;
+	OffsetNumber offnum;
+	BlockNumber blkno;
+	int			height;
+	int			nread;
+	int			level;
+	bool		ok;
+
+	/* Inserted items would not have the access counters of the tokens. */
+	if (rel->osts->backend->tokens)
+	{
+		selog(ERROR, "Index does not support insertions");
+		return false;
+	}
+
+	height = rel->osts->nlevels + 1;
+	path = (BTInsertLevelOST *) calloc(height, sizeof(BTInsertLevelOST));
+	rel->token = NULL;
+
+	/* we need an insertion scan key to do our search, so build one */
+	itup_scankey = _bt_mkscankey_ost(rel, itup, datum, size);
+
+	/* descend to the leaf, keeping every page of the path */
+	ok = true;
+	blkno = 0;
+	for (nread = 0; nread < height; nread++)
+	{
+		rel->level = nread;
+		path[nread].buf = ReadBuffer_ost(rel, blkno);
+		path[nread].blkno = blkno;
+		path[nread].naccess = 1;
+		page = BufferGetPage_ost(rel, path[nread].buf);
+		opaque = (BTPageOpaqueOST) PageGetSpecialPointer_s(page);
+
+		if (P_ISLEAF_OST(opaque) != (nread == height - 1))
+		{
+			selog(ERROR, "Block %u of level %d does not match the index height %d",
+				  blkno, nread, height);
+			ok = false;
+			nread++;
+			break;
+		}
+
+		offnum = _bt_binsrch_ost(rel, path[nread].buf, 1, itup_scankey, false);
+		path[nread].downlink = offnum;
+		if (nread < height - 1)
+			blkno = BTreeInnerTupleGetDownLink_OST((IndexTuple)
+												   PageGetItem_s(page, PageGetItemId_s(page, offnum)));
+		else if (P_NORMKEYS_OST(opaque) && rel->tDesc->natts == 1)
+			_bt_normalizetuple_s(rel->tDesc->attrs->atttypid, itup);
+	}
+
+	/* insert the tuple and the downlinks of the split pages, bottom-up */
+	item = itup;
+	offnum = ok ? path[height - 1].downlink : InvalidOffsetNumber;
+	for (level = height - 1; ok && level >= 0; level--)
+	{
+		rel->level = level;
+		if (item != NULL)
+		{
+			ok = _bt_insertonlevel_ost(rel, level, &path[level], item, offnum,
+									   &downlink);
+			if (item != itup)
+				free(item);
+			item = downlink;
+			if (level > 0)
+				offnum = OffsetNumberNext_s(path[level - 1].downlink);
+		}
+		if (ok && level > 0)
+			_bt_dummysplit_ost(rel, level, &path[level]);
+	}
+	if (item != NULL && item != itup)
+		free(item);
+
+	/* write back the path and the split pages */
+	for (level = height - 1; ok && level >= 0; level--)
+	{
+		rel->level = level;
+		MarkBufferDirty_ost(rel, path[level].buf);
+		path[level].naccess++;
+		if (level == 0)
+			continue;
+		if (path[level].split)
+		{
+			MarkBufferDirty_ost(rel, path[level].rbuf);
+			rel->levelBlocks[level]++;
+		}
+		if (path[level].sibling)
+			MarkBufferDirty_ost(rel, path[level].sbuf);
+		path[level].naccess += path[level].split + path[level].sibling;
+		_bt_dummysplit_ost(rel, level, &path[level]);
+	}
+
+	/* a rejected insertion makes the accesses it did not make */
+	for (level = 0; level < height; level++)
+		_bt_padlevel_ost(rel, level, path[level].naccess);
+
+	/* be tidy */
+	for (level = 0; level < nread; level++)
+	{
+		rel->level = level;
+		ReleaseBuffer_ost(rel, path[level].buf);
+		if (path[level].split)
+			ReleaseBuffer_ost(rel, path[level].rbuf);
+		if (path[level].sibling)
+			ReleaseBuffer_ost(rel, path[level].sbuf);
+	}
+	free(path);
+	_bt_freeskey_ost(itup_scankey);
+
+	return ok;
+}
+
+/*
+ * Dummy accesses to a level in place of the pages of a split that were not
+ * used.
+ */
+static void
+_bt_dummysplit_ost(OSTRelation rel, unsigned int level, BTInsertLevelOST * lev)
+{
+	BlockNumber dummy = rel->osts->fanouts[level - 1] + 1;
+
+	if (!lev->split)
+		ReadDummyBuffer_ost(rel, level, dummy);
+	if (!lev->sibling)
+		ReadDummyBuffer_ost(rel, level, dummy);
+	lev->naccess += !lev->split + !lev->sibling;
+}
+
+/*
+ * Dummy accesses to a level after naccess accesses of an insertion, up to
+ * the accesses of an insertion that succeeds.
+ */
+static void
+_bt_padlevel_ost(OSTRelation rel, unsigned int level, int naccess)
+{
+	BlockNumber dummy = level == 0 ? 1 : rel->osts->fanouts[level - 1] + 1;
+
+	rel->level = level;
+	for (; naccess < BT_INSERT_ACCESSES_OST(level); naccess++)
+		ReadDummyBuffer_ost(rel, level, dummy);
+}
+
+/*
+ *	_bt_dummyinsert() -- Same as _bt_dummyinsert_s.
+ */
+void
+_bt_dummyinsert_ost(OSTRelation rel)
+{
+	unsigned int level;
+
+	for (level = 0; level <= rel->osts->nlevels; level++)
+		_bt_padlevel_ost(rel, level, 0);
+}
+
+/*
+ *	_bt_insertonlevel() -- Insert an item on the page of the path on a level.
+ *
+ *		Same as _bt_insertonlevel_s.
+ */
+static bool
+_bt_insertonlevel_ost(OSTRelation rel, unsigned int level,
+					  BTInsertLevelOST * lev, IndexTuple item,
+					  OffsetNumber itemoff, IndexTuple *downlink)
+{
+	Page		page = BufferGetPage_ost(rel, lev->buf);
+	BTPageOpaqueOST opaque = (BTPageOpaqueOST) PageGetSpecialPointer_s(page);
+	BTPageOpaqueOST sopaque;
+	BlockNumber rblkno;
+	Size		itemsz;
+
+	*downlink = NULL;
+	itemsz = MAXALIGN_s(IndexTupleSize_s(item));
+
+	if (itemsz > BTMaxItemSize_OST(page))
+	{
+		selog(ERROR, "index row size %zu exceeds maximum %zu for index",
+			  itemsz, BTMaxItemSize_OST(page));
+		return false;
+	}
+
+	if (PageGetFreeSpace_s(page) >= itemsz)
+	{
+		if (!_bt_pgaddtup_s(page, itemsz, item, itemoff))
+		{
+			selog(ERROR, "failed to add new item to block %u in index",
+				  lev->blkno);
+			return false;
+		}
+		return true;
+	}
+
+	if (level == 0)
+	{
+		selog(ERROR, "Index root is full");
+		return false;
+	}
+
+	rblkno = rel->levelBlocks[level];
+	if (rblkno >= (BlockNumber) rel->osts->fanouts[level - 1])
+	{
+		selog(ERROR, "No free blocks left on level %u of index", level);
+		return false;
+	}
+
+	lev->rbuf = ReadBuffer_ost(rel, rblkno);
+	lev->split = true;
+	lev->naccess++;
+	if (!P_RIGHTMOST_OST(opaque))
+	{
+		lev->sbuf = ReadBuffer_ost(rel, opaque->btpo_next);
+		lev->sibling = true;
+		lev->naccess++;
+	}
+
+	*downlink = _bt_splitpage_s(page, lev->blkno,
+								BufferGetPage_ost(rel, lev->rbuf), rblkno,
+								rel->tDesc, item, itemoff);
+	if (*downlink == NULL)
+		return false;
+
+	if (lev->sibling)
+	{
+		sopaque = (BTPageOpaqueOST) PageGetSpecialPointer_s(BufferGetPage_ost(rel, lev->sbuf));
+		if (sopaque->btpo_prev != lev->blkno)
+		{
+			selog(ERROR, "right sibling's left-link doesn't match: "
+				  "block %u links to %u instead of expected %u",
+				  opaque->btpo_next, sopaque->btpo_prev, lev->blkno);
+			return false;
+		}
+		sopaque->btpo_prev = rblkno;
+	}
+
+	return true;
+}
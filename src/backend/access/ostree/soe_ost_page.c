@@ -95,7 +95,7 @@ _bt_checkpage_ost(OSTRelation rel, Buffer buf)
 	/*
 	 * Additionally check that the special area looks sane.
 	 */
-	if (PageGetSpecialSize_s(page) != MAXALIGN_s(sizeof(BTPageOpaqueDataOST)))
+	if (PageGetSpecialSize_s(page) < MAXALIGN_s(sizeof(BTPageOpaqueDataOST)))
 		selog(DEBUG1, "index contains corrupted page at block %d", buf);
 
 }
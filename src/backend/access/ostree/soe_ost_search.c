@@ -14,13 +14,17 @@
  */
 
 #include "access/soe_ost.h"
+#include "access/soe_nbtcompare.h"
 #include "storage/soe_ost_ofile.h"
 #include "logger/logger.h"
 #include "common/soe_prf.h"
 
+#include <stdlib.h>
+
 static bool _bt_readpage_ost(IndexScanDesc scan,
 							 OffsetNumber offnum);
-static void _bt_saveitem_ost(BTScanOpaqueOST so, int itemIndex,
+static bool _bt_reserveitems_ost(BTScanOpaqueOST so, int nitems);
+static int	_bt_saveitem_ost(BTScanOpaqueOST so, int itemIndex,
 							 OffsetNumber offnum, IndexTuple itup);
 static bool _bt_steppage_ost(IndexScanDesc scan);
 static bool _bt_readnextpage_ost(IndexScanDesc scan, BlockNumber blkno);
@@ -120,27 +124,17 @@ _bt_search_ost(OSTRelation rel, int keysz, ScanKey scankey, bool nextkey,
 		itemid = PageGetItemId_s(page, offnum);
 		itup = (IndexTuple) PageGetItem_s(page, itemid);
 		
-        //Test if offnum is in a valid state
-        if(offnum > 300){
-            selog(DEBUG1, "Too many keys for countes in opaque data %d", offnum);
-            abort();
-        }
-        if(opaque->counters[offnum] == 0){
-            opaque->counters[offnum] = 2;
-        }
-        nextNodeCounter = opaque->counters[offnum],
-
-        opaque->counters[offnum] += 2;
+        nextNodeCounter = _bt_nextcounter_ost(rel, page, offnum, 2);
 
 
         //get child node
         blkno = BTreeInnerTupleGetDownLink_OST(itup);
 		par_blkno = BufferGetBlockNumber_ost(*bufP);
-        #ifdef TFORESTORAM
-        //The root write ignores the token
-        prf(rel->level, oldBlkno, currentNodeCounter, (unsigned int*) &token);
-        MarkBufferDirty_ost(rel, *bufP);
-        #endif
+        if(rel->osts->backend->tokens){
+            //The root write ignores the token
+            prf(rel->level, oldBlkno, currentNodeCounter, (unsigned int*) &token);
+            MarkBufferDirty_ost(rel, *bufP);
+        }
 		ReleaseBuffer_ost(rel, *bufP);
 
         //Prepare state for child access
@@ -236,6 +230,19 @@ _bt_binsrch_ost(OSTRelation rel,
 
 	cmpval = nextkey ? 0 : 1;	/* select comparison value */
 
+#ifdef CT_SEARCH
+	/*
+	 * Compare the key with every slot of the page, leaving to the binary
+	 * search only the slots whose key prefix is equal to the scan key.
+	 */
+	if (P_NORMKEYS_OST(opaque) && scankey->sk_norm != NULL)
+	{
+		if (!P_ISLEAF_OST(opaque))
+			low++;				/* minus infinity is < scan key */
+		_bt_ctsearch_s(page, scankey, low, high, cmpval, &low, &high);
+	}
+#endif
+
 	while (high > low)
 	{
 		OffsetNumber mid = low + ((high - low) / 2);
@@ -301,7 +308,6 @@ _bt_compare_ost(OSTRelation rel,
 				Page page,
 				OffsetNumber offnum)
 {
-	char	   *datum;
 	IndexTuple	itup;
 	int32		result;
 
@@ -319,14 +325,10 @@ _bt_compare_ost(OSTRelation rel,
 
 	itup = (IndexTuple) PageGetItem_s(page, PageGetItemId_s(page, offnum));
 
-
-
-	/* datum = NameStr_s(*DatumGetName_s(index_getattr_s(itup))); */
-	datum = VARDATA_ANY_S(DatumGetBpCharPP_S(index_getattr_s(itup)));
-    //selog(DEBUG1, "Comparing %s %s", scankey->sk_argument, datum);
-	/* We assume we are comparing strings(varchars) */
-    result = (int32) strncmp(scankey->sk_argument, datum, strlen(scankey->sk_argument));
-    //selog(DEBUG1, "Result is %d", result);
+	if (P_NORMKEYS_OST(opaque) && scankey->sk_norm != NULL)
+		result = _bt_normcmp_s(scankey, index_getattr_s(itup));
+	else
+		result = rel->keycmp(scankey, index_getattr_s(itup));
 	/* if the keys are unequal, return the difference */
 	if (result != 0)
 		return result;
@@ -378,7 +380,6 @@ _bt_first_ost(IndexScanDesc scan)
 	ScanKey		cur = scan->keyData;
     Page         page;
     BlockNumber  leafBlkno;
-    BTPageOpaqueOST  opaque;
     unsigned int  token[8];
 
 	/**
@@ -405,10 +406,9 @@ _bt_first_ost(IndexScanDesc scan)
 	 */
 	/* selog(DEBUG1, "bt_first scan opoid is %d", scan->opoid); */
 	/* The protoype currently does not support backward scans. */
-	switch (scan->opoid)
+	switch (scan->strategy)
 	{
-		case 1058:
-			/* BTLessStrategyNumber: */
+		case BTLessStrategyNumber:
 
 			/*
              *
@@ -422,8 +422,7 @@ _bt_first_ost(IndexScanDesc scan)
 			selog(ERROR, "Less or equal strategy requires backward scan no supported");
 			break;
 
-		case 1059:
-			/* BTLessEqualStrategyNumber: */
+		case BTLessEqualStrategyNumber:
 
 			/*
 			 * Find first item > scankey, then back up one to arrive at last
@@ -436,8 +435,7 @@ _bt_first_ost(IndexScanDesc scan)
 			selog(ERROR, "Less than strategy requires backward scan no supported");
 			break;
 
-		case 1054:
-			/* BTEqualStrategyNumber: */
+		case BTEqualStrategyNumber:
 
 
 
@@ -449,8 +447,7 @@ _bt_first_ost(IndexScanDesc scan)
 			goback = false;
 			break;
 
-		case 1061:
-			/* BTGreaterEqualStrategyNumber: */
+		case BTGreaterEqualStrategyNumber:
 
 			/*
 			 * Find first item >= scankey.  (This is only used for forward
@@ -460,8 +457,7 @@ _bt_first_ost(IndexScanDesc scan)
 			goback = false;
 			break;
 
-		case 1060:
-			/* BTGreaterStrategyNumber: */
+		case BTGreaterStrategyNumber:
 
 			/*
 			 * Find first item > scankey.  (This is only used for forward
@@ -512,27 +508,16 @@ _bt_first_ost(IndexScanDesc scan)
 		/* selog(DEBUG1, "Found match on offset prev %d", offnum); */
 	}
     	
-    #ifdef TFORESTORAM
-    if(offnum > 300){
-        selog(DEBUG1, "Too many keys for countes in opaque data %d", offnum);
+    if(rel->osts->backend->tokens){
+        page = BufferGetPage_ost(rel, buf);
+        /* the counter only advances when the heap block is accessed */
+        rel->heapBlockCounter = _bt_nextcounter_ost(rel, page, offnum,
+                                                    scan->xs_heapfetch ? 1 : 0);
+        prf(rel->level, leafBlkno, rel->leafCurrentCounter, (unsigned int*) &token);
+
+        rel->token = token;
+        MarkBufferDirty_ost(rel, buf);
     }
-	    
-
-    page = BufferGetPage_ost(rel, buf);
-    opaque = (BTPageOpaqueOST) PageGetSpecialPointer_s(page);
-    
-    if(opaque->counters[offnum] == 0){
-        //selog(DEBUG1, "First Access");
-        opaque->counters[offnum] = 2;
-    }
-
-    rel->heapBlockCounter = opaque->counters[offnum];
-    opaque->counters[offnum] +=1;
-    prf(rel->level, leafBlkno, rel->leafCurrentCounter, (unsigned char*) &token);
-
-    rel->token = token;
-    MarkBufferDirty_ost(rel, buf);
-    #endif
     //selog(DEBUG1, "Found leaf match at offset %d", offnum);
 
 	/* remember which buffer we have pinned, if any */
@@ -572,6 +557,8 @@ _bt_first_ost(IndexScanDesc scan)
 	/* OK, itemIndex says what to return */
 	currItem = &so->currPos.items[so->currPos.itemIndex];
 	scan->xs_ctup.t_self = currItem->heapTid;
+	if (scan->xs_want_itup)
+		scan->xs_itup = (IndexTuple) (so->currTuples + currItem->tupleOffset);
 
 	return true;
 }
@@ -628,8 +615,8 @@ _bt_next_ost(IndexScanDesc scan)
 	/* OK, itemIndex says what to return */
 	currItem = &so->currPos.items[so->currPos.itemIndex];
 	scan->xs_ctup.t_self = currItem->heapTid;
-/* 	if (scan->xs_want_itup) */
-/* 		scan->xs_itup = (IndexTuple) (so->currTuples + currItem->tupleOffset); */
+	if (scan->xs_want_itup)
+		scan->xs_itup = (IndexTuple) (so->currTuples + currItem->tupleOffset);
 
 	return true;
 }
@@ -714,8 +701,7 @@ _bt_readpage_ost(IndexScanDesc scan, OffsetNumber offnum)
 		if (itup != NULL)
 		{
 			/* tuple passes all scan key conditions, so remember it */
-			_bt_saveitem_ost(so, itemIndex, offnum, itup);
-			itemIndex++;
+			itemIndex = _bt_saveitem_ost(so, itemIndex, offnum, itup);
 		}
 		if (!continuescan)
 		{
@@ -736,23 +722,91 @@ _bt_readpage_ost(IndexScanDesc scan, OffsetNumber offnum)
 	return (so->currPos.firstItem <= so->currPos.lastItem);
 }
 
-/* Save an index item into so->currPos.items[itemIndex] */
-static void
+/*
+ * Makes room for nitems items in so->currPos.items. The array starts with an
+ * item per index tuple of a page and only grows for the pages whose posting
+ * lists have more TIDs. Returns false if there is no room.
+ */
+static bool
+_bt_reserveitems_ost(BTScanOpaqueOST so, int nitems)
+{
+	BTScanPosItemOST *items;
+	int			maxItems;
+
+	if (nitems <= so->currPos.maxItems)
+		return true;
+	if (nitems > MaxTIDsPerIndexPage_s)
+		return false;
+
+	maxItems = Max_s(so->currPos.maxItems * 2, MaxIndexTuplesPerPage);
+	maxItems = Min_s(Max_s(maxItems, nitems), MaxTIDsPerIndexPage_s);
+	items = (BTScanPosItemOST *) realloc(so->currPos.items,
+								  sizeof(BTScanPosItemOST) * maxItems);
+	if (items == NULL)
+		return false;
+
+	so->currPos.items = items;
+	so->currPos.maxItems = maxItems;
+	return true;
+}
+
+/*
+ * Save an index item into so->currPos.items[itemIndex], one item per heap
+ * TID of a posting list tuple. Returns the index of the next free item.
+ */
+static int
 _bt_saveitem_ost(BTScanOpaqueOST so, int itemIndex,
 				 OffsetNumber offnum, IndexTuple itup)
 {
-	BTScanPosItemOST *currItem = &so->currPos.items[itemIndex];
+	BTScanPosItemOST *currItem;
+	LocationIndex tupleOffset = 0;
+	ItemPointer tids = &itup->t_tid;
+	int			ntids = 1;
+	int			i;
 
-	currItem->heapTid = itup->t_tid;
-	currItem->indexOffset = offnum;
 	if (so->currTuples)
 	{
 		Size		itupsz = IndexTupleSize_s(itup);
 
-		currItem->tupleOffset = so->currPos.nextTupleOffset;
+		/* the items of a posting list share the copy of the tuple */
+		tupleOffset = so->currPos.nextTupleOffset;
 		memcpy(so->currTuples + so->currPos.nextTupleOffset, itup, itupsz);
 		so->currPos.nextTupleOffset += MAXALIGN_s(itupsz);
 	}
+
+	if (IndexTupleIsPosting_s(itup))
+	{
+		tids = (ItemPointer) malloc(sizeof(ItemPointerData) *
+									IndexTupleGetNPosting_s(itup));
+		ntids = index_getposting_s(itup, tids,
+								   MaxTIDsPerIndexPage_s - itemIndex);
+		if (ntids < 0)
+		{
+			selog(ERROR, "Malformed posting list at index offset %d", offnum);
+			free(tids);
+			return itemIndex;
+		}
+	}
+
+	if (!_bt_reserveitems_ost(so, itemIndex + ntids))
+	{
+		selog(ERROR, "Could not allocate %d scan items", itemIndex + ntids);
+		if (tids != &itup->t_tid)
+			free(tids);
+		return itemIndex;
+	}
+
+	for (i = 0; i < ntids; i++)
+	{
+		currItem = &so->currPos.items[itemIndex + i];
+		currItem->heapTid = tids[i];
+		currItem->indexOffset = offnum;
+		currItem->tupleOffset = tupleOffset;
+	}
+
+	if (tids != &itup->t_tid)
+		free(tids);
+	return itemIndex + ntids;
 }
 
 /*
@@ -15,10 +15,34 @@
 
 #include "access/soe_ost.h"
 #include "access/soe_itup.h"
+#include "access/soe_nbtcompare.h"
 #include "logger/logger.h"
 
 
 
+/*
+ * Compares the key of an index tuple with a scan key of the scan, the
+ * comparator the other way.
+ */
+static int
+_bt_keytest_ost(IndexScanDesc scan, BTPageOpaqueOST opaque, ScanKey skey,
+				IndexTuple tuple)
+{
+	char	   *datum;
+
+	/* normalized strings have no padding, compare as the index does */
+	if (P_NORMKEYS_OST(opaque) && skey->sk_norm != NULL)
+		return -_bt_normcmp_s(skey, index_getattr_s(tuple));
+
+	if (scan->ost->tDesc->natts == 1 &&
+		_bt_keyisstring_s(scan->ost->tDesc->attrs->atttypid))
+	{
+		datum = VARDATA_ANY_S(DatumGetBpCharPP_S(index_getattr_s(tuple)));
+		return (int32) strncmp(datum, skey->sk_argument, strlen(datum) - 1);
+	}
+	return -scan->ost->keycmp(skey, index_getattr_s(tuple));
+}
+
 /*
  * Test whether an indextuple satisfies all the scankey conditions.
  *
@@ -44,10 +68,10 @@ _bt_checkkeys_ost(IndexScanDesc scan,
 				  bool *continuescan)
 {
 	ItemId		iid = PageGetItemId_s(page, offnum);
+	BTPageOpaqueOST opaque = (BTPageOpaqueOST) PageGetSpecialPointer_s(page);
 	IndexTuple	tuple;
-	char	   *keyValue;
-	char	   *datum;
 	int			test;
+	bool		tuple_alive;
 
 
 	*continuescan = false;		/* default assumption */
@@ -60,24 +84,36 @@ _bt_checkkeys_ost(IndexScanDesc scan,
 	 * However, if this is the last tuple on the page, we should check the
 	 * index keys to prevent uselessly advancing to the next page.
 	 */
-
+	if (ItemIdIsDead_s(iid))
+	{
+		/* return immediately if there are more tuples on the page */
+		if (offnum < PageGetMaxOffsetNumber_s(page))
+		{
+			*continuescan = true;
+			return NULL;
+		}
+		tuple_alive = false;
+	}
+	else
+		tuple_alive = true;
 
 	tuple = (IndexTuple) PageGetItem_s(page, iid);
-	datum = VARDATA_ANY_S(DatumGetBpCharPP_S(index_getattr_s(tuple)));
-	/* selog(DEBUG1, "Current datum is %s", datum); */
-	/* datumSize = strlen(datum)+1; */
-	keyValue = scan->keyData->sk_argument;
-	/* the prototype assumes string comparisons */
-	test = (int32) strncmp(datum, keyValue, strlen(datum)-1);
-
-    /**
-	* Look at soe_nbtsearch.c function _bt_first_s to which operations the
-	* opoids correspond to.
-	*/
-	if ((scan->opoid == 1058 && test < 0) || (scan->opoid == 1059 && test <= 0) || (scan->opoid == 1054 && test == 0) || (scan->opoid == 1061 && test >= 0) || (scan->opoid == 1060 && test > 0))
+	test = _bt_keytest_ost(scan, opaque, scan->keyData, tuple);
+
+	if ((scan->strategy == BTLessStrategyNumber && test < 0) ||
+		(scan->strategy == BTLessEqualStrategyNumber && test <= 0) ||
+		(scan->strategy == BTEqualStrategyNumber && test == 0) ||
+		(scan->strategy == BTGreaterEqualStrategyNumber && test >= 0) ||
+		(scan->strategy == BTGreaterStrategyNumber && test > 0))
 	{
+		/* the keys past the upper bound of a range scan end it */
+		if (scan->xs_hikey != NULL &&
+			!_bt_strategymatches_s(scan->xs_histrategy,
+								   _bt_keytest_ost(scan, opaque,
+												   scan->xs_hikey, tuple)))
+			return NULL;
 		*continuescan = true;
-		return tuple;
+		return tuple_alive ? tuple : NULL;
 	}
 	else
 	{
@@ -87,6 +123,92 @@ _bt_checkkeys_ost(IndexScanDesc scan,
 	}
 }
 
+/*
+ * _bt_matchexact() -- Whether the match of a scan is equal to its key.
+ *
+ * Same as _bt_matchexact_s, on the leaf level ORAM.
+ */
+bool
+_bt_matchexact_ost(IndexScanDesc scan)
+{
+	BTScanOpaqueOST so = (BTScanOpaqueOST) scan->opaque;
+	OSTRelation rel = scan->ost;
+	Page		page;
+	BTPageOpaqueOST opaque;
+	IndexTuple	itup;
+
+	rel->level = rel->osts->nlevels;
+	page = BufferGetPage_ost(rel, so->currPos.buf);
+	opaque = (BTPageOpaqueOST) PageGetSpecialPointer_s(page);
+	itup = (IndexTuple) PageGetItem_s(page,
+									  PageGetItemId_s(page, so->currPos.items[so->currPos.itemIndex].indexOffset));
+
+	return _bt_keyexact_s(rel->tDesc, scan->keyData, itup,
+						  P_NORMKEYS_OST(opaque));
+}
+
+/*
+ * _bt_killitem() -- Mark the index item of the match of a scan dead.
+ *
+ * Same as _bt_killitem_s, on the leaf level ORAM.
+ */
+void
+_bt_killitem_ost(IndexScanDesc scan, bool res)
+{
+	BTScanOpaqueOST so = (BTScanOpaqueOST) scan->opaque;
+	OSTRelation rel = scan->ost;
+	unsigned int level = rel->osts->nlevels;
+	Page		page;
+	ItemId		iid;
+
+	scan->xs_killed = false;
+	if (!res)
+	{
+		ReadDummyBuffer_ost(rel, level, rel->osts->fanouts[level - 1] + 1);
+		return;
+	}
+
+	rel->level = level;
+	page = BufferGetPage_ost(rel, so->currPos.buf);
+	iid = PageGetItemId_s(page, so->currPos.items[so->currPos.itemIndex].indexOffset);
+	if (IndexTupleIsPosting_s((IndexTuple) PageGetItem_s(page, iid)))
+		selog(ERROR, "Can't delete a tuple with duplicate keys");
+	else
+	{
+		ItemIdMarkDead_s(iid);
+		scan->xs_killed = true;
+	}
+
+	rel->token = NULL;
+	MarkBufferDirty_ost(rel, so->currPos.buf);
+}
+
+/*
+ * Returns the access counter of the item at offnum and advances it by step,
+ * as _bt_nextcounter_s.
+ */
+uint32
+_bt_nextcounter_ost(OSTRelation rel, Page page, OffsetNumber offnum,
+					uint32 step)
+{
+	uint32	   *counters = BTPageGetCounters_OST(page);
+	uint32		counter;
+
+	if (offnum < FirstOffsetNumber || offnum > BTPageGetNCounters_OST(page))
+	{
+		if (rel->osts->backend->tokens && offnum <= PageGetMaxOffsetNumber_s(page))
+			selog(ERROR, "Index page has no access counter for item %d", offnum);
+		return 0;
+	}
+
+	if (counters[offnum - 1] == 0)
+		counters[offnum - 1] = 2;
+	counter = counters[offnum - 1];
+	counters[offnum - 1] += step;
+
+	return counter;
+}
+
 /*
  * free a retracement stack made by _bt_search.
  */
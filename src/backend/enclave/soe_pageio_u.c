@@ -0,0 +1,52 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_pageio_u.c
+ *	  Default host side of the direct page I/O ocalls.
+ *
+ * The enclave only makes the outFileReadDirect and outFileWriteDirect
+ * ocalls after the host registers a buffer with setIOBuffer, but the ocall
+ * table still references them. These weak definitions are linked in the
+ * untrusted library so that hosts that do not implement them keep linking
+ * and loading; they do the I/O with the host's outFileRead and outFileWrite,
+ * which can use the registered buffer as it is in the host memory. A host
+ * that implements the direct ocalls overrides them.
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ * IDENTIFICATION
+ *        backend/enclave/soe_pageio_u.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifdef UNSAFE
+#include "Enclave_dt.h"
+
+__attribute__((weak)) sgx_status_t
+outFileReadDirect(char *page, const char *filename, int blkno, int pageSize)
+{
+	return outFileRead(page, filename, blkno, pageSize);
+}
+
+__attribute__((weak)) sgx_status_t
+outFileWriteDirect(const char *block, const char *filename, int oblkno,
+				   int pageSize)
+{
+	return outFileWrite(block, filename, oblkno, pageSize);
+}
+#else
+#include "Enclave_u.h"
+
+__attribute__((weak)) void
+outFileReadDirect(char *page, const char *filename, int blkno, int pageSize)
+{
+	outFileRead(page, filename, blkno, pageSize);
+}
+
+__attribute__((weak)) void
+outFileWriteDirect(const char *block, const char *filename, int oblkno,
+				   int pageSize)
+{
+	outFileWrite(block, filename, oblkno, pageSize);
+}
+#endif
@@ -11,37 +11,55 @@
 #include "access/soe_heapam.h"
 #include "storage/soe_bufmgr.h"
 #include "storage/soe_ost_bufmgr.h"
+#include "storage/soe_oram_backend.h"
+#include "storage/soe_pmap.h"
+#include "storage/soe_snapshot.h"
+#include "storage/soe_bulkload.h"
+#include "storage/soe_pageio.h"
 
-//#include "access/soe_hash.h"
+#include "access/soe_hash.h"
 #include "access/soe_nbtree.h"
 #include "access/soe_ost.h"
+#include "access/soe_nbtcompare.h"
 #include "access/soe_heapam.h"
-//#include "storage/soe_hash_ofile.h"
+#include "access/soe_delta.h"
+#include "access/soe_pushdown.h"
+#include "access/soe_toast.h"
+#include "storage/soe_hash_ofile.h"
 #include "storage/soe_heap_ofile.h"
 #include "storage/soe_nbtree_ofile.h"
 #include "storage/soe_ost_ofile.h"
+#include "storage/soe_single_ofile.h"
 #include "storage/soe_itemptr.h"
 #include "logger/logger.h"
 #include "common/soe_prf.h"
+#include "common/soe_seal.h"
 #include "access/soe_heapam.h"
+#include "utils/soe_advisor.h"
 
 #include <oram/oram.h>
 #include <oram/plblock.h>
 #include <oram/stash.h>
 #include <oram/pmap.h>
 #include <oram/ofile.h>
+#include <stdio.h>
 
 
 /*  Bucket capacity */
+#ifndef BKCAP
 #ifdef SMALL_BKCAP
 #define BKCAP 1
 #else
 #define BKCAP 4
 #endif
+#endif
 
 /* Predefined max tuple size for sgx to copy the real tuple to*/
 #define MAX_TUPLE_SIZE 8070
 
+/* Maximum number of indexes of the table (initSOE/initFSOE and addIndex) */
+#define MAX_INDEXES 8
+
 ORAMState	stateTable = NULL;
 ORAMState	stateIndex = NULL;
 
@@ -54,6 +72,18 @@ OSTRelation ostIndex;
 Amgr	   *tamgr;
 Amgr	   *iamgr;
 
+/* Bulk loads of the relations created between beginBulkLoad and endBulkLoad. */
+static BulkLoad tBulk = NULL;
+static BulkLoad iBulk = NULL;
+static BulkLoad *ostBulks = NULL;
+
+/* ORAM constructions used by the table and index, set with selectORAM. */
+const ORAMBackend *tBackend = NULL;
+const ORAMBackend *iBackend = NULL;
+
+/* Set when selectORAM names a construction that is not linked. */
+static bool invalidORAM = false;
+
 
 //Index scan global status
 IndexScanDesc scan;
@@ -64,6 +94,310 @@ IndexScanDesc scan;
 Mode        mode;
 int counter = 0;
 
+/*
+ * An index of the table. The index used by a request is selected with
+ * useIndex, which sets the globals above (mode, oIndex or ostIndex and
+ * ostTable).
+ */
+typedef struct SOEIndex
+{
+	Mode		mode;
+	VRelation	vrel;			/* DYNAMIC index */
+	ORAMState	state;
+	Amgr	   *amgr;
+	BulkLoad	bulk;
+	OSTRelation ostrel;			/* OST index */
+	OSTreeState ost;
+	BulkLoad   *ostBulks;
+} SOEIndex;
+
+static SOEIndex indexes[MAX_INDEXES];
+static int	nindexes = 0;
+
+/* Parameters of the last initSOE or initFSOE, sealed by sealState. */
+static Snapshot initParams = NULL;
+
+/* Parameters of the indexes added with addIndex and addFIndex. */
+static Snapshot indexParams = NULL;
+
+/* Delta of the table where appendTuple adds tuples (soe_delta.c). */
+static VRelation dTable = NULL;
+static Amgr *damgr = NULL;
+
+/* Toast of the table where insertHeap stores large tuples (soe_toast.c). */
+static VRelation toastTable = NULL;
+static Amgr *toastamgr = NULL;
+
+/* The last tuple stored out of line returned by getTuple, for readToast. */
+static ToastPointerData lastToast;
+static bool hasLastToast = false;
+
+
+/*
+ * Selects by name the ORAM constructions used by the table and by the index
+ * on the next initSOE or initFSOE. An empty name selects the default
+ * construction (ORAM_LIB). A name that is not linked makes the next
+ * initSOE or initFSOE fail.
+ */
+void
+selectORAM(const char *tORAM, const char *iORAM)
+{
+    tBackend = GetORAMBackend(tORAM);
+    iBackend = GetORAMBackend(iORAM);
+    invalidORAM = tBackend == NULL || iBackend == NULL;
+}
+
+/*
+ * Token based table ORAMs receive their access counters from the leaf pages
+ * of the index, which are only maintained by a token based index ORAM.
+ * Returns false if the selected constructions can not be used.
+ */
+static bool
+checkORAMBackends(void)
+{
+    if (invalidORAM)
+    {
+        selog(ERROR, "selectORAM named an ORAM that is not linked");
+        return false;
+    }
+    if (tBackend == NULL)
+        tBackend = GetORAMBackend(NULL);
+    if (iBackend == NULL)
+        iBackend = GetORAMBackend(NULL);
+
+    if (tBackend->tokens && !iBackend->tokens)
+    {
+        selog(ERROR, "Table ORAM %s requires a token based index ORAM, not %s",
+              tBackend->name, iBackend->name);
+        return false;
+    }
+    selog(DEBUG1, "Table ORAM is %s and index ORAM is %s", tBackend->name,
+          iBackend->name);
+    return true;
+}
+
+static void
+recordInit(Mode initMode, const char *tName, const char *iName, int tNBlocks,
+           int *fanouts, unsigned int fanout_size, unsigned int nlevels,
+           int iNBlocks, unsigned int tOid, unsigned int iOid,
+           unsigned int functionOid, unsigned int indexOid, char *attrDesc,
+           unsigned int attrDescLength)
+{
+    if (initParams != NULL)
+        snapshot_destroy(initParams);
+    if (indexParams != NULL)
+        snapshot_destroy(indexParams);
+    indexParams = NULL;
+
+    initParams = snapshot_create();
+    snapshot_putInt(initParams, initMode);
+    snapshot_putString(initParams, tBackend->name);
+    snapshot_putString(initParams, iBackend->name);
+    snapshot_putString(initParams, tName);
+    snapshot_putString(initParams, iName);
+    snapshot_putInt(initParams, tNBlocks);
+    snapshot_putInt(initParams, fanout_size);
+    snapshot_put(initParams, fanouts, fanout_size);
+    snapshot_putInt(initParams, nlevels);
+    snapshot_putInt(initParams, iNBlocks);
+    snapshot_putInt(initParams, tOid);
+    snapshot_putInt(initParams, iOid);
+    snapshot_putInt(initParams, functionOid);
+    snapshot_putInt(initParams, indexOid);
+    snapshot_putInt(initParams, attrDescLength);
+    snapshot_put(initParams, attrDesc, attrDescLength);
+}
+
+/* Appends the parameters of an index added after initSOE or initFSOE. */
+static void
+recordIndex(Mode indexMode, const char *iName, int *fanouts,
+            unsigned int fanout_size, unsigned int nlevels, int iNBlocks,
+            unsigned int iOid, unsigned int functionOid, unsigned int indexOid,
+            char *attrDesc, unsigned int attrDescLength)
+{
+    if (indexParams == NULL)
+        indexParams = snapshot_create();
+
+    snapshot_putInt(indexParams, indexMode);
+    snapshot_putString(indexParams, iBackend->name);
+    snapshot_putString(indexParams, iName);
+    snapshot_putInt(indexParams, fanout_size);
+    snapshot_put(indexParams, fanouts, fanout_size);
+    snapshot_putInt(indexParams, nlevels);
+    snapshot_putInt(indexParams, iNBlocks);
+    snapshot_putInt(indexParams, iOid);
+    snapshot_putInt(indexParams, functionOid);
+    snapshot_putInt(indexParams, indexOid);
+    snapshot_putInt(indexParams, attrDescLength);
+    snapshot_put(indexParams, attrDesc, attrDescLength);
+}
+
+/*
+ * Adds the index whose relation is in the globals (oIndex or ostIndex) to
+ * the indexes of the table. Returns its identifier.
+ */
+static int
+registerIndex(void)
+{
+    SOEIndex   *index = &indexes[nindexes];
+
+    memset(index, 0, sizeof(SOEIndex));
+    index->mode = mode;
+    if (mode == DYNAMIC)
+    {
+        index->vrel = oIndex;
+        index->state = stateIndex;
+        index->amgr = iamgr;
+        index->bulk = iBulk;
+    }
+    else
+    {
+        index->ostrel = ostIndex;
+        index->ost = ostTable;
+        index->ostBulks = ostBulks;
+    }
+    iBulk = NULL;
+    ostBulks = NULL;
+
+    return nindexes++;
+}
+
+/* Selects the index used by the next requests. */
+static bool
+useIndex(unsigned int indexId)
+{
+    SOEIndex   *index;
+
+    if (indexId >= (unsigned int) nindexes)
+    {
+        selog(ERROR, "Index %d does not exist", indexId);
+        return false;
+    }
+
+    index = &indexes[indexId];
+    mode = index->mode;
+    oIndex = index->vrel;
+    stateIndex = index->state;
+    iamgr = index->amgr;
+    ostIndex = index->ostrel;
+    ostTable = index->ost;
+    return true;
+}
+
+/*
+ * The hash pages have no access counters for the token based ORAMs and
+ * can not be told apart from the heap pages in a single ORAM, and hash
+ * codes are computed from a single column. Returns false if the index can
+ * not use the access method indexOid.
+ */
+static bool
+checkIndexHandler(unsigned int indexOid, unsigned int attrDescLength)
+{
+	if (indexOid != F_HASHHANDLER)
+		return true;
+	if (attrDescLength >= 2 * sizeof(FormData_pg_attribute))
+	{
+		selog(ERROR, "Hash indexes do not support keys of several columns");
+		return false;
+	}
+#ifdef SINGLE_ORAM
+	selog(ERROR, "SINGLE_ORAM does not support hash indexes");
+	return false;
+#endif
+	if (iBackend->tokens)
+	{
+		selog(ERROR, "Hash indexes do not support the token based ORAM %s",
+			  iBackend->name);
+		return false;
+	}
+	return true;
+}
+
+/* Creates the ORAM and the relation of a nbtree or hash index (oIndex). */
+static void
+createIndex(const char *iName, int iNBlocks, unsigned int iOid,
+            unsigned int indexOid)
+{
+	if (indexOid == F_HASHHANDLER)
+	{
+		selog(DEBUG1, "going to init hash oblivious file");
+		stateIndex = initORAMState(iName, iNBlocks, &hash_ofileCreate, iBackend, &iamgr, &iBulk);
+		oIndex = InitVRelation(stateIndex, iBackend, iOid, iNBlocks, &hash_pageInit);
+	}
+	else
+	{
+		selog(DEBUG1, "going to init nbtree oblivious heap file");
+		stateIndex = initORAMState(iName, iNBlocks, &nbtree_ofileCreate, iBackend, &iamgr, &iBulk);
+		oIndex = InitVRelation(stateIndex, iBackend, iOid, iNBlocks, &nbtree_pageInit);
+	}
+	oIndex->bulk = iBulk;
+}
+
+/* Sets the key and the level sizes of the index oIndex. */
+static void
+setupIndex(int *fanouts, unsigned int fanout_size, unsigned int nlevels,
+           unsigned int functionOid, unsigned int indexOid, char *attrDesc,
+           unsigned int attrDescLength)
+{
+	oIndex->foid = functionOid;
+	oIndex->indexOid = indexOid;
+	oIndex->keycmp = _bt_initkeydesc_s(oIndex->tDesc, attrDesc, attrDescLength);
+	btree_fanout_setup(oIndex, fanouts, fanout_size, nlevels);
+	//oIndex->tDesc->isnbtree = true;
+}
+
+/* Creates the ORAMs and the relation of an OST index (ostIndex). */
+static void
+createFIndex(const char *iName, int *fanouts, unsigned int nlevels,
+             unsigned int iOid, char *attrDesc, unsigned int attrDescLength)
+{
+    selog(DEBUG1, "Initializing FSOE for index %s for %d levels", iName, nlevels);
+
+	/* Handle the initialization of the tree index. */
+	ostTable = initOSTreeProtocol(iName, iOid, fanouts, nlevels, &ost_ofileCreate, iBackend);
+	/* By default a single attribute is used to compare elements in the tree. */
+	ostIndex = InitOSTRelation(ostTable, iOid, attrDesc, attrDescLength);
+	if (ostBulks != NULL)
+		memcpy(ostIndex->bulks + 1, ostBulks, sizeof(BulkLoad) * nlevels);
+}
+
+/*
+ * Indexes can only be added to an initialized table. The heap block counters
+ * of a token based table ORAM are kept in the leaves of its first index, so
+ * such a table can not have other indexes.
+ */
+static bool
+canAddIndex(const char *iName)
+{
+    if (initParams == NULL)
+    {
+        selog(ERROR, "Index %s added before initSOE or initFSOE", iName);
+        return false;
+    }
+    if (nindexes == MAX_INDEXES)
+    {
+        selog(ERROR, "Table already has %d indexes", MAX_INDEXES);
+        return false;
+    }
+    if (iBackend == NULL)
+    {
+        selog(ERROR, "Index %s has no linked ORAM selected", iName);
+        return false;
+    }
+    if (oTable->backend->tokens)
+    {
+        selog(ERROR, "Token based table ORAM %s supports a single index",
+              oTable->backend->name);
+        return false;
+    }
+    /* the tuples of the delta are merged with inserts on a single index */
+    if (dTable != NULL)
+    {
+        selog(ERROR, "Index %s added to a table with a delta", iName);
+        return false;
+    }
+    return true;
+}
 
 void
 initSOE(const char *tName, const char *iName, int tNBlocks, int* fanouts,
@@ -73,43 +407,54 @@ initSOE(const char *tName, const char *iName, int tNBlocks, int* fanouts,
 {
 	/* VALGRIND_DO_LEAK_CHECK; */
 
-
+	if (!checkORAMBackends())
+		return;
 #ifdef SINGLE_ORAM
-    /**
-     *
-     *  Simulates a single ORAM for both the Heap and Index. If there was just
-     *  one oram for both files, then the size would be sum of both, and the
-     *  oram requests would depend on the tree height for the size.
-     *
-     *  If both ORAMS have the sum of both sizes then the three height of both
-     *  orams will be the same and the requests read/write the same number of
-     *  blocks. Thus, it has the same bandwidth overhead. Furthermore, this
-     *  approach does not require changing any other part of the code and is
-     *  suffient for the paper tests.
-     *
-     */
-    tNBlocks += iNBlocks;
-    iNBlocks += tNBlocks;
+	/* the table and the index share one ORAM */
+	if (tBackend != iBackend)
+	{
+		selog(ERROR, "SINGLE_ORAM requires the same ORAM for the table and the index");
+		return;
+	}
 #endif
+	if (!checkIndexHandler(indexOid, attrDescLength))
+		return;
+	recordInit(DYNAMIC, tName, iName, tNBlocks, fanouts, fanout_size, nlevels,
+	           iNBlocks, tOid, iOid, functionOid, indexOid, attrDesc,
+	           attrDescLength);
+
 	selog(DEBUG1, "Initializing SOE for relation %s with %d blocks and index %s with %d blocks", tName, tNBlocks, iName, iNBlocks);
-	stateTable = initORAMState(tName, tNBlocks, &heap_ofileCreate, true);
-	oTable = InitVRelation(stateTable, tOid, tNBlocks, &heap_pageInit);
 
+#ifdef SINGLE_ORAM
+	/*
+	 * The table and the index share the ORAM of the table file, with the
+	 * index blocks stored after the table blocks.
+	 */
+	stateTable = initORAMState(tName, tNBlocks + iNBlocks, &single_ofileCreate, tBackend, &tamgr, &tBulk);
+	oTable = InitVRelation(stateTable, tBackend, tOid, tNBlocks, &heap_pageInit);
+	oTable->bulk = tBulk;
+
+	stateIndex = stateTable;
+	iamgr = NULL;
+	oIndex = InitVRelation(stateIndex, tBackend, iOid, iNBlocks, &nbtree_pageInit);
+	oIndex->blockOffset = tNBlocks;
+	oIndex->sharedORAM = true;
+	oIndex->bulk = tBulk;
+#else
+	stateTable = initORAMState(tName, tNBlocks, &heap_ofileCreate, tBackend, &tamgr, &tBulk);
+	oTable = InitVRelation(stateTable, tBackend, tOid, tNBlocks, &heap_pageInit);
+	oTable->bulk = tBulk;
 
-	selog(DEBUG1, "going to init nbtree oblivious heap file");
-	stateIndex = initORAMState(iName, iNBlocks, &nbtree_ofileCreate, false);
-	oIndex = InitVRelation(stateIndex, iOid, iNBlocks, &nbtree_pageInit);
+	createIndex(iName, iNBlocks, iOid, indexOid);
+#endif
 
-	oIndex->foid = functionOid;
-	oIndex->indexOid = indexOid;
-	oIndex->tDesc->natts = 1;
-	oIndex->tDesc->attrs = (FormData_pg_attribute *) malloc(sizeof(struct FormData_pg_attribute));
-	memcpy(oIndex->tDesc->attrs, attrDesc, attrDescLength);
-	btree_fanout_setup(fanouts, fanout_size, nlevels);
-	//oIndex->tDesc->isnbtree = true;
+	setupIndex(fanouts, fanout_size, nlevels, functionOid, indexOid, attrDesc,
+	           attrDescLength);
 	
     scan = NULL;
     mode = DYNAMIC;
+    nindexes = 0;
+    registerIndex();
 }
 
 void
@@ -121,24 +466,81 @@ initFSOE(const char *tName, const char *iName, int tNBlocks, int *fanouts,
 
 	selog(DEBUG1, "Initializing FSOE for relation %s with %d blocks and BKCAP %d", tName, tNBlocks, BKCAP);
 
-    stateTable = initORAMState(tName, tNBlocks, &heap_ofileCreate, true);
-	oTable = InitVRelation(stateTable, tOid, tNBlocks, &heap_pageInit);
-
-    selog(DEBUG1, "Initializing FSOE for index %s for %d levels", iName, nlevels);
-
-	/* Handle the initialization of the tree index. */
-	ostTable = initOSTreeProtocol(iName, iOid, fanouts, nlevels, &ost_ofileCreate);
-
+    if (!checkORAMBackends())
+        return;
+    recordInit(OST, tName, iName, tNBlocks, fanouts, fanout_size, nlevels, 0,
+               tOid, iOid, 0, 0, attrDesc, attrDescLength);
+    stateTable = initORAMState(tName, tNBlocks, &heap_ofileCreate, tBackend, &tamgr, &tBulk);
+	oTable = InitVRelation(stateTable, tBackend, tOid, tNBlocks, &heap_pageInit);
+	oTable->bulk = tBulk;
 
-	/* By default a single attribute is used to compare elements in the tree. */
-	ostIndex = InitOSTRelation(ostTable, iOid, attrDesc, attrDescLength);
+	createFIndex(iName, fanouts, nlevels, iOid, attrDesc, attrDescLength);
 
 	scan = NULL;
     mode = OST;
+    nindexes = 0;
+    registerIndex();
+}
+
+/*
+ * Adds a nbtree or hash index on its own ORAM (index construction of
+ * selectORAM) to the table of initSOE or initFSOE, with the parameters of
+ * initSOE. Returns the identifier of the index given to addIndexBlockTo and
+ * getTupleIndex, or -1 if it can not be added.
+ */
+int
+addIndex(const char *iName, int *fanouts, unsigned int fanout_size,
+         unsigned int nlevels, int iNBlocks, unsigned int iOid,
+         unsigned int functionOid, unsigned int indexOid, char *attrDesc,
+         unsigned int attrDescLength)
+{
+	if (!canAddIndex(iName))
+		return -1;
+#ifdef SINGLE_ORAM
+	selog(ERROR, "SINGLE_ORAM stores a single index with the table");
+	return -1;
+#else
+	if (!checkIndexHandler(indexOid, attrDescLength))
+		return -1;
+	recordIndex(DYNAMIC, iName, fanouts, fanout_size, nlevels, iNBlocks, iOid,
+	            functionOid, indexOid, attrDesc, attrDescLength);
+	selog(DEBUG1, "Adding index %s with %d blocks", iName, iNBlocks);
+
+	createIndex(iName, iNBlocks, iOid, indexOid);
+	setupIndex(fanouts, fanout_size, nlevels, functionOid, indexOid, attrDesc,
+	           attrDescLength);
+	mode = DYNAMIC;
+	return registerIndex();
+#endif
+}
+
+/*
+ * Adds an OST index to the table of initSOE or initFSOE, with the parameters
+ * of initFSOE. Returns the identifier of the index or -1.
+ */
+int
+addFIndex(const char *iName, int *fanouts, unsigned int fanout_size,
+          unsigned int nlevels, unsigned int iOid, char *attrDesc,
+          unsigned int attrDescLength)
+{
+	if (!canAddIndex(iName))
+		return -1;
+
+	recordIndex(OST, iName, fanouts, fanout_size, nlevels, 0, iOid, 0, 0,
+	            attrDesc, attrDescLength);
+	createFIndex(iName, fanouts, nlevels, iOid, attrDesc, attrDescLength);
+	mode = OST;
+	return registerIndex();
 }
 
+/*
+ * Creates the ORAM name of nBlocks blocks and returns its access manager in
+ * amgrOut. If bulkOut is not NULL, the blocks of the ORAM can be bulk loaded
+ * and its bulk load is returned there; otherwise they are written online.
+ */
 ORAMState
-initORAMState(const char *name, int nBlocks, AMOFile * (*ofile) (), bool isHeap)
+initORAMState(const char *name, int nBlocks, AMOFile * (*ofile) (),
+              const ORAMBackend *backend, Amgr **amgrOut, BulkLoad *bulkOut)
 {
 
 
@@ -147,27 +549,29 @@ initORAMState(const char *name, int nBlocks, AMOFile * (*ofile) (), bool isHeap)
 	ORAMState	state;
 
 	amgr = (Amgr *) malloc(sizeof(Amgr));
-	amgr->am_stash = stashCreate();
-	amgr->am_pmap = pmapCreate();
-	amgr->am_ofile = ofile();
-
-	if (isHeap)
-	{
-		tamgr = amgr;
-	}
+	amgr->am_stash = backend->stashcreate();
+	if (backend->tokens)
+		amgr->am_pmap = backend->pmapcreate();
 	else
-	{
-		iamgr = amgr;
-	}
+		amgr->am_pmap = soe_pmapCreate(name, backend);
+	amgr->am_ofile = ofile();
+	*amgrOut = amgr;
+	if (bulkOut != NULL)
+		*bulkOut = bulk_create(name, 0, name, backend, amgr->am_ofile, BKCAP,
+							   nBlocks);
     
-    state = init_oram(name, nBlocks, BLCKSZ, BKCAP, amgr, NULL);
+    state = backend->init(name, nBlocks, BLCKSZ, BKCAP, amgr, NULL);
+#ifdef SEAL_STATE
+    snapshot_registerORAM(name, 0, nBlocks, state, backend);
+#endif
 	return state;
 }
 
 
 OSTreeState
 initOSTreeProtocol(const char *name, unsigned int iOid, int *fanouts, 
-                   unsigned int nlevels, AMOFile * (*ofile) ())
+                   unsigned int nlevels, AMOFile * (*ofile) (),
+                   const ORAMBackend *backend)
 {
 
 	int			i;
@@ -180,6 +584,7 @@ initOSTreeProtocol(const char *name, unsigned int iOid, int *fanouts,
 
 	ost->nlevels = nlevels;
 	ost->iOid = iOid;
+	ost->backend = backend;
 
 	namelen = strlen(name) + 1;
 	ost->iname = (char *) malloc(namelen);
@@ -190,6 +595,8 @@ initOSTreeProtocol(const char *name, unsigned int iOid, int *fanouts,
     if(nlevels > 0){
 
 	    ost->orams = (ORAMState *) malloc(sizeof(ORAMState) * nlevels);
+	    if (bulk_loading && !backend->tokens)
+		    ostBulks = (BulkLoad *) malloc(sizeof(BulkLoad) * nlevels);
 
 	    ost_status(ost);
 
@@ -199,55 +606,349 @@ initOSTreeProtocol(const char *name, unsigned int iOid, int *fanouts,
 		    //size_t		fileSize = BLCKSZ * fanouts[i];
             //selog(DEBUG1, "level %d fanout is %d",i, fanouts[i]);
 		    Amgr	   *amgr;
+		    char		pmapName[256];
 
 		    amgr = (Amgr *) malloc(sizeof(Amgr));
-		    amgr->am_stash = stashCreate();
-		    amgr->am_pmap = pmapCreate();
+		    amgr->am_stash = backend->stashcreate();
+		    if (backend->tokens)
+			    amgr->am_pmap = backend->pmapcreate();
+		    else
+		    {
+			    snprintf(pmapName, sizeof(pmapName), "%s_pmap%d", name, i);
+			    amgr->am_pmap = soe_pmapCreate(pmapName, backend);
+		    }
 		    amgr->am_ofile = ofile();
+		    if (ostBulks != NULL)
+			    ostBulks[i] = bulk_create(name, i + 1, pmapName, backend,
+			                              amgr->am_ofile, BKCAP, fanouts[i]);
 			
 		    //selog(DEBUG1, "Initiating ORAM on level %d with filesize %d", i, fileSize);
-		    ost->orams[i] = init_oram(name, fanouts[i], BLCKSZ, BKCAP, amgr, &i);
+		    ost->orams[i] = backend->init(name, fanouts[i], BLCKSZ, BKCAP, amgr, &i);
+#ifdef SEAL_STATE
+		    snapshot_registerORAM(name, i + 1, fanouts[i], ost->orams[i], backend);
+#endif
 	    }
     }
 
 	return ost;
 }
 
-void
+/*
+ * Inserts are only supported on a btree index whose levels all have a free
+ * block for a split, so that an insert is never rejected after accessing the
+ * ORAMs because a level is full (see soe_nbtinsert.c).
+ */
+static bool
+canInsert(void)
+{
+    int        *levelBlocks;
+    int         nlevels;
+    int         l;
+    BlockNumber levelSize;
+
+    if (nindexes != 1 || !useIndex(0))
+    {
+        selog(ERROR, "Tuples can only be inserted on a table with one index");
+        return false;
+    }
+    if (mode == DYNAMIC && oIndex->indexOid == F_HASHHANDLER)
+    {
+        selog(ERROR, "Tuples can not be inserted on a hash index");
+        return false;
+    }
+    if (oTable->backend->tokens ||
+        (mode == DYNAMIC ? oIndex->backend->tokens
+                         : ostIndex->osts->backend->tokens))
+    {
+        selog(ERROR, "Tuples can not be inserted on token based ORAMs");
+        return false;
+    }
+
+    levelBlocks = mode == DYNAMIC ? oIndex->levelBlocks : ostIndex->levelBlocks;
+    nlevels = mode == DYNAMIC ? (int) oIndex->nlevels : ostIndex->osts->nlevels;
+    for (l = 1; l <= nlevels; l++)
+    {
+        levelSize = mode == DYNAMIC ? _bt_levelsize_s(oIndex, l)
+                                    : (BlockNumber) ostIndex->osts->fanouts[l - 1];
+        if ((BlockNumber) levelBlocks[l] >= levelSize)
+        {
+            selog(ERROR, "Index has no free blocks on level %d", l);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Inserts a heap tuple and its key on the index. The key is in the format of
+ * the scan keys of getTuple, with every column of the index. An insert makes
+ * a fixed number of accesses to the heap and to the index ORAMs, padded with
+ * dummy accesses, whether it moves to a new heap block, splits index pages
+ * or is rejected by the heap or the index. Returns 0 if the tuple was
+ * inserted; a rejected insert leaves neither a heap tuple nor an index item.
+ */
+int
 insert(const char *heapTuple, unsigned int tupleSize, char *datum, 
        unsigned int datumSize)
 {
+	HeapTuple	hTuple;
+	IndexTuple	itup;
+	char	   *trimedDatum;
+	BlockNumber heapBlock;
+	bool		ok;
+
+	if (tupleSize > MAX_TUPLE_SIZE)
+	{
+		selog(ERROR, "Can't insert tuple of size %d", tupleSize);
+		return 1;
+	}
+	if (!canInsert())
+		return 1;
 
-    selog(ERROR, "tuple insertion is not supported");
-	/*HeapTuple	hTuple = (HeapTuple) malloc(sizeof(HeapTupleData));
-	int			trimmedSize = (datumSize + 1) * sizeof(char);
-	char	   *trimedDatum = (char *) malloc(trimmedSize);
+	/* reject a malformed key before the tuple is added to the heap */
+	itup = _bt_formkeytuple_s(mode == DYNAMIC ? oIndex->tDesc : ostIndex->tDesc,
+	                          datum, datumSize);
+	if (itup == NULL)
+	{
+		selog(ERROR, "Key of size %d does not match the index", datumSize);
+		return 1;
+	}
+	free(itup);
 
+	hTuple = (HeapTuple) malloc(sizeof(HeapTupleData));
+	trimedDatum = (char *) malloc(datumSize + 1);
 	memcpy(trimedDatum, datum, datumSize);
 	trimedDatum[datumSize] = '\0';
 
-	Item		tuple = (Item) heapTuple;
+	/* the heap is read twice, whether the tuple fits on the current block */
+	heapBlock = oTable->currentBlock;
+	heap_insert_s(oTable, (Item) heapTuple, (uint32) tupleSize, hTuple);
+	if (oTable->currentBlock == heapBlock)
+		ReadDummyBuffer(oTable, oTable->totalBlocks + 1);
+
+	/*
+	 * A full heap makes a dummy access in place of the write of the tuple
+	 * and the accesses of the index insert.
+	 */
+	ok = ItemPointerIsValid_s(&(hTuple->t_self));
+	if (!ok)
+		ReadDummyBuffer(oTable, oTable->totalBlocks + 1);
+	if (!ok && mode == DYNAMIC)
+		_bt_dummyinsert_s(oIndex);
+	else if (!ok)
+		_bt_dummyinsert_ost(ostIndex);
+	else if (mode == DYNAMIC)
+		ok = btinsert_s(oIndex, oTable, &(hTuple->t_self), trimedDatum,
+		                datumSize + 1);
+	else
+		ok = btinsert_ost(ostIndex, &(hTuple->t_self), trimedDatum,
+		                  datumSize + 1);
+
+	/*
+	 * A tuple the index rejected is deleted from the heap, so that no tuple
+	 * is left unreachable from the index. Otherwise the read and the write
+	 * of the delete are dummy accesses.
+	 */
+	if (!ok && ItemPointerIsValid_s(&(hTuple->t_self)))
+		heap_delete_s(oTable, &(hTuple->t_self));
+	else
+	{
+		ReadDummyBuffer(oTable, oTable->totalBlocks + 1);
+		ReadDummyBuffer(oTable, oTable->totalBlocks + 1);
+	}
 
-	if (tupleSize <= MAX_TUPLE_SIZE)
+	free(hTuple);
+	free(trimedDatum);
+
+	return ok ? 0 : 1;
+}
+
+/*
+ * Creates the delta of the table, a heap ORAM of dNBlocks blocks with the
+ * construction of the table, where appendTuple adds tuples without the
+ * padded splits of insert. The table must accept inserts, which mergeDelta
+ * uses to move the tuples of the delta to the table and its index. Returns
+ * 0 if the delta was created.
+ */
+int
+initDelta(const char *dName, int dNBlocks)
+{
+    ORAMState   state;
+
+    if (dTable != NULL || bulk_loading || dNBlocks <= 0)
+    {
+        selog(ERROR, "Can't create a delta of %d blocks for the table", dNBlocks);
+        return 1;
+    }
+    if (!canInsert())
+        return 1;
+
+    selog(DEBUG1, "Initializing delta %s with %d blocks", dName, dNBlocks);
+    state = initORAMState(dName, dNBlocks, &heap_ofileCreate, tBackend,
+                          &damgr, NULL);
+    dTable = InitVRelation(state, tBackend, oTable->rd_id, dNBlocks,
+                           &heap_pageInit);
+    return 0;
+}
+
+/*
+ * Creates the toast of the table, a heap ORAM of toastNBlocks blocks with
+ * the construction of the table, where insertHeap stores the tuples larger
+ * than MAX_TUPLE_SIZE in chunks of a block. Must be called before the
+ * tuples are loaded. Returns 0 if the toast was created.
+ */
+int
+initToast(const char *toastName, int toastNBlocks)
+{
+    ORAMState   state;
+
+    if (initParams == NULL || toastTable != NULL || toastNBlocks <= 0)
+    {
+        selog(ERROR, "Can't create a toast of %d blocks for the table",
+              toastNBlocks);
+        return 1;
+    }
+
+    selog(DEBUG1, "Initializing toast %s with %d blocks", toastName,
+          toastNBlocks);
+    state = initORAMState(toastName, toastNBlocks, &heap_ofileCreate, tBackend,
+                          &toastamgr, NULL);
+    toastTable = InitVRelation(state, tBackend, oTable->rd_id, toastNBlocks,
+                               &heap_pageInit);
+    return 0;
+}
+
+/*
+ * Copies the bytes [offset, offset + dataLen) of the last tuple stored out
+ * of line returned by getTuple to data, for the tuples larger than the
+ * tupleData of the request. The toast is read as many times as the number
+ * of chunks of the bytes requested, whether getTuple returned such a tuple
+ * or not. Returns the number of bytes copied, or -1 on an error.
+ */
+int
+readToast(unsigned int offset, char *data, unsigned int dataLen)
+{
+    if (toastTable == NULL)
+    {
+        selog(ERROR, "The table has no toast");
+        return -1;
+    }
+    return toast_fetch_s(toastTable, hasLastToast ? &lastToast : NULL, offset,
+                         data, dataLen);
+}
+
+/*
+ * Appends a heap tuple and its key, in the format of the keys of insert, to
+ * the delta. An append reads the delta twice and writes it once and does
+ * not access the table or its index. Returns 0 if the tuple was appended,
+ * or 1 if the delta is full and has to be merged.
+ */
+int
+appendTuple(const char *heapTuple, unsigned int tupleSize, char *datum,
+            unsigned int datumSize)
+{
+	IndexTuple	itup;
+
+	if (dTable == NULL)
 	{
-		heap_insert_s(oTable, tuple, (uint32) tupleSize, hTuple);
-		if (oIndex->indexOid == F_HASHHANDLER)
-		{
-					hashinsert_s(oIndex, &(hTuple->t_self), trimedDatum, datumSize + 1);
-		}
-		else if (oIndex->indexOid == F_BTHANDLER)
-		{
-			btinsert_s(oIndex, oTable, &(hTuple->t_self), trimedDatum, datumSize + 1);
-		}
+		selog(ERROR, "Table has no delta");
+		return 1;
+	}
+	if (tupleSize > MAX_TUPLE_SIZE)
+	{
+		selog(ERROR, "Can't append tuple of size %d", tupleSize);
+		return 1;
+	}
 
+	itup = _bt_formkeytuple_s(mode == DYNAMIC ? oIndex->tDesc : ostIndex->tDesc,
+	                          datum, datumSize);
+	if (itup == NULL)
+	{
+		selog(ERROR, "Key of size %d does not match the index", datumSize);
+		return 1;
 	}
+	free(itup);
+
+	return delta_insert_s(dTable, datum, datumSize, heapTuple, tupleSize) ? 0 : 1;
+}
+
+/*
+ * Makes the accesses of insert without inserting: the two reads and the
+ * write of the heap, the index insert and the delete of a rejected tuple.
+ */
+static void
+dummyInsert(void)
+{
+	ReadDummyBuffer(oTable, oTable->totalBlocks + 1);
+	ReadDummyBuffer(oTable, oTable->totalBlocks + 1);
+	ReadDummyBuffer(oTable, oTable->totalBlocks + 1);
+	if (mode == DYNAMIC)
+		_bt_dummyinsert_s(oIndex);
 	else
+		_bt_dummyinsert_ost(ostIndex);
+	ReadDummyBuffer(oTable, oTable->totalBlocks + 1);
+	ReadDummyBuffer(oTable, oTable->totalBlocks + 1);
+}
+
+/*
+ * Moves the tuples of the delta to the table and its index with insert, and
+ * empties the delta. Every block of the delta is read and written back, and
+ * each tuple makes the accesses of an insert. A delta tuple is marked dead
+ * only once insert has added it to both the heap and the index; an insert
+ * that is rejected, as when a level of the index is full, leaves nothing in
+ * the table, so the rejected tuple and the ones not yet merged stay on the
+ * delta and a later merge does not add them twice. The tuples after a
+ * rejected one make the accesses of an insert without inserting, so the
+ * merge makes the same accesses whether it fails or not. Returns 0 if the
+ * delta was emptied.
+ */
+int
+mergeDelta(void)
+{
+	BlockNumber blkno;
+	Buffer		buffer;
+	Page		page;
+	OffsetNumber offnum;
+	ItemId		lp;
+	DeltaTuple	dtup;
+	bool		ok = true;
+
+	if (dTable == NULL)
 	{
-		selog(WARNING, "Can't insert tuple of size %d", tupleSize);
+		selog(ERROR, "Table has no delta");
+		return 1;
 	}
 
-	free(hTuple);
-	free(trimedDatum);*/
+	for (blkno = 0; blkno < (BlockNumber) dTable->totalBlocks; blkno++)
+	{
+		buffer = ReadBuffer_s(dTable, blkno);
+		page = BufferGetPage_s(dTable, buffer);
+		for (offnum = FirstOffsetNumber;
+		     dTable->fsm[blkno] > 0 && offnum <= PageGetMaxOffsetNumber_s(page);
+		     offnum = OffsetNumberNext_s(offnum))
+		{
+			lp = PageGetItemId_s(page, offnum);
+			if (!ItemIdIsNormal_s(lp))
+				continue;
+			if (!ok)
+			{
+				dummyInsert();
+				continue;
+			}
+			dtup = (DeltaTuple) PageGetItem_s(page, lp);
+			ok = insert(DeltaTupleGetTuple(dtup), dtup->tupleSize,
+			            DeltaTupleGetKey(dtup), dtup->keySize) == 0;
+			/* a merged tuple is found on the table, not on the delta */
+			if (ok)
+				ItemIdMarkDead_s(lp);
+		}
+		MarkBufferDirty_s(dTable, buffer);
+		ReleaseBuffer_s(dTable, buffer);
+	}
+
+	if (ok)
+		delta_reset_s(dTable);
+	return ok ? 0 : 1;
 }
 
 
@@ -257,19 +958,40 @@ addIndexBlock(char *block, unsigned int blocksize, unsigned int offset,
               unsigned int level)
 {
  
-    if(mode == DYNAMIC){
-        btree_load_s(oIndex, block, level, offset);
+    if(mode == DYNAMIC && oIndex->indexOid == F_HASHHANDLER){
+        hash_load_s(oIndex, block, offset);
+    }else if(mode == DYNAMIC){
+        btree_load_s(oIndex, block, level, offset, oTable->backend->tokens);
     }else{
         insert_ost(ostIndex, block, level, offset);
     }
 }
 
+/*
+ * Loads a block of the index indexId (addIndex, addFIndex). The blocks of a
+ * hash index are loaded in block order, so the blocks of the other indexes
+ * must not be interleaved with them.
+ */
+void
+addIndexBlockTo(unsigned int indexId, char *block, unsigned int blocksize,
+                unsigned int offset, unsigned int level)
+{
+    if (useIndex(indexId))
+        addIndexBlock(block, blocksize, offset, level);
+}
+
 void
 addHeapBlock(char *block, unsigned int blockSize, unsigned int blkno)
 {
     //selog(DEBUG1, "Insert heap block %d out of %d", blkno, oTable->totalBlocks);
 
     heap_insert_block_s(oTable, block, blkno);
+
+    /* inserts continue after the last loaded block */
+    if(blkno >= oTable->currentBlock && blkno < oTable->totalBlocks - 1)
+        oTable->currentBlock = blkno;
+    oTable->fsm[blkno] = PageGetMaxOffsetNumber_s((Page) block);
+
 	if(blkno == 0){
        int *r_blkno; 
         r_blkno = (int*) PageGetSpecialPointer_s((Page) block);
@@ -278,10 +1000,128 @@ addHeapBlock(char *block, unsigned int blockSize, unsigned int blkno)
     }
 }
 
-int
-getTuple(unsigned int opmode, unsigned int opoid, const char *key, 
-         int scanKeySize, char *tuple, unsigned int tupleLen, 
-         char *tupleData, unsigned int tupleDataLen)
+/*
+ * Checks that the operator and the scan key of a request are supported by the
+ * index in use. Hash indexes only support equality.
+ */
+static bool
+checkScanKey(unsigned int opoid, const char *key, int scanKeySize)
+{
+    TupleDesc   keyDesc;
+    Oid         keyType;
+    bool        hashScan;
+    bool        keyOk;
+
+    if (mode == DYNAMIC && oIndex->loadFailed)
+    {
+        selog(ERROR, "Index was not fully loaded and can not be scanned");
+        return false;
+    }
+
+    keyDesc = mode == DYNAMIC ? oIndex->tDesc : ostIndex->tDesc;
+    keyType = keyDesc->attrs->atttypid;
+    hashScan = mode == DYNAMIC && oIndex->indexOid == F_HASHHANDLER;
+    /* the scan key of a composite index holds one or more leading columns */
+    if (keyDesc->natts > 1)
+        keyOk = _bt_keycolumns_s(keyDesc, key, scanKeySize) > 0;
+    else
+        keyOk = _bt_keysizeok_s(keyType, scanKeySize + 1);
+    if (_bt_strategy_s(opoid) == InvalidStrategy ||
+        (hashScan && _bt_strategy_s(opoid) != BTEqualStrategyNumber) ||
+        !keyOk)
+    {
+        selog(ERROR, "Unsupported operator %d or key size %d for keys of type %d",
+              opoid, scanKeySize, keyType);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Starts a scan of the index in use for the key trimedKey, which has the
+ * terminator after its scanKeySize bytes.
+ */
+static IndexScanDesc
+beginIndexScan(unsigned int opoid, char *trimedKey, int scanKeySize)
+{
+    IndexScanDesc iscan;
+
+    if(mode == DYNAMIC && oIndex->indexOid == F_HASHHANDLER){
+        /* the keys are hashed without the terminator */
+        iscan = hashbeginscan_s(oIndex, trimedKey, scanKeySize);
+    }else if(mode == DYNAMIC){
+        iscan = btbeginscan_s(oIndex, trimedKey, scanKeySize + 1);
+    }else{
+        iscan = btbeginscan_ost(ostIndex, trimedKey, scanKeySize + 1);
+    }
+    iscan->opoid = opoid;
+    iscan->strategy = _bt_strategy_s(opoid);
+    return iscan;
+}
+
+static bool
+indexGetTuple(IndexScanDesc iscan)
+{
+    if(mode == DYNAMIC && oIndex->indexOid == F_HASHHANDLER)
+        return hashgettuple_s(iscan);
+    return mode == DYNAMIC ? btgettuple_s(iscan) : btgettuple_ost(iscan);
+}
+
+static void
+endIndexScan(IndexScanDesc iscan)
+{
+    if(mode == DYNAMIC && oIndex->indexOid == F_HASHHANDLER)
+        hashendscan_s(iscan);
+    else
+        mode == DYNAMIC ? btendscan_s(iscan) : btendscan_ost(iscan);
+}
+
+/*
+ * Result of an index-only (OPMODE_INDEX_ONLY) or existence (OPMODE_EXISTS)
+ * query, which does not access the heap. An index-only query returns in
+ * tupleData the leaf index tuple of the match, with the key in the format of
+ * the loaded index blocks, and in tuple a heap tuple header with its length
+ * and the TID of the match.
+ */
+static int
+indexResult(IndexScanDesc scan, bool matchFound, unsigned int opmode,
+            TupleDesc keyDesc, char *tuple, char *tupleData,
+            unsigned int tupleDataLen)
+{
+    HeapTupleData header;
+    Size        itupSize;
+
+    if(!matchFound)
+        return 1;
+    if(opmode == OPMODE_EXISTS)
+        return 0;
+
+    itupSize = IndexTupleSize_s(scan->xs_itup);
+    if(itupSize > tupleDataLen){
+        selog(ERROR, "Index tuple len does not fit %d < %d", tupleDataLen,
+              itupSize);
+        return 1;
+    }
+    memcpy(tupleData, scan->xs_itup, itupSize);
+    if(keyDesc->natts == 1 && _bt_keynormalizable_s(keyDesc->attrs->atttypid))
+        _bt_denormalizetuple_s(keyDesc->attrs->atttypid, (IndexTuple) tupleData);
+
+    memset(&header, 0, sizeof(HeapTupleData));
+    header.t_len = itupSize;
+    header.t_self = scan->xs_ctup.t_self;
+    memcpy(tuple, (char *) &header, sizeof(HeapTupleData));
+    return 0;
+}
+
+/*
+ * getTuple, which also sets found to whether the key has a match. With
+ * DUMMYS, a search without a match returns 0 with the tuple of the dummy
+ * access, so found tells it apart from a match.
+ */
+static int
+getTupleMatch(unsigned int opmode, unsigned int opoid, const char *key,
+              int scanKeySize, char *tuple, unsigned int tupleLen,
+              char *tupleData, unsigned int tupleDataLen, bool *found)
 {
 
 
@@ -291,8 +1131,21 @@ getTuple(unsigned int opmode, unsigned int opoid, const char *key,
 	//int			hasNext;
 	char	   *trimedKey;
     bool        matchFound  = false;
+    bool        deltaFound  = false;
+    HeapTupleData deltaTuple;
+    IndexTuple  deltaKey = NULL;
+    bool        hashScan;
+    TupleDesc   keyDesc;
+    int         result;
+
+    /* readToast only streams the match of this request */
+    hasLastToast = false;
+    *found = false;
 
     heapTuple = (HeapTuple) malloc(sizeof(HeapTupleData));
+    heapTuple->t_data = NULL;
+    heapTuple->t_len = 0;
+    deltaTuple.t_data = NULL;
 	//hasNext = 0;
     
      /* FOREST_ORAM MODE: Table strings in the index do not have
@@ -304,40 +1157,83 @@ getTuple(unsigned int opmode, unsigned int opoid, const char *key,
     
 
     //Stop everything. Resources have to be freed correctly.
-    if(strcmp(key, "HALT")==0){
+    if(strcmp(trimedKey, "HALT")==0){
         selog(DEBUG1, "Received Halt signal from client");
+        free(heapTuple);
         free(trimedKey);
         return 1;
     }
 
-    if(scan == NULL){
-        //selog(DEBUG1, "Starting Scan");
+    keyDesc = mode == DYNAMIC ? oIndex->tDesc : ostIndex->tDesc;
+    hashScan = mode == DYNAMIC && oIndex->indexOid == F_HASHHANDLER;
+    if (!checkScanKey(opoid, key, scanKeySize))
+    {
+        free(heapTuple);
+        free(trimedKey);
+        return 1;
+    }
+
+    /* hash indexes only hold the hash codes of the keys */
+    if (opmode > OPMODE_EXISTS || (hashScan && opmode == OPMODE_INDEX_ONLY))
+    {
+        selog(ERROR, "Unsupported query mode %d", opmode);
+        free(heapTuple);
+        free(trimedKey);
+        return 1;
+    }
+
+    if(scan == NULL){
+        //selog(DEBUG1, "Starting Scan");
         /*Old request is complete. Start new input request*/
-        if(mode == DYNAMIC){
-            scan = btbeginscan_s(oIndex, trimedKey, scanKeySize + 1);
-        }else{
-		    scan = btbeginscan_ost(ostIndex, trimedKey, scanKeySize + 1);
-        }
-        scan->opoid = opoid;
+        scan = beginIndexScan(opoid, trimedKey, scanKeySize);
+        scan->xs_want_itup = opmode == OPMODE_INDEX_ONLY;
+        scan->xs_heapfetch = opmode == OPMODE_TUPLE;
     }
     //selog(DEBUG1, "Mode is %d", mode);
-    matchFound = mode == DYNAMIC? btgettuple_s(scan): btgettuple_ost(scan);
+    matchFound = indexGetTuple(scan);
+    /* the tuples appended to the delta are found after those of the index */
+    if (dTable != NULL)
+        deltaFound = delta_search_s(dTable, scan->keyData, scan->strategy,
+                                    keyDesc, mode == DYNAMIC ? oIndex->keycmp
+                                                             : ostIndex->keycmp,
+                                    &deltaTuple,
+                                    opmode == OPMODE_INDEX_ONLY ? &deltaKey : NULL);
+    *found = matchFound || deltaFound;
     #ifdef STASH_COUNT
         counter +=1;
         if(counter%1000==0){
-            logStashes(oTable->oram);
+            oTable->backend->logstashes(oTable->oram);
         }
     #endif
+
+    if(opmode != OPMODE_TUPLE){
+        if(!matchFound && deltaKey != NULL){
+            /* the key in the format of the leaf tuples of the index */
+            if(keyDesc->natts == 1 && _bt_keynormalizable_s(keyDesc->attrs->atttypid))
+                _bt_normalizetuple_s(keyDesc->attrs->atttypid, deltaKey);
+            scan->xs_itup = deltaKey;
+            ItemPointerSetInvalid_s(&scan->xs_ctup.t_self);
+        }
+        result = indexResult(scan, matchFound || deltaFound, opmode, keyDesc,
+                             tuple, tupleData, tupleDataLen);
+        endIndexScan(scan);
+        scan = NULL;
+        free(deltaKey);
+        free(deltaTuple.t_data);
+        free(trimedKey);
+        free(heapTuple);
+        return result;
+    }
+
     if(matchFound){
         //Normal case
         if(ItemPointerIsValid_s(&scan->xs_ctup.t_self)){
              tid = scan->xs_ctup.t_self;
-             #ifdef TPATHORAM
-             oTable->heapBlockCounter = scan->indexRelation->heapBlockCounter;
-             #endif
-             #ifdef TFORESTORAM
-             oTable->heapBlockCounter = scan->ost->heapBlockCounter;
-             #endif
+             if(oTable->backend->tokens){
+                 oTable->heapBlockCounter = mode == DYNAMIC ?
+                     scan->indexRelation->heapBlockCounter :
+                     scan->ost->heapBlockCounter;
+             }
              heap_gettuple_s(oTable, &tid, heapTuple);
 
         }
@@ -353,27 +1249,575 @@ getTuple(unsigned int opmode, unsigned int opoid, const char *key,
             free(dtid);
             oTable->rCounter +=1;
         #else
+        if(!deltaFound){
+            endIndexScan(scan);
+            scan = NULL;
             free(heapTuple);
             free(trimedKey);
             return 1;
+        }
         #endif
     }
-    mode == DYNAMIC ? btendscan_s(scan) : btendscan_ost(scan);
+    endIndexScan(scan);
     scan = NULL;
 
-    if (heapTuple->t_len > MAX_TUPLE_SIZE){
-		    selog(ERROR, "Tuple len does not match %d != %d", tupleDataLen, heapTuple->t_len);
+    /* the index has no live match, return the tuple of the delta */
+    if (deltaFound && (!matchFound || heapTuple->t_data == NULL)){
+        free(heapTuple->t_data);
+        *heapTuple = deltaTuple;
+        deltaTuple.t_data = NULL;
+    }
+    free(deltaTuple.t_data);
+
+    /*
+     * A tuple stored out of line is copied from its chunks to tupleData. The
+     * toast is read as many times as the chunks tupleData can hold, whether
+     * the match is stored out of line or not.
+     */
+    if (toastTable != NULL){
+        hasLastToast = heapTuple->t_data != NULL && IsToastPointer_s(heapTuple);
+        if (hasLastToast)
+            lastToast = *ToastTupleGetPointer_s(heapTuple);
+        if (toast_fetch_s(toastTable, hasLastToast ? &lastToast : NULL, 0,
+                          tupleData, tupleDataLen) < 0){
+            /* the item on the table is not the tuple */
+            hasLastToast = false;
+            free(heapTuple->t_data);
+            free(heapTuple);
+            free(trimedKey);
+            return 1;
+        }
+        if (hasLastToast){
+            /* the host reads the rest of a larger tuple with readToast */
+            free(heapTuple->t_data);
+            heapTuple->t_data = NULL;
+            heapTuple->t_len = lastToast.rawSize;
+            memcpy(tuple, (char *) heapTuple, sizeof(HeapTupleData));
+            free(trimedKey);
+            free(heapTuple);
+            return 0;
+        }
+    }
+
+    /* the tuple was deleted (deleteTuple) */
+    if (heapTuple->t_data == NULL){
+        free(heapTuple);
+        free(trimedKey);
+        return 1;
+    }
+
+    /* the tuple must fit in tupleData */
+    if (heapTuple->t_len > MAX_TUPLE_SIZE || heapTuple->t_len > tupleDataLen){
+		    selog(ERROR, "Tuple len does not fit %d < %d", tupleDataLen, heapTuple->t_len);
+		    result = 1;
 	}else{
 		memcpy(tuple, (char *) heapTuple, sizeof(HeapTupleData));
 		memcpy(tupleData, (char *) (heapTuple->t_data), (heapTuple->t_len));
+		result = 0;
 	}
     
     free(trimedKey);
     free(heapTuple->t_data);
     free(heapTuple);
+    return result;
+}
+
+int
+getTuple(unsigned int opmode, unsigned int opoid, const char *key,
+         int scanKeySize, char *tuple, unsigned int tupleLen,
+         char *tupleData, unsigned int tupleDataLen)
+{
+    bool        found;
+
+    return getTupleMatch(opmode, opoid, key, scanKeySize, tuple, tupleLen,
+                         tupleData, tupleDataLen, &found);
+}
+
+/*
+ * getTuple over the index indexId of the table (0 is the index of initSOE
+ * or initFSOE). The index stays selected for the next getTuple requests.
+ */
+int
+getTupleIndex(unsigned int indexId, unsigned int opmode, unsigned int opoid,
+              const char *key, int scanKeySize, char *tuple,
+              unsigned int tupleLen, char *tupleData,
+              unsigned int tupleDataLen)
+{
+    if (!useIndex(indexId))
+        return 1;
+    return getTuple(opmode, opoid, key, scanKeySize, tuple, tupleLen,
+                    tupleData, tupleDataLen);
+}
+
+/*
+ * Sets the column descriptors of the table, an array of
+ * FormData_pg_attribute in the order of the columns, used to evaluate the
+ * projections and predicates of getTupleProject. Returns 0 on success.
+ */
+int
+setTableDesc(char *attrDesc, unsigned int attrDescLength)
+{
+    TupleDesc   desc;
+    int         i;
+
+    if (initParams == NULL)
+    {
+        selog(ERROR, "SOE is not initialized");
+        return 1;
+    }
+    if (attrDescLength == 0 ||
+        attrDescLength % sizeof(FormData_pg_attribute) != 0)
+    {
+        selog(ERROR, "Malformed column descriptors of %d bytes", attrDescLength);
+        return 1;
+    }
+
+    desc = oTable->tDesc;
+    free(desc->attrs);
+    desc->natts = attrDescLength / sizeof(FormData_pg_attribute);
+    desc->attrs = (FormData_pg_attribute *) malloc(attrDescLength);
+    memcpy(desc->attrs, attrDesc, attrDescLength);
+    /* the offsets are cached by heap_deform_tuple_s */
+    for (i = 0; i < desc->natts; i++)
+        desc->attrs[i].attcacheoff = -1;
     return 0;
 }
 
+/*
+ * getTuple with a projection and predicates on the columns of the table
+ * (soe_pushdown.h) evaluated in the enclave. The match of the key is
+ * searched as by getTuple in OPMODE_TUPLE and, if it satisfies every
+ * predicate, its projected columns are copied to tupleData. Returns 1 when
+ * there is no match, the match does not satisfy the predicates or on an
+ * error, so the host does not learn which one happened.
+ */
+int
+getTupleProject(unsigned int opoid, const char *key, int scanKeySize,
+                const char *query, unsigned int queryLen, char *tupleData,
+                unsigned int tupleDataLen)
+{
+    Pushdown    pd;
+    HeapTupleData heapTuple;
+    char       *data;
+    int         result;
+    bool        found;
+
+    if (initParams == NULL || oTable->tDesc->attrs == NULL)
+    {
+        selog(ERROR, "Table has no column descriptors (setTableDesc)");
+        return 1;
+    }
+
+    pd = pushdown_parse_s(oTable->tDesc, query, queryLen);
+    if (pd == NULL)
+        return 1;
+
+    data = (char *) malloc(MAX_TUPLE_SIZE);
+    result = getTupleMatch(OPMODE_TUPLE, opoid, key, scanKeySize,
+                           (char *) &heapTuple, sizeof(HeapTupleData), data,
+                           MAX_TUPLE_SIZE, &found);
+    /* the columns of a tuple stored out of line are not deformed */
+    if (result == 0 && heapTuple.t_len > MAX_TUPLE_SIZE)
+    {
+        selog(ERROR, "Can't project a tuple of size %d", heapTuple.t_len);
+        result = 1;
+    }
+    if (result == 0)
+    {
+        /*
+         * The tuple of the dummy access of a search without a match (DUMMYS)
+         * goes through the same predicates, but is not a match.
+         */
+        heapTuple.t_data = (HeapTupleHeader) data;
+        result = pushdown_apply_s(pd, oTable->tDesc, &heapTuple, tupleData,
+                                  tupleDataLen) > 0 && found ? 0 : 1;
+        if (!found)
+            memset(tupleData, 0, tupleDataLen);
+    }
+
+    free(data);
+    pushdown_free_s(pd);
+    return result;
+}
+
+/* Can the sum, minimum and maximum of a column of type atttypid be taken? */
+static bool
+aggregateTypeOk(Oid atttypid)
+{
+    return atttypid == INT4OID || atttypid == DATEOID ||
+        atttypid == INT8OID || atttypid == TIMESTAMPOID ||
+        atttypid == TIMESTAMPTZOID || atttypid == FLOAT8OID;
+}
+
+/* Adds the value of a column of type atttypid to an aggregate. */
+static void
+aggregateValue(SOEAggregate *agg, unsigned int aggop, Oid atttypid,
+               const char *value)
+{
+    int32       i4;
+    int64       i8;
+    float8      f8;
+    bool        first = agg->count == 0;
+
+    switch (atttypid)
+    {
+        case INT4OID:
+        case DATEOID:
+            memcpy(&i4, value, sizeof(int32));
+            i8 = i4;
+            break;
+        case INT8OID:
+        case TIMESTAMPOID:
+        case TIMESTAMPTZOID:
+            memcpy(&i8, value, sizeof(int64));
+            break;
+        case FLOAT8OID:
+            memcpy(&f8, value, sizeof(float8));
+            if (aggop == AGG_SUM)
+                agg->floatValue += f8;
+            else if (first || (aggop == AGG_MIN && f8 < agg->floatValue) ||
+                     (aggop == AGG_MAX && f8 > agg->floatValue))
+                agg->floatValue = f8;
+            agg->count++;
+            return;
+        default:
+            return;
+    }
+
+    if (aggop == AGG_SUM)
+        agg->intValue += i8;
+    else if (first || (aggop == AGG_MIN && i8 < agg->intValue) ||
+             (aggop == AGG_MAX && i8 > agg->intValue))
+        agg->intValue = i8;
+    agg->count++;
+}
+
+/*
+ * Aggregates (ops.h) the column attnum (from 1) of the tuples of a key range
+ * in the enclave and returns a single SOEAggregate. The range starts at key
+ * with the operator opoid (=, >= or >) and, if hiKeySize is not 0, ends
+ * before the first key that does not satisfy hiOpoid (< or <=) with hiKey.
+ *
+ * The scan is padded to maxRange steps: each step reads the index, as
+ * _bt_next does, and a heap block, with dummy accesses once the range is
+ * over, so the accesses only depend on maxRange. The column descriptors of
+ * the table must have been set with setTableDesc. Returns 0 on success.
+ */
+int
+aggregateTuples(unsigned int aggop, int attnum, unsigned int opoid,
+                const char *key, int scanKeySize, unsigned int hiOpoid,
+                const char *hiKey, int hiKeySize, unsigned int maxRange,
+                char *result, unsigned int resultSize)
+{
+    SOEAggregate agg;
+    IndexScanDesc iscan;
+    HeapTupleData heapTuple;
+    ItemPointerData tid;
+    TupleDesc   desc = oTable->tDesc;
+    char      **values;
+    int32      *lens;
+    bool       *isnull;
+    char       *trimedKey;
+    StrategyNumber strategy = _bt_strategy_s(opoid);
+    StrategyNumber histrategy = _bt_strategy_s(hiOpoid);
+    bool        found = false;
+    bool        more = false;
+    bool        ok = true;
+    unsigned int i;
+
+    if (initParams == NULL || desc->attrs == NULL)
+    {
+        selog(ERROR, "Table has no column descriptors (setTableDesc)");
+        return 1;
+    }
+    if (resultSize != sizeof(SOEAggregate) || aggop > AGG_MAX ||
+        (aggop != AGG_COUNT && (attnum < 1 || attnum > desc->natts ||
+         !aggregateTypeOk(TupleDescAttr_s(desc, attnum - 1)->atttypid))))
+    {
+        selog(ERROR, "Unsupported aggregate %d of column %d", aggop, attnum);
+        return 1;
+    }
+    /* the heap is accessed without the counters of the index leaves */
+    if ((mode == DYNAMIC && oIndex->indexOid == F_HASHHANDLER) ||
+        oTable->backend->tokens || dTable != NULL)
+    {
+        selog(ERROR, "Range aggregates need a btree index without a delta");
+        return 1;
+    }
+    /* the tuples stored out of line can not be deformed */
+    if (toastTable != NULL)
+    {
+        selog(ERROR, "Range aggregates are not supported on a table with a toast");
+        return 1;
+    }
+    if (!checkScanKey(opoid, key, scanKeySize) ||
+        (hiKeySize > 0 && !checkScanKey(hiOpoid, hiKey, hiKeySize)))
+        return 1;
+    if ((strategy != BTEqualStrategyNumber &&
+         strategy != BTGreaterEqualStrategyNumber &&
+         strategy != BTGreaterStrategyNumber) ||
+        (hiKeySize > 0 && histrategy != BTLessStrategyNumber &&
+         histrategy != BTLessEqualStrategyNumber))
+    {
+        selog(ERROR, "Unsupported range operators %d and %d", opoid, hiOpoid);
+        return 1;
+    }
+
+    memset(&agg, 0, sizeof(SOEAggregate));
+    values = (char **) malloc(sizeof(char *) * desc->natts);
+    lens = (int32 *) malloc(sizeof(int32) * desc->natts);
+    isnull = (bool *) malloc(sizeof(bool) * desc->natts);
+
+    trimedKey = (char *) malloc(scanKeySize + 1);
+    memcpy(trimedKey, key, scanKeySize);
+    trimedKey[scanKeySize] = '\0';
+    iscan = beginIndexScan(opoid, trimedKey, scanKeySize);
+    free(trimedKey);
+    if (hiKeySize > 0)
+    {
+        trimedKey = (char *) malloc(hiKeySize + 1);
+        memcpy(trimedKey, hiKey, hiKeySize);
+        trimedKey[hiKeySize] = '\0';
+        _bt_sethikey_s(iscan, mode == DYNAMIC ? oIndex->tDesc : ostIndex->tDesc,
+                       trimedKey, hiKeySize + 1, histrategy);
+        free(trimedKey);
+    }
+
+    for (i = 0; i < maxRange; i++)
+    {
+        if (i == 0)
+        {
+            found = indexGetTuple(iscan);
+#ifdef DUMMYS
+            /* _bt_first does not step over a first leaf without matches */
+            more = true;
+#else
+            more = found;
+#endif
+        }
+        else if (more)
+            found = more = mode == DYNAMIC ? _bt_next_s(iscan)
+                                           : _bt_next_ost(iscan);
+        else
+        {
+            found = false;
+            if (mode == DYNAMIC)
+                bt_dummy_search_s(oIndex, oIndex->tHeight);
+            else
+                bt_dummy_search_ost(ostIndex, ostIndex->osts->nlevels);
+        }
+
+        heapTuple.t_data = NULL;
+        if (found)
+        {
+            tid = iscan->xs_ctup.t_self;
+            heap_gettuple_s(oTable, &tid, &heapTuple);
+        }
+        else
+        {
+#ifdef DUMMYS
+            oTable->heapBlockCounter = oTable->rCounter;
+            ItemPointerSet_s(&tid, oTable->totalBlocks - 1, 1);
+            heap_gettuple_s(oTable, &tid, &heapTuple);
+            oTable->rCounter += 1;
+            free(heapTuple.t_data);
+            heapTuple.t_data = NULL;
+#else
+            break;
+#endif
+        }
+
+        /* the tuples deleted by deleteTuple have no data */
+        if (heapTuple.t_data == NULL)
+            continue;
+        if (aggop == AGG_COUNT)
+            agg.count++;
+        else if (!heap_deform_tuple_s(&heapTuple, desc, values, lens, isnull))
+            ok = false;
+        else if (!isnull[attnum - 1])
+            aggregateValue(&agg, aggop,
+                           TupleDescAttr_s(desc, attnum - 1)->atttypid,
+                           values[attnum - 1]);
+        free(heapTuple.t_data);
+    }
+    agg.more = found;
+    endIndexScan(iscan);
+
+    free(values);
+    free(lens);
+    free(isnull);
+
+    if (!ok)
+    {
+        selog(ERROR, "Could not aggregate column %d of the range", attnum);
+        return 1;
+    }
+    memcpy(result, &agg, sizeof(SOEAggregate));
+    return 0;
+}
+
+/*
+ * Maps the columns of the key of the index in use to the columns of the
+ * table, matched by name and type, into keycols (zero based). Returns the
+ * number of key columns, or -1 if a key column is not a column of the table.
+ */
+static int
+keyColumns(int *keycols)
+{
+    TupleDesc   keyDesc = mode == DYNAMIC ? oIndex->tDesc : ostIndex->tDesc;
+    TupleDesc   desc = oTable->tDesc;
+    Form_pg_attribute keyAtt;
+    int         i,
+                j;
+
+    if (keyDesc->natts > INDEX_MAX_KEYS)
+    {
+        selog(ERROR, "Index has more than %d key columns", INDEX_MAX_KEYS);
+        return -1;
+    }
+    for (i = 0; i < keyDesc->natts; i++)
+    {
+        keyAtt = TupleDescAttr_s(keyDesc, i);
+        for (j = 0; j < desc->natts; j++)
+            if (TupleDescAttr_s(desc, j)->atttypid == keyAtt->atttypid &&
+                strncmp(NameStr_s(TupleDescAttr_s(desc, j)->attname),
+                        NameStr_s(keyAtt->attname), NAMEDATALEN) == 0)
+                break;
+        if (j == desc->natts)
+        {
+            selog(ERROR, "Key column %d of the index is not a column of the table",
+                  i + 1);
+            return -1;
+        }
+        keycols[i] = j;
+    }
+    return keyDesc->natts;
+}
+
+/*
+ * Updates or deletes the first tuple that matches the key, as found by
+ * getTuple on the index in use. The heap block of the match is read and
+ * written back, and a delete also writes back the leaf of the match with its
+ * item marked dead. Without a match the same number of dummy accesses is
+ * made, so the ORAMs do not tell whether a tuple was changed. An equality
+ * key must be equal to the whole key of the match, and not only a prefix of
+ * a string key, or the change is made as without a match.
+ *
+ * Only the index in use is maintained, so tables with more than one index
+ * are rejected, and an update must keep the key of the tuple, which is
+ * checked on the columns of the table set by setTableDesc.
+ */
+static int
+changeTuple(bool delete, unsigned int opoid, const char *key,
+            int scanKeySize, const char *tuple, unsigned int tupleSize)
+{
+    IndexScanDesc iscan;
+    ItemPointerData tid;
+    char       *trimedKey;
+    int         keycols[INDEX_MAX_KEYS];
+    int         nkeycols = 0;
+    bool        matchFound;
+    bool        hashScan;
+    bool        ok = false;
+
+    if (!checkScanKey(opoid, key, scanKeySize))
+        return 1;
+
+    if (nindexes > 1)
+    {
+        selog(ERROR, "Tuples can only be changed on a table with one index");
+        return 1;
+    }
+    if (!delete)
+    {
+        if (oTable->tDesc->attrs == NULL)
+        {
+            selog(ERROR, "Table has no column descriptors (setTableDesc)");
+            return 1;
+        }
+        nkeycols = keyColumns(keycols);
+        if (nkeycols < 0)
+            return 1;
+    }
+
+    hashScan = mode == DYNAMIC && oIndex->indexOid == F_HASHHANDLER;
+    if (delete && hashScan)
+    {
+        selog(ERROR, "Tuples can not be deleted on a hash index");
+        return 1;
+    }
+    if (oTable->backend->tokens ||
+        (mode == DYNAMIC ? oIndex->backend->tokens
+                         : ostIndex->osts->backend->tokens))
+    {
+        selog(ERROR, "Tuples can not be changed on token based ORAMs");
+        return 1;
+    }
+
+    trimedKey = (char *) malloc(scanKeySize + 1);
+    memcpy(trimedKey, key, scanKeySize);
+    trimedKey[scanKeySize] = '\0';
+
+    iscan = beginIndexScan(opoid, trimedKey, scanKeySize);
+    iscan->xs_heapfetch = true;
+    iscan->xs_kill = delete;
+    iscan->xs_exact = iscan->strategy == BTEqualStrategyNumber;
+    matchFound = indexGetTuple(iscan);
+    tid = iscan->xs_ctup.t_self;
+    if (delete)
+        matchFound = matchFound && iscan->xs_killed;
+    endIndexScan(iscan);
+    free(trimedKey);
+
+    if (matchFound && ItemPointerIsValid_s(&tid))
+    {
+        if (delete)
+            ok = heap_delete_s(oTable, &tid);
+        else
+            ok = heap_update_s(oTable, &tid, (Item) tuple, (Size) tupleSize,
+                               oTable->tDesc, keycols, nkeycols);
+    }
+    else
+    {
+        /* the reads and the write of the heap block */
+        ReadDummyBuffer(oTable, oTable->totalBlocks + 1);
+        ReadDummyBuffer(oTable, oTable->totalBlocks + 1);
+    }
+
+    return ok ? 0 : 1;
+}
+
+/*
+ * Replaces in place the first tuple that matches the key. The table must
+ * have a single index and its column descriptors (setTableDesc), and the new
+ * tuple must keep the key columns of the old one, as the index is not
+ * updated, and fit on the heap block of the old tuple. Returns 0 if the tuple
+ * was updated.
+ */
+int
+updateTuple(unsigned int opoid, const char *key, int scanKeySize,
+            const char *tuple, unsigned int tupleSize)
+{
+    if (tupleSize > MAX_TUPLE_SIZE)
+    {
+        selog(ERROR, "Can't update tuple to size %d", tupleSize);
+        return 1;
+    }
+    return changeTuple(false, opoid, key, scanKeySize, tuple, tupleSize);
+}
+
+/*
+ * Deletes the first tuple that matches the key. The heap tuple and its item
+ * on the index are marked dead. The table must have a single index, as the
+ * items of other indexes would not be killed. A key with duplicates kept on
+ * a posting list can not be deleted. Returns 0 if the tuple was deleted.
+ */
+int
+deleteTuple(unsigned int opoid, const char *key, int scanKeySize)
+{
+    return changeTuple(true, opoid, key, scanKeySize, NULL, 0);
+}
+
 
 void
 insertHeap(const char *heapTuple, unsigned int tupleSize)
@@ -383,12 +1827,24 @@ insertHeap(const char *heapTuple, unsigned int tupleSize)
 
 
 	Item		tuple = (Item) heapTuple;
+	ToastPointerData ptr;
+	HeapTupleHeader toastTuple;
 
 	if (tupleSize <= MAX_TUPLE_SIZE)
 	{
 		heap_insert_s(oTable, tuple, (uint32) tupleSize, hTuple);
 
 	}
+	else if (toastTable != NULL)
+	{
+		/* the table holds a pointer to the chunks of the tuple */
+		if (toast_insert_s(toastTable, heapTuple, tupleSize, &ptr))
+		{
+			toastTuple = toast_formtuple_s(&ptr);
+			heap_insert_s(oTable, (Item) toastTuple, ToastTupleSize, hTuple);
+			free(toastTuple);
+		}
+	}
 	else
 	{
 		selog(WARNING, "Can't insert tuple of size %d", tupleSize);
@@ -399,25 +1855,575 @@ insertHeap(const char *heapTuple, unsigned int tupleSize)
 }
 
 
+/*
+ * The relations initialized after beginBulkLoad keep the loaded blocks in the
+ * enclave until endBulkLoad places them on the ORAM files (soe_bulkload.c).
+ * Must be called before initSOE/initFSOE. Token based ORAMs are still loaded
+ * block by block.
+ */
+void
+beginBulkLoad(void)
+{
+    bulk_loading = true;
+}
+
+/*
+ * Places the blocks loaded since beginBulkLoad. Returns 1 if an index
+ * rejected one of its loaded blocks.
+ */
+int
+endBulkLoad(void)
+{
+    SOEIndex   *index;
+    int i;
+    int l;
+
+    bulk_loading = false;
+
+    if (tBulk != NULL)
+    {
+        bulk_finish(tBulk, oTable->oram);
+        oTable->bulk = NULL;
+        if (nindexes > 0 && indexes[0].mode == DYNAMIC &&
+            indexes[0].vrel->bulk == tBulk)
+            indexes[0].vrel->bulk = NULL;
+        tBulk = NULL;
+    }
+
+    for (i = 0; i < nindexes; i++)
+    {
+        index = &indexes[i];
+        if (index->bulk != NULL)
+        {
+            bulk_finish(index->bulk, index->vrel->oram);
+            index->vrel->bulk = NULL;
+            index->bulk = NULL;
+        }
+
+        if (index->ostBulks != NULL)
+        {
+            for (l = 0; l < index->ost->nlevels; l++)
+            {
+                if (index->ostBulks[l] != NULL)
+                    bulk_finish(index->ostBulks[l], index->ost->orams[l]);
+                index->ostrel->bulks[l + 1] = NULL;
+            }
+            free(index->ostBulks);
+            index->ostBulks = NULL;
+        }
+    }
+
+    for (i = 0; i < nindexes; i++)
+    {
+        if (indexes[i].mode == DYNAMIC && indexes[i].vrel->loadFailed)
+        {
+            selog(ERROR, "Index %d failed to load", i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Evicts up to maxWrites of the ORAM writes queued by the previous requests
+ * (DEFERRED_WB), starting with the indexes. Meant to be called by the host
+ * while the enclave is idle. Returns the number of writes still queued.
+ */
+int
+flushWrites(unsigned int maxWrites)
+{
+    int budget = maxWrites;
+    int queued;
+    int remaining;
+    int left = 0;
+    int i;
+
+    for (i = 0; i < nindexes; i++)
+    {
+        if (indexes[i].mode == DYNAMIC)
+        {
+            queued = list_size(indexes[i].vrel->pending);
+            remaining = FlushWrites_s(indexes[i].vrel, budget);
+        }
+        else
+        {
+            queued = list_size(indexes[i].ostrel->pending);
+            remaining = FlushWrites_ost(indexes[i].ostrel, budget);
+        }
+        budget -= queued - remaining;
+        left += remaining;
+    }
+
+    return left + FlushWrites_s(oTable, budget);
+}
+
+/*
+ * Registers the untrusted buffer of bufferSize bytes the pages of the ORAMs
+ * are read into and written from, or unregisters it if buffer is NULL. The
+ * host keeps the buffer until it is unregistered or the enclave is closed.
+ * Returns 0 on success and -1 if the buffer can not be used.
+ */
+int
+setIOBuffer(char *buffer, unsigned int bufferSize)
+{
+    return pageio_setBuffer(buffer, bufferSize) ? 0 : -1;
+}
+
+/*
+ * Sets the minimum level of the messages logged by the enclave. Messages of
+ * a level below the LOG_MIN_LEVEL of the build are never logged.
+ */
+void
+setLogLevel(int level)
+{
+    log_min_level = level;
+}
+
+/* Sends the log messages buffered in the enclave to the host. */
+void
+flushLog(void)
+{
+    selog_flush();
+}
+
+/*
+ * Serializes the state of the enclave. The writes deferred by the previous
+ * requests and the stashes are evicted first, so the pages of the relations
+ * are all on the ORAM files. If sizeOnly is set, nothing is evicted and the
+ * snapshot returned only counts the bytes of the state. Returns NULL if the
+ * state can not be sealed.
+ */
+static Snapshot
+saveState(bool sizeOnly)
+{
+#ifdef SEAL_STATE
+    Snapshot    snap;
+    unsigned char *key;
+    int         i;
+
+    if (initParams == NULL || scan != NULL || oTable->bulk != NULL)
+    {
+        selog(ERROR, "SOE state can only be sealed between requests");
+        return NULL;
+    }
+    if (dTable != NULL || toastTable != NULL)
+    {
+        selog(ERROR, "SOE state can not be sealed with a delta or a toast");
+        return NULL;
+    }
+    for (i = 0; i < nindexes; i++)
+    {
+        if (indexes[i].mode == DYNAMIC && indexes[i].vrel->loadFailed)
+        {
+            selog(ERROR, "SOE state can not be sealed with an index that failed to load");
+            return NULL;
+        }
+    }
+
+    if (!sizeOnly)
+    {
+        FlushWrites_s(oTable, -1);
+        for (i = 0; i < nindexes; i++)
+        {
+            if (indexes[i].mode == DYNAMIC)
+                FlushWrites_s(indexes[i].vrel, -1);
+            else
+                FlushWrites_ost(indexes[i].ostrel, -1);
+        }
+        if (!snapshot_evictStashes())
+            return NULL;
+    }
+
+    snap = sizeOnly ? snapshot_count() : snapshot_create();
+    snapshot_putInt(snap, SNAPSHOT_MAGIC);
+    snapshot_putInt(snap, SNAPSHOT_VERSION);
+    snapshot_putInt(snap, initParams->len);
+    snapshot_put(snap, initParams->data, initParams->len);
+    if (indexParams != NULL)
+    {
+        snapshot_putInt(snap, indexParams->len);
+        snapshot_put(snap, indexParams->data, indexParams->len);
+    }
+    else
+        snapshot_putInt(snap, 0);
+    if (oTable->tDesc->attrs != NULL)
+    {
+        snapshot_putInt(snap, oTable->tDesc->natts * sizeof(FormData_pg_attribute));
+        snapshot_put(snap, oTable->tDesc->attrs,
+                     oTable->tDesc->natts * sizeof(FormData_pg_attribute));
+    }
+    else
+        snapshot_putInt(snap, 0);
+
+    key = (unsigned char *) malloc(prf_keysize() + 1);
+    prf_getkey(key);
+    snapshot_putInt(snap, prf_keysize());
+    snapshot_put(snap, key, prf_keysize());
+    free(key);
+
+    soe_pmapSave(snap);
+    SaveVRelation_s(oTable, snap);
+    for (i = 0; i < nindexes; i++)
+    {
+        if (indexes[i].mode == DYNAMIC)
+            SaveVRelation_s(indexes[i].vrel, snap);
+        else
+            SaveOSTRelation_ost(indexes[i].ostrel, snap);
+    }
+    snapshot_saveStashes(snap);
+
+    if (snap->failed)
+    {
+        snapshot_destroy(snap);
+        return NULL;
+    }
+    return snap;
+#else
+    selog(ERROR, "SOE was compiled without SEAL_STATE");
+    return NULL;
+#endif
+}
+
+/* Recreates the relations with the parameters recorded by recordInit. */
+static bool
+restoreInit(Snapshot params)
+{
+    Mode        initMode = snapshot_getInt(params);
+    char       *tORAM = snapshot_getString(params);
+    char       *iORAM = snapshot_getString(params);
+    char       *tName = snapshot_getString(params);
+    char       *iName = snapshot_getString(params);
+    int         tNBlocks = snapshot_getInt(params);
+    unsigned int fanout_size = snapshot_getInt(params);
+    int        *fanouts = (int *) malloc(fanout_size + sizeof(int));
+    unsigned int nlevels;
+    int         iNBlocks;
+    unsigned int tOid;
+    unsigned int iOid;
+    unsigned int functionOid;
+    unsigned int indexOid;
+    unsigned int attrDescLength;
+    char       *attrDesc;
+    bool        ok;
+
+    snapshot_get(params, fanouts, fanout_size);
+    nlevels = snapshot_getInt(params);
+    iNBlocks = snapshot_getInt(params);
+    tOid = snapshot_getInt(params);
+    iOid = snapshot_getInt(params);
+    functionOid = snapshot_getInt(params);
+    indexOid = snapshot_getInt(params);
+    attrDescLength = snapshot_getInt(params);
+    attrDesc = (char *) malloc(attrDescLength + 1);
+    snapshot_get(params, attrDesc, attrDescLength);
+
+    ok = !params->failed;
+    if (ok)
+    {
+        selectORAM(tORAM, iORAM);
+        if (initMode == DYNAMIC)
+            initSOE(tName, iName, tNBlocks, fanouts, fanout_size, nlevels,
+                    iNBlocks, tOid, iOid, functionOid, indexOid, attrDesc,
+                    attrDescLength);
+        else
+            initFSOE(tName, iName, tNBlocks, fanouts, fanout_size, nlevels,
+                     tOid, iOid, attrDesc, attrDescLength);
+        ok = initParams != NULL;
+    }
+
+    free(tORAM);
+    free(iORAM);
+    free(tName);
+    free(iName);
+    free(fanouts);
+    free(attrDesc);
+    return ok;
+}
+
+/* Adds the indexes recorded by recordIndex. */
+static bool
+restoreIndexes(Snapshot params)
+{
+    Mode        indexMode;
+    char       *iORAM;
+    char       *iName;
+    unsigned int fanout_size;
+    int        *fanouts;
+    unsigned int nlevels;
+    int         iNBlocks;
+    unsigned int iOid;
+    unsigned int functionOid;
+    unsigned int indexOid;
+    unsigned int attrDescLength;
+    char       *attrDesc;
+    int         indexId = 0;
+    const ORAMBackend *selected = iBackend;
+
+    while (!params->failed && indexId >= 0 && params->cursor < params->len)
+    {
+        indexMode = snapshot_getInt(params);
+        iORAM = snapshot_getString(params);
+        iName = snapshot_getString(params);
+        fanout_size = snapshot_getInt(params);
+        fanouts = (int *) malloc(fanout_size + sizeof(int));
+        snapshot_get(params, fanouts, fanout_size);
+        nlevels = snapshot_getInt(params);
+        iNBlocks = snapshot_getInt(params);
+        iOid = snapshot_getInt(params);
+        functionOid = snapshot_getInt(params);
+        indexOid = snapshot_getInt(params);
+        attrDescLength = snapshot_getInt(params);
+        attrDesc = (char *) malloc(attrDescLength + 1);
+        snapshot_get(params, attrDesc, attrDescLength);
+
+        if (!params->failed)
+        {
+            iBackend = GetORAMBackend(iORAM);
+            if (indexMode == DYNAMIC)
+                indexId = addIndex(iName, fanouts, fanout_size, nlevels,
+                                   iNBlocks, iOid, functionOid, indexOid,
+                                   attrDesc, attrDescLength);
+            else
+                indexId = addFIndex(iName, fanouts, fanout_size, nlevels,
+                                    iOid, attrDesc, attrDescLength);
+        }
+
+        free(iORAM);
+        free(iName);
+        free(fanouts);
+        free(attrDesc);
+    }
+
+    /* the indexes are restored on their own ORAMs, not on the selected one */
+    iBackend = selected;
+    return !params->failed && indexId >= 0;
+}
+
+/*
+ * Size of the buffer that sealState requires to seal the current state,
+ * counted without building the state or evicting the deferred writes.
+ */
+unsigned int
+sealedStateSize(void)
+{
+    Snapshot    snap = saveState(true);
+    unsigned int size;
+
+    if (snap == NULL)
+        return 0;
+
+    size = seal_size(snap->len);
+    snapshot_destroy(snap);
+    return size;
+}
+
+/*
+ * Seals the state of the enclave (relation metadata and position maps) so
+ * that a new enclave can be attached to the same ORAM files with
+ * restoreState instead of loading the relations again. No blocks are
+ * sealed: the deferred writes are evicted and the stashes are emptied with
+ * SEAL_EVICT_ACCESSES dummy accesses to every ORAM first (see
+ * soe_snapshot.c), and the seal fails if a stash still holds a block.
+ * Returns 0 on success.
+ */
+int
+sealState(char *sealed, unsigned int sealedSize)
+{
+    Snapshot    snap = saveState(false);
+    int         result;
+
+    if (snap == NULL)
+        return 1;
+
+    result = seal_data(snap->data, snap->len, sealed, sealedSize);
+    selog(DEBUG1, "Sealed %d bytes of state", snap->len);
+    snapshot_destroy(snap);
+    return result;
+}
+
+/*
+ * Restores a state sealed by sealState in place of initSOE or initFSOE and
+ * the load of the relations. The ORAM files must be the ones the state was
+ * sealed with, and can not have been accessed since. Returns 0 on success.
+ */
+int
+restoreState(const char *sealed, unsigned int sealedSize)
+{
+#ifdef SEAL_STATE
+    Snapshot    snap;
+    Snapshot    params;
+    Snapshot    iparams;
+    Snapshot    tparams;
+    char       *plain;
+    unsigned int plainSize;
+    unsigned int len;
+    unsigned char *key;
+    bool        ok;
+    int         i;
+
+    if (initParams != NULL)
+    {
+        selog(ERROR, "SOE is already initialized");
+        return 1;
+    }
+
+    if (unseal_data(sealed, sealedSize, &plain, &plainSize) != 0)
+        return 1;
+
+    snap = snapshot_open(plain, plainSize);
+    if (snapshot_getInt(snap) != SNAPSHOT_MAGIC ||
+        snapshot_getInt(snap) != SNAPSHOT_VERSION)
+    {
+        selog(ERROR, "Sealed state has an unknown format");
+        snapshot_destroy(snap);
+        return 1;
+    }
+
+    len = snapshot_getInt(snap);
+    params = snapshot_open((char *) malloc(len + 1), len);
+    snapshot_get(snap, params->data, len);
+
+    len = snapshot_getInt(snap);
+    iparams = snapshot_open((char *) malloc(len + 1), len);
+    snapshot_get(snap, iparams->data, len);
+
+    len = snapshot_getInt(snap);
+    tparams = snapshot_open((char *) malloc(len + 1), len);
+    snapshot_get(snap, tparams->data, len);
+
+    len = snapshot_getInt(snap);
+    key = (unsigned char *) malloc(len + 1);
+    snapshot_get(snap, key, len);
+    if (len != prf_keysize())
+    {
+        selog(ERROR, "Sealed PRF key does not match the enclave");
+        snap->failed = true;
+    }
+    else
+    {
+        prf_setkey(key);
+    }
+    free(key);
+
+    ok = !snap->failed && soe_pmapLoad(snap);
+
+    if (ok)
+    {
+        snapshot_restoring = true;
+        ok = restoreInit(params) && restoreIndexes(iparams) &&
+            (tparams->len == 0 ||
+             setTableDesc(tparams->data, tparams->len) == 0);
+        snapshot_restoring = false;
+    }
+    ok = soe_pmapLoadDone() && ok;
+
+    if (ok)
+    {
+        ok = RestoreVRelation_s(oTable, snap);
+        for (i = 0; ok && i < nindexes; i++)
+        {
+            if (indexes[i].mode == DYNAMIC)
+                ok = RestoreVRelation_s(indexes[i].vrel, snap);
+            else
+                ok = RestoreOSTRelation_ost(indexes[i].ostrel, snap);
+        }
+        ok = ok && useIndex(0) && snapshot_restoreStashes(snap);
+    }
+
+    if (!ok)
+        selog(ERROR, "Could not restore the sealed state");
+    else
+        selog(DEBUG1, "Restored %d bytes of state", plainSize);
+
+    snapshot_destroy(params);
+    snapshot_destroy(iparams);
+    snapshot_destroy(tparams);
+    snapshot_destroy(snap);
+    return ok ? 0 : 1;
+#else
+    selog(ERROR, "SOE was compiled without SEAL_STATE");
+    return 1;
+#endif
+}
+
+/*
+ * Recommends the ORAM configuration for a relation with nTuples tuples of
+ * tupleSize bytes indexed by keys of keySize bytes, given an enclave memory
+ * budget in MB. The advice is written to the SOEAdvice structure defined in
+ * ops.h. Returns ADVICE_OK if some configuration fits the budget.
+ */
+int
+adviseSOE(unsigned int nTuples, unsigned int tupleSize, unsigned int keySize,
+          unsigned int epcBudgetMB, char *advice, unsigned int adviceSize)
+{
+    if (adviceSize != sizeof(SOEAdvice))
+    {
+        selog(ERROR, "Advice size does not match %d != %d", adviceSize,
+              (int) sizeof(SOEAdvice));
+        return ADVICE_OVER_BUDGET;
+    }
+
+    if (!checkORAMBackends())
+        return ADVICE_OVER_BUDGET;
+    return advise_oram(nTuples, tupleSize, keySize, epcBudgetMB, tBackend,
+                       iBackend, (SOEAdvice *) advice);
+}
+
+
 void
 closeSoe()
 {
+	int i;
+
 	selog(DEBUG1, "Going to close soe");
-    free_btree_fanout();
 	closeVRelation(oTable);
-    if(mode == DYNAMIC){
-    	if(scan != NULL){
-			btendscan_s(scan);
-    	}
-	    closeVRelation(oIndex);
-    }else{
-    	if(scan != NULL){
-    		btendscan_ost(scan);
-    	}
-        closeOSTRelation(ostIndex);
-    } 
+	/* a scan is only left open on the selected index */
+	if(scan != NULL)
+		endIndexScan(scan);
+	scan = NULL;
+	for (i = 0; i < nindexes; i++)
+	{
+		if (indexes[i].mode == DYNAMIC)
+		{
+			free_btree_fanout(indexes[i].vrel);
+			closeVRelation(indexes[i].vrel);
+			free(indexes[i].amgr);
+		}
+		else
+			closeOSTRelation(indexes[i].ostrel);
+	}
+	nindexes = 0;
+	if (dTable != NULL)
+	{
+		closeVRelation(dTable);
+		free(damgr);
+		dTable = NULL;
+		damgr = NULL;
+	}
+	if (toastTable != NULL)
+	{
+		closeVRelation(toastTable);
+		free(toastamgr);
+		toastTable = NULL;
+		toastamgr = NULL;
+	}
+	hasLastToast = false;
+	pageio_setBuffer(NULL, 0);
 	free(tamgr);
-	free(iamgr);
+	tBackend = NULL;
+	iBackend = NULL;
+	invalidORAM = false;
+	if (initParams != NULL)
+	{
+		snapshot_destroy(initParams);
+		initParams = NULL;
+	}
+	if (indexParams != NULL)
+	{
+		snapshot_destroy(indexParams);
+		indexParams = NULL;
+	}
+	selog_flush();
 }
 
 /*
@@ -19,12 +19,15 @@ NumberOfBlocks_s(VRelation rel)
 
 
 VRelation
-InitVRelation(ORAMState relstate, unsigned int oid, int total_blocks, pageinit_function pg_f)
+InitVRelation(ORAMState relstate, const ORAMBackend *backend, unsigned int oid, int total_blocks, pageinit_function pg_f)
 {
 	int			offset;
 	VRelation	vrel = (VRelation) malloc(sizeof(struct VRelation));
 
 	vrel->oram = relstate;
+	vrel->backend = backend;
+	vrel->blockOffset = 0;
+	vrel->sharedORAM = false;
 	vrel->rd_id = oid;
 	vrel->currentBlock = 0;
 	vrel->lastFreeBlock = 0;
@@ -39,6 +42,7 @@ InitVRelation(ORAMState relstate, unsigned int oid, int total_blocks, pageinit_f
 	list_new(&(vrel->buffer));
 	vrel->tDesc = (TupleDesc) malloc(sizeof(struct tupleDesc));
 	vrel->tDesc->attrs = NULL;
+	vrel->keycmp = NULL;
 
     vrel->tHeight = 0;
     vrel->level = 0;
@@ -46,17 +50,93 @@ InitVRelation(ORAMState relstate, unsigned int oid, int total_blocks, pageinit_f
     vrel->rCounter = 2; //counter starts at 2 as blocks do two oblivious operations at initialization
     vrel->leafCurrentCounter = 0;
     vrel->heapBlockCounter = 0;
+    list_new(&(vrel->pending));
+    vrel->bulk = NULL;
+    vrel->fanouts = NULL;
+    vrel->nlevels = 0;
+    vrel->levelBlocks = NULL;
+    vrel->chainPages = NULL;
+    vrel->nbuckets = 0;
+    vrel->loadFailed = false;
 	return vrel;
 }
 
 
+static void
+WritePage_s(VRelation relation, int id, char *page, unsigned int *token)
+{
+	int			result;
+	BlockNumber oblkno = relation->blockOffset + id;
+
+	#ifdef SEAL_STATE
+	snapshot_blockWrite(relation->oram, oblkno);
+	#endif
+	relation->backend->settoken(relation->oram, token);
+	result = relation->backend->write(page, BLCKSZ, oblkno, relation->oram, NULL);
+
+	if (result != BLCKSZ)
+	{
+		selog(ERROR, "Write failed to write a complete page");
+	}
+}
+
+static void
+WritePending_s(VRelation relation, VPendingWrite pw)
+{
+	WritePage_s(relation, pw->id, pw->page, pw->hasToken ? pw->token : NULL);
+	free(pw->page);
+	free(pw);
+}
+
+/*
+ * Evicts up to maxWrites queued writes (all of them if maxWrites is negative)
+ * in the order they were queued. Returns the number of writes still queued.
+ */
+int
+FlushWrites_s(VRelation rel, int maxWrites)
+{
+	void	   *element;
+
+	while (maxWrites != 0 && list_size(rel->pending) > 0)
+	{
+		list_remove_first(rel->pending, &element);
+		WritePending_s(rel, (VPendingWrite) element);
+		if (maxWrites > 0)
+			maxWrites--;
+	}
+
+	return list_size(rel->pending);
+}
+
+/* Returns the last queued write of the block blockNum, or NULL. */
+static VPendingWrite
+FindPendingWrite_s(VRelation rel, BlockNumber blockNum)
+{
+	ListIter	iter;
+	void	   *element;
+	VPendingWrite last = NULL;
+
+	list_iter_init(&iter, rel->pending);
+	while (list_iter_next(&iter, &element) != CC_ITER_END)
+	{
+		if (((VPendingWrite) element)->id == blockNum)
+			last = (VPendingWrite) element;
+	}
+	return last;
+}
+
+
 Buffer 
 ReadDummyBuffer(VRelation relation, BlockNumber blkno){
     int     result = 0;
     #ifdef DUMMYS
     char    *page = NULL;
 
-    result = read_oram(&page, blkno, relation->oram, NULL);
+    if (relation->bulk != NULL)
+        return result;
+
+    result = relation->backend->read(&page, relation->blockOffset + blkno,
+                                     relation->oram, NULL);
 
     free(page);
     #endif
@@ -64,6 +144,25 @@ ReadDummyBuffer(VRelation relation, BlockNumber blkno){
 }
 
 
+/* Bulk loaded pages stay in the enclave until endBulkLoad. */
+static Buffer
+ReadBulkBuffer_s(VRelation relation, BlockNumber blockNum)
+{
+	char	   *loaded = bulk_getPage(relation->bulk,
+										  relation->blockOffset + blockNum);
+	VBlock		block = (VBlock) malloc(sizeof(struct VBlock));
+
+	block->id = blockNum;
+	block->page = (char *) malloc(BLCKSZ);
+	if (loaded != NULL)
+		memcpy(block->page, loaded, BLCKSZ);
+	else
+		memset(block->page, 0, BLCKSZ);
+	list_add(relation->buffer, block);
+
+	return blockNum;
+}
+
 /**
 *
 * TODO: this function should see if the blocknumber is present on the list
@@ -77,9 +176,16 @@ ReadBuffer_s(VRelation relation, BlockNumber blockNum)
 	char	   *page = NULL;
     VBlock      block;	
 	int			result;
+    #ifdef DEFERRED_WB
+    VPendingWrite pw;
+    #endif
     
-    setToken(relation->oram, relation->token);
-    result = read_oram(&page, blockNum, relation->oram, NULL);
+    if (relation->bulk != NULL)
+        return ReadBulkBuffer_s(relation, blockNum);
+
+    relation->backend->settoken(relation->oram, relation->token);
+    result = relation->backend->read(&page, relation->blockOffset + blockNum,
+                                     relation->oram, NULL);
 	
 
     /**
@@ -93,6 +199,19 @@ ReadBuffer_s(VRelation relation, BlockNumber blockNum)
         memset(page, 0, BLCKSZ);
     } 
 
+    #ifdef DEFERRED_WB
+    /*
+     * The ORAM is accessed whether the block has a queued write or not, and
+     * the last queued page, which is newer than the one on the ORAM, is
+     * used. The queue is never flushed on a read, only by its size and by
+     * flushWrites, so the host does not learn that a block with a queued
+     * write is read again.
+     */
+    pw = FindPendingWrite_s(relation, blockNum);
+    if (pw != NULL)
+        memcpy(page, pw->page, BLCKSZ);
+    #endif
+
     block = (VBlock) malloc(sizeof(struct VBlock));
     
   
@@ -131,14 +250,11 @@ void
 MarkBufferDirty_s(VRelation relation, Buffer buffer)
 {
 
-	int			result;
 	ListIter	iter;
 	VBlock		vblock;
 	void	   *element;
 	bool		found = false;
 
-	result = 0;
-
 	list_iter_init(&iter, relation->buffer);
 
 	/* Search with virtual block with buffer */
@@ -151,22 +267,40 @@ MarkBufferDirty_s(VRelation relation, Buffer buffer)
 			break;
 		}
 	}
-	if (found)
+	if (found && relation->bulk != NULL)
+	{
+		bulk_setPage(relation->bulk, relation->blockOffset + vblock->id,
+					 vblock->page);
+	}
+	else if (found)
 	{	
-        setToken(relation->oram, relation->token);
-		result = write_oram(vblock->page, BLCKSZ, vblock->id, relation->oram, NULL);
-
+        #ifdef DEFERRED_WB
+        /* DEFERRED_WB applies to the token based ORAMs (see the Makefile). */
+        if (relation->backend->tokens)
+        {
+            VPendingWrite pw = (VPendingWrite) malloc(sizeof(struct VPendingWrite));
+
+            pw->id = vblock->id;
+            pw->page = (char *) malloc(BLCKSZ);
+            memcpy(pw->page, vblock->page, BLCKSZ);
+            pw->hasToken = relation->token != NULL;
+            if (pw->hasToken)
+                memcpy(pw->token, relation->token, sizeof(unsigned int) * ORAM_TOKEN_SIZE);
+
+            if (list_size(relation->pending) > MAX_PENDING_WRITES)
+                FlushWrites_s(relation, list_size(relation->pending) - MAX_PENDING_WRITES);
+        }
+        else
+            WritePage_s(relation, vblock->id, vblock->page, relation->token);
+        #else
+        WritePage_s(relation, vblock->id, vblock->page, relation->token);
+        #endif
 	}
 	else
 	{
 		selog(DEBUG1, "Did not find buffer %d to update", buffer);
 	}
 
-	if (result != BLCKSZ)
-	{
-		selog(ERROR, "Write failed to write a complete page");
-	}
-
 }
 
 void
@@ -245,16 +379,77 @@ destroyVBlock(void *block)
 	free(block);
 }
 
+/*
+ * Relation metadata kept in the enclave between requests. The pages of the
+ * relation are on the ORAM and the pending writes must have been flushed.
+ */
+void
+SaveVRelation_s(VRelation rel, Snapshot snap)
+{
+	snapshot_putInt(snap, rel->totalBlocks);
+	snapshot_put(snap, rel->fsm, sizeof(int) * rel->totalBlocks);
+	snapshot_putInt(snap, rel->currentBlock);
+	snapshot_putInt(snap, rel->lastFreeBlock);
+	snapshot_putInt(snap, rel->maxDatumSize);
+	snapshot_putInt(snap, rel->tHeight);
+	snapshot_putInt(snap, rel->level);
+	snapshot_putInt(snap, rel->rCounter);
+	snapshot_putInt(snap, rel->leafCurrentCounter);
+	snapshot_putInt(snap, rel->heapBlockCounter);
+	snapshot_putInt(snap, rel->levelBlocks != NULL ? (int) rel->nlevels + 1 : 0);
+	if (rel->levelBlocks != NULL)
+		snapshot_put(snap, rel->levelBlocks, sizeof(int) * (rel->nlevels + 1));
+}
+
+bool
+RestoreVRelation_s(VRelation rel, Snapshot snap)
+{
+	if (snapshot_getInt(snap) != rel->totalBlocks)
+	{
+		selog(ERROR, "Sealed relation %d does not have %d blocks", rel->rd_id,
+			  rel->totalBlocks);
+		return false;
+	}
+	snapshot_get(snap, rel->fsm, sizeof(int) * rel->totalBlocks);
+	rel->currentBlock = snapshot_getInt(snap);
+	rel->lastFreeBlock = snapshot_getInt(snap);
+	rel->maxDatumSize = snapshot_getInt(snap);
+	rel->tHeight = snapshot_getInt(snap);
+	rel->level = snapshot_getInt(snap);
+	rel->rCounter = snapshot_getInt(snap);
+	rel->leafCurrentCounter = snapshot_getInt(snap);
+	rel->heapBlockCounter = snapshot_getInt(snap);
+	if (snapshot_getInt(snap) != (rel->levelBlocks != NULL ? (int) rel->nlevels + 1 : 0))
+	{
+		selog(ERROR, "Sealed relation %d does not have %d levels", rel->rd_id,
+			  rel->nlevels);
+		return false;
+	}
+	if (rel->levelBlocks != NULL)
+		snapshot_get(snap, rel->levelBlocks, sizeof(int) * (rel->nlevels + 1));
+
+	return !snap->failed;
+}
+
 void
 closeVRelation(VRelation rel)
 {
-	close_oram(rel->oram, NULL);
+	FlushWrites_s(rel, -1);
+	list_destroy(rel->pending);
+	if (!rel->sharedORAM)
+	{
+		rel->backend->close(rel->oram, NULL);
+		#ifdef SEAL_STATE
+		snapshot_unregisterORAM(rel->oram);
+		#endif
+	}
 	list_remove_all_cb(rel->buffer, &destroyVBlock);
 	list_destroy(rel->buffer);
 	if (rel->rd_amcache != NULL)
 	{
 		free(rel->rd_amcache);
 	}
+	free(rel->chainPages);
 	if (rel->tDesc->attrs != NULL)
 	{
 		free(rel->tDesc->attrs);
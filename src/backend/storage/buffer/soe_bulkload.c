@@ -0,0 +1,468 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_bulkload.c
+ *	  Oblivious bulk placement of the blocks loaded into an ORAM.
+ *
+ * Loading a relation block by block costs a full ORAM access per block. As
+ * the initial content of the relations is known before the first request,
+ * the loaded pages are instead kept until endBulkLoad and placed directly on
+ * the buckets of the ORAM file:
+ *
+ *	1. every page is assigned a uniformly random leaf;
+ *	2. the buckets are filled from the leaves up, each page going to the
+ *	   deepest bucket of its path with a free slot. On each level the tags
+ *	   of the pages, padded with bkcap filler tags per bucket, are sorted by
+ *	   bucket with a bitonic network, ranked in their bucket with a linear
+ *	   scan and sorted again to move the placed tags to their slots
+ *	   (bulk_placeLevel), so the steps do not depend on the leaves;
+ *	3. every slot of the file is rewritten once, in file order, with dummy
+ *	   blocks on the free slots, and the leaves are set on the position map
+ *	   in block order.
+ *
+ * The files are still initialized with dummy blocks by the ORAM, so the
+ * placement only rewrites existing slots.
+ *
+ * The pages that do not fit on their path are written afterwards with
+ * regular ORAM writes, as if they were in the stash, padded with dummy
+ * accesses to BULK_OVERFLOW_WRITES accesses.
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ * IDENTIFICATION
+ *        backend/storage/buffer/soe_bulkload.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "storage/soe_bulkload.h"
+#include "storage/soe_pmap.h"
+#include "storage/soe_snapshot.h"
+#include "storage/soe_block.h"
+#include "logger/logger.h"
+
+#include <oram/plblock.h>
+#include <oram/orandom.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Number of ORAM accesses made for the pages that do not fit on their path,
+ * padded with dummy accesses. More pages than this are still written, which
+ * only tells that the bound was exceeded.
+ */
+#ifndef BULK_OVERFLOW_WRITES
+#define BULK_OVERFLOW_WRITES 64
+#endif
+
+/* Leaf of the filler and padding tags. */
+#define BULK_DUMMY UINT_MAX
+
+typedef struct BulkTag
+{
+	unsigned int leaf;
+	BlockNumber blkno;			/* InvalidBlockNumber for a dummy tag */
+	unsigned int key;			/* sort key, bucket or slot */
+}			BulkTag;
+
+struct BulkLoadData
+{
+	char	   *name;
+	int			level;
+	char	   *pmapName;
+	const ORAMBackend *backend;
+	AMOFile    *ofile;
+	unsigned int bkcap;
+	/* number of slots of the file, known once the ORAM initializes it */
+	unsigned int nslots;
+
+	unsigned int nblocks;
+	char	  **pages;
+
+	struct BulkLoadData *next;
+};
+
+bool		bulk_loading = false;
+
+/* Bulk loads in progress. */
+static BulkLoad bulks = NULL;
+
+
+/*
+ * Starts the bulk load of the ORAM with nblocks blocks stored on the file
+ * name. Returns NULL if the ORAM has to be loaded block by block, as token
+ * based ORAMs derive the leaves of the blocks from their access counters.
+ */
+BulkLoad
+bulk_create(const char *name, int level, const char *pmapName,
+			const ORAMBackend *backend, AMOFile * ofile, unsigned int bkcap,
+			unsigned int nblocks)
+{
+	BulkLoad	bulk;
+
+	if (!bulk_loading || backend->tokens)
+		return NULL;
+
+	bulk = (BulkLoad) malloc(sizeof(struct BulkLoadData));
+	bulk->name = strdup(name);
+	bulk->level = level;
+	bulk->pmapName = strdup(pmapName);
+	bulk->backend = backend;
+	bulk->ofile = ofile;
+	bulk->bkcap = bkcap;
+	bulk->nslots = 0;
+	bulk->nblocks = nblocks;
+	bulk->pages = (char **) malloc(sizeof(char *) * nblocks);
+	memset(bulk->pages, 0, sizeof(char *) * nblocks);
+
+	bulk->next = bulks;
+	bulks = bulk;
+	return bulk;
+}
+
+/*
+ * Called by the oblivious files on initialization to record the number of
+ * slots of the file, which is only known to the ORAM.
+ */
+void
+bulk_fileInit(const char *name, int level, unsigned int nslots)
+{
+	BulkLoad	bulk;
+
+	for (bulk = bulks; bulk != NULL; bulk = bulk->next)
+	{
+		if (bulk->level == level && strcmp(bulk->name, name) == 0)
+			bulk->nslots = nslots;
+	}
+}
+
+/* Returns the loaded page blkno, or NULL if it was not loaded yet. */
+char *
+bulk_getPage(BulkLoad bulk, BlockNumber blkno)
+{
+	if (blkno >= bulk->nblocks)
+	{
+		selog(ERROR, "Bulk load of block %d out of %d", blkno, bulk->nblocks);
+		return NULL;
+	}
+	return bulk->pages[blkno];
+}
+
+void
+bulk_setPage(BulkLoad bulk, BlockNumber blkno, const char *page)
+{
+	if (blkno >= bulk->nblocks)
+	{
+		selog(ERROR, "Bulk load of block %d out of %d", blkno, bulk->nblocks);
+		return;
+	}
+	if (bulk->pages[blkno] == NULL)
+		bulk->pages[blkno] = (char *) malloc(BLCKSZ);
+	memcpy(bulk->pages[blkno], page, BLCKSZ);
+}
+
+
+static void
+compare_exchange(BulkTag * tags, unsigned int i, unsigned int j, bool up)
+{
+	BulkTag		a = tags[i];
+	BulkTag		b = tags[j];
+	unsigned int swap;
+
+	swap = (a.key > b.key || (a.key == b.key && a.blkno > b.blkno)) == up;
+	tags[i] = swap ? b : a;
+	tags[j] = swap ? a : b;
+}
+
+/* Sorts n tags (a power of two) by key and block number. */
+static void
+bitonic_sort(BulkTag * tags, unsigned int n)
+{
+	unsigned int size;
+	unsigned int stride;
+	unsigned int i;
+
+	for (size = 2; size <= n; size <<= 1)
+	{
+		for (stride = size >> 1; stride > 0; stride >>= 1)
+		{
+			for (i = 0; i < n; i++)
+			{
+				if ((i ^ stride) > i)
+					compare_exchange(tags, i, i ^ stride, (i & size) == 0);
+			}
+		}
+	}
+}
+
+static unsigned int
+next_pow2(unsigned int n)
+{
+	unsigned int p = 1;
+
+	while (p < n)
+		p <<= 1;
+	return p;
+}
+
+/*
+ * Assigns the ncand candidate tags to the levelBuckets buckets of a level of
+ * the tree, the first at bucket first. Each bucket is padded with bkcap
+ * filler tags, so that after sorting by bucket every bucket is followed by
+ * at least bkcap tags, its pages first. The first bkcap tags of each bucket
+ * are placed, a second sort moves them to the front in slot order and they
+ * are copied to the slots of the level. The candidates left over, padded
+ * with the unplaced fillers, are the ncand candidates of the next level.
+ * Every step only depends on ncand, levelBuckets and bkcap.
+ */
+static void
+bulk_placeLevel(BulkTag * cand, unsigned int ncand, BulkTag * work,
+				BulkTag * slots, unsigned int first, unsigned int levelBuckets,
+				unsigned int shift, unsigned int bkcap)
+{
+	unsigned int nplaced = levelBuckets * bkcap;
+	unsigned int nwork = next_pow2(ncand + nplaced);
+	unsigned int prevKey = UINT_MAX;
+	unsigned int rank = 0;
+	unsigned int i;
+	bool		dummy;
+	bool		placed;
+
+	for (i = 0; i < ncand; i++)
+	{
+		work[i] = cand[i];
+		dummy = cand[i].leaf == BULK_DUMMY;
+		work[i].key = dummy ? UINT_MAX : cand[i].leaf >> shift;
+	}
+	for (i = 0; i < nplaced; i++)
+	{
+		work[ncand + i].leaf = BULK_DUMMY;
+		work[ncand + i].blkno = InvalidBlockNumber;
+		work[ncand + i].key = i / bkcap;
+	}
+	for (i = ncand + nplaced; i < nwork; i++)
+	{
+		work[i].leaf = BULK_DUMMY;
+		work[i].blkno = InvalidBlockNumber;
+		work[i].key = UINT_MAX;
+	}
+
+	bitonic_sort(work, nwork);
+
+	/* the rank of each tag in its bucket decides its slot */
+	for (i = 0; i < nwork; i++)
+	{
+		rank = work[i].key == prevKey ? rank + 1 : 0;
+		prevKey = work[i].key;
+		placed = work[i].key != UINT_MAX && rank < bkcap;
+		work[i].key = placed ? (first + work[i].key) * bkcap + rank : UINT_MAX;
+	}
+
+	bitonic_sort(work, nwork);
+
+	memcpy(slots + first * bkcap, work, sizeof(BulkTag) * nplaced);
+	/* the unplaced pages sort before the unplaced fillers */
+	memcpy(cand, work + nplaced, sizeof(BulkTag) * ncand);
+}
+
+static void
+write_block(BulkLoad bulk, ORAMState oram, BlockNumber blkno, char *page)
+{
+	int			level = bulk->level;
+
+	#ifdef SEAL_STATE
+	snapshot_blockWrite(oram, blkno);
+	#endif
+	bulk->backend->settoken(oram, NULL);
+	if (bulk->backend->write(page, BLCKSZ, blkno, oram,
+							 level > 0 ? &level : NULL) != BLCKSZ)
+	{
+		selog(ERROR, "Write failed to write a complete page");
+	}
+}
+
+/* An ORAM access to a block that is not stored, as ReadDummyBuffer does. */
+static void
+dummy_access(BulkLoad bulk, ORAMState oram)
+{
+	int			level = bulk->level;
+	char	   *page = NULL;
+
+	bulk->backend->settoken(oram, NULL);
+	bulk->backend->read(&page, bulk->nblocks + 1, oram,
+						level > 0 ? &level : NULL);
+	free(page);
+}
+
+static void
+bulk_free(BulkLoad bulk)
+{
+	BulkLoad   *prev;
+	BlockNumber blkno;
+
+	for (prev = &bulks; *prev != NULL; prev = &((*prev)->next))
+	{
+		if (*prev == bulk)
+		{
+			*prev = bulk->next;
+			break;
+		}
+	}
+
+	for (blkno = 0; blkno < bulk->nblocks; blkno++)
+	{
+		if (bulk->pages[blkno] != NULL)
+			free(bulk->pages[blkno]);
+	}
+	free(bulk->pages);
+	free(bulk->pmapName);
+	free(bulk->name);
+	free(bulk);
+}
+
+/*
+ * Files that do not have the expected layout have the pages written one at a
+ * time through the ORAM.
+ */
+static void
+bulk_fallback(BulkLoad bulk, ORAMState oram)
+{
+	BlockNumber blkno;
+
+	selog(WARNING, "File %s does not have the bucket layout of a Path ORAM, loading it block by block",
+		  bulk->name);
+
+	for (blkno = 0; blkno < bulk->nblocks; blkno++)
+	{
+		if (bulk->pages[blkno] != NULL)
+			write_block(bulk, oram, blkno, bulk->pages[blkno]);
+	}
+}
+
+/*
+ * Places the loaded pages on the ORAM file and frees the bulk load. Must be
+ * called before any other access to the ORAM.
+ */
+void
+bulk_finish(BulkLoad bulk, ORAMState oram)
+{
+	unsigned int nbuckets = bulk->nslots / bulk->bkcap;
+	unsigned int nleaves = (nbuckets + 1) / 2;
+	unsigned int npages = 0;
+	unsigned int ntags;
+	unsigned int levelBuckets;
+	unsigned int first;
+	unsigned int shift;
+	unsigned int slot;
+	unsigned int c;
+	unsigned int *leaves;
+	BulkTag    *cand;
+	BulkTag    *work;
+	BulkTag    *slots;
+	PLBlock		plblock;
+	char	   *dummy;
+	BlockNumber blkno;
+	bool		real;
+
+	if (bulk->nslots == 0 || bulk->nslots % bulk->bkcap != 0 ||
+		(nbuckets & (nbuckets + 1)) != 0)
+	{
+		bulk_fallback(bulk, oram);
+		bulk_free(bulk);
+		return;
+	}
+
+	for (blkno = 0; blkno < bulk->nblocks; blkno++)
+		npages += bulk->pages[blkno] != NULL;
+	ntags = next_pow2(npages);
+
+	leaves = (unsigned int *) malloc(sizeof(unsigned int) * bulk->nblocks);
+	cand = (BulkTag *) malloc(sizeof(BulkTag) * ntags);
+	c = 0;
+	for (blkno = 0; blkno < bulk->nblocks; blkno++)
+	{
+		if (bulk->pages[blkno] == NULL)
+			continue;
+		leaves[blkno] = getRandomInt() % nleaves;
+		cand[c].leaf = leaves[blkno];
+		cand[c].blkno = blkno;
+		c++;
+	}
+	for (; c < ntags; c++)
+	{
+		cand[c].leaf = BULK_DUMMY;
+		cand[c].blkno = InvalidBlockNumber;
+	}
+
+	slots = (BulkTag *) malloc(sizeof(BulkTag) * bulk->nslots);
+	work = (BulkTag *) malloc(sizeof(BulkTag) *
+							  next_pow2(ntags + nleaves * bulk->bkcap));
+
+	/* Fill the buckets level by level from the leaves up to the root. */
+	for (shift = 0, levelBuckets = nleaves, first = nleaves - 1;
+		 levelBuckets > 0;
+		 shift++, levelBuckets >>= 1, first = (first - 1) / 2)
+	{
+		bulk_placeLevel(cand, ntags, work, slots, first, levelBuckets, shift,
+						bulk->bkcap);
+		if (first == 0)
+			break;
+	}
+
+	selog(DEBUG1, "Bulk load of %d pages on %s with %d buckets",
+		  npages, bulk->name, nbuckets);
+
+	/* Write every slot of the file once, in file order. */
+	plblock = createEmptyBlock();
+	dummy = (char *) malloc(BLCKSZ);
+	for (slot = 0; slot < bulk->nslots; slot++)
+	{
+		real = slots[slot].blkno != InvalidBlockNumber;
+		plblock->blkno = real ? slots[slot].blkno : DUMMY_BLOCK;
+		plblock->block = real ? bulk->pages[slots[slot].blkno] : dummy;
+		plblock->location[0] = real ? slots[slot].leaf : 0;
+		plblock->size = BLCKSZ;
+		plblock->location[1] = 0;
+		bulk->ofile->ofilewrite(NULL, plblock, bulk->name, slot,
+								bulk->level > 0 ? &bulk->level : NULL);
+	}
+	free(plblock);
+	free(dummy);
+
+	/* the loaded blocks are known to the host */
+	for (blkno = 0; blkno < bulk->nblocks; blkno++)
+	{
+		if (bulk->pages[blkno] != NULL &&
+			!soe_pmapSet(bulk->pmapName, blkno, leaves[blkno]))
+		{
+			selog(ERROR, "Could not find position map %s", bulk->pmapName);
+			break;
+		}
+	}
+
+	/*
+	 * Pages that did not fit on their path go through the stash. They sort
+	 * before the dummy tags left over from the root.
+	 */
+	for (c = 0; c < ntags; c++)
+	{
+		real = cand[c].blkno != InvalidBlockNumber;
+		if (c >= BULK_OVERFLOW_WRITES && !real)
+			break;
+		if (c == BULK_OVERFLOW_WRITES)
+			selog(WARNING, "Bulk load of %s has more than %d pages that do not fit on their path",
+				  bulk->name, BULK_OVERFLOW_WRITES);
+		if (real)
+			write_block(bulk, oram, cand[c].blkno, bulk->pages[cand[c].blkno]);
+		else
+			dummy_access(bulk, oram);
+	}
+	for (; c < BULK_OVERFLOW_WRITES; c++)
+		dummy_access(bulk, oram);
+
+	free(leaves);
+	free(cand);
+	free(work);
+	free(slots);
+	bulk_free(bulk);
+}
@@ -28,7 +28,10 @@
 #include "common/soe_pe.h"
 #include "logger/logger.h"
 #include "storage/soe_hash_ofile.h"
+#include "storage/soe_snapshot.h"
+#include "storage/soe_bulkload.h"
 #include "storage/soe_bufpage.h"
+#include "storage/soe_pageio.h"
 
 #include <oram/plblock.h>
 #include <string.h>
@@ -36,7 +39,7 @@
 
 
 void
-hash_pageInit(Page page, int blkno, Size blocksize)
+hash_pageInit(Page page, int blkno, unsigned int locationSize, Size blocksize)
 {
 	HashPageOpaque ovflopaque;
 
@@ -51,6 +54,20 @@ hash_pageInit(Page page, int blkno, Size blocksize)
 	ovflopaque->hasho_bucket = -1;
 	ovflopaque->hasho_flag = LH_UNUSED_PAGE;
 	ovflopaque->hasho_page_id = HASHO_PAGE_ID;
+	ovflopaque->location[0] = 0;
+	ovflopaque->location[1] = 0;
+}
+
+/* Sets the block number and location of a block read from the file. */
+void
+hash_pageTag(PLBlock block)
+{
+	HashPageOpaque oopaque = (HashPageOpaque) PageGetSpecialPointer_s((Page) block->block);
+
+	block->blkno = oopaque->o_blkno;
+	block->size = BLCKSZ;
+	block->location[0] = oopaque->location[0];
+	block->location[1] = oopaque->location[1];
 }
 
 /**
@@ -58,8 +75,8 @@ hash_pageInit(Page page, int blkno, Size blocksize)
  * This function follows a logic similar to the function
  * _hash_alloc_buckets in soe_hashpage.c.
  * */
-void
-hash_fileInit(const char *filename, unsigned int nblocks, unsigned int blocksize, void *appData)
+FileHandler
+hash_fileInit(const char *filename, unsigned int nblocks, unsigned int blocksize, unsigned int locationSize, void *appData)
 {
 	sgx_status_t status;
 
@@ -75,6 +92,12 @@ hash_fileInit(const char *filename, unsigned int nblocks, unsigned int blocksize
 	int			allocBlocks = 0;
 	int			boffset = 0;
 
+	/* The file of a sealed state already holds the ORAM blocks. */
+	if (snapshot_restoring)
+		return NULL;
+
+	bulk_fileInit(filename, 0, nblocks);
+
 	do
 	{
 		/*
@@ -92,8 +115,12 @@ hash_fileInit(const char *filename, unsigned int nblocks, unsigned int blocksize
 		for (offset = 0; offset < allocBlocks; offset++)
 		{
 			destPage = blocks + (offset * BLCKSZ);
-			hash_pageInit(tmpPage, DUMMY_BLOCK, (Size) blocksize);
+			hash_pageInit(tmpPage, DUMMY_BLOCK, locationSize, (Size) blocksize);
+#ifndef CPAGES
 			page_encryption((unsigned char *) tmpPage, (unsigned char *) destPage);
+#else
+			memcpy(destPage, tmpPage, BLCKSZ);
+#endif
 			/* oopaque = (HashPageOpaque) PageGetSpecialPointer_s(page); */
 
 			/*
@@ -114,36 +141,27 @@ hash_fileInit(const char *filename, unsigned int nblocks, unsigned int blocksize
 		tnblocks -= BATCH_SIZE;
 		boffset += BATCH_SIZE;
 	} while (tnblocks > 0);
+
+	return NULL;
 }
 
 
 void
-hash_fileRead(PLBlock block, const char *filename, const BlockNumber ob_blkno, void *appData)
+hash_fileRead(FileHandler handler, PLBlock block, const char *filename, const BlockNumber ob_blkno, void *appData)
 {
-	sgx_status_t status;
-	HashPageOpaque oopaque;
-
 	/* selog(DEBUG1, "hash_fileRead %d", ob_blkno); */
-	status = SGX_SUCCESS;
-	char	   *ciphertexBlock;
-
 	block->block = (void *) malloc(BLCKSZ);
-	ciphertexBlock = (char *) malloc(BLCKSZ);
 
-
-
-	status = outFileRead(ciphertexBlock, filename, ob_blkno, BLCKSZ);
-	page_decryption((unsigned char *) ciphertexBlock, (unsigned char *) block->block);
-
-	if (status != SGX_SUCCESS)
+	if (!pageio_read((char *) block->block, filename, ob_blkno))
 	{
 		selog(ERROR, "Could not read %d from relation %s\n", ob_blkno, filename);
 	}
 
-	oopaque = (HashPageOpaque) PageGetSpecialPointer_s((Page) block->block);
-	block->blkno = oopaque->o_blkno;
-	block->size = BLCKSZ;
-	free(ciphertexBlock);
+	hash_pageTag(block);
+
+#ifdef SEAL_STATE
+	snapshot_blockIn(filename, 0, block);
+#endif
 
 	/*
 	 * selog(DEBUG1, "requested %d and block has real blkno %d", ob_blkno,
@@ -153,12 +171,10 @@ hash_fileRead(PLBlock block, const char *filename, const BlockNumber ob_blkno, v
 
 
 void
-hash_fileWrite(const PLBlock block, const char *filename, const BlockNumber ob_blkno, void *appData)
+hash_fileWrite(FileHandler handler, const PLBlock block, const char *filename, const BlockNumber ob_blkno, void *appData)
 {
-	sgx_status_t status = SGX_SUCCESS;
-	char	   *encPage = (char *) malloc(BLCKSZ);
-
-	/* HashPageOpaque oopaque = NULL; */
+	char	   *encPage;
+	HashPageOpaque oopaque;
 
 
 	if (block->blkno == DUMMY_BLOCK)
@@ -172,9 +188,15 @@ hash_fileWrite(const PLBlock block, const char *filename, const BlockNumber ob_b
 		* on the ocalls.
 		*/
 		/* selog(DEBUG1, "Going to write DUMMY_BLOCK"); */
-		hash_pageInit((Page) block->block, DUMMY_BLOCK, BLCKSZ);
+		hash_pageInit((Page) block->block, DUMMY_BLOCK, 0, BLCKSZ);
 	}
-	page_encryption((unsigned char *) block->block, (unsigned char *) encPage);
+
+	oopaque = (HashPageOpaque) PageGetSpecialPointer_s((Page) block->block);
+	oopaque->o_blkno = block->blkno;
+	oopaque->location[0] = block->location[0];
+	oopaque->location[1] = block->location[1];
+
+	encPage = pageio_encrypt((char *) block->block);
 
 	/*
 	 * oopaque = (HashPageOpaque) PageGetSpecialPointer_s((Page)
@@ -186,19 +208,19 @@ hash_fileWrite(const PLBlock block, const char *filename, const BlockNumber ob_b
 	 * ob_blkno, block->blkno, oopaque->o_blkno);
 	 */
 	/* selog(DEBUG1, "hash_fileWrite for file %s", filename); */
-	status = outFileWrite(encPage, filename, ob_blkno, BLCKSZ);
-
-	if (status != SGX_SUCCESS)
+	if (!pageio_write(encPage, filename, ob_blkno))
 	{
 		selog(ERROR, "Could not write %d on relation %s\n", ob_blkno, filename);
 	}
 
-	free(encPage);
+#ifdef SEAL_STATE
+	snapshot_blockOut(filename, 0, block->blkno);
+#endif
 }
 
 
 void
-hash_fileClose(const char *filename, void *appData)
+hash_fileClose(FileHandler handler, const char *filename, void *appData)
 {
 	sgx_status_t status = SGX_SUCCESS;
 
@@ -27,6 +27,9 @@
 
 #include "logger/logger.h"
 #include "storage/soe_heap_ofile.h"
+#include "storage/soe_snapshot.h"
+#include "storage/soe_bulkload.h"
+#include "storage/soe_pageio.h"
 #include "common/soe_pe.h"
 
 
@@ -50,6 +53,18 @@ heap_pageInit(Page page, int blkno, unsigned int lsize, Size blocksize)
     pblkno[3] = 0;
 }
 
+/* Sets the block number and location of a block read from the file. */
+void
+heap_pageTag(PLBlock block)
+{
+	int		   *r_blkno = (int *) PageGetSpecialPointer_s((Page) block->block);
+
+	block->blkno = r_blkno[0];
+	block->location[0] = r_blkno[2];
+	block->location[1] = r_blkno[3];
+	block->size = BLCKSZ;
+}
+
 /**
  *
  * This function follows a logic similar to the function RelationAddExtraBlocks in hio.c which  pre-extend a
@@ -72,7 +87,13 @@ heap_fileInit(const char *filename, unsigned int nblocks, unsigned int blocksize
 	status = SGX_SUCCESS;
 	int			offset = 0;
 	int			boffset = 0;
-	
+
+	/* The file of a sealed state already holds the ORAM blocks. */
+	if (snapshot_restoring)
+		return NULL;
+
+	bulk_fileInit(filename, 0, nblocks);
+
     do
 	{	
 
@@ -116,36 +137,18 @@ void
 heap_fileRead(FileHandler handler, PLBlock block, const char *filename, const BlockNumber ob_blkno, void *appData)
 {
 
-	sgx_status_t status;
-	char	   *ciphertexBlock;
-	int*    r_blkno;
-
-	status = SGX_SUCCESS;
-
 	block->block = (void *) malloc(BLCKSZ);
-	ciphertexBlock = (char *) malloc(BLCKSZ);
 
-	
-    status = outFileRead(ciphertexBlock, filename, ob_blkno, BLCKSZ);
-
-	#ifndef CPAGES
-		page_decryption((unsigned char *) ciphertexBlock, (unsigned char *) block->block);
-	#else
-    	memcpy(block->block, ciphertexBlock, BLCKSZ);
-	#endif
-
-	if (status != SGX_SUCCESS)
+	if (!pageio_read((char *) block->block, filename, ob_blkno))
 	{
 		selog(ERROR, "Could not read %d from relation %s\n", ob_blkno, filename);
 	}
    
-	r_blkno = (int*) PageGetSpecialPointer_s((Page) block->block);
-    //selog(DEBUG1, "Read real block %d", r_blkno[0]);
-    block->blkno = r_blkno[0];
-    block->location[0] = r_blkno[2];
-    block->location[1] = r_blkno[3];
-	block->size = BLCKSZ;
-	free(ciphertexBlock);
+	heap_pageTag(block);
+
+	#ifdef SEAL_STATE
+	snapshot_blockIn(filename, 0, block);
+	#endif
 
 }
 
@@ -153,8 +156,7 @@ heap_fileRead(FileHandler handler, PLBlock block, const char *filename, const Bl
 void
 heap_fileWrite(FileHandler handler, const PLBlock block, const char *filename, const BlockNumber ob_blkno, void *appData)
 {
-	sgx_status_t status = SGX_SUCCESS;
-	char	   *encPage = (char *) malloc(BLCKSZ);
+	char	   *encPage;
     int        *r_blkno;
     int        *c_blkno;
     
@@ -179,25 +181,20 @@ heap_fileWrite(FileHandler handler, const PLBlock block, const char *filename, c
 		*/
 		heap_pageInit((Page) block->block, DUMMY_BLOCK, 0, BLCKSZ);
 	}
-	#ifndef CPAGES
-		page_encryption((unsigned char *) block->block, (unsigned char *) encPage);
-	#else
-		memcpy(encPage, block->block, BLCKSZ);
- 	#endif
+	encPage = pageio_encrypt((char *) block->block);
 
     c_blkno = (int*) PageGetSpecialPointer_s((Page) encPage);
     c_blkno[2] = block->location[0];
     c_blkno[3] = block->location[1];
 
-    status = outFileWrite(encPage, filename, ob_blkno, BLCKSZ);
-
-	
-	if (status != SGX_SUCCESS)
+	if (!pageio_write(encPage, filename, ob_blkno))
 	{
 		selog(ERROR, "Could not write %d on relation %s\n", ob_blkno, filename);
 	}
 
-	free(encPage);
+	#ifdef SEAL_STATE
+	snapshot_blockOut(filename, 0, block->blkno);
+	#endif
 }
 
 
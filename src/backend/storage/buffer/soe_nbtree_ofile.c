@@ -27,7 +27,10 @@
 #include "access/soe_nbtree.h"
 #include "logger/logger.h"
 #include "storage/soe_nbtree_ofile.h"
+#include "storage/soe_snapshot.h"
+#include "storage/soe_bulkload.h"
 #include "storage/soe_bufpage.h"
+#include "storage/soe_pageio.h"
 #include "common/soe_pe.h"
 
 #include <oram/plblock.h>
@@ -54,7 +57,18 @@ nbtree_pageInit(Page page, int blkno, unsigned int locationSize, Size blocksize)
     
     ovflopaque->location[0] = 0;
     ovflopaque->location[1] = 0;
-    memset(ovflopaque->counters,0, sizeof(uint32)*300);
+}
+
+/* Sets the block number and location of a block read from the file. */
+void
+nbtree_pageTag(PLBlock block)
+{
+	BTPageOpaque oopaque = (BTPageOpaque) PageGetSpecialPointer_s((Page) block->block);
+
+	block->blkno = oopaque->o_blkno;
+	block->size = BLCKSZ;
+	block->location[0] = oopaque->location[0];
+	block->location[1] = oopaque->location[1];
 }
 
 /**
@@ -76,7 +90,13 @@ nbtree_fileInit(const char *filename, unsigned int nblocks, unsigned int blocksi
 
 
 	status = SGX_SUCCESS;
-	
+
+	/* The file of a sealed state already holds the ORAM blocks. */
+	if (snapshot_restoring)
+		return NULL;
+
+	bulk_fileInit(filename, 0, nblocks);
+
     do
 	{
 		/* BTPageOpaque oopaque; */
@@ -117,47 +137,29 @@ nbtree_fileInit(const char *filename, unsigned int nblocks, unsigned int blocksi
 void
 nbtree_fileRead(FileHandler handler, PLBlock block, const char *filename, const BlockNumber ob_blkno, void *appData)
 {
-	sgx_status_t status;
-	BTPageOpaque oopaque;
-
 	/* selog(DEBUG1, "nbtree_fileRead %d", ob_blkno); */
-	status = SGX_SUCCESS;
-	char	   *ciphertextBlock;
-
 	block->block = (void *) malloc(BLCKSZ);
-	ciphertextBlock = (char *) malloc(BLCKSZ);
 
-	status = outFileRead(ciphertextBlock, filename, ob_blkno, BLCKSZ);
-	#ifndef CPAGES
-		page_decryption((unsigned char *) ciphertextBlock, (unsigned char *) block->block);
-	#else
-    	memcpy(block->block, ciphertextBlock, BLCKSZ);
-	#endif
-
-	if (status != SGX_SUCCESS)
+	if (!pageio_read((char *) block->block, filename, ob_blkno))
 	{
 		selog(ERROR, "Could not read %d from relation %s", ob_blkno, filename);
 	}
 
-	oopaque = (BTPageOpaque) PageGetSpecialPointer_s((Page) block->block);
-	block->blkno = oopaque->o_blkno;
-	block->size = BLCKSZ;
-    block->location[0] = oopaque->location[0];
-    block->location[1] = oopaque->location[1];
-	free(ciphertextBlock);
+	nbtree_pageTag(block);
+
+	#ifdef SEAL_STATE
+	snapshot_blockIn(filename, 0, block);
+	#endif
 }
 
 
 void
 nbtree_fileWrite(FileHandler handler, const PLBlock block, const char *filename, const BlockNumber ob_blkno, void *appData)
 {
-	sgx_status_t status = SGX_SUCCESS;
     BTPageOpaque oopaque;
 
 	char	   *encpage;
 
-	encpage = (char *) malloc(BLCKSZ);
-
 	if (block->blkno == DUMMY_BLOCK)
 	{
 		/* selog(DEBUG1, "Requested write of DUMMY_BLOCK"); */
@@ -178,18 +180,16 @@ nbtree_fileWrite(FileHandler handler, const PLBlock block, const char *filename,
     oopaque->location[1] = block->location[1];
 
      
-	#ifndef CPAGES
-		page_encryption((unsigned char *) block->block, (unsigned char *) encpage);
-	#else
-		 memcpy(encpage, block->block, BLCKSZ);
-	#endif
-	status = outFileWrite(encpage, filename, ob_blkno, BLCKSZ);
+	encpage = pageio_encrypt((char *) block->block);
 
-	if (status != SGX_SUCCESS)
+	if (!pageio_write(encpage, filename, ob_blkno))
 	{
 		selog(ERROR, "Could not write %d on relation %s\n", ob_blkno, filename);
 	}
-	free(encpage);
+
+	#ifdef SEAL_STATE
+	snapshot_blockOut(filename, 0, block->blkno);
+	#endif
 }
 
 
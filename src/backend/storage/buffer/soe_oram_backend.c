@@ -0,0 +1,126 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_oram_backend.c
+ *	  Table of the ORAM constructions linked in the binary.
+ *
+ * The library selected with ORAM_LIB is linked as is and is the default
+ * backend. Each additional library listed in ORAM_LIBS is linked with all of
+ * its global symbols prefixed by its lower case name (pathoram_read_oram,
+ * tforestoram_init_oram, ...), which the Makefile does with objcopy, and is
+ * enabled here with a WITH_<NAME> flag.
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ * IDENTIFICATION
+ *        backend/storage/buffer/soe_oram_backend.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "storage/soe_oram_backend.h"
+#include "logger/logger.h"
+
+#include <string.h>
+
+#ifndef ORAM_LIB_NAME
+#define ORAM_LIB_NAME "ORAM"
+#endif
+
+#if defined TPATHORAM || defined TFORESTORAM
+#define ORAM_LIB_TOKENS true
+#else
+#define ORAM_LIB_TOKENS false
+#endif
+
+#define ORAM_BACKEND_DECLARE(prefix) \
+	extern ORAMState prefix##_init_oram(const char *, unsigned int, \
+										unsigned int, unsigned int, \
+										Amgr *, void *); \
+	extern int	prefix##_read_oram(char **, BlockNumber, ORAMState, void *); \
+	extern int	prefix##_write_oram(char *, unsigned int, BlockNumber, \
+									ORAMState, void *); \
+	extern void prefix##_close_oram(ORAMState, void *); \
+	extern void prefix##_setToken(ORAMState, unsigned int *); \
+	extern void prefix##_logStashes(ORAMState); \
+	extern Stash *prefix##_stashCreate(void); \
+	extern PMap *prefix##_pmapCreate(void);
+
+#define ORAM_BACKEND_ENTRY(name, tokens, prefix) \
+	{name, tokens, &prefix##_init_oram, &prefix##_read_oram, \
+	 &prefix##_write_oram, &prefix##_close_oram, &prefix##_setToken, \
+	 &prefix##_logStashes, &prefix##_stashCreate, &prefix##_pmapCreate}
+
+#ifdef WITH_PATHORAM
+ORAM_BACKEND_DECLARE(pathoram)
+#endif
+#ifdef WITH_FORESTORAM
+ORAM_BACKEND_DECLARE(forestoram)
+#endif
+#ifdef WITH_TPATHORAM
+ORAM_BACKEND_DECLARE(tpathoram)
+#endif
+#ifdef WITH_TFORESTORAM
+ORAM_BACKEND_DECLARE(tforestoram)
+#endif
+#ifdef WITH_DPATHORAM
+ORAM_BACKEND_DECLARE(dpathoram)
+#endif
+#ifdef WITH_DFORESTORAM
+ORAM_BACKEND_DECLARE(dforestoram)
+#endif
+#ifdef WITH_DTPATHORAM
+ORAM_BACKEND_DECLARE(dtpathoram)
+#endif
+#ifdef WITH_DTFORESTORAM
+ORAM_BACKEND_DECLARE(dtforestoram)
+#endif
+
+static const ORAMBackend backends[] = {
+	{ORAM_LIB_NAME, ORAM_LIB_TOKENS, &init_oram, &read_oram, &write_oram,
+	&close_oram, &setToken, &logStashes, &stashCreate, &pmapCreate},
+#ifdef WITH_PATHORAM
+	ORAM_BACKEND_ENTRY("PATHORAM", false, pathoram),
+#endif
+#ifdef WITH_FORESTORAM
+	ORAM_BACKEND_ENTRY("FORESTORAM", false, forestoram),
+#endif
+#ifdef WITH_TPATHORAM
+	ORAM_BACKEND_ENTRY("TPATHORAM", true, tpathoram),
+#endif
+#ifdef WITH_TFORESTORAM
+	ORAM_BACKEND_ENTRY("TFORESTORAM", true, tforestoram),
+#endif
+#ifdef WITH_DPATHORAM
+	ORAM_BACKEND_ENTRY("DPATHORAM", false, dpathoram),
+#endif
+#ifdef WITH_DFORESTORAM
+	ORAM_BACKEND_ENTRY("DFORESTORAM", false, dforestoram),
+#endif
+#ifdef WITH_DTPATHORAM
+	ORAM_BACKEND_ENTRY("DTPATHORAM", true, dtpathoram),
+#endif
+#ifdef WITH_DTFORESTORAM
+	ORAM_BACKEND_ENTRY("DTFORESTORAM", true, dtforestoram),
+#endif
+};
+
+#define NBACKENDS (sizeof(backends) / sizeof(ORAMBackend))
+
+
+const ORAMBackend *
+GetORAMBackend(const char *name)
+{
+	unsigned int i;
+
+	if (name == NULL || name[0] == '\0')
+		return &backends[0];
+
+	for (i = 0; i < NBACKENDS; i++)
+	{
+		if (strcmp(backends[i].name, name) == 0)
+			return &backends[i];
+	}
+
+	selog(ERROR, "ORAM backend %s is not linked", name);
+	return NULL;
+}
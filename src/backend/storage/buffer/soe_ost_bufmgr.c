@@ -1,6 +1,7 @@
 
 #include "storage/soe_ost_bufmgr.h"
 #include "access/soe_skey.h"
+#include "access/soe_nbtcompare.h"
 #include "logger/logger.h"
 #include "storage/soe_heap_ofile.h"
 #include "storage/soe_ost_ofile.h"
@@ -34,17 +35,86 @@ InitOSTRelation(OSTreeState relstate, unsigned int oid, char *attrDesc, unsigned
 	}
 
 	rel->tDesc = (TupleDesc) malloc(sizeof(struct tupleDesc));
-	rel->tDesc->natts = 1;
-	rel->tDesc->attrs = (FormData_pg_attribute *) malloc(sizeof(struct FormData_pg_attribute));
-	memcpy(rel->tDesc->attrs, attrDesc, attrDescLength);
+	rel->keycmp = _bt_initkeydesc_s(rel->tDesc, attrDesc, attrDescLength);
     
     rel->token = NULL;
     rel->leafCurrentCounter = 0;
     rel->heapBlockCounter = 0;
+    list_new(&(rel->pending));
+
+	rel->bulks = (BulkLoad *) malloc(sizeof(BulkLoad) * (relstate->nlevels + 1));
+	for (loffset = 0; loffset < relstate->nlevels + 1; loffset++)
+	{
+		rel->bulks[loffset] = NULL;
+	}
+	rel->levelBlocks = (int *) calloc(relstate->nlevels + 1, sizeof(int));
 
 	return rel;
 }
 
+static void
+WritePage_ost(OSTRelation relation, int clevel, int id, char *page,
+			  unsigned int *token)
+{
+	int			result;
+	ORAMState	oram = relation->osts->orams[clevel - 1];
+
+	#ifdef SEAL_STATE
+	snapshot_blockWrite(oram, id);
+	#endif
+	relation->osts->backend->settoken(oram, token);
+	result = relation->osts->backend->write(page, BLCKSZ, id, oram, &clevel);
+
+	if (result != BLCKSZ)
+	{
+		selog(ERROR, "Write failed to write a complete page");
+	}
+}
+
+/*
+ * Evicts up to maxWrites queued writes (all of them if maxWrites is negative)
+ * in the order they were queued. Returns the number of writes still queued.
+ */
+int
+FlushWrites_ost(OSTRelation rel, int maxWrites)
+{
+	void	   *element;
+	OSTPendingWrite pw;
+
+	while (maxWrites != 0 && list_size(rel->pending) > 0)
+	{
+		list_remove_first(rel->pending, &element);
+		pw = (OSTPendingWrite) element;
+		WritePage_ost(rel, pw->level, pw->id, pw->page,
+					  pw->hasToken ? pw->token : NULL);
+		free(pw->page);
+		free(pw);
+		if (maxWrites > 0)
+			maxWrites--;
+	}
+
+	return list_size(rel->pending);
+}
+
+/* Same as FindPendingWrite_s for the block blkno of level clevel. */
+static OSTPendingWrite
+FindPendingWrite_ost(OSTRelation rel, int clevel, BlockNumber blkno)
+{
+	ListIter	iter;
+	void	   *element;
+	OSTPendingWrite pw;
+	OSTPendingWrite last = NULL;
+
+	list_iter_init(&iter, rel->pending);
+	while (list_iter_next(&iter, &element) != CC_ITER_END)
+	{
+		pw = (OSTPendingWrite) element;
+		if (pw->level == clevel && pw->id == blkno)
+			last = pw;
+	}
+	return last;
+}
+
 Buffer ReadDummyBuffer_ost(OSTRelation relation, int treeLevel, 
                            BlockNumber blkno){
     int result = 0;
@@ -65,8 +135,10 @@ Buffer ReadDummyBuffer_ost(OSTRelation relation, int treeLevel,
 		ost_fileRead(NULL, plblock, relation->osts->iname, blkno, &clevel);
 	    free(plblock);
         result = plblock->size;
-    }else{
-        result = read_oram(&page, blkno, relation->osts->orams[clevel - 1], &clevel);
+    }else if(relation->bulks[clevel] == NULL){
+        result = relation->osts->backend->read(&page, blkno,
+                                               relation->osts->orams[clevel - 1],
+                                               &clevel);
         free(page); 
     }
     #endif
@@ -86,6 +158,9 @@ ReadBuffer_ost(OSTRelation relation, BlockNumber blockNum)
 	int			clevel = relation->level;
 	PLBlock		plblock = NULL;
     ORAMState   oram = NULL;
+    #ifdef DEFERRED_WB
+    OSTPendingWrite pw;
+    #endif
 
 	/*
 	 * This code assumes that there are no consecutive accesses to read the
@@ -106,13 +181,22 @@ ReadBuffer_ost(OSTRelation relation, BlockNumber blockNum)
 		page = plblock->block;
 		free(plblock);
 	}
+	else if (relation->bulks[clevel] != NULL)
+	{
+		/* Bulk loaded pages stay in the enclave until endBulkLoad. */
+		page = (char *) malloc(BLCKSZ);
+		if (bulk_getPage(relation->bulks[clevel], blockNum) != NULL)
+			memcpy(page, bulk_getPage(relation->bulks[clevel], blockNum), BLCKSZ);
+		else
+			memset(page, 0, BLCKSZ);
+	}
 	else
 	{
         oram = relation->osts->orams[clevel-1];
         
-        setToken(oram, relation->token);
+        relation->osts->backend->settoken(oram, relation->token);
         //selog(DEBUG1, "Read oram ost block %d at level %d", blockNum, clevel);
-		result = read_oram(&page, blockNum, oram, &clevel);
+		result = relation->osts->backend->read(&page, blockNum, oram, &clevel);
 
 		/**
          *  When the read returns a DUMMY_BLOCK page  it means its the
@@ -125,6 +209,13 @@ ReadBuffer_ost(OSTRelation relation, BlockNumber blockNum)
 			page = (char *) malloc(BLCKSZ);
 			memset(page, 0, BLCKSZ);
 		}
+
+        #ifdef DEFERRED_WB
+        /* the queued page is newer, see ReadBuffer_s */
+        pw = FindPendingWrite_ost(relation, clevel, blockNum);
+        if (pw != NULL)
+            memcpy(page, pw->page, BLCKSZ);
+        #endif
 	}
 
 	OSTVBlock	block = (OSTVBlock) malloc(sizeof(struct OSTVBlock));
@@ -172,7 +263,6 @@ MarkBufferDirty_ost(OSTRelation relation, Buffer buffer)
 
 	result = 0;
 	int			clevel = relation->level;
-    ORAMState   oram = NULL;
 	/* OblivPageOpaque oopaque; */
 
 	list_iter_init(&iter, relation->buffers[clevel]);
@@ -202,11 +292,37 @@ MarkBufferDirty_ost(OSTRelation relation, Buffer buffer)
 			free(block);
             result = BLCKSZ;
 		}
+		else if (relation->bulks[clevel] != NULL)
+		{
+			bulk_setPage(relation->bulks[clevel], vblock->id, vblock->page);
+			result = BLCKSZ;
+		}
 		else
 		{
-            oram = relation->osts->orams[clevel - 1];
-            setToken(oram, relation->token);
-			result = write_oram(vblock->page, BLCKSZ, vblock->id, oram ,&clevel);
+            #ifdef DEFERRED_WB
+            /* DEFERRED_WB applies to the token based ORAMs (see the Makefile). */
+            if (relation->osts->backend->tokens)
+            {
+                OSTPendingWrite pw = (OSTPendingWrite) malloc(sizeof(struct OSTPendingWrite));
+
+                pw->id = vblock->id;
+                pw->level = clevel;
+                pw->page = (char *) malloc(BLCKSZ);
+                memcpy(pw->page, vblock->page, BLCKSZ);
+                pw->hasToken = relation->token != NULL;
+                if (pw->hasToken)
+                    memcpy(pw->token, relation->token, sizeof(unsigned int) * ORAM_TOKEN_SIZE);
+                list_add(relation->pending, pw);
+
+                if (list_size(relation->pending) > MAX_PENDING_WRITES)
+                    FlushWrites_ost(relation, list_size(relation->pending) - MAX_PENDING_WRITES);
+            }
+            else
+                WritePage_ost(relation, clevel, vblock->id, vblock->page, relation->token);
+            #else
+            WritePage_ost(relation, clevel, vblock->id, vblock->page, relation->token);
+            #endif
+            result = BLCKSZ;
 		}
 	}
 	else
@@ -272,16 +388,45 @@ destroyOSTVBlock(void *block)
 	free(block);
 }
 
+/* Same as SaveVRelation_s, including the layout of the levels on the file. */
+void
+SaveOSTRelation_ost(OSTRelation rel, Snapshot snap)
+{
+	snapshot_putInt(snap, rel->level);
+	snapshot_putInt(snap, rel->leafCurrentCounter);
+	snapshot_putInt(snap, rel->heapBlockCounter);
+	snapshot_put(snap, rel->levelBlocks, sizeof(int) * (rel->osts->nlevels + 1));
+	ost_saveOffsets(rel->osts, snap);
+}
+
+bool
+RestoreOSTRelation_ost(OSTRelation rel, Snapshot snap)
+{
+	rel->level = snapshot_getInt(snap);
+	rel->leafCurrentCounter = snapshot_getInt(snap);
+	rel->heapBlockCounter = snapshot_getInt(snap);
+	snapshot_get(snap, rel->levelBlocks, sizeof(int) * (rel->osts->nlevels + 1));
+
+	return ost_restoreOffsets(rel->osts, snap) && !snap->failed;
+}
+
 void
 closeOSTRelation(OSTRelation rel)
 {
 	int			l;
 
+	FlushWrites_ost(rel, -1);
+	list_destroy(rel->pending);
 
 	for (l = 0; l < rel->osts->nlevels; l++)
 	{
-		close_oram(rel->osts->orams[l], NULL);
+		rel->osts->backend->close(rel->osts->orams[l], NULL);
+		#ifdef SEAL_STATE
+		snapshot_unregisterORAM(rel->osts->orams[l]);
+		#endif
 	}
+	free(rel->bulks);
+	free(rel->levelBlocks);
 	free(rel->osts->orams);
 	free(rel->osts->fanouts);
 	free(rel->osts->iname);
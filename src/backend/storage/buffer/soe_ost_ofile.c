@@ -26,7 +26,9 @@
 
 #include "logger/logger.h"
 #include "storage/soe_ost_ofile.h"
+#include "storage/soe_bulkload.h"
 #include "storage/soe_bufpage.h"
+#include "storage/soe_pageio.h"
 #include "common/soe_pe.h"
 #include "access/soe_ost.h"
 
@@ -35,13 +37,64 @@
 #include <stdlib.h>
 
 
-OSTreeState ostate;
+/*
+ * Layout of the file of an OST index: the root block followed by the blocks
+ * of every level ORAM. Each index attached to the table has its own file.
+ */
+typedef struct OSTFile
+{
+	char	   *name;
+	int			nlevels;
+	unsigned int init_offset;
+	/* number of blocks requested to be allocated for each oram level. */
+	int		   *o_nblocks;
+	struct OSTFile *next;
+}		   *OSTFile;
+
+static OSTFile ostFiles = NULL;
 
-unsigned int init_offset;
 
-/* number of blocks requested to be allocated for each oram level. */
-int		   *o_nblocks;
+static OSTFile
+ost_findFile(const char *filename)
+{
+	OSTFile		file;
 
+	for (file = ostFiles; file != NULL; file = file->next)
+	{
+		if (strcmp(file->name, filename) == 0)
+			return file;
+	}
+	return NULL;
+}
+
+static OSTFile
+ost_getFile(const char *filename)
+{
+	OSTFile		file = ost_findFile(filename);
+
+	if (file == NULL)
+		selog(ERROR, "Unknown OST index file %s", filename);
+	return file;
+}
+
+/* Offset on the file of the first block of a level ORAM. */
+static unsigned int
+ost_levelOffset(OSTFile file, int clevel)
+{
+	unsigned int l_offset = 0;
+	unsigned int l_index;
+
+	if (clevel > 0)
+	{
+		l_offset = 1;
+		/* Fanout of previous levels */
+		for (l_index = 0; l_index < clevel - 1; l_index++)
+		{
+			l_offset += file->o_nblocks[l_index];
+		}
+	}
+	return l_offset;
+}
 
 
 void init_root(const char* filename){
@@ -49,10 +102,28 @@ void init_root(const char* filename){
     char	    *tmpPage;
     char        *destPage;
     sgx_status_t status;
+    OSTFile     file;
     
 
     status = SGX_SUCCESS;
 
+    file = ost_findFile(filename);
+    if (file == NULL)
+    {
+        file = (OSTFile) malloc(sizeof(struct OSTFile));
+        file->name = strdup(filename);
+        file->nlevels = 0;
+        file->init_offset = 0;
+        file->o_nblocks = NULL;
+        file->next = ostFiles;
+        ostFiles = file;
+    }
+
+    if (snapshot_restoring)
+    {
+        file->init_offset++;
+        return;
+    }
 
     tmpPage = malloc(BLCKSZ);
     destPage = malloc(BLCKSZ);
@@ -74,15 +145,17 @@ void init_root(const char* filename){
 
     free(tmpPage);
     free(destPage);
-    init_offset++;
+    file->init_offset++;
 
 }
 
 void
 ost_status(OSTreeState state)
 {
-	ostate = state;
-   o_nblocks = (int *) malloc(sizeof(int) * ostate->nlevels); 
+	OSTFile		file = ost_getFile(state->iname);
+
+	file->nlevels = state->nlevels;
+	file->o_nblocks = (int *) malloc(sizeof(int) * state->nlevels);
 }
 
 void
@@ -102,7 +175,6 @@ ost_pageInit(Page page, int blkno, Size blocksize)
 
     ovflopaque->location[0] = 0;
     ovflopaque->location[1] = 0;
-    memset(ovflopaque->counters, 0, sizeof(uint32)*300);
 }
 
 /**
@@ -126,12 +198,24 @@ ost_fileInit(const char *filename, unsigned int nblocks,
 
 	int         offset;
 	int			allocBlocks = 0;
-	int			boffset = init_offset;
 	int			clevel = *((int *) appData);
+	OSTFile		file = ost_getFile(filename);
+	int			boffset = file->init_offset;
     
 
     selog(DEBUG1, "request ost_fileInit of %d nblocks\n", nblocks);
 
+    /* The file of a sealed state already holds the level blocks. */
+    if (snapshot_restoring)
+    {
+        file->init_offset += nblocks;
+        file->o_nblocks[clevel] = nblocks;
+        return NULL;
+    }
+
+    /* Reads and writes identify the levels starting from 1. */
+    bulk_fileInit(filename, clevel + 1, nblocks);
+
     do
     {
 	    allocBlocks = Min_s(tnblocks, BATCH_SIZE);
@@ -164,9 +248,9 @@ ost_fileInit(const char *filename, unsigned int nblocks,
 			boffset += BATCH_SIZE;
 	} while (tnblocks > 0);
 
-    init_offset += nblocks;
-    selog(DEBUG1, "Init offset is at %d\n", init_offset);
-	o_nblocks[clevel] = nblocks;
+    file->init_offset += nblocks;
+    selog(DEBUG1, "Init offset is at %d\n", file->init_offset);
+	file->o_nblocks[clevel] = nblocks;
 
     return NULL;
 }
@@ -175,42 +259,17 @@ ost_fileInit(const char *filename, unsigned int nblocks,
 void
 ost_fileRead(FileHandler handler, PLBlock block, const char *filename, const BlockNumber ob_blkno, void *appData)
 {
-	sgx_status_t status;
 	BTPageOpaqueOST oopaque;
 	int			clevel = *((int *) appData);
-
-	status = SGX_SUCCESS;
-	char	   *ciphertextBlock;
-	unsigned int l_offset = 0;
-	unsigned int l_index;
 	unsigned int l_ob_blkno = 0;
 
     //We calculate an offset of where each level start as all of the levels
     //are stored in a single file, even tough they are indepedent ORAMS.
-	if (clevel > 0)
-	{
-		l_offset = 1;
-		/* Fanout of previous levels */
-		for (l_index = 0; l_index < clevel - 1; l_index++)
-		{
-			l_offset += o_nblocks[l_index];
-		}
-	}
-
-	l_ob_blkno = ob_blkno + l_offset;
+	l_ob_blkno = ob_blkno + ost_levelOffset(ost_getFile(filename), clevel);
 
 	block->block = (void *) malloc(BLCKSZ);
-	ciphertextBlock = (char *) malloc(BLCKSZ);
-
-	status = outFileRead(ciphertextBlock, filename, l_ob_blkno, BLCKSZ);
 
-	#ifndef CPAGES
-		page_decryption((unsigned char *) ciphertextBlock, (unsigned char *) block->block);
-	#else
-    	memcpy(block->block, ciphertextBlock, BLCKSZ);
-	#endif
-    
-	if (status != SGX_SUCCESS)
+	if (!pageio_read((char *) block->block, filename, l_ob_blkno))
 	{
 		selog(ERROR, "Could not read %d from relation %s\n", ob_blkno, filename);
 	}
@@ -220,8 +279,10 @@ ost_fileRead(FileHandler handler, PLBlock block, const char *filename, const Blo
 	block->size = BLCKSZ;
     block->location[0] = oopaque->location[0];
     block->location[1] = oopaque->location[1];
-	free(ciphertextBlock);
 
+	#ifdef SEAL_STATE
+	snapshot_blockIn(filename, clevel, block);
+	#endif
 }
 
 
@@ -229,28 +290,12 @@ void
 ost_fileWrite(FileHandler handler, const PLBlock block, const char *filename, const BlockNumber ob_blkno, void *appData)
 {
 
-	sgx_status_t status = SGX_SUCCESS;
 	BTPageOpaqueOST oopaque = NULL;
 	char	   *encpage;
-	unsigned int l_offset = 0;
-	unsigned int l_index;
 	unsigned int l_ob_blkno = 0;
 	int			clevel = *((int *) appData);
 
-	if (clevel > 0)
-	{
-		l_offset = 1;
-
-		/* Fanout of previous levels */
-		for (l_index = 0; l_index < clevel - 1; l_index++)
-		{
-			l_offset += o_nblocks[l_index];
-		}
-	}
-
-	l_ob_blkno = ob_blkno + l_offset;
-
-	encpage = (char *) malloc(BLCKSZ);
+	l_ob_blkno = ob_blkno + ost_levelOffset(ost_getFile(filename), clevel);
 
 	if (block->blkno == DUMMY_BLOCK)
 	{
@@ -269,19 +314,16 @@ ost_fileWrite(FileHandler handler, const PLBlock block, const char *filename, co
     oopaque->location[0] = block->location[0];
     oopaque->location[1] = block->location[1];
 
-	#ifndef CPAGES
-		page_encryption((unsigned char *) block->block, (unsigned char *) encpage);
-	#else
- 		memcpy(encpage, block->block, BLCKSZ);
-	#endif
+	encpage = pageio_encrypt((char *) block->block);
 
-    status = outFileWrite(encpage, filename, l_ob_blkno, BLCKSZ);
-
-	if (status != SGX_SUCCESS)
+	if (!pageio_write(encpage, filename, l_ob_blkno))
 	{
 		selog(ERROR, "Could not write %d on relation %s\n", ob_blkno, filename);
 	}
-	free(encpage);
+
+	#ifdef SEAL_STATE
+	snapshot_blockOut(filename, clevel, block->blkno);
+	#endif
 }
 
 
@@ -289,10 +331,18 @@ void
 ost_fileClose(FileHandler handler, const char *filename, void *appData)
 {
 	sgx_status_t status = SGX_SUCCESS;
-    if(o_nblocks != NULL){
+	OSTFile		file = ost_findFile(filename);
+	OSTFile    *prev;
+
+	/* Every level ORAM closes the file, which is closed by the first. */
+    if(file != NULL){
 	    status = outFileClose(filename);
-        free(o_nblocks);
-        o_nblocks = NULL;
+        for (prev = &ostFiles; *prev != file; prev = &(*prev)->next)
+            ;
+        *prev = file->next;
+        free(file->o_nblocks);
+        free(file->name);
+        free(file);
 	    if (status != SGX_SUCCESS)
 	    {
 		    selog(ERROR, "Could not close relation %s\n", filename);
@@ -301,6 +351,31 @@ ost_fileClose(FileHandler handler, const char *filename, void *appData)
 }
 
 
+/* Offsets of the level ORAMs on the index file. */
+void
+ost_saveOffsets(OSTreeState state, Snapshot snap)
+{
+	OSTFile		file = ost_getFile(state->iname);
+
+	snapshot_putInt(snap, file->init_offset);
+	snapshot_putInt(snap, file->nlevels);
+	snapshot_put(snap, file->o_nblocks, sizeof(int) * file->nlevels);
+}
+
+bool
+ost_restoreOffsets(OSTreeState state, Snapshot snap)
+{
+	OSTFile		file = ost_getFile(state->iname);
+
+	file->init_offset = snapshot_getInt(snap);
+	if (snapshot_getInt(snap) != file->nlevels)
+	{
+		selog(ERROR, "Sealed index levels do not match %d", file->nlevels);
+		return false;
+	}
+	return snapshot_get(snap, file->o_nblocks, sizeof(int) * file->nlevels);
+}
+
 
 AMOFile *
 ost_ofileCreate()
@@ -0,0 +1,147 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_pageio.c
+ *	  Encrypted page I/O of the oblivious files.
+ *
+ * Each ofile used to read a page into a ciphertext page marshalled by the
+ * ocall and decrypt it into a second page, and to encrypt a page into a
+ * fresh ciphertext page marshalled again by the ocall, so a page was copied
+ * three or four times per access. Here a read decrypts in place in the
+ * block the ORAM library gets, and a write encrypts into a single page
+ * buffer that is kept for every write.
+ *
+ * If the host registers an untrusted buffer of at least a page with
+ * setIOBuffer, the direct ocalls read and write the pages there instead,
+ * without marshalling: a read decrypts from the host buffer straight into
+ * the block and a write encrypts straight into the host buffer, so a page
+ * crosses the enclave boundary once. The buffer is checked to be outside
+ * the enclave when it is registered, as the ocalls take it unchecked. The
+ * host could change the ciphertext while it is decrypted, which is no more
+ * than it can do to the file.
+ *
+ * The enclave serves one request at a time, so a single buffer is enough.
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ * IDENTIFICATION
+ *        backend/storage/buffer/soe_pageio.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifdef UNSAFE
+#include "Enclave_dt.h"
+#else
+#include "sgx_trts.h"
+#include "Enclave_t.h"
+#endif
+
+#include "logger/logger.h"
+#include "storage/soe_pageio.h"
+#include "common/soe_pe.h"
+
+#include <string.h>
+#include <stdint.h>
+
+
+/* Untrusted page buffer of the host, NULL if none was registered. */
+static char *hostBuffer = NULL;
+
+/* Page the writes are encrypted into without a host buffer. */
+static PGAlignedBlock encBuffer;
+
+
+/*
+ * Registers the untrusted buffer of size bytes the pages are exchanged
+ * through, or unregisters it if buffer is NULL. The buffer must be outside
+ * the enclave, maxaligned and hold a page.
+ */
+bool
+pageio_setBuffer(char *buffer, unsigned int size)
+{
+	if (buffer == NULL)
+	{
+		hostBuffer = NULL;
+		return true;
+	}
+
+	if (size < BLCKSZ || (uintptr_t) buffer != MAXALIGN_s(buffer))
+	{
+		selog(ERROR, "I/O buffer of %u bytes is too small or not aligned", size);
+		return false;
+	}
+
+#ifndef UNSAFE
+	if (!sgx_is_outside_enclave(buffer, size))
+	{
+		selog(ERROR, "I/O buffer is not outside the enclave");
+		return false;
+	}
+#endif
+
+	hostBuffer = buffer;
+	return true;
+}
+
+/*
+ * Reads block blkno of a file and decrypts it into page. Returns false if
+ * the block could not be read.
+ */
+bool
+pageio_read(char *page, const char *filename, int blkno)
+{
+	sgx_status_t status;
+
+	if (hostBuffer != NULL)
+	{
+		status = outFileReadDirect(hostBuffer, filename, blkno, BLCKSZ);
+#ifndef CPAGES
+		page_decryption((unsigned char *) hostBuffer, (unsigned char *) page);
+#else
+		memcpy(page, hostBuffer, BLCKSZ);
+#endif
+	}
+	else
+	{
+		status = outFileRead(page, filename, blkno, BLCKSZ);
+#ifndef CPAGES
+		page_decryption((unsigned char *) page, (unsigned char *) page);
+#endif
+	}
+
+	return status == SGX_SUCCESS;
+}
+
+/*
+ * Encrypts a page into the buffer pageio_write writes from and returns the
+ * buffer. The page is left as it is.
+ */
+char *
+pageio_encrypt(char *page)
+{
+	char	   *encPage = hostBuffer != NULL ? hostBuffer : encBuffer.data;
+
+#ifndef CPAGES
+	page_encryption((unsigned char *) page, (unsigned char *) encPage);
+#else
+	memcpy(encPage, page, BLCKSZ);
+#endif
+	return encPage;
+}
+
+/*
+ * Writes the page encrypted by pageio_encrypt on block blkno of a file.
+ * Returns false if the block could not be written.
+ */
+bool
+pageio_write(char *encPage, const char *filename, int blkno)
+{
+	sgx_status_t status;
+
+	if (encPage == hostBuffer)
+		status = outFileWriteDirect(encPage, filename, blkno, BLCKSZ);
+	else
+		status = outFileWrite(encPage, filename, blkno, BLCKSZ);
+
+	return status == SGX_SUCCESS;
+}
@@ -0,0 +1,488 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_pmap.c
+ *	  Position maps given to the ORAM library for the constructions without
+ *	  tokens.
+ *
+ * The position map stores the leaf of every ORAM block. Small maps are kept
+ * in the enclave as a bit-packed array whose entries are as wide as the
+ * largest leaf stored so far. Maps of ORAMs with more than PMAP_THRESHOLD
+ * blocks are recursive: the packed entries are stored on the pages of a
+ * smaller ORAM, outside of the enclave memory, whose own position map is
+ * again chosen by size.
+ *
+ * The ORAM library reads the position of the block it accesses and then
+ * updates it with the new leaf. A recursive map does one access to its ORAM
+ * on every read and one on every update, reusing on the update the page read
+ * just before, so the number of accesses does not depend on the blocks.
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ * IDENTIFICATION
+ *        backend/storage/buffer/soe_pmap.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "storage/soe_pmap.h"
+#include "storage/soe_heap_ofile.h"
+#include "storage/soe_bufpage.h"
+#include "logger/logger.h"
+
+#include <oram/plblock.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+/* Entries of a recursive map stored on each page of its ORAM. */
+#define RPMAP_ENTRIES_PER_PAGE \
+	((BLCKSZ - MAXALIGN_s(SizeOfPageHeaderData) - MAXALIGN_s(sizeof(int) * 4)) \
+	 / sizeof(TreePath))
+
+/* Bucket capacity of the ORAMs storing recursive maps. */
+#define RPMAP_BKCAP 4
+
+#define PMAP_NAME_SIZE 256
+
+struct PMapState
+{
+	bool		recursive;
+
+	/* bit-packed map */
+	uint64	   *words;
+	unsigned int nentries;
+	unsigned int width;
+
+	/* recursive map */
+	char	   *name;
+	const ORAMBackend *backend;
+	ORAMState	oram;
+	Amgr	   *amgr;
+	BlockNumber cachedBlkno;
+	char	   *cachedPage;
+
+	/* maps in use, or loaded from a sealed state and not yet used */
+	struct PMapState *next;
+};
+
+/*
+ * The PMap interface does not carry any application data, so the name of the
+ * relation and its backend are handed over from soe_pmapCreate to the
+ * pminit call made by the init of the same ORAM.
+ */
+static char pendingName[PMAP_NAME_SIZE];
+static const ORAMBackend *pendingBackend = NULL;
+
+static PMapState maps = NULL;
+static PMapState loadedMaps = NULL;
+
+
+static unsigned int
+bits_for(unsigned long long value)
+{
+	unsigned int bits = 1;
+
+	while (bits < 32 && (value >> bits) != 0)
+		bits++;
+	return bits;
+}
+
+/*
+ * Width of the entries of a packed map for a tree of treeHeight levels below
+ * the root, whose leaves are numbered from 0 to 2^treeHeight - 1.
+ */
+static unsigned int
+compact_width(unsigned int treeHeight)
+{
+	return Max_s(treeHeight, 1);
+}
+
+static TreePath
+compact_get(PMapState state, BlockNumber blkno)
+{
+	unsigned long long bit = (unsigned long long) blkno * state->width;
+	unsigned int word = bit / 64;
+	unsigned int shift = bit % 64;
+	uint64		mask = (((uint64) 1) << state->width) - 1;
+	uint64		value;
+
+	value = state->words[word] >> shift;
+	if (shift + state->width > 64)
+		value |= state->words[word + 1] << (64 - shift);
+
+	return (TreePath) (value & mask);
+}
+
+static void
+compact_set(PMapState state, BlockNumber blkno, TreePath leaf)
+{
+	unsigned long long bit = (unsigned long long) blkno * state->width;
+	unsigned int word = bit / 64;
+	unsigned int shift = bit % 64;
+	uint64		mask = (((uint64) 1) << state->width) - 1;
+
+	state->words[word] &= ~(mask << shift);
+	state->words[word] |= ((uint64) leaf & mask) << shift;
+
+	if (shift + state->width > 64)
+	{
+		state->words[word + 1] &= ~(mask >> (64 - shift));
+		state->words[word + 1] |= ((uint64) leaf & mask) >> (64 - shift);
+	}
+}
+
+/*
+ * Repacks the map with entries of width bits for at least nentries blocks.
+ * The map grows when the ORAM stores a leaf or a block number larger than
+ * the ones expected from the sizes given to pminit.
+ */
+static void
+compact_resize(PMapState state, unsigned int nentries, unsigned int width)
+{
+	struct PMapState old = *state;
+	size_t		nwords;
+	BlockNumber blkno;
+
+	nwords = ((unsigned long long) nentries * width + 63) / 64 + 1;
+	state->words = (uint64 *) malloc(sizeof(uint64) * nwords);
+	memset(state->words, 0, sizeof(uint64) * nwords);
+	state->nentries = nentries;
+	state->width = width;
+
+	if (old.words != NULL)
+	{
+		for (blkno = 0; blkno < old.nentries; blkno++)
+			compact_set(state, blkno, compact_get(&old, blkno));
+		free(old.words);
+	}
+}
+
+static char *
+rpmap_read(PMapState state, BlockNumber pblkno)
+{
+	char	   *page = NULL;
+	int			result;
+
+	result = state->backend->read(&page, pblkno, state->oram, NULL);
+
+	if (result == DUMMY_BLOCK)
+	{
+		/* First access to the page, every entry starts at leaf 0. */
+		page = (char *) malloc(BLCKSZ);
+		heap_pageInit((Page) page, pblkno, 0, BLCKSZ);
+		memset(PageGetContents_s(page), 0, RPMAP_ENTRIES_PER_PAGE * sizeof(TreePath));
+	}
+
+	if (state->cachedPage != NULL)
+		free(state->cachedPage);
+	state->cachedBlkno = pblkno;
+	state->cachedPage = page;
+
+	return page;
+}
+
+/* Removes and returns the map named name from the list head. */
+static PMapState
+unlink_map(PMapState *head, const char *name)
+{
+	PMapState	state;
+
+	for (; *head != NULL; head = &((*head)->next))
+	{
+		if (strcmp((*head)->name, name) == 0)
+		{
+			state = *head;
+			*head = state->next;
+			return state;
+		}
+	}
+	return NULL;
+}
+
+static PMapState
+pmap_init(unsigned int nblocks, unsigned int treeHeight)
+{
+	PMapState	state = unlink_map(&loadedMaps, pendingName);
+
+	if (state != NULL)
+	{
+		selog(DEBUG1, "Position map of %s restored", pendingName);
+		state->next = maps;
+		maps = state;
+		pendingBackend = NULL;
+		return state;
+	}
+
+	state = (PMapState) malloc(sizeof(struct PMapState));
+	memset(state, 0, sizeof(struct PMapState));
+	state->name = strdup(pendingName);
+
+	if (nblocks > PMAP_THRESHOLD && pendingBackend != NULL)
+	{
+		char		childName[PMAP_NAME_SIZE];
+		unsigned int npages;
+
+		state->recursive = true;
+		state->backend = pendingBackend;
+		state->cachedBlkno = InvalidBlockNumber;
+		state->cachedPage = NULL;
+
+		/* the pages also map the dummy block nblocks + 1 */
+		npages = (nblocks + 2 + RPMAP_ENTRIES_PER_PAGE - 1) / RPMAP_ENTRIES_PER_PAGE;
+		snprintf(childName, PMAP_NAME_SIZE, "%s_pmap", state->name);
+		selog(DEBUG1, "Position map of %s stored on %d blocks of %s",
+			  state->name, npages, childName);
+
+		state->amgr = (Amgr *) malloc(sizeof(Amgr));
+		state->amgr->am_stash = state->backend->stashcreate();
+		state->amgr->am_pmap = soe_pmapCreate(childName, state->backend);
+		state->amgr->am_ofile = heap_ofileCreate();
+		state->oram = state->backend->init(childName, npages, BLCKSZ,
+										   RPMAP_BKCAP, state->amgr, NULL);
+		#ifdef SEAL_STATE
+		snapshot_registerORAM(childName, 0, npages, state->oram, state->backend);
+		#endif
+	}
+	else
+	{
+		state->recursive = false;
+		state->words = NULL;
+		/*
+		 * Room for the dummy block nblocks + 1 read by the dummy accesses,
+		 * so that the map does not grow once the ORAM is in use and a sealed
+		 * state has the size counted by sealedStateSize.
+		 */
+		compact_resize(state, nblocks + 2, compact_width(treeHeight));
+	}
+
+	state->next = maps;
+	maps = state;
+	pendingBackend = NULL;
+	return state;
+}
+
+static TreePath
+pmap_get(PMapState state, BlockNumber blkno)
+{
+	char	   *page;
+
+	if (!state->recursive)
+	{
+		if (blkno >= state->nentries)
+			return 0;
+		return compact_get(state, blkno);
+	}
+
+	page = rpmap_read(state, blkno / RPMAP_ENTRIES_PER_PAGE);
+	return ((TreePath *) PageGetContents_s(page))[blkno % RPMAP_ENTRIES_PER_PAGE];
+}
+
+static void
+pmap_update(PMapState state, BlockNumber blkno, TreePath leaf)
+{
+	BlockNumber pblkno;
+	char	   *page;
+
+	if (!state->recursive)
+	{
+		if (blkno >= state->nentries || bits_for(leaf) > state->width)
+			compact_resize(state, Max_s(state->nentries, blkno + 1),
+						   Max_s(state->width, bits_for(leaf)));
+		compact_set(state, blkno, leaf);
+		return;
+	}
+
+	pblkno = blkno / RPMAP_ENTRIES_PER_PAGE;
+	if (state->cachedPage != NULL && state->cachedBlkno == pblkno)
+		page = state->cachedPage;
+	else
+		page = rpmap_read(state, pblkno);
+
+	((TreePath *) PageGetContents_s(page))[blkno % RPMAP_ENTRIES_PER_PAGE] = leaf;
+
+	#ifdef SEAL_STATE
+	snapshot_blockWrite(state->oram, pblkno);
+	#endif
+	if (state->backend->write(page, BLCKSZ, pblkno, state->oram, NULL) != BLCKSZ)
+	{
+		selog(ERROR, "Could not update position map of %s", state->name);
+	}
+
+	free(state->cachedPage);
+	state->cachedPage = NULL;
+	state->cachedBlkno = InvalidBlockNumber;
+}
+
+static void
+free_map(PMapState state)
+{
+	if (state->recursive)
+	{
+		if (state->cachedPage != NULL)
+			free(state->cachedPage);
+		free(state->amgr);
+	}
+	else
+	{
+		free(state->words);
+	}
+	free(state->name);
+	free(state);
+}
+
+static void
+pmap_destroy(PMapState state)
+{
+	unlink_map(&maps, state->name);
+	if (state->recursive)
+	{
+		state->backend->close(state->oram, NULL);
+		#ifdef SEAL_STATE
+		snapshot_unregisterORAM(state->oram);
+		#endif
+	}
+	free_map(state);
+}
+
+/*
+ * Creates the position map of the ORAM stored on the file name. Must be
+ * called right before the init of that ORAM.
+ */
+PMap *
+soe_pmapCreate(const char *name, const ORAMBackend *backend)
+{
+	PMap	   *pmap = (PMap *) malloc(sizeof(PMap));
+
+	pmap->pminit = &pmap_init;
+	pmap->pmget = &pmap_get;
+	pmap->pmupdate = &pmap_update;
+	pmap->pmdestroy = &pmap_destroy;
+
+	snprintf(pendingName, PMAP_NAME_SIZE, "%s", name);
+	pendingBackend = backend;
+
+	return pmap;
+}
+
+/*
+ * Sets the leaf of a block on the map named name, for blocks placed on the
+ * ORAM file without an access (see soe_bulkload.c).
+ */
+bool
+soe_pmapSet(const char *name, BlockNumber blkno, TreePath leaf)
+{
+	PMapState	state;
+
+	for (state = maps; state != NULL; state = state->next)
+	{
+		if (strcmp(state->name, name) == 0)
+		{
+			pmap_update(state, blkno, leaf);
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Enclave memory used by the position map of an ORAM with nblocks blocks,
+ * for a tree with at most a leaf per block. As in pmap_init, the map has
+ * room for the dummy block nblocks + 1.
+ */
+unsigned long long
+soe_pmapSize(unsigned int nblocks)
+{
+	unsigned int npages;
+	unsigned int treeHeight;
+
+	if (nblocks <= PMAP_THRESHOLD)
+	{
+		treeHeight = nblocks > 1 ? bits_for(nblocks - 1) : 0;
+		return ((unsigned long long) (nblocks + 2) * compact_width(treeHeight) + 7) / 8;
+	}
+
+	npages = (nblocks + 2 + RPMAP_ENTRIES_PER_PAGE - 1) / RPMAP_ENTRIES_PER_PAGE;
+	return BLCKSZ + soe_pmapSize(npages);
+}
+
+/*
+ * Writes the maps kept in the enclave. Recursive maps are stored on their
+ * own ORAM and only the map of its smallest ORAM is sealed.
+ */
+void
+soe_pmapSave(Snapshot snap)
+{
+	PMapState	state;
+	unsigned int nmaps = 0;
+
+	for (state = maps; state != NULL; state = state->next)
+		nmaps += !state->recursive;
+
+	snapshot_putInt(snap, nmaps);
+	for (state = maps; state != NULL; state = state->next)
+	{
+		if (state->recursive)
+			continue;
+		snapshot_putString(snap, state->name);
+		snapshot_putInt(snap, state->nentries);
+		snapshot_putInt(snap, state->width);
+		snapshot_put(snap, state->words, sizeof(uint64) *
+					 (((unsigned long long) state->nentries * state->width + 63) / 64 + 1));
+	}
+}
+
+bool
+soe_pmapLoad(Snapshot snap)
+{
+	PMapState	state;
+	unsigned int nmaps = snapshot_getInt(snap);
+	unsigned int m;
+	size_t		nwords;
+
+	for (m = 0; m < nmaps && !snap->failed; m++)
+	{
+		state = (PMapState) malloc(sizeof(struct PMapState));
+		memset(state, 0, sizeof(struct PMapState));
+		state->name = snapshot_getString(snap);
+		state->nentries = snapshot_getInt(snap);
+		state->width = snapshot_getInt(snap);
+
+		if (state->name == NULL || state->width == 0 || state->width > 32)
+		{
+			snap->failed = true;
+			free(state->name);
+			free(state);
+			break;
+		}
+
+		nwords = ((unsigned long long) state->nentries * state->width + 63) / 64 + 1;
+		state->words = (uint64 *) malloc(sizeof(uint64) * nwords);
+		snapshot_get(snap, state->words, sizeof(uint64) * nwords);
+
+		state->next = loadedMaps;
+		loadedMaps = state;
+	}
+
+	return !snap->failed;
+}
+
+/*
+ * Releases the loaded maps that were not used. Returns false if there was
+ * any, as the ORAMs of the sealed state were not all recreated.
+ */
+bool
+soe_pmapLoadDone(void)
+{
+	PMapState	state;
+	bool		used = loadedMaps == NULL;
+
+	while (loadedMaps != NULL)
+	{
+		state = loadedMaps;
+		loadedMaps = state->next;
+		selog(WARNING, "Sealed position map of %s was not restored", state->name);
+		free_map(state);
+	}
+
+	return used;
+}
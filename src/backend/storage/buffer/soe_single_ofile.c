@@ -0,0 +1,103 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_single_ofile.c
+ *     Oblivious file shared by the heap and the nbtree index (SINGLE_ORAM).
+ *
+ * With SINGLE_ORAM the table and the index are stored in a single ORAM. The
+ * heap blocks keep their block numbers and the index blocks are stored after
+ * them (see the blockOffset of the VRelation). Both kinds of pages go through
+ * this file, which tells them apart by the size of their special space and
+ * hands them to the heap or nbtree file functions. Free slots are heap dummy
+ * pages.
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ * IDENTIFICATION
+ *        backend/storage/buffer/soe_single_ofile.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifdef UNSAFE
+#include "Enclave_dt.h"
+#else
+#include "sgx_trts.h"
+#include "Enclave_t.h"
+#endif
+
+#include "access/soe_nbtree.h"
+#include "logger/logger.h"
+#include "storage/soe_single_ofile.h"
+#include "storage/soe_heap_ofile.h"
+#include "storage/soe_nbtree_ofile.h"
+#include "storage/soe_snapshot.h"
+#include "storage/soe_pageio.h"
+
+#include <oram/plblock.h>
+#include <string.h>
+#include <stdlib.h>
+
+
+static bool
+single_isIndexPage(Page page)
+{
+	/*
+	 * The special space of a heap page is the 16 bytes of heap_pageInit,
+	 * less than the btree opaque data that starts the special space of an
+	 * index page, with or without its counters (see BTPageGetCounters_s).
+	 */
+	return PageGetSpecialSize_s(page) >= MAXALIGN_s(sizeof(BTPageOpaqueData));
+}
+
+FileHandler
+single_fileInit(const char *filename, unsigned int nblocks, unsigned int blocksize,
+				unsigned int lsize, void *appData)
+{
+	return heap_fileInit(filename, nblocks, blocksize, lsize, appData);
+}
+
+
+void
+single_fileRead(FileHandler handler, PLBlock block, const char *filename, const BlockNumber ob_blkno, void *appData)
+{
+	block->block = (void *) malloc(BLCKSZ);
+
+	if (!pageio_read((char *) block->block, filename, ob_blkno))
+	{
+		selog(ERROR, "Could not read %d from relation %s\n", ob_blkno, filename);
+	}
+
+	if (single_isIndexPage((Page) block->block))
+		nbtree_pageTag(block);
+	else
+		heap_pageTag(block);
+
+	#ifdef SEAL_STATE
+	snapshot_blockIn(filename, 0, block);
+	#endif
+}
+
+
+void
+single_fileWrite(FileHandler handler, const PLBlock block, const char *filename, const BlockNumber ob_blkno, void *appData)
+{
+	if (block->blkno != DUMMY_BLOCK && single_isIndexPage((Page) block->block))
+		nbtree_fileWrite(handler, block, filename, ob_blkno, appData);
+	else
+		heap_fileWrite(handler, block, filename, ob_blkno, appData);
+}
+
+
+AMOFile *
+single_ofileCreate()
+{
+
+	AMOFile    *file = (AMOFile *) malloc(sizeof(AMOFile));
+
+	file->ofileinit = &single_fileInit;
+	file->ofileread = &single_fileRead;
+	file->ofilewrite = &single_fileWrite;
+	file->ofileclose = &heap_fileClose;
+	return file;
+
+}
@@ -0,0 +1,560 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_snapshot.c
+ *	  Serialization of the enclave state sealed by sealState.
+ *
+ * Besides the buffer used to write and read snapshots, this file tracks the
+ * blocks held in the stash of every ORAM. A block enters a stash when the
+ * ORAM reads it from its file (snapshot_blockIn) or when the SOE writes it
+ * (snapshot_blockWrite) and leaves it once the ORAM evicts it back to the
+ * file (snapshot_blockOut). Only the ids of the blocks are kept, in a hash
+ * table keyed by the ORAM and the block number.
+ *
+ * The ORAM library does not expose its stashes, so the state is only sealed
+ * once they are empty: snapshot_evictStashes makes SEAL_EVICT_ACCESSES dummy
+ * accesses to every ORAM, whatever its stash holds, and the seal fails if a
+ * block is still stashed. The sealed state then holds no blocks, and
+ * restoring it only checks that the same ORAMs were created.
+ *
+ * The dummy accesses are made to block nblocks + 1, which holds no data. The
+ * token based ORAMs only evict on a write, so on those the block is read and
+ * written back with the tokens of a counter kept per ORAM and sealed with
+ * the state. The block is not tracked, as it is never part of a relation.
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ * IDENTIFICATION
+ *        backend/storage/buffer/soe_snapshot.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "storage/soe_snapshot.h"
+#include "logger/logger.h"
+#include "common/soe_prf.h"
+
+#include <collectc/list.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SNAPSHOT_INITIAL_SIZE BLCKSZ
+
+/* Buckets of the table of stashed blocks, a power of two. */
+#define STASH_TABLE_SIZE 1024
+
+typedef struct TrackedORAM
+{
+	char	   *name;
+	int			level;
+	unsigned int nblocks;
+	ORAMState	oram;
+	const ORAMBackend *backend;
+	unsigned int nstashed;		/* blocks of the ORAM in the table */
+	unsigned int dummyCounter;	/* token counter of the dummy block */
+}		   *TrackedORAM;
+
+/* A block of an ORAM that is not on its file. */
+typedef struct StashEntry
+{
+	TrackedORAM toram;
+	BlockNumber blkno;
+	struct StashEntry *next;
+}		   *StashEntry;
+
+bool		snapshot_restoring = false;
+
+/* ORAMs in the order they were created, position map ORAMs first. */
+static List *orams = NULL;
+
+/* Stashed blocks of every ORAM, chained by bucket. */
+static StashEntry stashTable[STASH_TABLE_SIZE];
+
+
+Snapshot
+snapshot_create(void)
+{
+	Snapshot	snap = (Snapshot) malloc(sizeof(SnapshotData));
+
+	snap->data = (char *) malloc(SNAPSHOT_INITIAL_SIZE);
+	snap->size = SNAPSHOT_INITIAL_SIZE;
+	snap->len = 0;
+	snap->cursor = 0;
+	snap->failed = false;
+	snap->counting = false;
+	return snap;
+}
+
+/*
+ * Creates a snapshot that only counts the bytes written to it, to size a
+ * snapshot without building it.
+ */
+Snapshot
+snapshot_count(void)
+{
+	Snapshot	snap = (Snapshot) malloc(sizeof(SnapshotData));
+
+	snap->data = NULL;
+	snap->size = 0;
+	snap->len = 0;
+	snap->cursor = 0;
+	snap->failed = false;
+	snap->counting = true;
+	return snap;
+}
+
+/* Opens a snapshot to read data. The snapshot takes ownership of data. */
+Snapshot
+snapshot_open(char *data, unsigned int len)
+{
+	Snapshot	snap = (Snapshot) malloc(sizeof(SnapshotData));
+
+	snap->data = data;
+	snap->size = len;
+	snap->len = len;
+	snap->cursor = 0;
+	snap->failed = false;
+	snap->counting = false;
+	return snap;
+}
+
+void
+snapshot_destroy(Snapshot snap)
+{
+	free(snap->data);
+	free(snap);
+}
+
+void
+snapshot_put(Snapshot snap, const void *src, unsigned int len)
+{
+	if (snap->counting)
+	{
+		snap->len += len;
+		return;
+	}
+	if (snap->len + len > snap->size)
+	{
+		while (snap->len + len > snap->size)
+			snap->size *= 2;
+		snap->data = (char *) realloc(snap->data, snap->size);
+	}
+	memcpy(snap->data + snap->len, src, len);
+	snap->len += len;
+}
+
+void
+snapshot_putInt(Snapshot snap, unsigned int value)
+{
+	snapshot_put(snap, &value, sizeof(unsigned int));
+}
+
+void
+snapshot_putString(Snapshot snap, const char *str)
+{
+	unsigned int len = strlen(str) + 1;
+
+	snapshot_putInt(snap, len);
+	snapshot_put(snap, str, len);
+}
+
+/*
+ * Reads len bytes from the snapshot. A read past the end of the snapshot
+ * marks it as failed and fills dest with zeros, so callers can check for
+ * errors once after reading a whole section.
+ */
+bool
+snapshot_get(Snapshot snap, void *dest, unsigned int len)
+{
+	if (snap->failed || len > snap->len - snap->cursor)
+	{
+		snap->failed = true;
+		memset(dest, 0, len);
+		return false;
+	}
+	memcpy(dest, snap->data + snap->cursor, len);
+	snap->cursor += len;
+	return true;
+}
+
+unsigned int
+snapshot_getInt(Snapshot snap)
+{
+	unsigned int value;
+
+	snapshot_get(snap, &value, sizeof(unsigned int));
+	return value;
+}
+
+/* Returns a copy of the next string, or NULL if the snapshot is corrupted. */
+char *
+snapshot_getString(Snapshot snap)
+{
+	unsigned int len = snapshot_getInt(snap);
+	char	   *str;
+
+	if (snap->failed || len == 0 || len > snap->len - snap->cursor)
+	{
+		snap->failed = true;
+		return NULL;
+	}
+	str = (char *) malloc(len);
+	snapshot_get(snap, str, len);
+	str[len - 1] = '\0';
+	return str;
+}
+
+
+static TrackedORAM
+findByName(const char *name, int level)
+{
+	ListIter	iter;
+	void	   *element;
+	TrackedORAM toram;
+
+	if (orams == NULL)
+		return NULL;
+
+	/* a relation has a handful of ORAMs */
+	list_iter_init(&iter, orams);
+	while (list_iter_next(&iter, &element) != CC_ITER_END)
+	{
+		toram = (TrackedORAM) element;
+		if (toram->level == level && strcmp(toram->name, name) == 0)
+			return toram;
+	}
+	return NULL;
+}
+
+static TrackedORAM
+findByState(ORAMState oram)
+{
+	ListIter	iter;
+	void	   *element;
+
+	if (orams == NULL)
+		return NULL;
+
+	list_iter_init(&iter, orams);
+	while (list_iter_next(&iter, &element) != CC_ITER_END)
+	{
+		if (((TrackedORAM) element)->oram == oram)
+			return (TrackedORAM) element;
+	}
+	return NULL;
+}
+
+static StashEntry *
+stashBucket(TrackedORAM toram, BlockNumber blkno)
+{
+	uint32		hash = (uint32) ((uintptr_t) toram >> 4) * 2654435761u;
+
+	hash ^= (uint32) blkno * 2246822519u;
+	return &stashTable[(hash ^ (hash >> 16)) & (STASH_TABLE_SIZE - 1)];
+}
+
+/*
+ * Returns the link that points to the entry of a stashed block, or to the
+ * end of its bucket if the block is not stashed.
+ */
+static StashEntry *
+findBlock(TrackedORAM toram, BlockNumber blkno)
+{
+	StashEntry *link = stashBucket(toram, blkno);
+
+	while (*link != NULL &&
+		   ((*link)->toram != toram || (*link)->blkno != blkno))
+		link = &(*link)->next;
+	return link;
+}
+
+static void
+addBlock(TrackedORAM toram, BlockNumber blkno)
+{
+	StashEntry *link = findBlock(toram, blkno);
+
+	if (*link != NULL)
+		return;
+
+	*link = (StashEntry) malloc(sizeof(struct StashEntry));
+	(*link)->toram = toram;
+	(*link)->blkno = blkno;
+	(*link)->next = NULL;
+	toram->nstashed++;
+}
+
+static void
+removeBlock(TrackedORAM toram, BlockNumber blkno)
+{
+	StashEntry *link = findBlock(toram, blkno);
+	StashEntry	entry = *link;
+
+	if (entry == NULL)
+		return;
+
+	*link = entry->next;
+	free(entry);
+	toram->nstashed--;
+}
+
+/* Removes the blocks of an ORAM from the table. */
+static void
+removeAllBlocks(TrackedORAM toram)
+{
+	StashEntry *link;
+	StashEntry	entry;
+	int			b;
+
+	for (b = 0; b < STASH_TABLE_SIZE && toram->nstashed > 0; b++)
+	{
+		link = &stashTable[b];
+		while (*link != NULL)
+		{
+			entry = *link;
+			if (entry->toram == toram)
+			{
+				*link = entry->next;
+				free(entry);
+				toram->nstashed--;
+			}
+			else
+				link = &entry->next;
+		}
+	}
+}
+
+/*
+ * Starts tracking the stash of an ORAM of nblocks blocks stored on the file
+ * name. The level identifies the ORAMs of an OST that share the same file,
+ * and is 0 for every other ORAM.
+ */
+void
+snapshot_registerORAM(const char *name, int level, unsigned int nblocks,
+					  ORAMState oram, const ORAMBackend *backend)
+{
+	TrackedORAM toram = findByName(name, level);
+
+	if (orams == NULL)
+		list_new(&orams);
+
+	if (toram == NULL)
+	{
+		toram = (TrackedORAM) malloc(sizeof(struct TrackedORAM));
+		toram->name = strdup(name);
+		toram->level = level;
+		toram->nstashed = 0;
+		toram->dummyCounter = 0;
+		list_add(orams, toram);
+	}
+	toram->nblocks = nblocks;
+	toram->oram = oram;
+	toram->backend = backend;
+}
+
+void
+snapshot_unregisterORAM(ORAMState oram)
+{
+	TrackedORAM toram = findByState(oram);
+	void	   *removed;
+
+	if (toram == NULL)
+		return;
+
+	list_remove(orams, toram, &removed);
+	removeAllBlocks(toram);
+	free(toram->name);
+	free(toram);
+
+	if (list_size(orams) == 0)
+	{
+		list_destroy(orams);
+		orams = NULL;
+	}
+}
+
+/* Called by the oblivious files when a real block is read from the file. */
+void
+snapshot_blockIn(const char *name, int level, PLBlock block)
+{
+	TrackedORAM toram = findByName(name, level);
+
+	if (toram == NULL || block->blkno == DUMMY_BLOCK ||
+		block->blkno == toram->nblocks + 1)
+		return;
+
+	addBlock(toram, block->blkno);
+}
+
+/* Called by the oblivious files when a real block is written to the file. */
+void
+snapshot_blockOut(const char *name, int level, BlockNumber blkno)
+{
+	TrackedORAM toram = findByName(name, level);
+
+	if (toram == NULL || blkno == (BlockNumber) DUMMY_BLOCK ||
+		blkno == toram->nblocks + 1)
+		return;
+
+	removeBlock(toram, blkno);
+}
+
+/*
+ * Called before a block is written to an ORAM. The block is held in the
+ * stash once the write reaches the ORAM, until it is evicted to the file.
+ */
+void
+snapshot_blockWrite(ORAMState oram, BlockNumber blkno)
+{
+	TrackedORAM toram = findByState(oram);
+
+	if (toram == NULL)
+		return;
+
+	addBlock(toram, blkno);
+}
+
+/*
+ * Makes a dummy access to the block nblocks + 1 of an ORAM. The token based
+ * ORAMs read the block with the tokens of its counter and write it back with
+ * the next ones, as they only evict on a write.
+ */
+static void
+evictAccess(TrackedORAM toram)
+{
+	char	   *page = NULL;
+	unsigned int token[8];
+	BlockNumber blkno = toram->nblocks + 1;
+	int			level = toram->level;
+	int			result;
+
+	if (toram->backend->tokens)
+	{
+		prf(level, blkno, toram->dummyCounter, (unsigned int *) &token);
+		toram->backend->settoken(toram->oram, token);
+	}
+	else
+		toram->backend->settoken(toram->oram, NULL);
+
+	result = toram->backend->read(&page, blkno, toram->oram,
+								  level > 0 ? &level : NULL);
+
+	if (toram->backend->tokens)
+	{
+		if (result == DUMMY_BLOCK)
+		{
+			page = (char *) malloc(BLCKSZ);
+			memset(page, 0, BLCKSZ);
+		}
+		toram->dummyCounter++;
+		prf(level, blkno, toram->dummyCounter, (unsigned int *) &token);
+		toram->backend->settoken(toram->oram, token);
+		level = toram->level;
+		toram->backend->write(page, BLCKSZ, blkno, toram->oram,
+							  level > 0 ? &level : NULL);
+	}
+	free(page);
+}
+
+/*
+ * Makes SEAL_EVICT_ACCESSES dummy accesses to every ORAM to empty the stashes,
+ * whatever they hold, so that the accesses do not depend on the stashes. The
+ * accesses to an ORAM also access the ORAM of its position map. Returns false
+ * if a stash is still not empty.
+ */
+bool
+snapshot_evictStashes(void)
+{
+	ListIter	iter;
+	void	   *element;
+	TrackedORAM toram;
+	int			round;
+
+	if (orams == NULL)
+		return true;
+
+	for (round = 0; round < SEAL_EVICT_ACCESSES; round++)
+	{
+		list_iter_init(&iter, orams);
+		while (list_iter_next(&iter, &element) != CC_ITER_END)
+			evictAccess((TrackedORAM) element);
+	}
+
+	list_iter_init(&iter, orams);
+	while (list_iter_next(&iter, &element) != CC_ITER_END)
+	{
+		toram = (TrackedORAM) element;
+		if (toram->nstashed > 0)
+		{
+			selog(ERROR, "Stash of %s still holds %d blocks", toram->name,
+				  toram->nstashed);
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Writes the ORAMs whose stashes were emptied by snapshot_evictStashes, with
+ * the counters of their dummy blocks. A counting snapshot is written before
+ * the stashes are evicted.
+ */
+void
+snapshot_saveStashes(Snapshot snap)
+{
+	ListIter	iter;
+	void	   *element;
+	TrackedORAM toram;
+
+	snapshot_putInt(snap, orams == NULL ? 0 : list_size(orams));
+	if (orams == NULL)
+		return;
+
+	list_iter_init(&iter, orams);
+	while (list_iter_next(&iter, &element) != CC_ITER_END)
+	{
+		toram = (TrackedORAM) element;
+		if (!snap->counting && toram->nstashed > 0)
+		{
+			selog(ERROR, "Stash of %s is not empty", toram->name);
+			snap->failed = true;
+		}
+		snapshot_putString(snap, toram->name);
+		snapshot_putInt(snap, toram->level);
+		snapshot_putInt(snap, toram->dummyCounter);
+	}
+}
+
+/*
+ * Checks that the ORAMs of the sealed state were created again and restores
+ * the counters of their dummy blocks. Their stashes were empty when the
+ * state was sealed, so there are no blocks to write back.
+ */
+bool
+snapshot_restoreStashes(Snapshot snap)
+{
+	unsigned int norams = snapshot_getInt(snap);
+	unsigned int o;
+	char	   *name;
+	int			level;
+	unsigned int dummyCounter;
+	TrackedORAM toram;
+
+	for (o = 0; o < norams && !snap->failed; o++)
+	{
+		name = snapshot_getString(snap);
+		level = snapshot_getInt(snap);
+		dummyCounter = snapshot_getInt(snap);
+		toram = name != NULL ? findByName(name, level) : NULL;
+
+		if (toram == NULL)
+		{
+			selog(ERROR, "Sealed state of unknown ORAM %s", name);
+			snap->failed = true;
+		}
+		else
+			toram->dummyCounter = dummyCounter;
+		free(name);
+	}
+
+	return !snap->failed;
+}
@@ -490,6 +490,109 @@ PageIndexMultiDelete_s(Page page, OffsetNumber * itemnos, int nitems)
 }
 
 
+/*
+ * PageIndexTupleOverwrite
+ *
+ * Replace a specified tuple on a page.  The new tuple is placed exactly
+ * where the old one had been, shifting other tuples' data up or down as
+ * needed to keep the page compacted without changing their line pointers.
+ *
+ * Returns false if the new tuple does not fit on the page, in which case
+ * the page is unchanged.
+ */
+bool
+PageIndexTupleOverwrite_s(Page page, OffsetNumber offnum,
+						  Item newtup, Size newsize)
+{
+	PageHeader	phdr = (PageHeader) page;
+	ItemId		tupid;
+	int			oldsize;
+	unsigned	offset;
+	Size		alignednewsize;
+	int			size_diff;
+	int			itemcount;
+
+	/*
+	 * As with PageRepairFragmentation, paranoia seems justified.
+	 */
+	if (phdr->pd_lower < SizeOfPageHeaderData ||
+		phdr->pd_lower > phdr->pd_upper ||
+		phdr->pd_upper > phdr->pd_special ||
+		phdr->pd_special > BLCKSZ ||
+		phdr->pd_special != MAXALIGN_s(phdr->pd_special))
+	{
+		selog(ERROR, "corrupted page pointers: lower = %u, upper = %u, special = %u",
+			  phdr->pd_lower, phdr->pd_upper, phdr->pd_special);
+		return false;
+	}
+
+	itemcount = PageGetMaxOffsetNumber_s(page);
+	if ((int) offnum <= 0 || (int) offnum > itemcount)
+	{
+		selog(ERROR, "invalid index offnum: %u", offnum);
+		return false;
+	}
+
+	tupid = PageGetItemId_s(page, offnum);
+	oldsize = ItemIdGetLength_s(tupid);
+	offset = ItemIdGetOffset_s(tupid);
+
+	if (offset < phdr->pd_upper || (offset + oldsize) > phdr->pd_special ||
+		offset != MAXALIGN_s(offset))
+	{
+		selog(ERROR, "corrupted item pointer: offset = %u, length = %u",
+			  offset, (unsigned int) oldsize);
+		return false;
+	}
+
+	/*
+	 * Determine actual change in space requirement, check for page overflow.
+	 */
+	oldsize = MAXALIGN_s(oldsize);
+	alignednewsize = MAXALIGN_s(newsize);
+	if (alignednewsize > oldsize + (phdr->pd_upper - phdr->pd_lower))
+		return false;
+
+	/*
+	 * Relocate existing data and update line pointers, unless the new tuple
+	 * is the same size as the old (after alignment), in which case there's
+	 * nothing to do.  Notice that what we have to relocate is data before the
+	 * target tuple, not data after, so it's convenient to express size_diff
+	 * as the amount by which the tuple's size is decreasing, making it the
+	 * delta to add to pd_upper and affected line pointers.
+	 */
+	size_diff = oldsize - (int) alignednewsize;
+	if (size_diff != 0)
+	{
+		char	   *addr = (char *) page + phdr->pd_upper;
+		int			i;
+
+		/* relocate all tuple data before the target tuple */
+		memmove(addr + size_diff, addr, offset - phdr->pd_upper);
+
+		/* adjust free space boundary pointer */
+		phdr->pd_upper += size_diff;
+
+		/* adjust affected line pointers too */
+		for (i = FirstOffsetNumber; i <= itemcount; i++)
+		{
+			ItemId		ii = PageGetItemId_s(page, i);
+
+			if (ItemIdHasStorage_s(ii) && ItemIdGetOffset_s(ii) <= offset)
+				ii->lp_off += size_diff;
+		}
+	}
+
+	/* Update the item's tuple length (other fields shouldn't change) */
+	ItemIdSetNormal_s(tupid, offset + size_diff, newsize);
+
+	/* Copy new tuple data onto page */
+	memcpy(PageGetItem_s(page, tupid), newtup, newsize);
+
+	return true;
+}
+
+
 
 /*
  * PageGetExactFreeSpace
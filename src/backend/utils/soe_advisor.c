@@ -0,0 +1,422 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_advisor.c
+ *	  ORAM parameter advisor.
+ *
+ * The advisor sizes the heap and the index ORAMs of a relation from the
+ * number of tuples, the tuple size and the index key size, and then runs the
+ * ORAM library over an in-memory oblivious file for every candidate bucket
+ * capacity. The simulated file never leaves the enclave and keeps only the
+ * block number stored on each slot, which is enough to measure the number of
+ * slots transferred per access and the stash occupancy (blocks that have
+ * been loaded but are not stored in any slot of the file).
+ *
+ * The configuration with the lowest bandwidth per query that fits the EPC
+ * budget and keeps the stash bounded is returned to the caller.
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ * IDENTIFICATION
+ *        backend/utils/soe_advisor.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "utils/soe_advisor.h"
+#include "access/soe_itup.h"
+#include "access/soe_nbtree.h"
+#include "storage/soe_bufpage.h"
+#include "storage/soe_pmap.h"
+#include "common/soe_prf.h"
+#include "logger/logger.h"
+
+#include <oram/plblock.h>
+#include <oram/ofile.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Candidate bucket capacities (blocks per ORAM tree node). */
+static const unsigned int bkcaps[] = {1, 2, 4, 8};
+
+#define NBKCAPS (sizeof(bkcaps) / sizeof(unsigned int))
+
+/* State of a simulated oblivious file. */
+typedef struct SimFile
+{
+	int		   *blknos;			/* real block stored on each slot */
+	unsigned int *locations;	/* two location integers per slot */
+	unsigned int nslots;
+	unsigned int live;			/* distinct blocks written to the ORAM */
+	int			inFile;			/* real blocks currently stored on slots */
+	unsigned long long slotReads;
+	unsigned long long slotWrites;
+	unsigned int peakStash;
+}			SimFile;
+
+/* Measurements of a simulated ORAM. */
+typedef struct SimResult
+{
+	unsigned long long slotsPerAccess;
+	unsigned int peakStash;
+}			SimResult;
+
+
+static FileHandler
+sim_fileInit(const char *filename, unsigned int nblocks, unsigned int blocksize,
+			 unsigned int lsize, void *appData)
+{
+	SimFile    *sim = (SimFile *) appData;
+	unsigned int slot;
+
+	sim->nslots = nblocks;
+	sim->blknos = (int *) malloc(sizeof(int) * nblocks);
+	sim->locations = (unsigned int *) malloc(sizeof(unsigned int) * 2 * nblocks);
+
+	for (slot = 0; slot < nblocks; slot++)
+	{
+		sim->blknos[slot] = DUMMY_BLOCK;
+		sim->locations[2 * slot] = 0;
+		sim->locations[2 * slot + 1] = 0;
+	}
+
+	return NULL;
+}
+
+static void
+sim_fileRead(FileHandler handler, PLBlock block, const char *filename,
+			 const BlockNumber ob_blkno, void *appData)
+{
+	SimFile    *sim = (SimFile *) appData;
+
+	/* Page contents are not relevant for the simulation. */
+	block->block = (void *) malloc(BLCKSZ);
+	block->blkno = sim->blknos[ob_blkno];
+	block->location[0] = sim->locations[2 * ob_blkno];
+	block->location[1] = sim->locations[2 * ob_blkno + 1];
+	block->size = BLCKSZ;
+
+	/* A real block read from the file is moved to the stash. */
+	if (block->blkno != DUMMY_BLOCK)
+	{
+		sim->blknos[ob_blkno] = DUMMY_BLOCK;
+		sim->inFile--;
+	}
+	sim->slotReads++;
+}
+
+static void
+sim_fileWrite(FileHandler handler, const PLBlock block, const char *filename,
+			  const BlockNumber ob_blkno, void *appData)
+{
+	SimFile    *sim = (SimFile *) appData;
+
+	if (sim->blknos[ob_blkno] != DUMMY_BLOCK)
+		sim->inFile--;
+
+	sim->blknos[ob_blkno] = block->blkno;
+	sim->locations[2 * ob_blkno] = block->location[0];
+	sim->locations[2 * ob_blkno + 1] = block->location[1];
+
+	if (block->blkno != DUMMY_BLOCK)
+		sim->inFile++;
+	sim->slotWrites++;
+}
+
+static void
+sim_fileClose(FileHandler handler, const char *filename, void *appData)
+{
+	SimFile    *sim = (SimFile *) appData;
+
+	free(sim->blknos);
+	free(sim->locations);
+}
+
+static AMOFile *
+sim_ofileCreate(void)
+{
+	AMOFile    *file = (AMOFile *) malloc(sizeof(AMOFile));
+
+	file->ofileinit = &sim_fileInit;
+	file->ofileread = &sim_fileRead;
+	file->ofilewrite = &sim_fileWrite;
+	file->ofileclose = &sim_fileClose;
+	return file;
+}
+
+static void
+sim_sampleStash(SimFile * sim)
+{
+	unsigned int stash = sim->live - sim->inFile;
+
+	sim->peakStash = Max_s(sim->peakStash, stash);
+}
+
+/*
+ * Access a block the same way the buffer managers do: read the block with the
+ * token of its current counter and write it back with the next one.
+ */
+static void
+sim_access(const ORAMBackend *backend, ORAMState state, SimFile * sim,
+		   BlockNumber blkno, unsigned int counter, bool write)
+{
+	char	   *page = NULL;
+	unsigned int token[8];
+	int			result;
+
+	prf(0, blkno, counter, (unsigned int *) &token);
+	backend->settoken(state, token);
+	result = backend->read(&page, blkno, state, sim);
+
+	if (result == DUMMY_BLOCK)
+	{
+		page = (char *) malloc(BLCKSZ);
+		memset(page, 0, BLCKSZ);
+	}
+
+	if (write)
+	{
+		prf(0, blkno, counter + 1, (unsigned int *) &token);
+		backend->settoken(state, token);
+		if (backend->write(page, BLCKSZ, blkno, state, sim) != BLCKSZ)
+			selog(ERROR, "Advisor simulation failed to write block %d", blkno);
+	}
+
+	free(page);
+}
+
+static unsigned int
+log2_ceil(unsigned long long n)
+{
+	unsigned int l = 0;
+
+	while ((1ULL << l) < n)
+		l++;
+	return l;
+}
+
+/*
+ * Loads nblocks blocks on an ORAM with bucket capacity bkcap and issues
+ * ADVISOR_SIM_ACCESSES uniformly random accesses. Returns the number of slots
+ * transferred per access, extrapolated to realBlocks, and the peak stash
+ * occupancy observed during the run.
+ */
+static SimResult
+simulate(const ORAMBackend *backend, unsigned int nblocks,
+		 unsigned int realBlocks, unsigned int bkcap)
+{
+	SimFile		sim;
+	SimResult	res;
+	Amgr	   *amgr;
+	ORAMState	state;
+	unsigned int *counters;
+	unsigned int blkno;
+	unsigned int i;
+	unsigned long long accessSlots;
+
+	memset(&sim, 0, sizeof(SimFile));
+
+	amgr = (Amgr *) malloc(sizeof(Amgr));
+	amgr->am_stash = backend->stashcreate();
+	amgr->am_pmap = backend->pmapcreate();
+	amgr->am_ofile = sim_ofileCreate();
+
+	state = backend->init("advisor", nblocks, BLCKSZ, bkcap, amgr, &sim);
+	counters = (unsigned int *) malloc(sizeof(unsigned int) * nblocks);
+
+	/* Loading phase, mirrors heap_insert_block_s and btree_load_s. */
+	for (blkno = 0; blkno < nblocks; blkno++)
+	{
+		sim_access(backend, state, &sim, blkno, 0, true);
+		counters[blkno] = 2;
+		sim.live++;
+		sim_sampleStash(&sim);
+	}
+
+	sim.slotReads = 0;
+	sim.slotWrites = 0;
+
+	for (i = 0; i < ADVISOR_SIM_ACCESSES; i++)
+	{
+		blkno = getRandomInt() % nblocks;
+		sim_access(backend, state, &sim, blkno, counters[blkno],
+				   backend->tokens);
+		counters[blkno] += 2;
+		sim_sampleStash(&sim);
+	}
+
+	accessSlots = (sim.slotReads + sim.slotWrites) / ADVISOR_SIM_ACCESSES;
+
+	/* Path length grows with the logarithm of the number of blocks. */
+	if (realBlocks > nblocks)
+		accessSlots = accessSlots * (log2_ceil(realBlocks) + 1) /
+			(log2_ceil(nblocks) + 1);
+
+	res.slotsPerAccess = accessSlots;
+	res.peakStash = sim.peakStash;
+
+	backend->close(state, &sim);
+	free(counters);
+	free(amgr->am_ofile);
+	free(amgr);
+
+	return res;
+}
+
+/*
+ * Enclave memory required by an ORAM of nblocks blocks whose stash peaked at
+ * peakStash blocks: the position map (absent on token based constructions),
+ * the stash, one path of buckets and the in memory free space map kept by
+ * every VRelation.
+ */
+static unsigned long long
+oram_footprint(const ORAMBackend *backend, unsigned int nblocks,
+			   unsigned int bkcap, unsigned int peakStash)
+{
+	unsigned long long bytes = 0;
+
+	if (!backend->tokens)
+		bytes += soe_pmapSize(nblocks);
+
+	bytes += (unsigned long long) peakStash * (BLCKSZ + sizeof(struct PLBlock));
+	bytes += (unsigned long long) (log2_ceil(nblocks) + 1) * bkcap * BLCKSZ;
+	bytes += (unsigned long long) nblocks * sizeof(int);
+
+	return bytes;
+}
+
+/*
+ * Number of blocks of each level of the index, from the root downwards. The
+ * page capacity follows the default nbtree fill factors.
+ */
+static unsigned int
+index_levels(unsigned int nTuples, unsigned int keySize, unsigned int *levels)
+{
+	Size		keyLen;
+	Size		itemSize;
+	Size		usable;
+	unsigned int leafItems;
+	unsigned int innerItems;
+	unsigned int nblocks;
+	unsigned int rev[ADVISOR_MAX_LEVELS + 1];
+	unsigned int height = 0;
+	unsigned int i;
+
+	keyLen = keySize + VARHDRSZ_SHORT <= VARATT_SHORT_MAX ?
+		keySize + VARHDRSZ_SHORT : keySize + sizeof(int32);
+	itemSize = MAXALIGN_s(sizeof(IndexTupleData) + keyLen) + sizeof(ItemIdData) +
+		sizeof(uint32);			/* access counter */
+	usable = BLCKSZ - MAXALIGN_s(SizeOfPageHeaderData) -
+		MAXALIGN_s(sizeof(BTPageOpaqueData));
+
+	leafItems = Max_s(2, usable * BTREE_DEFAULT_FILLFACTOR / 100 / itemSize);
+	innerItems = Max_s(2, usable * BTREE_NONLEAF_FILLFACTOR / 100 / itemSize);
+
+	nblocks = Max_s(1, (nTuples + leafItems - 1) / leafItems);
+	rev[height++] = nblocks;
+
+	while (nblocks > 1 && height <= ADVISOR_MAX_LEVELS)
+	{
+		nblocks = (nblocks + innerItems - 1) / innerItems;
+		rev[height++] = nblocks;
+	}
+
+	if (nblocks > 1)
+		selog(WARNING, "Index needs more than %d levels", ADVISOR_MAX_LEVELS);
+
+	for (i = 0; i < height; i++)
+		levels[i] = rev[height - 1 - i];
+
+	return height;
+}
+
+static unsigned int
+heap_blocks(unsigned int nTuples, unsigned int tupleSize)
+{
+	Size		usable;
+	unsigned int perPage;
+
+	usable = BLCKSZ - MAXALIGN_s(SizeOfPageHeaderData) - MAXALIGN_s(sizeof(int) * 4);
+	perPage = Max_s(1, usable / (MAXALIGN_s(tupleSize) + sizeof(ItemIdData)));
+
+	/* The last heap block holds the copy of block 0 used by dummy reads. */
+	return (nTuples + perPage - 1) / perPage + 1;
+}
+
+int
+advise_oram(unsigned int nTuples, unsigned int tupleSize, unsigned int keySize,
+			unsigned int epcBudgetMB, const ORAMBackend *tBackend,
+			const ORAMBackend *iBackend, SOEAdvice * advice)
+{
+	unsigned int levels[ADVISOR_MAX_LEVELS + 1];
+	unsigned int height;
+	unsigned int tNBlocks;
+	unsigned long long budget;
+	unsigned int b;
+	unsigned int l;
+	bool		found = false;
+	SOEAdvice	cand;
+
+	budget = (unsigned long long) epcBudgetMB * 1024 * 1024;
+	tNBlocks = heap_blocks(nTuples, tupleSize);
+	height = index_levels(nTuples, keySize, levels);
+
+	memset(advice, 0, sizeof(SOEAdvice));
+	advice->status = ADVICE_OVER_BUDGET;
+
+	for (b = 0; b < NBKCAPS; b++)
+	{
+		SimResult	res;
+
+		memset(&cand, 0, sizeof(SOEAdvice));
+		cand.bkcap = bkcaps[b];
+		cand.tNBlocks = tNBlocks;
+
+		/* The root is stored outside of the ORAMs. */
+		cand.nlevels = height - 1;
+		cand.iNBlocks = 1;
+
+		res = simulate(tBackend, Min_s(tNBlocks, ADVISOR_SIM_BLOCKS), tNBlocks,
+					   cand.bkcap);
+		cand.peakStash = res.peakStash;
+		cand.bytesPerQuery = res.slotsPerAccess * BLCKSZ;
+		cand.epcBytes = oram_footprint(tBackend, tNBlocks, cand.bkcap,
+									   res.peakStash);
+
+		for (l = 1; l < height; l++)
+		{
+			cand.fanouts[l - 1] = levels[l];
+			cand.iNBlocks += levels[l];
+
+			res = simulate(iBackend, Min_s(levels[l], ADVISOR_SIM_BLOCKS),
+						   levels[l], cand.bkcap);
+			cand.peakStash += res.peakStash;
+			cand.bytesPerQuery += res.slotsPerAccess * BLCKSZ;
+			cand.epcBytes += oram_footprint(iBackend, levels[l], cand.bkcap,
+											res.peakStash);
+		}
+
+		selog(DEBUG1, "Advisor BKCAP %d: stash %d, epc %llu, bytes per query %llu",
+			  cand.bkcap, cand.peakStash, cand.epcBytes, cand.bytesPerQuery);
+
+		if (cand.epcBytes <= budget && cand.peakStash <= ADVISOR_MAX_STASH)
+		{
+			cand.status = ADVICE_OK;
+			if (!found || cand.bytesPerQuery < advice->bytesPerQuery ||
+				(cand.bytesPerQuery == advice->bytesPerQuery &&
+				 cand.epcBytes < advice->epcBytes))
+			{
+				memcpy(advice, &cand, sizeof(SOEAdvice));
+				found = true;
+			}
+		}
+		else if (!found && (b == 0 || cand.epcBytes < advice->epcBytes))
+		{
+			/* Keep the smallest setting as a fallback. */
+			cand.status = ADVICE_OVER_BUDGET;
+			memcpy(advice, &cand, sizeof(SOEAdvice));
+		}
+	}
+
+	return advice->status;
+}
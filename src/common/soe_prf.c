@@ -15,6 +15,8 @@
 
 #ifdef PRF
 #include <sodium.h>
+#include <stdlib.h>
+#include <string.h>
 
 unsigned char *pkey = NULL; //= (unsigned char *) "01234567890123456789012345678901";
 unsigned int keylen = 34*sizeof(char);
@@ -87,3 +89,41 @@ void prf(unsigned int level, unsigned int offset, unsigned int counter, unsigned
 
 
 }
+
+
+/*
+ * The PRF key is generated by the enclave and is sealed with the state, as
+ * the tokens of the blocks on the ORAM files depend on it.
+ */
+unsigned int
+prf_keysize(void)
+{
+#ifdef PRF
+    return crypto_auth_hmacsha512_KEYBYTES;
+#else
+    return 0;
+#endif
+}
+
+void
+prf_getkey(unsigned char *dest)
+{
+#ifdef PRF
+    if(pkey == NULL){
+        pkey = (unsigned char*) malloc(crypto_auth_hmacsha512_KEYBYTES);
+        crypto_auth_hmacsha512_keygen(pkey);
+    }
+    memcpy(dest, pkey, crypto_auth_hmacsha512_KEYBYTES);
+#endif
+}
+
+void
+prf_setkey(const unsigned char *src)
+{
+#ifdef PRF
+    if(pkey == NULL){
+        pkey = (unsigned char*) malloc(crypto_auth_hmacsha512_KEYBYTES);
+    }
+    memcpy(pkey, src, crypto_auth_hmacsha512_KEYBYTES);
+#endif
+}
@@ -0,0 +1,72 @@
+/**
+ * Implementation of the state sealing using the sgx sealing library.
+ * This is used in normal mode where the SOE is loaded to
+ * an SGX enclave. The data is sealed with the MRSIGNER policy so the
+ * state can be restored by any enclave signed with the same key.
+ */
+
+#include "soe_c.h"
+#include "common/soe_seal.h"
+#include "logger/logger.h"
+#include "sgx_tseal.h"
+#include <stdlib.h>
+
+unsigned int
+seal_size(unsigned int plainSize)
+{
+	return sgx_calc_sealed_data_size(0, plainSize);
+}
+
+int
+seal_data(const char *plain, unsigned int plainSize, char *sealed,
+		  unsigned int sealedSize)
+{
+	sgx_status_t status;
+
+	if (sealedSize < seal_size(plainSize))
+	{
+		selog(ERROR, "Sealed buffer of %d bytes is too small", sealedSize);
+		return 1;
+	}
+
+	status = sgx_seal_data(0, NULL, plainSize, (const uint8_t *) plain,
+						   sealedSize, (sgx_sealed_data_t *) sealed);
+
+	if (status != SGX_SUCCESS)
+	{
+		selog(ERROR, "Could not seal state %d", status);
+		return 1;
+	}
+	return 0;
+}
+
+int
+unseal_data(const char *sealed, unsigned int sealedSize, char **plain,
+			unsigned int *plainSize)
+{
+	sgx_status_t status;
+	uint32_t	size = UINT32_MAX;
+
+	if (sealedSize >= sizeof(sgx_sealed_data_t))
+		size = sgx_get_encrypt_txt_len((const sgx_sealed_data_t *) sealed);
+
+	if (size == UINT32_MAX || sealedSize < seal_size(size))
+	{
+		selog(ERROR, "Sealed state is corrupted");
+		return 1;
+	}
+
+	*plain = (char *) malloc(size);
+	status = sgx_unseal_data((const sgx_sealed_data_t *) sealed, NULL, NULL,
+							 (uint8_t *) * plain, &size);
+
+	if (status != SGX_SUCCESS)
+	{
+		selog(ERROR, "Could not unseal state %d", status);
+		free(*plain);
+		return 1;
+	}
+
+	*plainSize = size;
+	return 0;
+}
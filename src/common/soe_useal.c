@@ -0,0 +1,165 @@
+/**
+ * Implementation of the state sealing using openssl. This implementation
+ * is only used on the UNSAFE mode, where there is no enclave sealing key.
+ * The state is encrypted with AES-256-GCM with a key read from the file
+ * SEAL_KEY_FILE, which is created with a random key on the first seal.
+ */
+
+#include "soe_c.h"
+#include "common/soe_seal.h"
+#include "logger/logger.h"
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef SEAL_KEY_FILE
+#define SEAL_KEY_FILE "soe_seal.key"
+#endif
+
+#define SEAL_KEY_SIZE 32
+#define SEAL_IV_SIZE 12
+#define SEAL_TAG_SIZE 16
+
+/* The sealed data is the iv, the authentication tag and the ciphertext. */
+#define SEAL_HEADER_SIZE (SEAL_IV_SIZE + SEAL_TAG_SIZE)
+
+
+static int
+seal_key(unsigned char *key, bool create)
+{
+	FILE	   *file = fopen(SEAL_KEY_FILE, "rb");
+	size_t		len = 0;
+
+	if (file != NULL)
+	{
+		len = fread(key, 1, SEAL_KEY_SIZE, file);
+		fclose(file);
+		return len == SEAL_KEY_SIZE ? 0 : 1;
+	}
+
+	if (!create)
+	{
+		selog(ERROR, "Could not read seal key from %s", SEAL_KEY_FILE);
+		return 1;
+	}
+
+	if (RAND_bytes(key, SEAL_KEY_SIZE) != 1)
+	{
+		selog(ERROR, "Could not generate seal key");
+		return 1;
+	}
+
+	file = fopen(SEAL_KEY_FILE, "wb");
+	if (file != NULL)
+	{
+		len = fwrite(key, 1, SEAL_KEY_SIZE, file);
+		fclose(file);
+	}
+
+	if (len != SEAL_KEY_SIZE)
+	{
+		selog(ERROR, "Could not write seal key to %s", SEAL_KEY_FILE);
+		return 1;
+	}
+	return 0;
+}
+
+unsigned int
+seal_size(unsigned int plainSize)
+{
+	return SEAL_HEADER_SIZE + plainSize;
+}
+
+int
+seal_data(const char *plain, unsigned int plainSize, char *sealed,
+		  unsigned int sealedSize)
+{
+	EVP_CIPHER_CTX *ctx;
+	unsigned char key[SEAL_KEY_SIZE];
+	unsigned char *iv = (unsigned char *) sealed;
+	unsigned char *tag = iv + SEAL_IV_SIZE;
+	unsigned char *ciphertext = tag + SEAL_TAG_SIZE;
+	int			len;
+	int			result = 1;
+
+	if (sealedSize < seal_size(plainSize))
+	{
+		selog(ERROR, "Sealed buffer of %d bytes is too small", sealedSize);
+		return 1;
+	}
+
+	if (seal_key(key, true) != 0 || RAND_bytes(iv, SEAL_IV_SIZE) != 1)
+		return 1;
+
+	if (!(ctx = EVP_CIPHER_CTX_new()))
+	{
+		selog(ERROR, "could not create openssl context for sealing");
+		return 1;
+	}
+
+	if (EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, key, iv) == 1 &&
+		EVP_EncryptUpdate(ctx, ciphertext, &len, (const unsigned char *) plain,
+						  plainSize) == 1 &&
+		EVP_EncryptFinal_ex(ctx, ciphertext + len, &len) == 1 &&
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, SEAL_TAG_SIZE, tag) == 1)
+	{
+		result = 0;
+	}
+	else
+	{
+		selog(ERROR, "could not seal state");
+	}
+
+	EVP_CIPHER_CTX_free(ctx);
+	return result;
+}
+
+int
+unseal_data(const char *sealed, unsigned int sealedSize, char **plain,
+			unsigned int *plainSize)
+{
+	EVP_CIPHER_CTX *ctx;
+	unsigned char key[SEAL_KEY_SIZE];
+	unsigned char *iv = (unsigned char *) sealed;
+	unsigned char *tag = iv + SEAL_IV_SIZE;
+	unsigned char *ciphertext = tag + SEAL_TAG_SIZE;
+	int			len;
+	int			result = 1;
+
+	if (sealedSize < SEAL_HEADER_SIZE)
+	{
+		selog(ERROR, "Sealed state is corrupted");
+		return 1;
+	}
+
+	if (seal_key(key, false) != 0)
+		return 1;
+
+	if (!(ctx = EVP_CIPHER_CTX_new()))
+	{
+		selog(ERROR, "could not create openssl context for unsealing");
+		return 1;
+	}
+
+	*plainSize = sealedSize - SEAL_HEADER_SIZE;
+	*plain = (char *) malloc(*plainSize);
+
+	if (EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, key, iv) == 1 &&
+		EVP_DecryptUpdate(ctx, (unsigned char *) *plain, &len, ciphertext,
+						  *plainSize) == 1 &&
+		EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, SEAL_TAG_SIZE, tag) == 1 &&
+		EVP_DecryptFinal_ex(ctx, (unsigned char *) *plain + len, &len) == 1)
+	{
+		result = 0;
+	}
+	else
+	{
+		selog(ERROR, "could not unseal state");
+		free(*plain);
+	}
+
+	EVP_CIPHER_CTX_free(ctx);
+	return result;
+}
@@ -0,0 +1,47 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_delta.h
+ *	  Delta ORAM of a table, where tuples are appended with their keys until
+ *	  they are merged on the table and its index.
+ *
+ * src/include/access/soe_delta.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SOE_DELTA_H
+#define SOE_DELTA_H
+
+#include "access/soe_htup.h"
+#include "access/soe_itup.h"
+#include "access/soe_skey.h"
+#include "access/soe_tupdesc.h"
+#include "storage/soe_bufmgr.h"
+
+/*
+ * An entry of the delta: the key of a tuple, in the scan key format of
+ * getTuple with every column of the index, followed by the heap tuple.
+ */
+typedef struct DeltaTupleData
+{
+	uint32		keySize;
+	uint32		tupleSize;
+	/* the key, then the heap tuple at MAXALIGN(keySize) */
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+}			DeltaTupleData;
+
+typedef DeltaTupleData * DeltaTuple;
+
+#define DeltaTupleGetKey(dtup) ((dtup)->data)
+#define DeltaTupleGetTuple(dtup) ((dtup)->data + MAXALIGN_s((dtup)->keySize))
+#define DeltaTupleSize(keySize, tupleSize) \
+	(offsetof_s(DeltaTupleData, data) + MAXALIGN_s(keySize) + (tupleSize))
+
+extern bool delta_insert_s(VRelation rel, const char *key, uint32 keySize,
+						   const char *tuple, uint32 tupleSize);
+extern bool delta_search_s(VRelation rel, ScanKey skey,
+						   StrategyNumber strategy, TupleDesc desc,
+						   keycmp_function keycmp, HeapTuple tuple,
+						   IndexTuple *itup);
+extern void delta_reset_s(VRelation rel);
+
+#endif							/* SOE_DELTA_H */
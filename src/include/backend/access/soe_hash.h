@@ -46,6 +46,16 @@ typedef uint32 Bucket;
 #define HASH_MAGIC		0x6440640
 #define HASH_VERSION	4
 
+/*
+ * Number of pages of a bucket chain (the primary bucket page and its
+ * overflow pages) read by every scan. The index is loaded as a static table
+ * whose chains can not be longer, and shorter chains are padded with dummy
+ * ORAM accesses, so every lookup does the same number of accesses.
+ */
+#ifndef HASH_DEPTH
+#define HASH_DEPTH	2
+#endif
+
 
 /*
  * In an overflow page, hasho_prevblkno stores the block number of the previous
@@ -66,6 +76,7 @@ typedef struct HashPageOpaqueData
 	uint16		hasho_flag;		/* page type code + flag bits, see above */
 	uint16		hasho_page_id;	/* for identification of hash indexes */
 	int			o_blkno;		/* real block number or Dummy Block */
+	uint32		location[2];	/* ORAM location of the block */
 
 }			HashPageOpaqueData;
 
@@ -147,6 +158,9 @@ typedef struct HashScanOpaqueData
 	 */
 	bool		hashso_buc_split;
 
+	/* number of pages of the bucket chain read by the scan */
+	int			hashso_npages;
+
 
 	/*
 	 * Identify all the matching items on a page and save them in
@@ -335,6 +349,7 @@ typedef HashMetaPageData * HashMetaPage;
 
 /*public routines*/
 
+extern bool hash_load_s(VRelation rel, char *block, unsigned int offset);
 extern bool hashinsert_s(VRelation rel, ItemPointer ht_ctid, const char *datum, unsigned int datumSize);
 
 extern IndexScanDesc hashbeginscan_s(VRelation rel, const char *key, int keysize);
@@ -382,6 +397,8 @@ extern Buffer _hash_getbuf_with_strategy_s(VRelation rel, BlockNumber blkno, int
 
 extern void _hash_relbuf_s(VRelation rel, Buffer buf);
 
+extern HashMetaPage _hash_getcachedmetap_s(VRelation rel, Buffer * metabuf,
+											bool force_refresh);
 extern Buffer _hash_getbucketbuf_from_hashkey_s(VRelation rel, uint32 hashkey,
 												int access,
 												HashMetaPage cachedmetap);
@@ -16,6 +16,7 @@
 #define SOE_HEAPAM_H
 
 #include "access/soe_htup.h"
+#include "access/soe_tupdesc.h"
 
 #include "storage/soe_block.h"
 #include "storage/soe_bufmgr.h"
@@ -28,5 +29,8 @@ extern void heap_insert_s(VRelation relation, Item tup, Size len, HeapTuple tupl
 extern void heap_insert_block_s(VRelation relation, char *page, int blkno);
 
 extern void heap_gettuple_s(VRelation rel, ItemPointer tid, HeapTuple tuple);
+extern bool heap_update_s(VRelation rel, ItemPointer tid, Item tup, Size len,
+						  TupleDesc desc, int *keycols, int nkeycols);
+extern bool heap_delete_s(VRelation rel, ItemPointer tid);
 
 #endif							/* SOE_HEAPAM_H */
@@ -192,6 +192,17 @@ struct HeapTupleHeaderData
 
 #define HEAP_XACT_MASK			0xFFF0	/* visibility-related bits */
 
+/*
+ * information stored in t_infomask2:
+ */
+#define HEAP_NATTS_MASK			0x07FF	/* 11 bits for number of attributes */
+
+#define HeapTupleHeaderGetNatts_s(tup) \
+	((tup)->t_infomask2 & HEAP_NATTS_MASK)
+
+#define HeapTupleHeaderHasNulls_s(tup) \
+	(((tup)->t_infomask & HEAP_HASNULL) != 0)
+
 
 
 
@@ -219,5 +230,10 @@ extern void heap_fill_tuple_s(TupleDesc tupleDesc,
 							  Datum * values, bool *isnull,
 							  char *data, Size data_size,
 							  uint16 * infomask, bits8 * bit);
+/* soe_htup.h includes this header before it defines HeapTuple */
+struct HeapTupleData;
+extern bool heap_deform_tuple_s(struct HeapTupleData *tuple,
+								TupleDesc tupleDesc, char **values,
+								int32 *lens, bool *isnull);
 
 #endif                  /*SOE_HTUP_DETAILS.h*/
@@ -97,6 +97,31 @@ typedef IndexTupleData * IndexTuple;
 
 #define IndexTupleSize_s(itup)		((Size) ((itup)->t_info & INDEX_SIZE_MASK))
 
+/*
+ * Posting list tuples
+ *
+ * A btree leaf tuple with INDEX_AM_RESERVED_BIT set holds the heap TIDs of
+ * every duplicate of its key. Its t_tid is not a heap TID: the block number
+ * is the offset of the posting list from the start of the tuple and the
+ * offset number is the number of TIDs. The posting list is the first TID,
+ * stored as an ItemPointerData, followed by the differences between each
+ * TID and the previous one (the TIDs are sorted), taken as the 48 bit
+ * number block << 16 | offset and written 7 bits per byte, lowest bits
+ * first, with the high bit set on every byte but the last.
+ */
+#define IndexTupleIsPosting_s(itup) \
+	(((itup)->t_info & INDEX_AM_RESERVED_BIT) != 0)
+#define IndexTupleGetNPosting_s(itup) \
+	ItemPointerGetOffsetNumberNoCheck_s(&(itup)->t_tid)
+#define IndexTupleGetPostingOffset_s(itup) \
+	ItemPointerGetBlockNumberNoCheck_s(&(itup)->t_tid)
+
+/*
+ * Upper bound on the number of heap TIDs of an index page, as each TID of a
+ * posting list takes at least one byte.
+ */
+#define MaxTIDsPerIndexPage_s	((int) (BLCKSZ - SizeOfPageHeaderData))
+
 /*
  * Takes an infomask as argument (primarily because this needs to be usable
  * at index_form_tuple time so enough space is allocated).
@@ -130,5 +155,6 @@ typedef IndexTupleData * IndexTuple;
 /* routines in indextuple.c */
 extern IndexTuple index_form_tuple_s(TupleDesc tupleDescriptor,
 									 Datum * values, bool *isnull);
+extern int	index_getposting_s(IndexTuple itup, ItemPointer tids, int maxtids);
 
 #endif
@@ -0,0 +1,78 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_nbtcompare.h
+ *	  Comparison routines for the key types supported by the SOE indexes.
+ *
+ * The comparator of an index is chosen once, from the types of the indexed
+ * attributes given at initialization (attrDesc). Scan keys of the fixed size
+ * types (int4, int8, float8, date, timestamp, timestamptz) are the binary
+ * value of the datum, in the byte order of the enclave. Scan keys of the
+ * other types are the bytes of the value, without a varlena header.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/access/soe_nbtcompare.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SOE_NBTCOMPARE_H
+#define SOE_NBTCOMPARE_H
+
+#include "soe_c.h"
+#include "access/soe_itup.h"
+#include "access/soe_skey.h"
+#include "storage/soe_bufpage.h"
+
+/* Type oids, from pg_type.dat */
+#define BYTEAOID		17
+#define INT8OID			20
+#define INT4OID			23
+#define TEXTOID			25
+#define FLOAT8OID		701
+#define BPCHAROID		1042
+#define VARCHAROID		1043
+#define DATEOID			1082
+#define TIMESTAMPOID	1114
+#define TIMESTAMPTZOID	1184
+
+extern keycmp_function _bt_keycmp_s(Oid atttypid);
+extern keycmp_function _bt_valuecmp_s(Oid atttypid);
+extern bool _bt_keyexact_s(TupleDesc desc, ScanKey scankey, IndexTuple itup,
+						   bool normkeys);
+extern bool _bt_keyisstring_s(Oid atttypid);
+extern bool _bt_keysizeok_s(Oid atttypid, int keysize);
+extern StrategyNumber _bt_strategy_s(unsigned int opoid);
+extern bool _bt_strategymatches_s(StrategyNumber strategy, int32 test);
+extern int	_bt_keysuffixlen_s(Oid atttypid, const char *lastleft,
+							   const char *firstright);
+
+/* Keys of one or more columns, described by the attributes of the index. */
+extern keycmp_function _bt_initkeydesc_s(TupleDesc desc, const char *attrDesc,
+										 unsigned int attrDescLength);
+extern int	_bt_keycolumns_s(TupleDesc desc, const char *key, int keysize);
+extern void _bt_preparekey_s(TupleDesc desc, ScanKey scankey);
+extern void _bt_freekeydata_s(ScanKey scankey);
+extern IndexTuple _bt_formkeytuple_s(TupleDesc desc, const char *key,
+									 int keysize);
+
+/* Normalized keys, compared with memcmp on the pages with BTP_NORMKEYS. */
+extern bool _bt_keynormalizable_s(Oid atttypid);
+extern bool _bt_normalizepage_s(Oid atttypid, Page page);
+extern void _bt_normalizetuple_s(Oid atttypid, IndexTuple itup);
+extern void _bt_normalizekey_s(Oid atttypid, ScanKey scankey);
+extern int32 _bt_normcmp_s(ScanKey scankey, const char *attr);
+extern void _bt_denormalizetuple_s(Oid atttypid, IndexTuple itup);
+extern void _bt_ctsearch_s(Page page, ScanKey scankey, OffsetNumber low,
+						   OffsetNumber high, int cmpval,
+						   OffsetNumber *tieLow, OffsetNumber *tieHigh);
+
+/* Page splits of the insertions, in soe_nbtinsert.c. */
+extern IndexTuple _bt_splitpage_s(Page origpage, BlockNumber origblkno,
+								  Page rightpage, BlockNumber rightblkno,
+								  TupleDesc desc, IndexTuple newitem,
+								  OffsetNumber newitemoff);
+extern bool _bt_pgaddtup_s(Page page, Size itemsize, IndexTuple itup,
+						   OffsetNumber itup_off);
+
+#endif							/* SOE_NBTCOMPARE_H */
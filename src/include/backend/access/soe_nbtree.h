@@ -63,14 +63,27 @@ typedef struct BTPageOpaqueData
 	BTCycleId   btpo_cycleid; /* vacuum cycle ID of latest split */
 	uint32		o_blkno; 		/* used to store original block number inside soe*/
     uint32      location[2];    //we will store up to 2 integer of relevant location
-    /* Stores the counters of the child nodes
-     * currently limited to 300 child nodes pers parent.
-     * */
-    uint32      counters[300];  
 }			BTPageOpaqueData;
 
 typedef BTPageOpaqueData * BTPageOpaque;
 
+/*
+ * The special space of an index page continues after the opaque data with
+ * the access counters of the items of the page, one uint32 per item. The
+ * counter of the item at offnum is the number of accesses to the child
+ * page (or to the heap block of a leaf item) the token based ORAMs use to
+ * derive its location. The loaded pages are given one counter per item,
+ * so the fanout is only bounded by the page space. Pages created in the
+ * enclave by _bt_pageinit_s, as the pages of splits, have no counters, so
+ * the token based ORAMs can not take inserts.
+ */
+#define BTPageGetCounters_s(page) \
+	((uint32 *) ((char *) PageGetSpecialPointer_s(page) + \
+				 MAXALIGN_s(sizeof(BTPageOpaqueData))))
+#define BTPageGetNCounters_s(page) \
+	((PageGetSpecialSize_s(page) - MAXALIGN_s(sizeof(BTPageOpaqueData))) / \
+	 sizeof(uint32))
+
 /* Bits defined in btpo_flags */
 #define BTP_LEAF		(1 << 0)	/* leaf page, i.e. not internal page */
 #define BTP_ROOT		(1 << 1)	/* root page (has no parent) */
@@ -80,6 +93,7 @@ typedef BTPageOpaqueData * BTPageOpaque;
 #define BTP_SPLIT_END	(1 << 5)	/* rightmost page of split group */
 #define BTP_HAS_GARBAGE (1 << 6)	/* page has LP_DEAD tuples */
 #define BTP_INCOMPLETE_SPLIT (1 << 7)	/* right sibling's downlink is missing */
+#define BTP_NORMKEYS	(1 << 8)	/* keys are normalized, see nbtcompare */
 
 /*
  * The max allowed value of a cycle ID is a bit less than 64K.  This is
@@ -162,6 +176,7 @@ typedef struct BTMetaPageData
 #define P_ISMETA_s(opaque)		(((opaque)->btpo_flags & BTP_META) != 0)
 #define P_IGNORE_s(opaque)		(((opaque)->btpo_flags & (BTP_DELETED|BTP_HALF_DEAD)) != 0)
 #define P_INCOMPLETE_SPLIT_s(opaque)	(((opaque)->btpo_flags & BTP_INCOMPLETE_SPLIT) != 0)
+#define P_NORMKEYS_s(opaque)	(((opaque)->btpo_flags & BTP_NORMKEYS) != 0)
 
 /*
  *	Lehman and Yao's algorithm requires a ``high key'' on every non-rightmost
@@ -320,7 +335,13 @@ typedef struct BTScanPosData
 	int			lastItem;		/* last valid index in items[] */
 	int			itemIndex;		/* current index in items[] */
 
-	BTScanPosItem items[MaxIndexTuplesPerPage]; /* MUST BE LAST */
+	/*
+	 * The items are allocated when a page is first read and grown when the
+	 * posting lists of a page have more TIDs than there are items, up to
+	 * MaxTIDsPerIndexPage_s.
+	 */
+	BTScanPosItem *items;
+	int			maxItems;		/* allocated entries of items[] */
 }			BTScanPosData;
 
 typedef BTScanPosData * BTScanPos;
@@ -336,6 +357,12 @@ typedef BTScanPosData * BTScanPos;
 		(scanpos).nextPage = InvalidBlockNumber; \
 	} while (0);
 
+#define BTScanPosInitItems_s(scanpos) \
+	do { \
+		(scanpos).items = NULL; \
+		(scanpos).maxItems = 0; \
+	} while (0);
+
 #define BT_N_KEYS_OFFSET_MASK		0x0FFF
 
 #define BTreeTupleSetNAtts_s(itup, n) \
@@ -391,19 +418,19 @@ extern bool btinsert_s(VRelation indexRel, VRelation heapRel, ItemPointer ht_cti
 extern IndexScanDesc btbeginscan_s(VRelation rel, const char *key, int keysize);
 extern bool btgettuple_s(IndexScanDesc scan);
 extern void btendscan_s(IndexScanDesc scan);
-extern void btree_load_s(VRelation indexRel, char* block, unsigned int level, unsigned int  offset);
-extern void btree_fanout_setup(int* fanouts, 
+extern void btree_load_s(VRelation indexRel, char* block, unsigned int level, unsigned int  offset, bool heapTokens);
+extern void btree_fanout_setup(VRelation rel, int* fanouts,
                                unsigned int fanout_size,
                                unsigned int nlevels);
 
-extern void free_btree_fanout();
+extern void free_btree_fanout(VRelation rel);
 
 
 /*
  * prototypes for functions in nbtinsert.c
  */
 extern bool _bt_doinsert_s(VRelation rel, IndexTuple itup, char *datum, int size, VRelation heapRel);
-extern Buffer _bt_getstackbuf_s(VRelation rel, BTStack stack, int access);
+extern void _bt_dummyinsert_s(VRelation rel);
 
 /*
  * prototypes for functions in nbtpage.c
@@ -416,6 +443,8 @@ extern Buffer _bt_getbuf_s(VRelation rel, BlockNumber blkno, int access);
 extern void _bt_relbuf_s(VRelation rel, Buffer buf);
 extern void _bt_pageinit_s(Page page, Size size);
 extern Buffer _bt_getbuf_level_s(VRelation rel, BlockNumber blkno);
+extern BlockNumber _bt_levelstart_s(VRelation rel, unsigned int level);
+extern BlockNumber _bt_levelsize_s(VRelation rel, unsigned int level);
 
 /*
  * prototypes for functions in nbtsearch.c
@@ -436,10 +465,18 @@ extern void bt_dummy_search_s(VRelation rel, int maxHeight);
  * prototypes for functions in nbtutils.c
  */
 extern ScanKey _bt_mkscankey_s(VRelation rel, IndexTuple itup, char *datum, int dsize);
+extern void _bt_sethikey_s(IndexScanDesc scan, TupleDesc desc, const char *key,
+						   int keysize, StrategyNumber strategy);
 extern void _bt_freeskey_s(ScanKey skey);
+extern IndexTuple _bt_truncate_s(TupleDesc desc, IndexTuple lastleft,
+								 IndexTuple firstright);
+extern uint32 _bt_nextcounter_s(VRelation rel, Page page, OffsetNumber offnum,
+								uint32 step);
 extern void _bt_freestack_s(BTStack stack);
 extern IndexTuple _bt_checkkeys_s(IndexScanDesc scan,
 								  Page page, OffsetNumber offnum, bool *continuescan);
+extern bool _bt_matchexact_s(IndexScanDesc scan);
+extern void _bt_killitem_s(IndexScanDesc scan, bool res);
 extern int	bpchartruelen_s(char *s, int len);
 
 extern unsigned int getRandomInt_nb(void);
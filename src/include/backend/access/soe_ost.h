@@ -64,15 +64,18 @@ typedef struct BTPageOpaqueDataOST
 	BTCycleId_OST btpo_cycleid; /* vacuum cycle ID of latest split */
     uint32      o_blkno;
     uint32      location[2];    //we will store up to 2 integer of relevant location
-    /* Stores the counters of the child nodes
-     * currently limited to 300 child nodes pers parent.
-     **/
-    uint32      counters[300];  
-
 }			BTPageOpaqueDataOST;
 
 typedef BTPageOpaqueDataOST * BTPageOpaqueOST;
 
+/* Access counters of the items, after the opaque data (see soe_nbtree.h). */
+#define BTPageGetCounters_OST(page) \
+	((uint32 *) ((char *) PageGetSpecialPointer_s(page) + \
+				 MAXALIGN_s(sizeof(BTPageOpaqueDataOST))))
+#define BTPageGetNCounters_OST(page) \
+	((PageGetSpecialSize_s(page) - MAXALIGN_s(sizeof(BTPageOpaqueDataOST))) / \
+	 sizeof(uint32))
+
 /* Bits defined in btpo_flags */
 #define BTP_LEAF_OST		(1 << 0)	/* leaf page, i.e. not internal page */
 #define BTP_ROOT_OST		(1 << 1)	/* root page (has no parent) */
@@ -83,6 +86,7 @@ typedef BTPageOpaqueDataOST * BTPageOpaqueOST;
 #define BTP_HAS_GARBAGE_OST (1 << 6)	/* page has LP_DEAD tuples */
 #define BTP_INCOMPLETE_SPLI_OST (1 << 7)	/* right sibling's downlink is
 											 * missing */
+#define BTP_NORMKEYS_OST	(1 << 8)	/* keys are normalized */
 
 
 
@@ -123,7 +127,7 @@ typedef struct BTMetaPageDataOST
 #define BTMaxItemSize_OST(page) \
 	MAXALIGN_DOWN_s((PageGetPageSize_s(page) - \
 				   MAXALIGN_s(SizeOfPageHeaderData + 3*sizeof(ItemIdData)) - \
-				   MAXALIGN_s(sizeof(BTPageOpaqueData))) / 3)
+				   MAXALIGN_s(sizeof(BTPageOpaqueDataOST))) / 3)
 
 /*
  * The leaf-page fillfactor defaults to 90% but is user-adjustable.
@@ -157,6 +161,7 @@ typedef struct BTMetaPageDataOST
 #define P_ISMETA_OST(opaque)		(((opaque)->btpo_flags & BTP_META_OST) != 0)
 #define P_IGNORE_OST(opaque)		(((opaque)->btpo_flags & (BTP_DELETED_OST|BTP_HALF_DEAD_OST)) != 0)
 #define P_INCOMPLETE_SPLIT_OST(opaque)	(((opaque)->btpo_flags & BTP_INCOMPLETE_SPLIT_OST) != 0)
+#define P_NORMKEYS_OST(opaque)	(((opaque)->btpo_flags & BTP_NORMKEYS_OST) != 0)
 
 /*
  *	Lehman and Yao's algorithm requires a ``high key'' on every non-rightmost
@@ -315,7 +320,13 @@ typedef struct BTScanPosDataOST
 	int			lastItem;		/* last valid index in items[] */
 	int			itemIndex;		/* current index in items[] */
 
-	BTScanPosItemOST items[MaxIndexTuplesPerPage];	/* MUST BE LAST */
+	/*
+	 * The items are allocated when a page is first read and grown when the
+	 * posting lists of a page have more TIDs than there are items, up to
+	 * MaxTIDsPerIndexPage_s.
+	 */
+	BTScanPosItemOST *items;
+	int			maxItems;		/* allocated entries of items[] */
 }			BTScanPosDataOST;
 
 typedef BTScanPosDataOST * BTScanPosOST;
@@ -331,6 +342,12 @@ typedef BTScanPosDataOST * BTScanPosOST;
 		(scanpos).nextPage = InvalidBlockNumber; \
 	} while (0);
 
+#define BTScanPosInitItems_OST(scanpos) \
+	do { \
+		(scanpos).items = NULL; \
+		(scanpos).maxItems = 0; \
+	} while (0);
+
 #define BT_N_KEYS_OFFSET_MASK		0x0FFF
 
 #define BTreeTupleSetNAtts_OST(itup, n) \
@@ -383,11 +400,18 @@ typedef BTScanOpaqueDataOST * BTScanOpaqueOST;
  * external entry points for btree, in nbtree.c
  */
 extern bool insert_ost(OSTRelation relstate, char *block, unsigned int level, unsigned int offset);
+extern bool btinsert_ost(OSTRelation rel, ItemPointer ht_ctid, char *datum, unsigned int datumSize);
 extern IndexScanDesc btbeginscan_ost(OSTRelation rel, const char *key, int keysize);
 extern bool btgettuple_ost(IndexScanDesc scan);
 extern void btendscan_ost(IndexScanDesc scan);
 
 
+/*
+ * prototypes for functions in nbtinsert.c
+ */
+extern bool _bt_doinsert_ost(OSTRelation rel, IndexTuple itup, char *datum, int size);
+extern void _bt_dummyinsert_ost(OSTRelation rel);
+
 /*
  * prototypes for functions in nbtpage.c
  */
@@ -421,8 +445,12 @@ extern void bt_dummy_search_ost(OSTRelation rel, int maxHeight);
 extern ScanKey _bt_mkscankey_ost(OSTRelation rel, IndexTuple itup, char *datum, int dsize);
 extern void _bt_freeskey_ost(ScanKey skey);
 extern void _bt_freestack_ost(BTStackOST stack);
+extern uint32 _bt_nextcounter_ost(OSTRelation rel, Page page,
+								  OffsetNumber offnum, uint32 step);
 extern IndexTuple _bt_checkkeys_ost(IndexScanDesc scan,
 									Page page, OffsetNumber offnum, bool *continuescan);
+extern bool _bt_matchexact_ost(IndexScanDesc scan);
+extern void _bt_killitem_ost(IndexScanDesc scan, bool res);
 extern int	bpchartruelen_ost(char *s, int len);
 
 extern unsigned int getRandomInt_nb_ost(void);
@@ -0,0 +1,57 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_pushdown.h
+ *	  Projections and predicates on the columns of a table evaluated in the
+ *	  enclave on the tuples of getTupleProject.
+ *
+ * src/include/access/soe_pushdown.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SOE_PUSHDOWN_H
+#define SOE_PUSHDOWN_H
+
+#include "soe_c.h"
+#include "access/soe_attnum.h"
+#include "access/soe_htup.h"
+#include "access/soe_skey.h"
+#include "access/soe_tupdesc.h"
+
+/*
+ * A predicate on a column of the table, comparing the column with a
+ * constant in the scan key format of the type of the column.
+ */
+typedef struct PushdownPredData
+{
+	AttrNumber	attnum;			/* column, from 0 */
+	StrategyNumber strategy;	/* btree strategy of the operator */
+	ScanKeyData key;			/* the constant and its comparator */
+}			PushdownPredData;
+
+/*
+ * A query pushed down to the enclave, parsed from the buffer of a request:
+ *
+ *	int32 nproj, then nproj int32 column numbers (from 1), the projection;
+ *	int32 npreds, then for each predicate an int32 column number, the
+ *	uint32 oid of the operator, an int32 length and the constant.
+ *
+ * A projection without columns returns every column of the table. All the
+ * predicates must hold for a tuple to be returned.
+ */
+typedef struct PushdownData
+{
+	int			nproj;
+	AttrNumber *proj;			/* projected columns, from 0 */
+	int			npreds;
+	PushdownPredData *preds;
+}			PushdownData;
+
+typedef PushdownData * Pushdown;
+
+extern Pushdown pushdown_parse_s(TupleDesc desc, const char *query,
+								 unsigned int queryLen);
+extern void pushdown_free_s(Pushdown pd);
+extern int	pushdown_apply_s(Pushdown pd, TupleDesc desc, HeapTuple tuple,
+							 char *result, unsigned int resultLen);
+
+#endif							/* SOE_PUSHDOWN_H */
@@ -31,8 +31,24 @@ typedef struct IndexScanDescData
 	/* state data for traversing HOT chains in index_getnext */
 	bool		xs_continue_hot;	/* T if must keep walking HOT chain */
 
+	/* in an index-only scan, xs_itup is the index tuple of the match */
+	bool		xs_want_itup;
+	IndexTuple	xs_itup;
+	/* the heap tuple of the match is read after the scan */
+	bool		xs_heapfetch;
+	/* mark the index item of the match dead (deleteTuple) */
+	bool		xs_kill;
+	bool		xs_killed;
+	/* the match must be equal to the whole scan key (changeTuple) */
+	bool		xs_exact;
+	/* upper bound of a range scan (aggregateTuples), NULL if none */
+	ScanKey		xs_hikey;
+	StrategyNumber xs_histrategy;
+
 	unsigned int opoid;
 	/* oid of where comparison clause. */
+	StrategyNumber strategy;
+	/* btree strategy of opoid */
     //Forest ORAM or PathORAM
     Mode mode;
 
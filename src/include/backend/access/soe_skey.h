@@ -65,8 +65,25 @@ typedef struct ScanKeyData
 	Oid			sk_subtype;		/* strategy subtype */
 	char	   *sk_argument;	/* data to compare */
 	int			datumSize;
+	char	   *sk_norm;		/* normalized sk_argument, or NULL */
+	int			normSize;
+	bool		normVarlena;	/* sk_norm is compared with a varlena */
+
+	/* keys of an index on several columns (see soe_nbtcompare.c) */
+	int			sk_ncols;		/* number of columns in sk_cols, or 0 */
+	struct ScanKeyData *sk_cols;	/* scan key of each leading column */
+	int32		(*sk_cmp) (struct ScanKeyData *scankey, const char *attr);
+	int16		sk_attlen;		/* attlen and attalign of a column */
+	char		sk_attalign;
 }			ScanKeyData;
 
 typedef ScanKeyData * ScanKey;
 
+/*
+ * Compares a scan key with the key attributes of an index tuple, given the
+ * first one. Returns a value less than, equal to or greater than zero if the
+ * key is smaller, equal or greater than the attributes.
+ */
+typedef int32 (*keycmp_function) (ScanKey scankey, const char *attr);
+
 #endif          /* SKEY_H  */
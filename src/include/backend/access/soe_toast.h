@@ -0,0 +1,82 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_toast.h
+ *	  Out of line storage of the tuples larger than the pages of the table,
+ *	  split in chunks on a separate heap ORAM.
+ *
+ * src/include/access/soe_toast.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SOE_TOAST_H
+#define SOE_TOAST_H
+
+#include "access/soe_htup.h"
+#include "access/soe_htup_details.h"
+#include "storage/soe_bufmgr.h"
+
+/*
+ * The pointer to a tuple stored out of line. Its chunks are on consecutive
+ * blocks of the toast from firstBlock, one chunk per block.
+ */
+typedef struct ToastPointerData
+{
+	uint32		magic;
+	uint32		rawSize;		/* size of the tuple */
+	BlockNumber firstBlock;
+	uint32		nchunks;
+}			ToastPointerData;
+
+typedef ToastPointerData * ToastPointer;
+
+#define TOAST_POINTER_MAGIC 0x54534f45
+
+/*
+ * The item of the table that stands for a tuple stored out of line is a heap
+ * tuple without columns whose data is the pointer, so heap_insert_s can set
+ * its t_ctid. It is told apart from the tuples of the table by a bit of
+ * t_infomask2 above the number of columns, which PostgreSQL does not use.
+ */
+#define HEAP_TOAST_POINTER_S	0x0800
+
+#define ToastTupleSize \
+	(MAXALIGN_s(SizeofHeapTupleHeader) + sizeof(ToastPointerData))
+
+#define ToastTupleGetPointer_s(tuple) \
+	((ToastPointer) ((char *) (tuple)->t_data + (tuple)->t_data->t_hoff))
+
+#define IsToastPointer_s(tuple) \
+	((tuple)->t_len == ToastTupleSize && \
+	 ((tuple)->t_data->t_infomask2 & HEAP_TOAST_POINTER_S) != 0 && \
+	 ToastTupleGetPointer_s(tuple)->magic == TOAST_POINTER_MAGIC)
+
+/* A chunk of a tuple, the only item of its toast block. */
+typedef struct ToastChunkData
+{
+	BlockNumber firstBlock;		/* first block of the tuple */
+	uint32		seq;			/* chunk number */
+	uint32		len;
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+}			ToastChunkData;
+
+typedef ToastChunkData * ToastChunk;
+
+/* heap_pageInit keeps 4 ints in the special space of a page */
+#define TOAST_MAX_ITEM_SIZE \
+	MAXALIGN_DOWN_s(BLCKSZ - SizeOfPageHeaderData - sizeof(ItemIdData) - \
+					MAXALIGN_s(sizeof(int) * 4))
+#define TOAST_CHUNK_SIZE \
+	(TOAST_MAX_ITEM_SIZE - offsetof_s(ToastChunkData, data))
+
+/* Number of chunks of the bytes [offset, offset + len) of a tuple. */
+#define ToastChunksSpanned(offset, len) \
+	((len) == 0 ? 0 : \
+	 ((offset) + (len) - 1) / TOAST_CHUNK_SIZE - (offset) / TOAST_CHUNK_SIZE + 1)
+
+extern bool toast_insert_s(VRelation rel, const char *tuple, uint32 size,
+						   ToastPointer ptr);
+extern HeapTupleHeader toast_formtuple_s(ToastPointer ptr);
+extern int	toast_fetch_s(VRelation rel, ToastPointer ptr, uint32 offset,
+						  char *data, uint32 len);
+
+#endif							/* SOE_TOAST_H */
@@ -19,6 +19,13 @@
 #include "logger/logger.h"
 
 
+/*
+ * Check a tuple's null bitmap to determine whether the attribute is null.
+ * Note that a 0 in the null bitmap indicates a null, while 1 indicates
+ * non-null.
+ */
+#define att_isnull_s(ATT, BITS) (!((BITS)[(ATT) >> 3] & (1 << ((ATT) & 0x07))))
+
 
 /*
  * att_align_nominal aligns the given offset as needed for a datum of alignment
@@ -60,6 +67,22 @@
 	att_align_nominal_s(cur_offset, attalign) \
 )
 
+/*
+ * att_align_pointer performs the same calculation as att_align_datum,
+ * but is used when walking a tuple.  attptr is the current actual data
+ * pointer; when accessing a varlena field we have to "peek" to see if we
+ * are looking at a pad byte or the first byte of a 1-byte-header datum.
+ * (A zero byte must be either a pad byte, or the first byte of a correctly
+ * aligned 4-byte length word; in either case we can align safely.  A non-zero
+ * byte must be either a 1-byte length word, or the first byte of a correctly
+ * aligned 4-byte length word; in either case we need not align.)
+ */
+#define att_align_pointer_s(cur_offset, attalign, attlen, attptr) \
+( \
+	((attlen) == -1 && VARATT_NOT_PAD_BYTE_S(attptr)) ? \
+	(uintptr_t) (cur_offset) : \
+	att_align_nominal_s(cur_offset, attalign) \
+)
 
 /*
  * att_addlength_datum increments the given offset by the space needed for
@@ -78,7 +101,7 @@
  * actually perfectly OK, but probably should be cleaned up along with
  * the same practice for att_align_pointer.
  */
-/*#define att_addlength_pointer_s(cur_offset, attlen, attptr) \
+#define att_addlength_pointer_s(cur_offset, attlen, attptr) \
 ( \
 	((attlen) > 0) ? \
 	( \
@@ -92,7 +115,7 @@
 	( \
 		(cur_offset) + (strlen((char *) (attptr)) + 1) \
 	)) \
-)*/
+)
 
 /*
  * store_att_byval is a partial inverse of fetch_att: store a given Datum
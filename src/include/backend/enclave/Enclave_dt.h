@@ -8,6 +8,8 @@ typedef unsigned int sgx_status_t;
 
 
 
+void		selectORAM(const char *tORAM, const char *iORAM);
+
 void		initSOE(const char *tName, const char *iName, int tNBlocks, 
                     int* fanouts, unsigned int fanout_size,
                     unsigned int nlevels,int nBlocks, unsigned int tOid,
@@ -21,12 +23,36 @@ void		initFSOE(const char *tName, const char *iName, int tNBlocks,
                      unsigned int iOid, char *pg_attr_desc, 
                      unsigned int pgDescSize);
 
-void		insert(const char *heapTuple, unsigned int tupleSize, 
+int			insert(const char *heapTuple, unsigned int tupleSize, 
                    char *datum, unsigned int datumSize);
 
+int			initDelta(const char *dName, int dNBlocks);
+
+int			appendTuple(const char *heapTuple, unsigned int tupleSize,
+                        char *datum, unsigned int datumSize);
+
+int			mergeDelta(void);
+
+int			initToast(const char *toastName, int toastNBlocks);
+
+int			readToast(unsigned int offset, char *data, unsigned int dataLen);
+
 void		addIndexBlock(char *block, unsigned int blockSize, 
                           unsigned int offset, unsigned int level);
 
+int			addIndex(const char *iName, int *fanouts, unsigned int fanout_size,
+                     unsigned int nlevels, int nBlocks, unsigned int iOid,
+                     unsigned int functionOid, unsigned int indexHandler,
+                     char *attrDesc, unsigned int attrDescLength);
+
+int			addFIndex(const char *iName, int *fanout, unsigned int fanout_size,
+                      unsigned int nlevels, unsigned int iOid,
+                      char *pg_attr_desc, unsigned int pgDescSize);
+
+void		addIndexBlockTo(unsigned int indexId, char *block,
+                            unsigned int blockSize, unsigned int offset,
+                            unsigned int level);
+
 void		addHeapBlock(char *block, unsigned int blockSize, 
                          unsigned int blkno);
 
@@ -37,6 +63,51 @@ int			getTuple(unsigned int opmode, unsigned int opoid,
                      unsigned int tupleLen, char *tupleData, 
                      unsigned int tupleDataLen);
 
+int			getTupleIndex(unsigned int indexId, unsigned int opmode,
+                          unsigned int opoid, const char *key, int scanKeySize,
+                          char *tuple, unsigned int tupleLen, char *tupleData,
+                          unsigned int tupleDataLen);
+
+int			updateTuple(unsigned int opoid, const char *key, int scanKeySize,
+                        const char *tuple, unsigned int tupleSize);
+
+int			deleteTuple(unsigned int opoid, const char *key, int scanKeySize);
+
+int			setTableDesc(char *attrDesc, unsigned int attrDescLength);
+
+int			getTupleProject(unsigned int opoid, const char *key,
+                            int scanKeySize, const char *query,
+                            unsigned int queryLen, char *tupleData,
+                            unsigned int tupleDataLen);
+
+int			aggregateTuples(unsigned int aggop, int attnum, unsigned int opoid,
+                            const char *key, int scanKeySize,
+                            unsigned int hiOpoid, const char *hiKey,
+                            int hiKeySize, unsigned int maxRange,
+                            char *result, unsigned int resultSize);
+
+int			flushWrites(unsigned int maxWrites);
+
+int			setIOBuffer(char *buffer, unsigned int bufferSize);
+
+void		setLogLevel(int level);
+
+void		flushLog(void);
+
+void		beginBulkLoad(void);
+
+int			endBulkLoad(void);
+
+unsigned int sealedStateSize(void);
+
+int			sealState(char *sealed, unsigned int sealedSize);
+
+int			restoreState(const char *sealed, unsigned int sealedSize);
+
+int			adviseSOE(unsigned int nTuples, unsigned int tupleSize,
+                      unsigned int keySize, unsigned int epcBudgetMB,
+                      char *advice, unsigned int adviceSize);
+
 void		closeSoe();
 
 extern void oc_logger(const char *str);
@@ -48,6 +119,10 @@ extern sgx_status_t outFileRead(char *page, const char *filename, int blkno,
                                 int pageSize);
 extern sgx_status_t outFileWrite(const char *block, const char *filename, 
                                  int oblkno, int pageSize);
+extern sgx_status_t outFileReadDirect(char *page, const char *filename,
+                                      int blkno, int pageSize);
+extern sgx_status_t outFileWriteDirect(const char *block, const char *filename,
+                                       int oblkno, int pageSize);
 extern sgx_status_t outFileClose(const char *filename);
 
 #endif          /*ENCLAVE_DT_H*/
@@ -7,6 +7,15 @@
 #define PRODUCTION_MODE 1
 
 
+/*
+ * Query modes of getTuple. A mode is fixed per request type, as the heap is
+ * only accessed by OPMODE_TUPLE: OPMODE_INDEX_ONLY returns the leaf index
+ * tuple of the match and OPMODE_EXISTS only whether there is a match.
+ */
+#define OPMODE_TUPLE 0
+#define OPMODE_INDEX_ONLY 1
+#define OPMODE_EXISTS 2
+
 /*  Index types */
 #define F_HASHHANDLER 331
 #define F_BTHANDLER 330
@@ -20,4 +29,53 @@
 #define STR_EQUAL 1070
 
 
+/* ORAM advisor (adviseSOE) */
+#define ADVISOR_MAX_LEVELS 16
+
+#define ADVICE_OK 0
+#define ADVICE_OVER_BUDGET 1
+
+/*
+ * Recommended ORAM configuration. tNBlocks is the heap size to pass to
+ * initSOE/initFSOE, fanouts/nlevels are the OST level sizes for initFSOE and
+ * iNBlocks is the size of the single nbtree ORAM for initSOE. The remaining
+ * fields are the simulated peak stash (summed over every ORAM), the
+ * estimated enclave memory footprint and the bytes transferred per query.
+ */
+typedef struct SOEAdvice
+{
+	unsigned int status;
+	unsigned int bkcap;
+	unsigned int tNBlocks;
+	unsigned int iNBlocks;
+	unsigned int nlevels;
+	int			fanouts[ADVISOR_MAX_LEVELS];
+	unsigned int peakStash;
+	unsigned long long epcBytes;
+	unsigned long long bytesPerQuery;
+} SOEAdvice;
+
+
+/* Aggregates of aggregateTuples */
+#define AGG_COUNT 0
+#define AGG_SUM 1
+#define AGG_MIN 2
+#define AGG_MAX 3
+
+/*
+ * Result of aggregateTuples. count is the number of tuples in the range for
+ * AGG_COUNT and the number of non-null values aggregated otherwise. The sum,
+ * minimum or maximum is in intValue for int4, int8, date and timestamp
+ * columns and in floatValue for float8 columns. more is set when the range
+ * had maxRange tuples, so it may hold more.
+ */
+typedef struct SOEAggregate
+{
+	unsigned int count;
+	unsigned int more;
+	long long	intValue;
+	double		floatValue;
+} SOEAggregate;
+
+
 #endif   /* SOE_OPS_H */
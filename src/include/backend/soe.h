@@ -39,10 +39,10 @@ typedef uint16 StrategyNumber;
 
 //extern declarations
 
-extern ORAMState initORAMState(const char *name, int nBlocks, AMOFile* (*ofile)(), bool isHeap);
+extern ORAMState initORAMState(const char *name, int nBlocks, AMOFile* (*ofile)(), const ORAMBackend *backend, Amgr **amgr, BulkLoad *bulk);
 
 extern void FormIndexDatum_s(HeapTuple tuple, Datum *values, bool *isnull);
 
- OSTreeState initOSTreeProtocol(const char *name, unsigned int iOid, int* fanouts, unsigned int nlevels, AMOFile* (*ofile)());
+ OSTreeState initOSTreeProtocol(const char *name, unsigned int iOid, int* fanouts, unsigned int nlevels, AMOFile* (*ofile)(), const ORAMBackend *backend);
 
 #endif 	/* SOE_H */
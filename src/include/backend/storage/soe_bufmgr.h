@@ -6,6 +6,10 @@
 #include "storage/soe_buf.h"
 #include "storage/soe_bufpage.h"
 #include "storage/soe_block.h"
+#include "storage/soe_oram_backend.h"
+#include "storage/soe_snapshot.h"
+#include "storage/soe_bulkload.h"
+#include "access/soe_skey.h"
 
 #include <oram/oram.h>
 #include <oram/plblock.h>
@@ -51,6 +55,16 @@
 #define BUFFER_LOCK_SHARE		1
 #define BUFFER_LOCK_EXCLUSIVE	2
 
+/*
+ * With DEFERRED_WB, MarkBufferDirty_s queues the page instead of writing it
+ * to the ORAM. Each queued write keeps its block in the ORAM stash until it
+ * is written back, so the queue is drained synchronously once it holds
+ * MAX_PENDING_WRITES pages.
+ */
+#ifndef MAX_PENDING_WRITES
+#define MAX_PENDING_WRITES 64
+#endif
+
 typedef void (*pageinit_function) (Page page, int blockNum, unsigned int location, Size blocksize);
 
 typedef struct VRelation
@@ -64,6 +78,11 @@ typedef struct VRelation
 	/* in memory free space map that keeps the number of items in each block */
 
 	ORAMState	oram;
+	const ORAMBackend *backend;
+	/* first ORAM block of the relation, when the ORAM is shared (SINGLE_ORAM) */
+	BlockNumber blockOffset;
+	/* the ORAM is closed by the relation that owns it */
+	bool		sharedORAM;
 	List	   *buffer;
 	/* Buffer containing relation pages */
 
@@ -75,6 +94,8 @@ typedef struct VRelation
 
 	/* FormData_pg_attribute* indexTupleDesc; */
 	TupleDesc	tDesc;
+	/* comparator of the index keys, chosen from the type of tDesc */
+	keycmp_function keycmp;
 
 	/* Funciton oid to hash values */
 	unsigned int foid;
@@ -98,6 +119,35 @@ typedef struct VRelation
     unsigned int leafCurrentCounter;
     unsigned int heapBlockCounter;
 
+    /* Writes waiting to be evicted to the ORAM, oldest first. */
+    List       *pending;
+
+    /* Pages loaded between beginBulkLoad and endBulkLoad, or NULL. */
+    BulkLoad    bulk;
+
+    /*
+     * Number of blocks of the levels of a nbtree index below the root
+     * (fanouts[i] for level i + 1) and number of such levels.
+     */
+    int        *fanouts;
+    unsigned int nlevels;
+
+    /*
+     * Blocks of each level in use, from the root (nlevels + 1 entries). The
+     * other blocks of a level are the free pages of its splits.
+     */
+    int        *levelBlocks;
+
+    /*
+     * Pages loaded on the chain of each bucket of a hash index (nbuckets
+     * entries), counted by hash_load_s while the index is loaded.
+     */
+    uint16     *chainPages;
+    uint32      nbuckets;
+
+    /* A loaded block was rejected, so the relation can not be used. */
+    bool        loadFailed;
+
 }		   *VRelation;
 
 typedef struct VBlock
@@ -106,6 +156,15 @@ typedef struct VBlock
 	char	   *page;
 }		   *VBlock;
 
+/* Copy of a dirty page and of the token it has to be written with. */
+typedef struct VPendingWrite
+{
+	int			id;
+	char	   *page;
+	bool		hasToken;
+	unsigned int token[ORAM_TOKEN_SIZE];
+}		   *VPendingWrite;
+
 
 
 
@@ -120,7 +179,7 @@ typedef struct VBlock
 #define P_NEW	InvalidBlockNumber	/* grow the file to get a new page */
 
 
-extern VRelation InitVRelation(ORAMState relstate, unsigned int oid, int total_blocks, pageinit_function pg_f);
+extern VRelation InitVRelation(ORAMState relstate, const ORAMBackend *backend, unsigned int oid, int total_blocks, pageinit_function pg_f);
 
 extern Buffer ReadDummyBuffer(VRelation relation, BlockNumber blockNum);
                               
@@ -142,5 +201,11 @@ extern void UpdateFSM(VRelation rel);
 
 extern void BufferFull_s(VRelation rel, Buffer buffer);
 
+extern int FlushWrites_s(VRelation rel, int maxWrites);
+
+extern void SaveVRelation_s(VRelation rel, Snapshot snap);
+
+extern bool RestoreVRelation_s(VRelation rel, Snapshot snap);
+
 extern void closeVRelation(VRelation rel);
 #endif          /* SOE_BUFMGR_H*/
@@ -319,6 +319,8 @@ typedef PageHeaderData * PageHeader;
 
 extern void PageInit_s(Page page, Size pageSize, Size specialSize);
 extern void PageIndexMultiDelete_s(Page page, OffsetNumber * itemnos, int nitems);
+extern bool PageIndexTupleOverwrite_s(Page page, OffsetNumber offnum,
+									  Item newtup, Size newsize);
 extern Size PageGetHeapFreeSpace_s(Page page);
 extern Size PageGetFreeSpace_s(Page page);
 extern OffsetNumber PageAddItemExtended_s(Page page, Item item, Size size,
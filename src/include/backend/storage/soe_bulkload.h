@@ -0,0 +1,41 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_bulkload.h
+ *	  Oblivious bulk placement of the blocks loaded into an ORAM.
+ *
+ * Between the beginBulkLoad and endBulkLoad enclave calls, the pages loaded
+ * into the ORAMs without tokens are kept in the enclave instead of being
+ * written one at a time with a full ORAM access. endBulkLoad assigns every
+ * page a random leaf, sorts the pages into the buckets of their paths with an
+ * oblivious sort and rewrites each slot of the file once, in file order.
+ *
+ * The placement assumes the layout of the Path ORAM files: buckets of
+ * bucket capacity slots stored in heap order (bucket b has children 2b+1 and
+ * 2b+2), with leaf l stored in the bucket nleaves - 1 + l.
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ * src/include/backend/storage/soe_bulkload.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SOE_BULKLOAD_H
+#define SOE_BULKLOAD_H
+
+#include "soe_c.h"
+#include "storage/soe_oram_backend.h"
+
+typedef struct BulkLoadData *BulkLoad;
+
+/* Set between beginBulkLoad and endBulkLoad. */
+extern bool bulk_loading;
+
+extern BulkLoad bulk_create(const char *name, int level, const char *pmapName,
+							const ORAMBackend *backend, AMOFile * ofile,
+							unsigned int bkcap, unsigned int nblocks);
+extern void bulk_fileInit(const char *name, int level, unsigned int nslots);
+extern char *bulk_getPage(BulkLoad bulk, BlockNumber blkno);
+extern void bulk_setPage(BulkLoad bulk, BlockNumber blkno, const char *page);
+extern void bulk_finish(BulkLoad bulk, ORAMState oram);
+
+#endif							/* SOE_BULKLOAD_H */
@@ -5,8 +5,10 @@
 
 #include "storage/soe_bufpage.h"
 #include <oram/ofile.h>
+#include <oram/plblock.h>
 
-void		hash_pageInit(Page page, int blkno, Size blocksize);
+void		hash_pageInit(Page page, int blkno, unsigned int locationSize, Size blocksize);
+void		hash_pageTag(PLBlock block);
 extern AMOFile * hash_ofileCreate();
 
 #endif							/* SOE_HASH_OFILE_H */
@@ -4,6 +4,7 @@
 #include "soe_c.h"
 #include "storage/soe_bufpage.h"
 #include <oram/ofile.h>
+#include <oram/plblock.h>
 
 
 /* Data structure of the contents stored on every oblivious page. */
@@ -17,6 +18,17 @@ typedef struct OblivPageOpaqueData
 typedef OblivPageOpaqueData * OblivPageOpaque;
 
 void heap_pageInit(Page page, int blkno, unsigned int lsize, Size blocksize);
+void heap_pageTag(PLBlock block);
+
+/* Used by the file shared with the index (soe_single_ofile.c). */
+extern FileHandler heap_fileInit(const char *filename, unsigned int nblocks,
+								 unsigned int blocksize, unsigned int lsize,
+								 void *appData);
+extern void heap_fileWrite(FileHandler handler, const PLBlock block,
+						   const char *filename, const BlockNumber ob_blkno,
+						   void *appData);
+extern void heap_fileClose(FileHandler handler, const char *filename,
+						   void *appData);
 
 extern AMOFile * heap_ofileCreate();
 
@@ -5,8 +5,13 @@
 
 #include "storage/soe_bufpage.h"
 #include <oram/ofile.h>
+#include <oram/plblock.h>
 
 void		nbtree_pageInit(Page page, int blkno, unsigned int lsize, Size blocksize);
+void		nbtree_pageTag(PLBlock block);
+extern void nbtree_fileWrite(FileHandler handler, const PLBlock block,
+							 const char *filename, const BlockNumber ob_blkno,
+							 void *appData);
 extern AMOFile * nbtree_ofileCreate();
 
 #endif							/* SOE_NBTREE_OFILE_H */
@@ -0,0 +1,72 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_oram_backend.h
+ *	  ORAM constructions available to the buffer managers.
+ *
+ * Every relation keeps a pointer to the ORAM backend used to store its
+ * blocks. The default backend is the library selected by ORAM_LIB; the
+ * libraries listed in ORAM_LIBS are linked with their symbols renamed and can
+ * be chosen at run time by name (e.g. "PATHORAM", "TFORESTORAM").
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ * src/include/backend/storage/soe_oram_backend.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SOE_ORAM_BACKEND_H
+#define SOE_ORAM_BACKEND_H
+
+#include "soe_c.h"
+
+#include <oram/oram.h>
+#include <oram/stash.h>
+#include <oram/pmap.h>
+#include <oram/ofile.h>
+
+/* Number of integers of the token set before an access (see prf). */
+#define ORAM_TOKEN_SIZE 4
+
+typedef ORAMState (*oram_init_function) (const char *file, unsigned int nblocks,
+										 unsigned int blocksize,
+										 unsigned int bucketcapacity,
+										 Amgr * amgr, void *appData);
+typedef int (*oram_read_function) (char **ptr, BlockNumber blkno,
+								   ORAMState state, void *appData);
+typedef int (*oram_write_function) (char *ptr, unsigned int blksize,
+									BlockNumber blkno, ORAMState state,
+									void *appData);
+typedef void (*oram_close_function) (ORAMState state, void *appData);
+typedef void (*oram_settoken_function) (ORAMState state, unsigned int *token);
+typedef void (*oram_logstashes_function) (ORAMState state);
+typedef Stash *(*oram_stash_function) (void);
+typedef PMap *(*oram_pmap_function) (void);
+
+typedef struct ORAMBackend
+{
+	const char *name;
+
+	/*
+	 * Token based constructions derive the position of a block from a PRF
+	 * token set before each access instead of a position map. The search
+	 * code must then keep the per child access counters on the tree pages.
+	 */
+	bool		tokens;
+
+	oram_init_function init;
+	oram_read_function read;
+	oram_write_function write;
+	oram_close_function close;
+	oram_settoken_function settoken;
+	oram_logstashes_function logstashes;
+	oram_stash_function stashcreate;
+	oram_pmap_function pmapcreate;
+}			ORAMBackend;
+
+/*
+ * Returns the backend named name, the default backend if name is NULL or
+ * empty, or NULL if no linked backend has that name.
+ */
+extern const ORAMBackend *GetORAMBackend(const char *name);
+
+#endif							/* SOE_ORAM_BACKEND_H */
@@ -4,6 +4,10 @@
 #include "storage/soe_buf.h"
 #include "storage/soe_bufpage.h"
 #include "storage/soe_block.h"
+#include "storage/soe_oram_backend.h"
+#include "storage/soe_snapshot.h"
+#include "storage/soe_bulkload.h"
+#include "access/soe_skey.h"
 
 
 #include <oram/oram.h>
@@ -36,6 +40,7 @@ typedef struct OSTreeState
 	int			nlevels;
 	unsigned int iOid;
 	ORAMState  *orams;
+	const ORAMBackend *backend;
 	char	   *iname;
 }		   *OSTreeState;
 
@@ -60,10 +65,24 @@ typedef struct OSTRelation
 	/* Array of list of buffers. One list of buffer per level. */
 	List	  **buffers;
 	TupleDesc	tDesc;
+	/* comparator of the index keys, chosen from the type of tDesc */
+	keycmp_function keycmp;
 
 	/* used to cache metapages, I do not think it will be used. */
 	void	   *rd_amcache;
 
+	/* Writes waiting to be evicted to the level ORAMs, oldest first. */
+	List	   *pending;
+
+	/* Bulk load of each level ORAM, indexed by level, or NULL. */
+	BulkLoad   *bulks;
+
+	/*
+	 * Blocks of each level in use, from the root (nlevels + 1 entries). The
+	 * other blocks of a level are the free pages of its splits.
+	 */
+	int		   *levelBlocks;
+
 }		   *OSTRelation;
 
 
@@ -73,6 +92,16 @@ typedef struct OSTVBlock
 	char	   *page;
 }		   *OSTVBlock;
 
+/* Copy of a dirty page of a level ORAM and of its token. */
+typedef struct OSTPendingWrite
+{
+	int			id;
+	int			level;
+	char	   *page;
+	bool		hasToken;
+	unsigned int token[ORAM_TOKEN_SIZE];
+}		   *OSTPendingWrite;
+
 /*
  * RelationGetRelid
  *		Returns the OID of the relation
@@ -93,6 +122,10 @@ extern void ReleaseBuffer_ost(OSTRelation relation, Buffer buffer);
 
 extern BlockNumber BufferGetBlockNumber_ost(Buffer buffer);
 
+extern int FlushWrites_ost(OSTRelation rel, int maxWrites);
+extern void SaveOSTRelation_ost(OSTRelation rel, Snapshot snap);
+extern bool RestoreOSTRelation_ost(OSTRelation rel, Snapshot snap);
+
 extern void closeOSTRelation(OSTRelation rel);
 
 /* extern void setclevel(unsigned int nlevel); */
@@ -6,6 +6,7 @@
 #include "storage/soe_bufpage.h"
 #include "storage/soe_bufmgr.h"
 #include "storage/soe_ost_bufmgr.h"
+#include "storage/soe_snapshot.h"
 
 #include <oram/ofile.h>
 
@@ -14,6 +15,9 @@ extern void init_root(const char* filename);
 extern void ost_status(OSTreeState state);
 extern AMOFile * ost_ofileCreate();
 
+extern void ost_saveOffsets(OSTreeState state, Snapshot snap);
+extern bool ost_restoreOffsets(OSTreeState state, Snapshot snap);
+
 void		ost_pageInit(Page page, int blkno, Size blocksize);
 
 void		ost_fileRead(FileHandler handler, PLBlock block, const char *filename, const BlockNumber ob_blkno, void *appData);
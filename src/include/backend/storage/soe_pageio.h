@@ -0,0 +1,30 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_pageio.h
+ *	  Encrypted page I/O of the oblivious files.
+ *
+ * The ofiles of the heap, nbtree, hash and ost ORAMs read and write their
+ * pages through these functions. A page is decrypted in place in the block
+ * it is read into and encrypted straight into the buffer it is written
+ * from, so it is not copied through a separate ciphertext page. When the
+ * host registers an untrusted page buffer with the setIOBuffer enclave call,
+ * the pages cross the enclave boundary through it without being marshalled
+ * by the ocalls.
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ * src/include/backend/storage/soe_pageio.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SOE_PAGEIO_H
+#define SOE_PAGEIO_H
+
+#include "soe_c.h"
+
+extern bool pageio_setBuffer(char *buffer, unsigned int size);
+extern bool pageio_read(char *page, const char *filename, int blkno);
+extern char *pageio_encrypt(char *page);
+extern bool pageio_write(char *encPage, const char *filename, int blkno);
+
+#endif							/* SOE_PAGEIO_H */
@@ -0,0 +1,42 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_pmap.h
+ *	  Position maps of the ORAMs without tokens.
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ * src/include/backend/storage/soe_pmap.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SOE_PMAP_H
+#define SOE_PMAP_H
+
+#include "soe_c.h"
+#include "storage/soe_oram_backend.h"
+#include "storage/soe_snapshot.h"
+
+#include <oram/pmap.h>
+
+/*
+ * ORAMs with more blocks than PMAP_THRESHOLD keep their position map in a
+ * smaller ORAM (stored in the file <name>_pmap) instead of the enclave memory.
+ */
+#ifndef PMAP_THRESHOLD
+#define PMAP_THRESHOLD (1 << 22)
+#endif
+
+extern PMap *soe_pmapCreate(const char *name, const ORAMBackend *backend);
+extern bool soe_pmapSet(const char *name, BlockNumber blkno, TreePath leaf);
+
+extern unsigned long long soe_pmapSize(unsigned int nblocks);
+
+/*
+ * Sealing of the maps kept in the enclave. The maps loaded by soe_pmapLoad
+ * are used by the next maps created with the same name.
+ */
+extern void soe_pmapSave(Snapshot snap);
+extern bool soe_pmapLoad(Snapshot snap);
+extern bool soe_pmapLoadDone(void);
+
+#endif							/* SOE_PMAP_H */
@@ -0,0 +1,10 @@
+#ifndef SOE_SINGLE_OFILE_H
+#define SOE_SINGLE_OFILE_H
+
+#include "soe_c.h"
+
+#include <oram/ofile.h>
+
+extern AMOFile * single_ofileCreate();
+
+#endif							/* SOE_SINGLE_OFILE_H */
@@ -0,0 +1,83 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_snapshot.h
+ *	  Serialization of the enclave state sealed by sealState.
+ *
+ * A snapshot holds the state that only exists inside the enclave: the
+ * parameters the relations were initialized with, the relation metadata,
+ * the position maps and the blocks held in the ORAM stashes. The encrypted
+ * ORAM files are not part of the snapshot; restoreState reattaches to them.
+ *
+ * The ORAM library does not expose its stashes, so with SEAL_STATE the
+ * oblivious files track the ids of the blocks that leave them until they are
+ * evicted again (see snapshot_blockIn/snapshot_blockOut), and the stashes
+ * are emptied with dummy accesses before the state is sealed.
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ * src/include/backend/storage/soe_snapshot.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SOE_SNAPSHOT_H
+#define SOE_SNAPSHOT_H
+
+#include "soe_c.h"
+#include "storage/soe_oram_backend.h"
+
+#include <oram/plblock.h>
+
+#define SNAPSHOT_MAGIC		0x534f4553
+#define SNAPSHOT_VERSION	6
+
+/* Dummy accesses made to every ORAM to empty the stashes before sealing. */
+#ifndef SEAL_EVICT_ACCESSES
+#define SEAL_EVICT_ACCESSES 1024
+#endif
+
+/* Growable buffer a snapshot is written to or read from. */
+typedef struct SnapshotData
+{
+	char	   *data;
+	unsigned int len;
+	unsigned int size;
+	unsigned int cursor;
+	bool		failed;
+	bool		counting;		/* only len is kept (snapshot_count) */
+}			SnapshotData;
+
+typedef SnapshotData * Snapshot;
+
+/*
+ * While set, the oblivious files skip the initialization of the files, as the
+ * ORAMs being created are reattached to the files of a sealed state.
+ */
+extern bool snapshot_restoring;
+
+extern Snapshot snapshot_create(void);
+extern Snapshot snapshot_count(void);
+extern Snapshot snapshot_open(char *data, unsigned int len);
+extern void snapshot_destroy(Snapshot snap);
+
+extern void snapshot_put(Snapshot snap, const void *src, unsigned int len);
+extern void snapshot_putInt(Snapshot snap, unsigned int value);
+extern void snapshot_putString(Snapshot snap, const char *str);
+
+extern bool snapshot_get(Snapshot snap, void *dest, unsigned int len);
+extern unsigned int snapshot_getInt(Snapshot snap);
+extern char *snapshot_getString(Snapshot snap);
+
+/* Tracking of the blocks held in the ORAM stashes. */
+extern void snapshot_registerORAM(const char *name, int level,
+								  unsigned int nblocks, ORAMState oram,
+								  const ORAMBackend *backend);
+extern void snapshot_unregisterORAM(ORAMState oram);
+extern void snapshot_blockIn(const char *name, int level, PLBlock block);
+extern void snapshot_blockOut(const char *name, int level, BlockNumber blkno);
+extern void snapshot_blockWrite(ORAMState oram, BlockNumber blkno);
+
+extern bool snapshot_evictStashes(void);
+extern void snapshot_saveStashes(Snapshot snap);
+extern bool snapshot_restoreStashes(Snapshot snap);
+
+#endif							/* SOE_SNAPSHOT_H */
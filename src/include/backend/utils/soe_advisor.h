@@ -0,0 +1,45 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_advisor.h
+ *	  ORAM parameter advisor.
+ *
+ *	  Estimates the heap and index ORAM configuration (bucket capacity, OST
+ *	  levels and per-level sizes) for a relation by running the ORAM library
+ *	  over an in-memory oblivious file.
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ * src/include/backend/utils/soe_advisor.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SOE_ADVISOR_H
+#define SOE_ADVISOR_H
+
+#include "soe_c.h"
+#include "ops.h"
+#include "storage/soe_oram_backend.h"
+
+/*
+ * Upper bound on the number of blocks of a simulated ORAM. Larger relations
+ * are simulated at this size and the measured bandwidth is extrapolated to
+ * the height of the real tree.
+ */
+#define ADVISOR_SIM_BLOCKS		1024
+
+/* Number of random accesses issued after loading a simulated ORAM. */
+#define ADVISOR_SIM_ACCESSES	2048
+
+/*
+ * Largest stash occupancy (in blocks) accepted for a configuration. Settings
+ * whose simulated stash grows past this bound are considered at risk of
+ * overflowing.
+ */
+#define ADVISOR_MAX_STASH		128
+
+extern int	advise_oram(unsigned int nTuples, unsigned int tupleSize,
+						unsigned int keySize, unsigned int epcBudgetMB,
+						const ORAMBackend *tBackend,
+						const ORAMBackend *iBackend, SOEAdvice * advice);
+
+#endif							/* SOE_ADVISOR_H */
@@ -18,4 +18,8 @@
 void        prf(unsigned int level, unsigned int offset, unsigned int counter, unsigned int *token);
 
 unsigned int   getRandomInt();
+
+unsigned int   prf_keysize(void);
+void        prf_getkey(unsigned char *dest);
+void        prf_setkey(const unsigned char *src);
 #endif          /*SOE_PE_H*/
@@ -0,0 +1,27 @@
+/*-------------------------------------------------------------------------
+ *
+ * soe_seal.h
+ *	  Sealing of the enclave state.
+ *
+ * In an SGX enclave the state is sealed with the enclave sealing key. In the
+ * UNSAFE mode it is encrypted with a key stored on the file SEAL_KEY_FILE.
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef SOE_SEAL_H
+#define SOE_SEAL_H
+
+/* Size of the sealed form of plainSize bytes. */
+unsigned int seal_size(unsigned int plainSize);
+
+/* Both functions return 0 on success. unseal_data allocates *plain. */
+int			seal_data(const char *plain, unsigned int plainSize, char *sealed,
+					  unsigned int sealedSize);
+int			unseal_data(const char *sealed, unsigned int sealedSize,
+						char **plain, unsigned int *plainSize);
+
+#endif          /*SOE_SEAL_H*/
@@ -44,6 +44,30 @@
 #define ERROR		20			/* user error - abort transaction; return to
 								 * known state */
 
-void		selog(int level, const char *message,...);
+/*
+ * Messages below LOG_MIN_LEVEL are compiled out; the release builds set it
+ * to LOG so the DEBUG messages cost nothing. Messages below log_min_level,
+ * set at runtime with the setLogLevel enclave call, are dropped before they
+ * are formatted.
+ */
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL DEBUG5
+#endif
+
+/* Size of the enclave buffer of the log lines sent in a single ocall. */
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 4096
+#endif
+
+extern int	log_min_level;
+
+#define selog(level, ...) \
+	do { \
+		if ((level) >= LOG_MIN_LEVEL && (level) >= log_min_level) \
+			selog_emit(level, __VA_ARGS__); \
+	} while (0)
+
+extern void selog_emit(int level, const char *message,...);
+extern void selog_flush(void);
 
 #endif              /* SOE_LOGGER_H */
@@ -618,6 +618,38 @@ typedef uintptr_t Datum;
 #define NameGetDatum_s(X) CStringGetDatum_s(NameStr_s(*(X)))
 
 
+/*
+ * struct varatt_external is a traditional "TOAST pointer", that is, the
+ * information needed to fetch a Datum stored out-of-line in a TOAST table.
+ * The data is compressed if and only if va_extsize < va_rawsize - VARHDRSZ.
+ */
+typedef struct varatt_external
+{
+	int32		va_rawsize;		/* Original data size (includes header) */
+	int32		va_extsize;		/* External saved size (doesn't) */
+	Oid			va_valueid;		/* Unique ID of value within TOAST table */
+	Oid			va_toastrelid;	/* RelID of TOAST table containing it */
+}			varatt_external;
+
+/*
+ * Type tag for the various sorts of "TOAST pointer" datums. Only on-disk
+ * pointers are found in the tuples given to the enclave; the others point
+ * to memory of a backend.
+ */
+typedef enum vartag_external
+{
+	VARTAG_INDIRECT = 1,
+	VARTAG_EXPANDED_RO = 2,
+	VARTAG_EXPANDED_RW = 3,
+	VARTAG_ONDISK = 18
+}			vartag_external;
+
+#define VARTAG_IS_EXPANDED_S(tag) \
+	(((tag) & ~1) == VARTAG_EXPANDED_RO)
+
+#define VARTAG_SIZE_S(tag) \
+	((tag) == VARTAG_ONDISK ? sizeof(varatt_external) : 0)
+
 /*
  * These structs describe the header of a varlena object that may have been
  * TOASTed.  Generally, don't reference these structs directly, but use the
@@ -755,6 +787,7 @@ typedef union
 	(VARSIZE_S(PTR) - VARHDRSZ + VARHDRSZ_SHORT)
 
 #define VARHDRSZ_EXTERNAL		offsetof_s(varattrib_1b_e, va_data)
+#define VARHDRSZ				((int32) sizeof(int32))
 
 #define VARDATA_4B_S(PTR)		(((varattrib_4b *) (PTR))->va_4byte.va_data)
 #define VARDATA_4B_C_S(PTR)	(((varattrib_4b *) (PTR))->va_compressed.va_data)
@@ -821,6 +854,11 @@ typedef union
 	 (VARATT_IS_1B_S(PTR) ? VARSIZE_1B_S(PTR)-VARHDRSZ_SHORT : \
 	  VARSIZE_4B_S(PTR)-VARHDRSZ))
 
+/* Size of a varlena data, including header */
+/* caution: this will not work on an external Datum */
+#define VARSIZE_ANY_S(PTR) \
+	(VARATT_IS_1B_S(PTR) ? VARSIZE_1B_S(PTR) : VARSIZE_4B_S(PTR))
+
 /* caution: this will not work on an external or compressed-in-line Datum */
 /* caution: this will return a possibly unaligned pointer */
 #define VARDATA_ANY_S(PTR) \
@@ -844,6 +882,8 @@ typedef union
  */
 typedef uint16 StrategyNumber;
 
+#define InvalidStrategy ((StrategyNumber) 0)
+
 /*
  * Strategy numbers for B-tree indexes.
  */
@@ -904,11 +944,13 @@ struct varlena
 
 
 typedef struct varlena BpChar;	/* blank-padded char, ie SQL char(n) */
+typedef struct varlena bytea;
 
 #define PG_DETOAST_DATUM_PACKED_S(datum) \
 	((struct varlena *) datum)
 
 #define DatumGetBpCharPP_S(X)			((BpChar *) PG_DETOAST_DATUM_PACKED_S(X))
+#define DatumGetByteaPP_S(X)			((bytea *) PG_DETOAST_DATUM_PACKED_S(X))
 
 
 #define PointerIsValid_s(pointer) ((const void*)(pointer) != NULL)
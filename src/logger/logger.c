@@ -1,3 +1,18 @@
+/*-------------------------------------------------------------------------
+ *
+ * logger.c
+ *	  Log messages of the enclave and of the ORAM library.
+ *
+ * The selog macro (logger.h) drops the messages below the minimum level
+ * before they are formatted. The others are appended as lines to a buffer
+ * in the enclave that is sent to the host with a single oc_logger ocall
+ * when it is full, when an ERROR is logged, when the host calls flushLog
+ * and when the enclave is closed, instead of one ocall per message.
+ *
+ * Copyright (c) 2018-2019, HASLab
+ *
+ *-------------------------------------------------------------------------
+ */
 
 #include "logger/logger.h"
 
@@ -14,48 +29,71 @@
 #include <oram/logger.h>
 
 
+#if LOG_BUFFER_SIZE <= BUFSIZE
+#error "LOG_BUFFER_SIZE must hold a message of BUFSIZE bytes"
+#endif
+
+int			log_min_level = LOG_MIN_LEVEL;
+
+/* Lines logged since the last ocall, terminated by a null. */
+static char logBuffer[LOG_BUFFER_SIZE];
+static int	logUsed = 0;
+
+/* Sends the buffered lines to the host. */
 void
-logger(int level, const char *message,...)
+selog_flush(void)
 {
-	/* char* buf = (char*) malloc(sizeof(char)*BUFSIZE); */
-	char		buf[BUFSIZE];
+	if (logUsed == 0)
+		return;
+	logBuffer[logUsed] = '\0';
+	oc_logger(logBuffer);
+	logUsed = 0;
+}
 
-	memset(buf, 0, BUFSIZE);
-	/* int written = 0; */
-	/* int result; */
-	va_list		ap;
+/* Formats a message and appends it as a line to the buffer. */
+static void
+selog_append(int level, const char *message, va_list ap)
+{
+	char		buf[BUFSIZE];
+	int			len;
 
-	va_start(ap, message);
+	len = vsnprintf(buf, BUFSIZE, message, ap);
+	if (len < 0)
+		return;
+	/* longer messages are truncated */
+	len = len < BUFSIZE ? len : BUFSIZE - 1;
 
-	/*
-	 * written = vsnprintf(buf, BUFSIZE, message, ap); if(written < BUFSIZE){
-	 * buf = realloc(buf, sizeof(char)*written); memset(buf, 0, written); }
-	 */
+	/* a line and the null that terminates the buffer */
+	if (logUsed + len + 2 > LOG_BUFFER_SIZE)
+		selog_flush();
+	memcpy(logBuffer + logUsed, buf, len);
+	logUsed += len;
+	logBuffer[logUsed++] = '\n';
 
-	vsnprintf(buf, BUFSIZE, message, ap);
-	va_end(ap);
-	oc_logger(buf);
+	if (level >= ERROR)
+		selog_flush();
 }
 
 void
-selog(int level, const char *message,...)
+logger(int level, const char *message,...)
 {
-	/* char* buf = (char*) malloc(sizeof(char)*BUFSIZE); */
-	char		buf[BUFSIZE];
-
-	memset(buf, 0, BUFSIZE);
-	/* int written = 0; */
-	/* int result; */
 	va_list		ap;
 
+	if (level < LOG_MIN_LEVEL || level < log_min_level)
+		return;
+
 	va_start(ap, message);
+	selog_append(level, message, ap);
+	va_end(ap);
+}
 
-	/*
-	 * written = vsnprintf(buf, BUFSIZE, message, ap); if(written < BUFSIZE){
-	 * buf = realloc(buf, sizeof(char)*written); memset(buf, 0, written); }
-	 */
+/* The messages of selog that pass the minimum level. */
+void
+selog_emit(int level, const char *message,...)
+{
+	va_list		ap;
 
-	vsnprintf(buf, BUFSIZE, message, ap);
+	va_start(ap, message);
+	selog_append(level, message, ap);
 	va_end(ap);
-	oc_logger(buf);
 }